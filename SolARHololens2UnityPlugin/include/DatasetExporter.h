@@ -0,0 +1,86 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Export of a recording to the dataset layouts read by offline SolAR benchmarks, see
+// tools/SolARRecordingExport.cpp for the command line.
+//
+// Input is a Container recording (.slrec, read through its chunk indexes) or the folder of a
+// SeparateFiles recording (<sensor>.tar read through a TarballReader index, pose trajectories).
+// Frames are decoded and written as PNG by a work-stealing pool (Eigen NonBlockingThreadPool),
+// one task per frame, interleaved across streams; index files are written once all frames are.
+// Timestamps of the recordings are absolute, in hundreds of nanoseconds since 1601.
+//
+// Layouts:
+//   EuRoC	mav0/cam0..cam3 (LEFT_FRONT, RIGHT_FRONT, LEFT_LEFT, RIGHT_RIGHT), cam4 (PV, RGB),
+//			depth0 (depth plane, 16-bit millimeters): data/<ns>.png and data.csv.
+//			imu0/data.csv: gyroscope samples with the accelerometer interpolated at their
+//			timestamps. state_groundtruth_estimate0/data.csv. Nanoseconds since 1970.
+//   TUM	rgb (PV), depth (16-bit, 5000 per meter), left_front... (VLC): <s>.png and <dir>.txt.
+//			groundtruth.txt, accelerometer.txt. Seconds since 1970.
+//   SolAR	<STREAM>/images/<timestamp>.png and <STREAM>/frames.csv with the sensor to world pose
+//			of each frame (row-major 4x4, as the frame metadata), head_pose.csv, imu_accel.csv,
+//			imu_gyro.csv, imu_mag.csv. Recording timestamps.
+// Ground truth is the head pose (HoloLens axes: x right, y up, z backward) or, in recordings
+// without head poses, the rig to world pose of the first recorded VLC camera.
+// IMU samples and head poses are only recorded by Container recordings, AB planes are not exported.
+// No platform dependency.
+
+#include "NetworkProtocol.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+enum class DatasetLayout
+{
+	EuRoC,
+	TUM,
+	SolAR
+};
+
+struct DatasetExportSettings
+{
+	DatasetLayout layout = DatasetLayout::EuRoC;
+	// Exported time range, in hundreds of nanoseconds from the first record of the recording
+	uint64_t startOffset = 0;
+	uint64_t endOffset = UINT64_MAX;
+	// GetStreamBit() of the exported streams (frames, IMU sensors and HEAD_POSE), ~0u for all
+	uint32_t streamMask = ~0u;
+	// Conversion threads, 0 for one per hardware thread
+	unsigned threadCount = 0;
+};
+
+struct DatasetExportStats
+{
+	uint64_t frames = 0;				// images written
+	uint64_t failedFrames = 0;			// malformed or not written
+	uint64_t imageBytes = 0;
+	uint64_t imuSamples = 0;
+	uint64_t poses = 0;					// ground truth or head poses
+};
+
+// Return false with error set if the recording cannot be read or the output cannot be written.
+// Frames which fail individually are counted in stats.failedFrames.
+bool ExportDataset(const std::filesystem::path& input, const std::filesystem::path& output,
+				   const DatasetExportSettings& settings, DatasetExportStats& stats, std::string& error);
+
+// Stream of a command line argument: "PV", "LEFT_FRONT", ..., "HEAD_POSE" (GetSharedStreamName()
+// without prefix), case insensitive
+bool ParseStreamName(const std::string& name, SharedStream& stream);
+// "euroc", "tum" or "solar", case insensitive
+bool ParseDatasetLayout(const std::string& name, DatasetLayout& layout);
@@ -0,0 +1,49 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "RMCameraReader.h"
+
+// Reader for the depth cameras (DEPTH_AHAT, DEPTH_LONG_THROW)
+class DepthCameraReader : public RMCameraReaderT<DepthCameraReader, IResearchModeSensorDepthFrame>
+{
+public:
+	DepthCameraReader(IResearchModeSensor* pLLSensor, HANDLE camConsentGiven, ResearchModeSensorConsent* camAccessConsent, const GUID& guid)
+		: RMCameraReaderT(pLLSensor, camConsentGiven, camAccessConsent, guid)
+	{
+		m_isLongThrow = (m_sensorType == DEPTH_LONG_THROW);
+	}
+
+	// Result is a concatenation of depth and AB data
+	// Return an empty array unless status is FrameRequestStatus::NewFrame.
+	// rigToWorldtransform is the identity, and poseValid false, if the rig could not be located.
+	winrt::com_array<uint16_t> getDepthSensorData(uint64_t lastSeenSequence, FrameRequestStatus& status, uint64_t& sequence, uint64_t& timestamp, winrt::Windows::Foundation::Numerics::float4x4& rigToWorldtransform, bool& poseValid, uint32_t& pixelBufferSize, uint32_t& width, uint32_t& height);
+
+protected:
+	friend class RMCameraReaderT<DepthCameraReader, IResearchModeSensorDepthFrame>;
+
+	// Lock on m_storageMutex and m_sensorFrameMutex from caller
+	void SaveFrame(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorDepthFrame* pDepthFrame);
+	// Depth plane (invalid pixels set to 0) followed by AB plane, 16 bits per pixel.
+	// Lock on m_sensorFrameMutex from caller
+	void FillSharedFrameData(IResearchModeSensorDepthFrame* pDepthFrame, SharedFrame& frame);
+	// Depth frames are not affected by motion blur the same way, they are never scored
+	float ComputeSharpness(IResearchModeSensorFrame*, IResearchModeSensorDepthFrame*) { return FrameQuality::kNoScore; }
+
+	// Long throw frames carry a sigma buffer used for invalidation, AHAT frames rely on a depth threshold
+	bool m_isLongThrow = false;
+};
@@ -0,0 +1,78 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Eye gaze sampled in the render loop, queried at the timestamps of camera frames.
+// No platform dependency.
+
+#include "HeadPoseHistory.h"
+#include "PoseLogWriter.h"
+#include "TimestampedRing.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Eye gaze ray, in the coordinate system of the camera frame transforms
+struct EyeGaze
+{
+	float origin[3] = { 0.f, 0.f, 0.f };
+	float direction[3] = { 0.f, 0.f, -1.f };	// unit vector
+};
+
+// Eye gaze sampled once per render frame (MixedReality::Update), timestamped with the predicted
+// display time of the frame (absolute ticks, the clock of PV frames).
+// Samples are kept in a preallocated ring so that camera frames can be matched with the gaze
+// afterwards without querying the system again.
+class EyeGazeStream
+{
+public:
+	using Entry = TimestampedRing<EyeGaze>::Entry;
+
+	// About 17 seconds at 60 Hz
+	static constexpr size_t kDefaultCapacity = 1024;
+	// Samples further apart than this are not interpolated (tracking was lost in between). Sampled
+	// with the head pose, once per render frame: same gap.
+	static constexpr uint64_t kMaxInterpolationGap = HeadPoseHistory::kMaxInterpolationGap;
+
+	explicit EyeGazeStream(size_t capacity = kDefaultCapacity);
+
+	// Called from the render loop. Return false if timestamp is not newer than the last sample.
+	bool Record(uint64_t timestamp, const EyeGaze& gaze);
+
+	// Append samples with a timestamp greater than sinceTimestamp, oldest first
+	void GetSamples(uint64_t sinceTimestamp, std::vector<Entry>& samples) const { m_samples.Read(sinceTimestamp, samples); }
+	// Gaze at timestamp, linearly interpolated between the surrounding samples (direction is
+	// renormalized). Return false if timestamp is outside the buffered window or in a tracking gap.
+	bool GetGazeAtTimestamp(uint64_t timestamp, EyeGaze& gaze) const;
+
+	// Stream samples recorded between StartRecording() and StopRecording() to path
+	// (<datetime_path>_eye.txt in the recording folder), one line per sample:
+	// timestamp,originX,originY,originZ,directionX,directionY,directionZ
+	bool StartRecording(const std::wstring& path);
+	void StopRecording();
+
+	// Portable interpolation between two samples, before.timestamp <= timestamp <= after.timestamp
+	static EyeGaze Interpolate(const Entry& before, const Entry& after, uint64_t timestamp);
+
+private:
+	TimestampedRing<EyeGaze> m_samples;
+
+	ProfiledMutex m_logMutex{ "EyeGazeStream::m_logMutex" };
+	PoseLogWriter m_log;
+};
@@ -0,0 +1,51 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Clock of the frame timestamps returned by the getters of each stream. The PV frames and the
+// depth reader are on the absolute clock, the VLC readers return the host ticks of the Research
+// Mode frame (relative QPC time), both in hundreds of nanoseconds.
+// No platform dependency.
+
+#include "ImuSampleRing.h"
+#include "SharedMemoryRing.h"
+
+enum class FrameClock
+{
+	Absolute,
+	HostTicks
+};
+
+inline FrameClock GetFrameClock(SharedStream stream)
+{
+	switch (stream)
+	{
+	case SharedStream::LEFT_FRONT:
+	case SharedStream::LEFT_LEFT:
+	case SharedStream::RIGHT_FRONT:
+	case SharedStream::RIGHT_RIGHT:
+		return FrameClock::HostTicks;
+	default:
+		return FrameClock::Absolute;
+	}
+}
+
+// Member of ImuSample holding the time on that clock
+inline uint64_t ImuSample::* GetImuSampleClock(FrameClock clock)
+{
+	return clock == FrameClock::Absolute ? &ImuSample::timestamp : &ImuSample::hostTicks;
+}
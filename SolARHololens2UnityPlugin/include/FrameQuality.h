@@ -0,0 +1,65 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Image sharpness scoring used to drop motion blurred frames before they are copied.
+// Score is the variance of the 4-neighbour Laplacian of the luminance, computed on every
+// rowStep-th row (all the columns of a row are used, so that rows are processed with NEON on
+// ARM64). Higher is sharper, the value depends on the scene texture and sensor: thresholds must
+// be tuned per stream.
+namespace FrameQuality
+{
+	constexpr uint32_t kDefaultRowStep = 4;
+
+	// Score reported when a frame has not been scored (e.g. depth frames)
+	constexpr float kNoScore = -1.f;
+
+	// 8 bits grayscale image (VLC frames, luminance plane of NV12 frames)
+	float SharpnessGray8(const uint8_t* pImage, uint32_t width, uint32_t height, uint32_t stride, uint32_t rowStep = kDefaultRowStep);
+
+	// BGRA 8 image (converted PV frames), the green channel is used as luminance
+	float SharpnessBgra8(const uint8_t* pImage, uint32_t width, uint32_t height, uint32_t stride, uint32_t rowStep = kDefaultRowStep);
+}
+
+// Drops frames whose sharpness score is below a threshold. Threshold 0 disables the filter.
+// SetThreshold() may be called from any thread.
+class SharpnessFilter
+{
+public:
+	void SetThreshold(float minSharpness) { m_minSharpness = minSharpness; }
+	float GetThreshold() const { return m_minSharpness; }
+	bool IsEnabled() const { return m_minSharpness > 0.f; }
+
+	bool Accept(float sharpness)
+	{
+		if (!IsEnabled() || sharpness == FrameQuality::kNoScore || sharpness >= m_minSharpness)
+		{
+			return true;
+		}
+		m_rejected++;
+		return false;
+	}
+
+	uint64_t GetRejectedCount() const { return m_rejected; }
+
+private:
+	std::atomic<float> m_minSharpness = 0.f;
+	std::atomic<uint64_t> m_rejected = 0;
+};
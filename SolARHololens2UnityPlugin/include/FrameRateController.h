@@ -0,0 +1,76 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// No platform dependency: poses are KeyframePose (see ToKeyframePose()), so that decimation can be
+// tested off-device.
+
+#include "KeyframeSelector.h"
+#include "LockProfiler.h"
+
+#include <atomic>
+#include <cstdint>
+
+// Decimation settings of a stream. Default values keep every frame.
+struct FrameRateSettings
+{
+	// Maximum number of frames per second kept, 0 for sensor rate
+	float targetFps = 0.f;
+	// Keep one frame out of keepEveryNth sensor frames, 0 or 1 to keep all of them
+	uint32_t keepEveryNth = 1;
+	// A frame is kept only if the sensor moved by at least minTranslation (meters)
+	// or minRotationDeg (degrees) since the last kept frame, 0 to disable
+	float minTranslation = 0.f;
+	float minRotationDeg = 0.f;
+};
+
+// Decides, at the source, which sensor frames of a stream are kept.
+// Checks are split in two stages so that capture threads can reject a frame before looking up
+// its pose, and before any conversion or copy:
+//   if (!AcceptTimestamp(t)) drop;
+//   if (RequiresPose() && !AcceptPose(pose)) drop;
+//   Commit(t, pose);
+// Configure() may be called from any thread, other methods from the capture thread only.
+class FrameRateController
+{
+public:
+	void Configure(const FrameRateSettings& settings);
+	FrameRateSettings GetSettings();
+
+	// timestamp in hundreds of nanoseconds
+	bool AcceptTimestamp(uint64_t timestamp);
+	bool RequiresPose();
+	bool AcceptPose(const KeyframePose& toWorldTransform);
+	void Commit(uint64_t timestamp, const KeyframePose& toWorldTransform);
+	// Frame kept without a pose, pose delta is then measured from the last located kept frame
+	void Commit(uint64_t timestamp);
+
+	// Number of sensor frames dropped by the controller
+	uint64_t GetDecimatedCount() const { return m_decimated; }
+
+private:
+	ProfiledMutex m_settingsMutex{ "FrameRateController::m_settingsMutex" };
+	FrameRateSettings m_settings;
+
+	uint64_t m_arrivalIndex = 0;
+	bool m_hasKeptFrame = false;
+	bool m_hasKeptTransform = false;
+	uint64_t m_lastKeptTimestamp = 0;
+	KeyframePose m_lastKeptTransform{};
+
+	std::atomic<uint64_t> m_decimated = 0;
+};
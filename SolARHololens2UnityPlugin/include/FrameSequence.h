@@ -0,0 +1,115 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Result of a frame request made with the sequence number of the last frame seen by the caller
+enum class FrameRequestStatus
+{
+	NoFrame,		// Stream has not produced any frame yet
+	NotModified,	// Latest frame is the one the caller has already seen, no data returned
+	NewFrame		// Latest frame is returned
+};
+
+// Per-stream frame counters
+struct StreamFrameCounters
+{
+	uint64_t produced = 0;		// Frames received from the sensor
+	uint64_t consumed = 0;		// Frames returned to a consumer for the first time
+	uint64_t skipped = 0;		// Frames replaced by a newer one before any consumer got them
+	uint64_t duplicates = 0;	// Frames returned again after having already been consumed
+	uint64_t notModified = 0;	// Requests answered with FrameRequestStatus::NotModified
+	uint64_t decimated = 0;		// Sensor frames dropped at the source by rate control (see FrameRateController)
+	uint64_t blurry = 0;		// Sensor frames dropped at the source by the sharpness filter (see FrameQuality.h)
+};
+
+// Assigns a monotonically increasing sequence number (starting at 1) to the frames of a stream,
+// and keeps track of which of them were served to consumers.
+// Not thread safe: lock on the mutex guarding the stream latest frame from caller.
+class FrameSequence
+{
+public:
+	// Producer side: register a new latest frame and return its sequence number
+	uint64_t Produce()
+	{
+		if (m_latest != 0 && m_lastServed != m_latest)
+		{
+			m_counters.skipped++;
+		}
+		m_counters.produced++;
+		return ++m_latest;
+	}
+
+	// Consumer side: decide whether the latest frame must be returned to a caller
+	// which has already seen frame lastSeenSequence (0 if none)
+	FrameRequestStatus Request(uint64_t lastSeenSequence)
+	{
+		if (m_latest == 0)
+		{
+			return FrameRequestStatus::NoFrame;
+		}
+
+		if (m_latest == lastSeenSequence)
+		{
+			m_counters.notModified++;
+			return FrameRequestStatus::NotModified;
+		}
+
+		if (m_lastServed == m_latest)
+		{
+			m_counters.duplicates++;
+		}
+		else
+		{
+			m_counters.consumed++;
+			m_lastServed = m_latest;
+		}
+		return FrameRequestStatus::NewFrame;
+	}
+
+	// Consumer side: wait on condVar, with lock held on the mutex guarding the sequence, until a
+	// frame other than lastSeenSequence is produced, isStopped() or timeoutMs expires. The frame is
+	// not served: returns the status Request(lastSeenSequence) would report, sequence is Latest().
+	template <typename Lock, typename ConditionVariable, typename StopPredicate>
+	FrameRequestStatus Wait(Lock& lock, ConditionVariable& condVar, uint64_t lastSeenSequence, uint32_t timeoutMs,
+							StopPredicate isStopped, uint64_t& sequence) const
+	{
+		condVar.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]()
+		{
+			return isStopped() || (m_latest != 0 && m_latest != lastSeenSequence);
+		});
+
+		sequence = m_latest;
+		if (sequence == 0)
+		{
+			return FrameRequestStatus::NoFrame;
+		}
+		return sequence == lastSeenSequence ? FrameRequestStatus::NotModified : FrameRequestStatus::NewFrame;
+	}
+
+	uint64_t Latest() const { return m_latest; }
+	// True if the latest frame has already been returned by Request()
+	bool IsLatestServed() const { return m_latest != 0 && m_lastServed == m_latest; }
+	const StreamFrameCounters& Counters() const { return m_counters; }
+
+private:
+	uint64_t m_latest = 0;
+	uint64_t m_lastServed = 0;
+	StreamFrameCounters m_counters;
+};
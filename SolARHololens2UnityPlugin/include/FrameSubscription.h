@@ -0,0 +1,183 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "LockProfiler.h"
+#include "SolARHololens2PluginApi.h"
+#include "TaskExecutor.h"
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Immutable frame shared by all the subscribers of a stream.
+// Pixel data is copied once out of the sensor buffer by the producer, subscribers only
+// hold a reference on it.
+struct SharedFrame
+{
+	uint64_t sequence = 0;
+	// Absolute timestamp, in hundreds of nanoseconds
+	uint64_t timestamp = 0;
+	// Sensor (PV camera or rig) to world transform, as provided by the sensor (not transposed):
+	// the 16 floats of a winrt float4x4, see ToKeyframePose(). Identity if the sensor could not be
+	// located at timestamp.
+	std::array<float, 16> toWorldTransform = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f };
+	bool poseValid = false;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t bytesPerPixel = 0;
+	// Number of width x height planes in data (depth frames hold a depth plane followed by an AB plane)
+	uint32_t planeCount = 1;
+	// Sharpness score (see FrameQuality.h), -1 if the frame was not scored
+	float sharpness = -1.f;
+	std::vector<uint8_t> data;
+};
+
+using SharedFramePtr = std::shared_ptr<const SharedFrame>;
+
+// Metadata of frame as exported by the flat C API and the transports: row-major transform, in the
+// SolAR camera axes if solarCameraAxes (PV frames), the sensor axes otherwise, identity if the
+// frame pose is not valid
+void FillFrameMetadata(const SharedFrame& frame, bool solarCameraAxes, SolARHL2FrameMetadata& metadata);
+
+// Recycles frames, and the capacity of their data, once the producer and every subscriber
+// released them: in steady state, publishing a frame does not allocate its pixel buffer.
+// Frames can outlive the pool.
+class SharedFramePool
+{
+public:
+	// A few frames per subscriber queue plus the ones being read
+	static constexpr size_t kDefaultMaxPooledFrames = 8;
+
+	explicit SharedFramePool(size_t maxPooledFrames = kDefaultMaxPooledFrames);
+
+	// Frame with default header values and empty data
+	std::shared_ptr<SharedFrame> Allocate();
+	size_t GetPooledCount();
+
+private:
+	struct Storage
+	{
+		ProfiledMutex mutex{ "SharedFramePool::m_mutex" };
+		std::vector<std::unique_ptr<SharedFrame>> frames;
+		size_t maxPooledFrames = 0;
+	};
+
+	static void Recycle(const std::weak_ptr<Storage>& storage, SharedFrame* pFrame);
+
+	std::shared_ptr<Storage> m_storage;
+};
+
+// What to do when a frame is pushed to a full subscriber queue
+enum class DropPolicy
+{
+	DropOldest,	// Discard the oldest queued frame, subscriber always gets the latest frames
+	DropNewest	// Discard the incoming frame, subscriber gets an uninterrupted run of older frames
+};
+
+// Bounded frame queue of one subscriber. The producer never blocks on it.
+class FrameSubscriber
+{
+public:
+	// onPush is called by the producer, with the queue locked, after each queued frame
+	FrameSubscriber(size_t capacity, DropPolicy dropPolicy, std::function<void()> onPush = nullptr);
+
+	// Producer side
+	void Push(const SharedFramePtr& frame);
+
+	// Consumer side. Return false if the queue is empty (after timeoutMs for WaitPop)
+	// or the subscriber has been closed.
+	bool TryPop(SharedFramePtr& frame);
+	bool WaitPop(SharedFramePtr& frame, uint32_t timeoutMs);
+
+	// Wake up waiting consumers, no frame is queued after that
+	void Close();
+	bool IsClosed();
+
+	uint64_t GetReceivedCount();
+	uint64_t GetDroppedCount();
+
+private:
+	ProfiledMutex m_mutex{ "FrameSubscriber::m_mutex" };
+	std::condition_variable_any m_condVar;
+	std::deque<SharedFramePtr> m_queue;
+	const size_t m_capacity;
+	const DropPolicy m_dropPolicy;
+	const std::function<void()> m_onPush;
+	bool m_closed = false;
+	uint64_t m_received = 0;
+	uint64_t m_dropped = 0;
+};
+
+using FrameCallback = std::function<void(const SharedFramePtr&)>;
+
+// Subscriber whose frames are delivered to a callback by tasks of the shared executor, in order,
+// so that a slow callback never delays the capture thread nor other subscribers.
+// Unsubscribe by destroying the object.
+class FrameCallbackSubscription
+{
+public:
+	FrameCallbackSubscription(FrameCallback callback, size_t capacity, DropPolicy dropPolicy, TaskPriority priority);
+	~FrameCallbackSubscription();
+
+	FrameCallbackSubscription(const FrameCallbackSubscription&) = delete;
+	FrameCallbackSubscription& operator=(const FrameCallbackSubscription&) = delete;
+
+	const std::shared_ptr<FrameSubscriber>& GetSubscriber() const { return m_subscriber; }
+
+private:
+	// Deliver the queued frames
+	void Deliver();
+
+	FrameCallback m_callback;
+	// One pending delivery is enough, it delivers every frame queued when it runs
+	SerialTaskQueue m_deliveryQueue;
+	std::shared_ptr<FrameSubscriber> m_subscriber;
+};
+
+// Fan-out point of one stream: each published frame is queued once to every live subscriber.
+// Subscribers are held weakly, releasing the last reference on a subscriber unsubscribes it.
+class FramePublisher
+{
+public:
+	static constexpr size_t kDefaultQueueCapacity = 4;
+
+	std::shared_ptr<FrameSubscriber> Subscribe(size_t capacity = kDefaultQueueCapacity, DropPolicy dropPolicy = DropPolicy::DropOldest);
+	std::unique_ptr<FrameCallbackSubscription> Subscribe(FrameCallback callback, size_t capacity = kDefaultQueueCapacity, DropPolicy dropPolicy = DropPolicy::DropOldest,
+														 TaskPriority priority = TaskPriority::Capture);
+	void Unsubscribe(const std::shared_ptr<FrameSubscriber>& subscriber);
+
+	// Let producers skip building a SharedFrame nobody will read
+	bool HasSubscribers();
+	// Pooled frame to fill and publish
+	std::shared_ptr<SharedFrame> AllocateFrame() { return m_framePool.Allocate(); }
+
+	void Publish(const SharedFramePtr& frame);
+
+	// Close all the subscribers, e.g. when the stream stops
+	void CloseAll();
+
+private:
+	ProfiledMutex m_mutex{ "FramePublisher::m_mutex" };
+	std::vector<std::weak_ptr<FrameSubscriber>> m_subscribers;
+	SharedFramePool m_framePool;
+};
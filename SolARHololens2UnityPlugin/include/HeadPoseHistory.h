@@ -0,0 +1,69 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// History of head poses recorded once per render frame, queried at arbitrary timestamps by
+// interpolation instead of one SpatialPointerPose::TryGetAtTimestamp() call per query.
+// No platform dependency.
+
+#include "TimestampedRing.h"
+
+#include <cstdint>
+
+// Head pose as given by SpatialPointerPose::Head(): forward and up are unit vectors
+struct HeadPose
+{
+	float position[3] = { 0.f, 0.f, 0.f };
+	float forward[3] = { 0.f, 0.f, -1.f };
+	float up[3] = { 0.f, 1.f, 0.f };
+};
+
+enum class HeadPoseLookup
+{
+	Interpolated,	// pose interpolated between two buffered poses
+	OutsideWindow,	// timestamp is older than the oldest or newer than the newest buffered pose
+	TrackingGap		// surrounding poses are too far apart, tracking was likely lost in between
+};
+
+class HeadPoseHistory
+{
+public:
+	using Entry = TimestampedRing<HeadPose>::Entry;
+
+	// About 17 seconds at 60 Hz
+	static constexpr size_t kDefaultCapacity = 1024;
+	// Poses further apart than this are not interpolated
+	static constexpr uint64_t kMaxInterpolationGap = 1'000'000;	// 100 ms, in hundreds of nanoseconds
+
+	explicit HeadPoseHistory(size_t capacity = kDefaultCapacity) : m_poses(capacity, "HeadPoseHistory::m_poses") {}
+
+	// Return false if timestamp is not newer than the last recorded pose
+	bool Record(uint64_t timestamp, const HeadPose& pose) { return m_poses.Push(timestamp, pose); }
+	// Poses must all be expressed in the same coordinate system: clear when it changes
+	void Clear() { m_poses.Clear(); }
+
+	// pose is only set when the result is HeadPoseLookup::Interpolated
+	HeadPoseLookup Lookup(uint64_t timestamp, HeadPose& pose) const;
+
+	// Position is linearly interpolated, orientation is spherically interpolated on the rotations
+	// defined by (forward, up), which re-orthogonalizes the result.
+	// before.timestamp <= timestamp <= after.timestamp
+	static HeadPose Interpolate(const Entry& before, const Entry& after, uint64_t timestamp);
+
+private:
+	TimestampedRing<HeadPose> m_poses;
+};
@@ -0,0 +1,88 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// On-manifold IMU preintegration between two camera timestamps (Forster et al., "On-Manifold
+// Preintegration for Real-Time Visual-Inertial Odometry", 2017).
+// No platform dependency: samples come from ImuSampleRing, results are plain Eigen types.
+
+#include "ImuSampleRing.h"
+
+#include <Eigen/Dense>
+
+#include <vector>
+
+struct ImuPreintegrationParameters
+{
+	// Continuous time white noise densities, rad/s/sqrt(Hz) and m/s^2/sqrt(Hz)
+	double gyroNoiseDensity = 1.7e-4;
+	double accelNoiseDensity = 2.0e-3;
+	// Bias estimates at which the integration is linearized, in the IMU frame
+	Eigen::Vector3d gyroBias = Eigen::Vector3d::Zero();
+	Eigen::Vector3d accelBias = Eigen::Vector3d::Zero();
+};
+
+// Deltas are expressed in the IMU frame at the start of the interval. Gravity is not removed:
+// deltaVelocity and deltaPosition integrate the specific force measured by the accelerometer.
+struct PreintegratedImu
+{
+	uint64_t startTime = 0;
+	uint64_t endTime = 0;
+	double deltaTime = 0.0;			// seconds
+	uint32_t sampleCount = 0;		// gyroscope samples used
+
+	Eigen::Matrix3d deltaRotation = Eigen::Matrix3d::Identity();
+	Eigen::Vector3d deltaVelocity = Eigen::Vector3d::Zero();
+	Eigen::Vector3d deltaPosition = Eigen::Vector3d::Zero();
+
+	// Covariance of the [rotation, velocity, position] errors (rotation error is right-perturbation)
+	Eigen::Matrix<double, 9, 9> covariance = Eigen::Matrix<double, 9, 9>::Zero();
+
+	// First order corrections for a bias update, e.g. deltaRotation * Exp(dR_dbg * deltaGyroBias)
+	Eigen::Matrix3d dR_dbg = Eigen::Matrix3d::Zero();
+	Eigen::Matrix3d dV_dbg = Eigen::Matrix3d::Zero();
+	Eigen::Matrix3d dV_dba = Eigen::Matrix3d::Zero();
+	Eigen::Matrix3d dP_dbg = Eigen::Matrix3d::Zero();
+	Eigen::Matrix3d dP_dba = Eigen::Matrix3d::Zero();
+};
+
+class ImuPreintegrator
+{
+public:
+	explicit ImuPreintegrator(const ImuPreintegrationParameters& parameters = ImuPreintegrationParameters());
+
+	void Reset(uint64_t startTime);
+	// Integrate one step of dt seconds with constant angular rate (rad/s) and specific force (m/s^2)
+	void Integrate(const Eigen::Vector3d& angularRate, const Eigen::Vector3d& acceleration, double dt);
+	const PreintegratedImu& Result() const { return m_result; }
+
+	// Integrate [startTime, endTime] from gyroscope and accelerometer samples, timestamps read from
+	// their clock member. Each stream must have a sample at or before startTime and one at or after
+	// endTime. Steps are bounded by gyroscope samples, both streams are linearly interpolated at
+	// the middle of each step. Return false if the samples do not cover the interval.
+	static bool IntegrateInterval(const std::vector<ImuSample>& gyroSamples,
+								  const std::vector<ImuSample>& accelSamples,
+								  uint64_t ImuSample::* clock,
+								  uint64_t startTime,
+								  uint64_t endTime,
+								  const ImuPreintegrationParameters& parameters,
+								  PreintegratedImu& result);
+
+private:
+	ImuPreintegrationParameters m_parameters;
+	PreintegratedImu m_result;
+};
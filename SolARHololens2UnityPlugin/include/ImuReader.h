@@ -0,0 +1,77 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "ImuSampleRing.h"
+#include "ResearchModeApi.h"
+#include "TimeConverter.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Reader for the IMU sensors (IMU_ACCEL, IMU_GYRO, IMU_MAG).
+// Each sensor frame holds a batch of samples; the update thread drains every batch into a
+// ring buffer, consumers read it in bulk without blocking the sensor.
+class ImuReader
+{
+public:
+	ImuReader(IResearchModeSensor* pSensor, HANDLE imuConsentGiven, ResearchModeSensorConsent* imuAccessConsent,
+			  size_t ringCapacity = ImuSampleRing::kDefaultCapacity);
+	virtual ~ImuReader();
+
+	// Return false if thread is already running
+	bool start();
+	void stop();
+
+	ResearchModeSensorType getSensorType() const { return m_sensorType; }
+
+	// Append samples with an index greater than sinceIndex to samples, oldest first.
+	// Return the number of such samples lost because the ring was overwritten.
+	uint64_t getSamples(uint64_t sinceIndex, std::vector<ImuSample>& samples) const { return m_samples.Read(sinceIndex, samples); }
+	// Samples from the last one at or before from, to the first one at or after to, timestamps
+	// being read from their clock member. Return false if the ring does not cover [from, to].
+	bool getSamplesBetween(uint64_t ImuSample::* clock, uint64_t from, uint64_t to, std::vector<ImuSample>& samples) const
+	{
+		return m_samples.ReadBetween(clock, from, to, samples);
+	}
+	uint64_t getLastIndex() const { return m_samples.LastIndex(); }
+	const ImuSampleRing& getSampleRing() const { return m_samples; }
+
+private:
+	static void ImuUpdateThread(ImuReader* pReader);
+
+	// Wait for IMU access consent, then open the sensor stream.
+	// Return false if access is denied or the stream cannot be opened.
+	bool WaitForConsentAndOpenStream();
+	void DrainFrame(IResearchModeSensorFrame* pSensorFrame);
+	template <class TSample>
+	void PushSamples(const TSample* pSamples, size_t count);
+
+	IResearchModeSensor* m_pRMSensor = nullptr;
+	ResearchModeSensorType m_sensorType;
+
+	HANDLE m_imuConsentGiven;
+	ResearchModeSensorConsent* m_imuAccessConsent;
+
+	ImuSampleRing m_samples;
+	TimeConverter m_converter;
+
+	std::atomic<bool> m_fExit = false;
+	std::unique_ptr<std::thread> m_pImuUpdateThread;
+};
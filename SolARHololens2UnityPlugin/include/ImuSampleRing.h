@@ -0,0 +1,174 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// One accelerometer (m/s^2), gyroscope (rad/s) or magnetometer sample
+struct ImuSample
+{
+	uint64_t index = 0;			// position in the stream of the sensor, starting at 1
+	uint64_t timestamp = 0;		// absolute timestamp, in hundreds of nanoseconds
+	uint64_t hostTicks = 0;		// host ticks timestamp (hundreds of nanoseconds), the clock of Research Mode frames
+	uint64_t sensorTicks = 0;	// IMU clock timestamp (VinylHupTicks), in nanoseconds
+	float x = 0.f;
+	float y = 0.f;
+	float z = 0.f;
+	float temperature = 0.f;	// 0 for the magnetometer
+};
+
+// Fixed size ring of the latest IMU samples of a sensor, written by a single producer and read
+// by any number of consumers without locking.
+// The producer never waits: when the ring is full the oldest samples are overwritten. Readers
+// detect samples overwritten while they were copied by checking the write index again after the
+// copy (seqlock style), and report them as lost.
+class ImuSampleRing
+{
+public:
+	// A few seconds of samples at HoloLens 2 IMU rates
+	static constexpr size_t kDefaultCapacity = 16384;
+
+	// Capacity is rounded up to a power of two, at least 2
+	explicit ImuSampleRing(size_t capacity = kDefaultCapacity)
+	{
+		size_t size = 2;
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+		m_samples.resize(size);
+		m_mask = size - 1;
+	}
+
+	// Producer side: index of the sample is assigned by the ring
+	void Push(ImuSample sample)
+	{
+		const uint64_t index = m_lastIndex.load(std::memory_order_relaxed) + 1;
+		sample.index = index;
+		// Seqlock writer: the previous store of m_lastIndex (index - 1) must be visible before any
+		// byte of the slot. The release store of Push() only orders the writes before it, and on
+		// ARM64 the slot could otherwise be seen overwritten while m_lastIndex is still index - 2,
+		// which OldestValidIndex() accepts. ImuSampleRingTest runs on x86, where stores are never
+		// reordered (TSO): it cannot catch a missing fence.
+		std::atomic_thread_fence(std::memory_order_release);
+		m_samples[(index - 1) & m_mask] = sample;
+		m_lastIndex.store(index, std::memory_order_release);
+	}
+
+	// Consumer side: append samples with an index greater than sinceIndex to samples, oldest
+	// first. Return the number of such samples which were overwritten before they could be read
+	// (e.g. sinceIndex is too old, or the caller was too slow).
+	uint64_t Read(uint64_t sinceIndex, std::vector<ImuSample>& samples) const
+	{
+		const uint64_t lastIndex = m_lastIndex.load(std::memory_order_acquire);
+		uint64_t firstIndex = std::max(sinceIndex + 1, OldestValidIndex(lastIndex));
+
+		const size_t begin = samples.size();
+		if (firstIndex <= lastIndex)
+		{
+			samples.reserve(begin + static_cast<size_t>(lastIndex - firstIndex + 1));
+			for (uint64_t index = firstIndex; index <= lastIndex; ++index)
+			{
+				samples.push_back(m_samples[(index - 1) & m_mask]);
+			}
+		}
+
+		// Discard the samples the producer may have overwritten during the copy
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint64_t oldestValidIndex = OldestValidIndex(m_lastIndex.load(std::memory_order_relaxed));
+		if (firstIndex < oldestValidIndex)
+		{
+			const uint64_t overwritten = std::min(oldestValidIndex, lastIndex + 1) - firstIndex;
+			samples.erase(samples.begin() + begin, samples.begin() + begin + static_cast<size_t>(overwritten));
+			firstIndex += overwritten;
+		}
+
+		return firstIndex > sinceIndex + 1 ? firstIndex - sinceIndex - 1 : 0;
+	}
+
+	// Index of the last sample whose clock member is at most time, 0 if there is none in the ring.
+	// Samples are sorted on every clock. The result is a hint: the sample may have been
+	// overwritten when Read() is called, which Read() reports.
+	uint64_t FindLastAtOrBefore(uint64_t ImuSample::* clock, uint64_t time) const
+	{
+		const uint64_t lastIndex = m_lastIndex.load(std::memory_order_acquire);
+		uint64_t low = OldestValidIndex(lastIndex);
+		uint64_t high = lastIndex;
+		if (lastIndex == 0 || m_samples[(low - 1) & m_mask].*clock > time)
+		{
+			return 0;
+		}
+		// Invariant: sample low is at or before time
+		while (low < high)
+		{
+			const uint64_t middle = low + (high - low + 1) / 2;
+			if (m_samples[(middle - 1) & m_mask].*clock <= time)
+			{
+				low = middle;
+			}
+			else
+			{
+				high = middle - 1;
+			}
+		}
+		return low;
+	}
+
+	// Samples from the last one at or before from, to the first one at or after to, timestamps
+	// being read from their clock member. Return false if the ring does not cover [from, to].
+	bool ReadBetween(uint64_t ImuSample::* clock, uint64_t from, uint64_t to, std::vector<ImuSample>& samples) const
+	{
+		const uint64_t firstIndex = FindLastAtOrBefore(clock, from);
+		if (firstIndex == 0)
+		{
+			return false;
+		}
+
+		samples.clear();
+		if (Read(firstIndex - 1, samples) > 0 || samples.empty())
+		{
+			// First sample was overwritten in the meantime
+			return false;
+		}
+
+		auto after = std::find_if(samples.begin(), samples.end(), [&](const ImuSample& sample) { return sample.*clock >= to; });
+		if (after == samples.end())
+		{
+			return false;
+		}
+		samples.erase(after + 1, samples.end());
+		return true;
+	}
+
+	uint64_t LastIndex() const { return m_lastIndex.load(std::memory_order_acquire); }
+	size_t Capacity() const { return m_samples.size(); }
+
+private:
+	// Oldest sample that cannot be under overwrite when lastIndex is the last published sample:
+	// the slot of sample lastIndex + 1 may be in the process of being written
+	uint64_t OldestValidIndex(uint64_t lastIndex) const
+	{
+		return lastIndex + 2 > m_samples.size() ? lastIndex + 2 - m_samples.size() : 1;
+	}
+
+	std::vector<ImuSample> m_samples;
+	size_t m_mask = 0;
+	std::atomic<uint64_t> m_lastIndex = 0;
+};
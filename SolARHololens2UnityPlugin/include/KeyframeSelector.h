@@ -0,0 +1,142 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// No platform dependency on purpose: the selector only depends on its inputs, so that decisions
+// can be replayed off-device from a recorded trajectory.
+
+#include "LockProfiler.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+struct KeyframeSettings
+{
+	bool enabled = false;
+	// A frame is a keyframe candidate when one of these thresholds is crossed since the last
+	// keyframe (0 disables the criterion)
+	float minTranslation = 0.f;		// meters
+	float minRotationDeg = 0.f;		// degrees
+	float maxIntervalSec = 0.f;		// seconds, a keyframe is emitted at least this often
+	// Optional gate on motion candidates: emit only if the estimated image overlap with the last
+	// keyframe is at most maxOverlap (in ]0, 1[, 0 or 1 disables the gate). Time triggered keyframes
+	// are not gated.
+	float maxOverlap = 1.f;
+	float horizontalFovDeg = 64.f;
+	float verticalFovDeg = 40.f;
+	// Assumed distance to the scene, used to turn translations into image shifts
+	float sceneDepth = 2.f;
+};
+
+enum KeyframeReason : uint32_t
+{
+	KeyframeReasonNone = 0,
+	KeyframeReasonFirst = 1 << 0,
+	KeyframeReasonTranslation = 1 << 1,
+	KeyframeReasonRotation = 1 << 2,
+	KeyframeReasonTime = 1 << 3,
+	KeyframeReasonOverlapGated = 1 << 4,	// motion thresholds crossed but overlap still too high
+	KeyframeReasonNoPose = 1 << 5			// frame could not be located, only time criterion applied
+};
+
+struct KeyframeDecision
+{
+	uint64_t index = 0;			// evaluation index, starting at 1
+	uint64_t timestamp = 0;		// hundreds of nanoseconds
+	bool isKeyframe = false;
+	uint32_t reasons = KeyframeReasonNone;
+	// Measures relative to the last keyframe
+	float translation = 0.f;
+	float rotationDeg = 0.f;
+	float elapsedSec = 0.f;
+	float overlap = 1.f;
+};
+
+struct KeyframeStats
+{
+	uint64_t evaluated = 0;
+	uint64_t emitted = 0;
+	uint64_t byTranslation = 0;
+	uint64_t byRotation = 0;
+	uint64_t byTime = 0;
+	uint64_t rejectedByOverlap = 0;
+};
+
+// Sensor to world transform, laid out as a winrt float4x4 (row vector convention:
+// rows 1 to 3 are the sensor axes in world coordinates, row 4 its position)
+using KeyframePose = std::array<float, 16>;
+
+// transform: a winrt float4x4, or any struct holding the 16 floats in that layout. Plain float
+// arrays are rejected, they are usually in the layout of SolARHL2FrameMetadata.
+template <typename Transform>
+KeyframePose ToKeyframePose(const Transform& transform)
+{
+	static_assert(sizeof(Transform) == sizeof(KeyframePose) && !std::is_array_v<Transform>, "Transform must be a struct of 16 contiguous floats");
+	KeyframePose pose;
+	std::memcpy(pose.data(), &transform, sizeof(pose));
+	return pose;
+}
+
+// Selects keyframes from a stream of timestamped poses.
+// Thread safe: Evaluate() is called by a capture thread, other methods from any thread.
+class KeyframeSelector
+{
+public:
+	static constexpr size_t kDefaultHistorySize = 256;
+
+	explicit KeyframeSelector(size_t historySize = kDefaultHistorySize);
+
+	// Settings change restarts selection: the next evaluated frame is a keyframe
+	void Configure(const KeyframeSettings& settings);
+	KeyframeSettings GetSettings();
+	bool IsEnabled();
+
+	// Return true if the frame is a keyframe, or if selection is disabled.
+	// pPose is nullptr if the frame could not be located.
+	bool Evaluate(uint64_t timestamp, const KeyframePose* pPose);
+
+	// Decisions with an index greater than sinceIndex still in the history, oldest first
+	std::vector<KeyframeDecision> GetDecisions(uint64_t sinceIndex);
+	KeyframeStats GetStats();
+
+	// Coarse estimate of the image overlap between two views, from the angular shift of the
+	// optical axis plus the shift induced by the lateral translation at sceneDepth
+	static float EstimateOverlap(const KeyframePose& from, const KeyframePose& to, const KeyframeSettings& settings);
+	// Distance between the positions of two poses, in meters
+	static float TranslationDistance(const KeyframePose& a, const KeyframePose& b);
+	// Angle of the rotation from a to b, in degrees
+	static float RotationAngleDeg(const KeyframePose& a, const KeyframePose& b);
+
+private:
+	void Record(const KeyframeDecision& decision);
+
+	ProfiledMutex m_mutex{ "KeyframeSelector::m_mutex" };
+	KeyframeSettings m_settings;
+	KeyframeStats m_stats;
+
+	bool m_hasKeyframe = false;
+	bool m_hasKeyframePose = false;
+	uint64_t m_keyframeTimestamp = 0;
+	KeyframePose m_keyframePose{};
+
+	// Circular history of the last decisions
+	std::vector<KeyframeDecision> m_history;
+	uint64_t m_evaluationCount = 0;
+};
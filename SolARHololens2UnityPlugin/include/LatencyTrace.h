@@ -0,0 +1,136 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Per-frame latency tracing of the capture pipeline, from sensor exposure to consumer pickup.
+// Frames are stamped at each stage, stage latencies (relative to exposure) are aggregated in
+// lock-free log-linear histograms, and the last traces can be exported as Chrome trace JSON
+// (chrome://tracing, Perfetto).
+// No platform dependency.
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum class PipelineStage : uint32_t
+{
+	Exposure,	// sensor timestamp of the frame
+	Acquired,	// frame received from the sensor (GetNextBuffer() return, PV frame arrival)
+	Located,	// pose lookup done
+	Converted,	// source filters and pixel format conversion (PV) done
+	Copied,		// frame stored as the latest frame of the stream
+	Published,	// frame notified to waiters and delivered to subscribers
+	PickedUp,	// frame returned for the first time by a Get*Data() call
+	Count
+};
+
+constexpr size_t kPipelineStageCount = static_cast<size_t>(PipelineStage::Count);
+
+const char* ToString(PipelineStage stage);
+
+// Current time in hundreds of nanoseconds on the monotonic clock. On Windows this is the QPC
+// clock, the one of Research Mode host ticks and of PV SystemRelativeTime.
+uint64_t PipelineClockNow();
+
+struct FrameTrace
+{
+	uint64_t sequence = 0;
+	// Hundreds of nanoseconds on the PipelineClockNow() clock, 0 if the stage was not reached
+	std::array<uint64_t, kPipelineStageCount> stamps{};
+
+	void Mark(PipelineStage stage) { stamps[static_cast<size_t>(stage)] = PipelineClockNow(); }
+	void Set(PipelineStage stage, uint64_t time) { stamps[static_cast<size_t>(stage)] = time; }
+	uint64_t Get(PipelineStage stage) const { return stamps[static_cast<size_t>(stage)]; }
+};
+
+struct LatencyStats
+{
+	uint64_t count = 0;
+	// Hundreds of nanoseconds. Percentiles are bucket midpoints, within ~3% of the true value.
+	uint64_t min = 0;
+	uint64_t max = 0;
+	double mean = 0.0;
+	uint64_t p50 = 0;
+	uint64_t p90 = 0;
+	uint64_t p99 = 0;
+};
+
+// HDR-style histogram: values below 2^kSubBucketBits are counted exactly, above that each power
+// of two range is split in 2^kSubBucketBits buckets. Record() is wait-free.
+class LatencyHistogram
+{
+public:
+	static constexpr uint32_t kSubBucketBits = 5;
+	static constexpr uint32_t kSubBucketCount = 1u << kSubBucketBits;
+	static constexpr size_t kBucketCount = (64 - kSubBucketBits + 1) * kSubBucketCount;
+
+	LatencyHistogram();
+
+	void Record(uint64_t value);
+	LatencyStats GetStats() const;
+	// Not atomic with respect to concurrent Record() calls, which may be partly kept
+	void Reset();
+
+	static size_t BucketIndex(uint64_t value);
+	static uint64_t BucketMidpoint(size_t index);
+
+private:
+	std::array<std::atomic<uint64_t>, kBucketCount> m_buckets;
+	std::atomic<uint64_t> m_count;
+	std::atomic<uint64_t> m_sum;
+	std::atomic<uint64_t> m_min;
+	std::atomic<uint64_t> m_max;
+};
+
+// Latency histograms and recent traces of one stream.
+// Producer: Complete() once per frame reaching PipelineStage::Published.
+// Consumer: PickedUp() with the trace stored along the frame, when it is returned the first time.
+class PipelineTracer
+{
+public:
+	// Traces kept for export, about 8 seconds at 30 fps
+	static constexpr size_t kRecentTraceCount = 256;
+
+	PipelineTracer();
+
+	void Complete(const FrameTrace& trace);
+	void PickedUp(FrameTrace trace);
+
+	// Latency between exposure and stage
+	LatencyStats GetStats(PipelineStage stage) const { return m_histograms[static_cast<size_t>(stage)].GetStats(); }
+	void Reset();
+
+	// Recent traces, oldest first
+	std::vector<FrameTrace> GetRecentTraces() const;
+
+private:
+	void Record(const FrameTrace& trace, PipelineStage first, PipelineStage last);
+	// Merge trace in the recent traces, lock on m_recentMutex from caller
+	void Store(const FrameTrace& trace);
+
+	std::array<LatencyHistogram, kPipelineStageCount> m_histograms;
+
+	mutable std::mutex m_recentMutex;
+	std::vector<FrameTrace> m_recent;
+};
+
+// Chrome trace JSON ("X" events, one track per stream) of the recent traces of streams
+std::string ToChromeTrace(const std::vector<std::pair<std::string, const PipelineTracer*>>& streams);
@@ -0,0 +1,253 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Lock contention and thread utilization profiling.
+//
+// ProfiledMutex and ProfiledSharedMutex replace std::mutex and std::shared_mutex for the locks
+// shared by capture, recording and meshing threads, each one named after its site. Threads
+// declare themselves with a ScopedThreadProfile at the top of their thread function.
+//
+// Instrumentation is compiled in when SOLAR_PROFILE_LOCKS is defined (e.g. in the preprocessor
+// definitions of the project). Otherwise the wrappers are plain std::mutex / std::shared_mutex,
+// ScopedThreadProfile does nothing and LockProfiler::Report() returns an empty string.
+
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+
+#ifdef SOLAR_PROFILE_LOCKS
+
+#include <atomic>
+#include <memory>
+
+// Counters of one lock site, updated without locking
+struct LockSiteStats
+{
+	explicit LockSiteStats(const char* siteName) : site(siteName) {}
+
+	const char* site;
+	std::atomic<uint64_t> acquisitions = 0;
+	std::atomic<uint64_t> contended = 0;		// acquisitions which had to wait
+	std::atomic<uint64_t> waitTotal = 0;		// hundreds of nanoseconds
+	std::atomic<uint64_t> waitMax = 0;
+	std::atomic<uint64_t> holdTotal = 0;		// exclusive ownership only
+	std::atomic<uint64_t> holdMax = 0;
+	std::atomic<uint64_t> sharedAcquisitions = 0;
+	std::atomic<uint32_t> owner = 0;			// profile id of the exclusive owner thread, 0 if none
+	std::atomic<uint32_t> lastContender = 0;	// profile id of the last thread which waited
+};
+
+namespace LockProfiling
+{
+	uint64_t Now();
+	// Register a lock site. Stats outlive the lock so that the report covers destroyed readers.
+	std::shared_ptr<LockSiteStats> RegisterSite(const char* site);
+	// Profile id of the calling thread (see ScopedThreadProfile), 0 if not profiled
+	uint32_t CurrentThreadId();
+	// Add time spent waiting on a lock to the calling thread accounting
+	void AddCurrentThreadWait(uint64_t wait);
+	void UpdateMax(std::atomic<uint64_t>& maximum, uint64_t value);
+}
+
+class ProfiledMutex
+{
+public:
+	explicit ProfiledMutex(const char* site) : m_stats(LockProfiling::RegisterSite(site)) {}
+	ProfiledMutex(const ProfiledMutex&) = delete;
+	ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+	void lock()
+	{
+		if (!m_mutex.try_lock())
+		{
+			const uint64_t start = LockProfiling::Now();
+			m_mutex.lock();
+			OnContended(LockProfiling::Now() - start);
+		}
+		OnAcquired();
+	}
+
+	bool try_lock()
+	{
+		if (!m_mutex.try_lock())
+		{
+			return false;
+		}
+		OnAcquired();
+		return true;
+	}
+
+	void unlock()
+	{
+		const uint64_t hold = LockProfiling::Now() - m_acquiredAt;
+		m_stats->holdTotal.fetch_add(hold, std::memory_order_relaxed);
+		LockProfiling::UpdateMax(m_stats->holdMax, hold);
+		m_stats->owner.store(0, std::memory_order_relaxed);
+		m_mutex.unlock();
+	}
+
+private:
+	void OnContended(uint64_t wait)
+	{
+		m_stats->contended.fetch_add(1, std::memory_order_relaxed);
+		m_stats->waitTotal.fetch_add(wait, std::memory_order_relaxed);
+		LockProfiling::UpdateMax(m_stats->waitMax, wait);
+		m_stats->lastContender.store(LockProfiling::CurrentThreadId(), std::memory_order_relaxed);
+		LockProfiling::AddCurrentThreadWait(wait);
+	}
+
+	void OnAcquired()
+	{
+		m_stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+		m_stats->owner.store(LockProfiling::CurrentThreadId(), std::memory_order_relaxed);
+		m_acquiredAt = LockProfiling::Now();
+	}
+
+	std::mutex m_mutex;
+	std::shared_ptr<LockSiteStats> m_stats;
+	// Written by the owner only
+	uint64_t m_acquiredAt = 0;
+};
+
+class ProfiledSharedMutex
+{
+public:
+	explicit ProfiledSharedMutex(const char* site) : m_stats(LockProfiling::RegisterSite(site)) {}
+	ProfiledSharedMutex(const ProfiledSharedMutex&) = delete;
+	ProfiledSharedMutex& operator=(const ProfiledSharedMutex&) = delete;
+
+	void lock()
+	{
+		if (!m_mutex.try_lock())
+		{
+			const uint64_t start = LockProfiling::Now();
+			m_mutex.lock();
+			OnContended(LockProfiling::Now() - start);
+		}
+		OnAcquired();
+	}
+
+	bool try_lock()
+	{
+		if (!m_mutex.try_lock())
+		{
+			return false;
+		}
+		OnAcquired();
+		return true;
+	}
+
+	void unlock()
+	{
+		const uint64_t hold = LockProfiling::Now() - m_acquiredAt;
+		m_stats->holdTotal.fetch_add(hold, std::memory_order_relaxed);
+		LockProfiling::UpdateMax(m_stats->holdMax, hold);
+		m_stats->owner.store(0, std::memory_order_relaxed);
+		m_mutex.unlock();
+	}
+
+	void lock_shared()
+	{
+		if (!m_mutex.try_lock_shared())
+		{
+			const uint64_t start = LockProfiling::Now();
+			m_mutex.lock_shared();
+			OnContended(LockProfiling::Now() - start);
+		}
+		m_stats->sharedAcquisitions.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	bool try_lock_shared()
+	{
+		if (!m_mutex.try_lock_shared())
+		{
+			return false;
+		}
+		m_stats->sharedAcquisitions.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	void unlock_shared() { m_mutex.unlock_shared(); }
+
+private:
+	void OnContended(uint64_t wait)
+	{
+		m_stats->contended.fetch_add(1, std::memory_order_relaxed);
+		m_stats->waitTotal.fetch_add(wait, std::memory_order_relaxed);
+		LockProfiling::UpdateMax(m_stats->waitMax, wait);
+		m_stats->lastContender.store(LockProfiling::CurrentThreadId(), std::memory_order_relaxed);
+		LockProfiling::AddCurrentThreadWait(wait);
+	}
+
+	void OnAcquired()
+	{
+		m_stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+		m_stats->owner.store(LockProfiling::CurrentThreadId(), std::memory_order_relaxed);
+		m_acquiredAt = LockProfiling::Now();
+	}
+
+	std::shared_mutex m_mutex;
+	std::shared_ptr<LockSiteStats> m_stats;
+	// Written by the exclusive owner only
+	uint64_t m_acquiredAt = 0;
+};
+
+// CPU, lock wait and idle time accounting of the calling thread, from construction to destruction
+class ScopedThreadProfile
+{
+public:
+	explicit ScopedThreadProfile(const char* name);
+	~ScopedThreadProfile();
+	ScopedThreadProfile(const ScopedThreadProfile&) = delete;
+	ScopedThreadProfile& operator=(const ScopedThreadProfile&) = delete;
+
+private:
+	uint32_t m_id;
+};
+
+#else
+
+class ProfiledMutex : public std::mutex
+{
+public:
+	explicit ProfiledMutex(const char*) {}
+};
+
+class ProfiledSharedMutex : public std::shared_mutex
+{
+public:
+	explicit ProfiledSharedMutex(const char*) {}
+};
+
+class ScopedThreadProfile
+{
+public:
+	explicit ScopedThreadProfile(const char*) {}
+};
+
+#endif
+
+namespace LockProfiler
+{
+	// Human readable table of lock sites (acquisitions, contention, wait and hold times, owner)
+	// and profiled threads (wall, CPU, lock wait and idle times). Empty if profiling is disabled.
+	std::string Report();
+	// Clear counters of live sites and threads, forget destroyed ones
+	void Reset();
+}
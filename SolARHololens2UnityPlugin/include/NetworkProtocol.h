@@ -0,0 +1,124 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Binary protocol of the network streaming server (NetworkStreamServer.h).
+//
+// A connection carries messages, each a NetworkMessageHeader followed by payloadSize bytes:
+// - the client starts with a Hello holding the streams it wants, the server answers with a Hello
+//   holding the streams it publishes, then only sends messages;
+// - Frame: SolARHL2FrameMetadata followed by the pixels, encoded with the codec of the header;
+// - FramePose: NetworkFramePose, the pose of a frame without its pixels (UDP pose datagrams);
+// - HeadPose: SharedHeadPose;
+// - ImuSamples: SharedImuSample array.
+// UDP datagrams hold exactly one message. All the fields are little endian, as on HoloLens 2.
+//
+// Codecs are lossless. Rows are predicted from their left pixel (the first pixel from the one above),
+// residuals are zigzag coded and packed by blocks of 16 with the bit width of the largest one:
+// smooth images and the invalid (zero) areas of depth maps shrink to a few bits per pixel.
+//
+// No platform dependency.
+
+#include "SharedMemoryRing.h"
+#include "SolARHololens2PluginApi.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class NetworkMessageType : uint16_t
+{
+	Hello = 1,
+	Frame = 2,
+	FramePose = 3,
+	HeadPose = 4,
+	ImuSamples = 5
+};
+
+enum class NetworkCodec : uint16_t
+{
+	Raw = 0,
+	Gray8 = 1,		// 8-bit pixels (VLC cameras)
+	Depth16 = 2		// 16-bit pixels (depth and AB planes)
+};
+
+struct NetworkMessageHeader
+{
+	static constexpr uint32_t kMagic = 0x324C4853;		// "SHL2"
+
+	uint32_t magic = kMagic;
+	uint16_t type = 0;			// NetworkMessageType
+	uint16_t codec = 0;			// NetworkCodec of Frame messages
+	uint32_t stream = 0;		// SharedStream
+	uint32_t payloadSize = 0;
+	uint64_t timestamp = 0;		// absolute, in hundreds of nanoseconds
+};
+static_assert(sizeof(NetworkMessageHeader) == 24, "NetworkMessageHeader is sent as is");
+
+struct NetworkHello
+{
+	// 2: pose validity in SolARHL2FrameMetadata and NetworkFramePose
+	static constexpr uint32_t kVersion = 2;
+
+	uint32_t version = kVersion;
+	uint32_t streamMask = 0;	// bit (1 << SharedStream) per stream, 0 for all in a client Hello
+};
+
+struct NetworkFramePose
+{
+	uint64_t sequence;
+	float toWorldTransform[16];	// as SolARHL2FrameMetadata
+	uint32_t poseValid;
+	uint32_t reserved;
+};
+static_assert(sizeof(NetworkFramePose) == 80, "NetworkFramePose is sent as is");
+static_assert(sizeof(SolARHL2FrameMetadata) == 112, "SolARHL2FrameMetadata is sent as is");
+
+// Streams of a Hello stream mask
+constexpr uint32_t GetStreamBit(SharedStream stream) { return 1u << static_cast<uint32_t>(stream); }
+
+// Frames larger than this are rejected by receivers
+constexpr uint32_t kMaxNetworkPayloadSize = 64u << 20;
+
+// Append header and payload to buffer
+void AppendNetworkMessage(std::vector<uint8_t>& buffer, NetworkMessageType type, SharedStream stream,
+						  uint64_t timestamp, const void* pPayload, size_t payloadSize, NetworkCodec codec = NetworkCodec::Raw);
+
+// Append a Frame message, pixels encoded with codec. Codecs not matching metadata.bytesPerPixel
+// fall back to Raw. Return the size of the encoded pixels.
+size_t AppendFrameMessage(std::vector<uint8_t>& buffer, SharedStream stream, const SolARHL2FrameMetadata& metadata,
+						  const uint8_t* pPixels, NetworkCodec codec);
+
+// Encode width x rows pixels (bytes for Gray8, uint16_t for Depth16), appended to encoded
+void EncodePixels(NetworkCodec codec, const uint8_t* pPixels, uint32_t width, uint32_t rows, std::vector<uint8_t>& encoded);
+// Decode into pixels, which must hold width x rows pixels. False if encoded is malformed.
+bool DecodePixels(NetworkCodec codec, const uint8_t* pEncoded, size_t encodedSize, uint32_t width, uint32_t rows, uint8_t* pPixels);
+
+// Message as parsed by the receivers, only the members of its type are set
+struct NetworkMessage
+{
+	NetworkMessageHeader header;
+	NetworkHello hello{};
+	SolARHL2FrameMetadata frame{};
+	std::vector<uint8_t> pixels;	// decoded, frame.dataSize bytes
+	NetworkFramePose framePose{};
+	SharedHeadPose headPose{};
+	std::vector<SharedImuSample> imuSamples;
+};
+
+// Parse the payload of header into message, decoding frame pixels. False if malformed.
+bool ParseNetworkMessage(const NetworkMessageHeader& header, const uint8_t* pPayload, NetworkMessage& message);
@@ -0,0 +1,70 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Minimal blocking IPv4 TCP and UDP sockets over Winsock or BSD sockets.
+// Timeouts are in milliseconds, 0 waits forever.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class NetworkSocket
+{
+public:
+	NetworkSocket() = default;
+	~NetworkSocket() { Close(); }
+
+	NetworkSocket(const NetworkSocket&) = delete;
+	NetworkSocket& operator=(const NetworkSocket&) = delete;
+	NetworkSocket(NetworkSocket&& other) noexcept : m_handle(other.m_handle) { other.m_handle = kInvalidHandle; }
+	NetworkSocket& operator=(NetworkSocket&& other) noexcept;
+
+	// TCP server: listen on every interface, port 0 picks a free port (see GetLocalPort())
+	bool Listen(uint16_t port);
+	// False on timeout or error
+	bool Accept(NetworkSocket& client, uint32_t timeoutMs);
+	// TCP client
+	bool Connect(const std::string& host, uint16_t port);
+
+	// UDP: bound to port (0 for any) to receive, and sending to host:port if host is not empty
+	bool OpenUdp(uint16_t port, const std::string& host = {}, uint16_t destinationPort = 0);
+
+	// Send all of data, false on error or send timeout (the connection must then be closed)
+	bool Send(const void* pData, size_t size);
+	// Receive exactly size bytes, false on error, timeout or end of stream
+	bool Receive(void* pData, size_t size, uint32_t timeoutMs = 0);
+	// UDP: receive one datagram, return its size, 0 on timeout or error
+	size_t ReceiveDatagram(void* pData, size_t capacity, uint32_t timeoutMs);
+	// Wait until data, end of stream or an error is readable, false on timeout
+	bool WaitReadable(uint32_t timeoutMs) const;
+
+	void SetNoDelay();
+	void SetSendTimeout(uint32_t timeoutMs);
+	void SetSendBufferSize(uint32_t size);
+
+	uint16_t GetLocalPort() const;
+	bool IsOpen() const { return m_handle != kInvalidHandle; }
+	// Unblock pending calls of other threads, Close() must still be called
+	void Shutdown();
+	void Close();
+
+private:
+	static constexpr intptr_t kInvalidHandle = -1;
+
+	intptr_t m_handle = kInvalidHandle;
+};
@@ -0,0 +1,67 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Reference receiver of the network streaming server, for SolAR services: connects, subscribes
+// to streams and returns the messages with their frames decoded.
+//
+// Like the protocol, it only depends on the standard library and the socket API: it builds
+// on the service side (Windows or Linux) with NetworkProtocol.cpp, NetworkSocket.cpp and
+// SharedMemoryRing.cpp.
+
+#include "NetworkProtocol.h"
+#include "NetworkSocket.h"
+
+#include <string>
+#include <vector>
+
+class NetworkStreamReceiver
+{
+public:
+	// streamMask: GetStreamBit() of the wanted streams, 0 for all
+	bool Connect(const std::string& host, uint16_t port, uint32_t streamMask = 0);
+	void Close() { m_socket.Close(); }
+	bool IsConnected() const { return m_socket.IsOpen(); }
+
+	// Streams published by the server
+	uint32_t GetAvailableStreams() const { return m_availableStreams; }
+
+	// Next message, false on timeout, malformed message or disconnection (the connection is then
+	// closed, except on timeout between two messages). message is reused to avoid reallocating frames.
+	bool Receive(NetworkMessage& message, uint32_t timeoutMs = 0);
+
+private:
+	NetworkSocket m_socket;
+	uint32_t m_availableStreams = 0;
+	std::vector<uint8_t> m_payload;
+};
+
+// Receives the UDP pose datagrams (FramePose and HeadPose messages)
+class NetworkPoseReceiver
+{
+public:
+	bool Open(uint16_t port) { return m_socket.OpenUdp(port); }
+	void Close() { m_socket.Close(); }
+	uint16_t GetPort() const { return m_socket.GetLocalPort(); }
+
+	// Next pose, false on timeout. Malformed datagrams are skipped.
+	bool Receive(NetworkMessage& message, uint32_t timeoutMs);
+
+private:
+	NetworkSocket m_socket;
+	std::vector<uint8_t> m_datagram;
+};
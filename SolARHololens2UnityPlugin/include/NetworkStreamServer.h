@@ -0,0 +1,167 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Streams frames, IMU samples and head poses to remote SolAR services over TCP (NetworkProtocol.h),
+// and optionally the poses alone over UDP, where a late pose is worth less than a lost one.
+//
+// Each frame is encoded once, by the delivery task of its subscription, then queued to every
+// client which asked for its stream. Each client has a sender thread which batches the small
+// messages queued meanwhile into one send. When a client reads slower than the streams are
+// produced, its queue grows up to maxQueuedBytes, then its oldest frames are dropped: IMU samples
+// and poses are never dropped, a client which stops reading them is disconnected.
+// IMU sample rings and frame publishers must outlive the NetworkStreamServer.
+// Like the receiver, it only depends on the standard library and the socket API.
+
+#include "FrameSubscription.h"
+#include "ImuSampleRing.h"
+#include "NetworkProtocol.h"
+#include "NetworkSocket.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct NetworkStreamSettings
+{
+	static constexpr uint16_t kDefaultTcpPort = 5400;
+	static constexpr size_t kDefaultMaxQueuedBytes = 16u << 20;
+
+	uint16_t tcpPort = kDefaultTcpPort;		// 0 picks a free port
+	size_t maxQueuedBytes = kDefaultMaxQueuedBytes;	// per client
+	uint32_t maxClients = 4;
+	std::string udpPoseHost;				// empty to send no UDP pose
+	uint16_t udpPosePort = 0;
+};
+
+struct NetworkStreamStats
+{
+	uint32_t clients = 0;
+	uint64_t sentMessages = 0;
+	uint64_t sentBytes = 0;
+	uint64_t droppedFrames = 0;				// frames dropped for slow clients, per client
+	uint64_t rawFrameBytes = 0;				// pixels of the encoded frames, before and after encoding
+	uint64_t encodedFrameBytes = 0;
+};
+
+class NetworkStreamServer
+{
+public:
+	// Messages smaller than this are batched
+	static constexpr size_t kMaxBatchBytes = 64u << 10;
+	// A client not reading for that long is disconnected
+	static constexpr uint32_t kSendTimeoutMs = 5000;
+
+	NetworkStreamServer() = default;
+	~NetworkStreamServer() { Stop(); }
+
+	NetworkStreamServer(const NetworkStreamServer&) = delete;
+	NetworkStreamServer& operator=(const NetworkStreamServer&) = delete;
+
+	// Streams must be added before Start()
+	void AddFrameStream(SharedStream stream, FramePublisher& publisher, NetworkCodec codec = NetworkCodec::Raw);
+	// samples: the ring of the ImuReader of stream
+	void AddImuStream(SharedStream stream, const ImuSampleRing& samples);
+	void AddHeadPoseStream() { m_availableStreams |= GetStreamBit(SharedStream::HEAD_POSE); }
+
+	bool Start(const NetworkStreamSettings& settings);
+	// Disconnect the clients and unsubscribe from the streams
+	void Stop();
+	bool IsStarted() const { return m_listener.IsOpen(); }
+	uint16_t GetPort() const { return m_listener.GetLocalPort(); }
+
+	void PublishHeadPose(const SharedHeadPose& pose);
+
+	NetworkStreamStats GetStats();
+
+private:
+	using MessagePtr = std::shared_ptr<const std::vector<uint8_t>>;
+
+	struct QueuedMessage
+	{
+		MessagePtr message;
+		bool isFrame;
+	};
+
+	struct Client
+	{
+		NetworkSocket socket;
+		uint32_t streamMask = 0;
+		ProfiledMutex mutex{ "NetworkStreamServer::Client::mutex" };
+		std::condition_variable_any condVar;
+		std::deque<QueuedMessage> queue;
+		size_t queuedBytes = 0;
+		bool closed = false;
+		std::unique_ptr<std::thread> pSenderThread;
+	};
+
+	struct FrameStream
+	{
+		SharedStream stream;
+		FramePublisher* pPublisher = nullptr;
+		NetworkCodec codec = NetworkCodec::Raw;
+		std::unique_ptr<FrameCallbackSubscription> subscription;
+	};
+
+	struct ImuStream
+	{
+		SharedStream stream;
+		const ImuSampleRing* pSamples = nullptr;
+		uint64_t lastIndex = 0;
+		std::vector<ImuSample> samples;
+		std::vector<SharedImuSample> batch;
+	};
+
+	// Called by the delivery tasks of the subscription of stream
+	void SendFrame(const FrameStream& stream, const SharedFrame& frame);
+	// Whether a client wants stream
+	bool IsWanted(SharedStream stream);
+	void Broadcast(SharedStream stream, const MessagePtr& message, bool isFrame);
+	void Enqueue(Client& client, const MessagePtr& message, bool isFrame);
+	void SendDatagram(NetworkMessageType type, SharedStream stream, uint64_t timestamp, const void* pPayload, size_t size);
+
+	static void AcceptThread(NetworkStreamServer* pServer);
+	static void SenderThread(NetworkStreamServer* pServer, Client* pClient);
+	static void ImuThread(NetworkStreamServer* pServer);
+
+	NetworkStreamSettings m_settings;
+	uint32_t m_availableStreams = 0;
+	std::vector<std::unique_ptr<FrameStream>> m_frameStreams;
+	std::vector<std::unique_ptr<ImuStream>> m_imuStreams;
+
+	NetworkSocket m_listener;
+	NetworkSocket m_udpSocket;
+	ProfiledMutex m_udpMutex{ "NetworkStreamServer::m_udpMutex" };
+	std::vector<uint8_t> m_datagram;
+
+	ProfiledMutex m_clientsMutex{ "NetworkStreamServer::m_clientsMutex" };
+	std::vector<std::unique_ptr<Client>> m_clients;
+
+	std::atomic<bool> m_fExit = false;
+	std::unique_ptr<std::thread> m_pAcceptThread;
+	std::unique_ptr<std::thread> m_pImuThread;
+
+	std::atomic<uint64_t> m_sentMessages{ 0 };
+	std::atomic<uint64_t> m_sentBytes{ 0 };
+	std::atomic<uint64_t> m_droppedFrames{ 0 };
+	std::atomic<uint64_t> m_rawFrameBytes{ 0 };
+	std::atomic<uint64_t> m_encodedFrameBytes{ 0 };
+};
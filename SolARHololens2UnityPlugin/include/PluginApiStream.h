@@ -0,0 +1,32 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Stream handles of the flat C API (SolARHololens2PluginApi.h): frame metadata packing, status
+// mapping and the slots of the acquired frames. PluginApiStream.cpp implements every SolARHL2_*
+// function but SolARHL2_OpenStream(), which looks the publisher up in the plugin instance
+// (SolARHololens2PluginApi.cpp) and hands its subscriber to CreatePluginApiStream().
+// No platform dependency.
+
+#include "FrameSubscription.h"
+#include "SolARHololens2PluginApi.h"
+
+#include <memory>
+
+// Handle of stream over subscriber, with maxAcquiredFrames slots (0 for default)
+SolARHL2Result CreatePluginApiStream(
+	SolARHL2StreamId streamId, std::shared_ptr<FrameSubscriber> subscriber, uint32_t maxAcquiredFrames, SolARHL2Stream** stream);
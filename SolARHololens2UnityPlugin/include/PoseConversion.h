@@ -0,0 +1,191 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Conversion of sensor to world transforms from the HoloLens layout to the layouts of the frame
+// getters, trajectory files and SolAR.
+//
+// Input is a winrt float4x4 (16 contiguous floats m11, m12, ..., m44) in the row vector
+// convention, translation in m41..m43. Output is the column vector transform M (the transpose),
+// written row-major or column-major, in float or double. With CameraAxes::OpenCV the camera axes
+// are changed from HoloLens (x right, y up, z backward) to OpenCV (x right, y down, z forward),
+// i.e. M * diag(1, -1, -1, 1): a sign flip of the second and third columns.
+//
+// Every variant is resolved at compile time to 16 moves with constant indices and signs.
+//
+// Compact forms drop the constant last row: a 3x4 matrix [R | t], or a unit quaternion and a
+// translation, both in float. From*() helpers rebuild the row-major 4x4 transform.
+// No platform dependency.
+
+#include <cmath>
+#include <cstddef>
+
+namespace PoseConversion
+{
+	enum class Layout
+	{
+		RowMajor,		// SolAR, Eigen::RowMajor, trajectory files
+		ColumnMajor		// same memory order as the input float4x4
+	};
+
+	enum class CameraAxes
+	{
+		HoloLens,
+		OpenCV
+	};
+
+	constexpr size_t kTransformSize = 16;
+	// Rows 0 to 2 of the transform
+	constexpr size_t kMatrix3x4Size = 12;
+
+	template <Layout layout, CameraAxes axes, typename T>
+	inline void Convert(const float* hololensToWorld, T* toWorld)
+	{
+		for (size_t row = 0; row < 4; ++row)
+		{
+			for (size_t column = 0; column < 4; ++column)
+			{
+				// M(row, column) is the transposed input element
+				const T value = static_cast<T>(hololensToWorld[column * 4 + row]);
+				const bool flip = axes == CameraAxes::OpenCV && (column == 1 || column == 2);
+				const size_t index = layout == Layout::RowMajor ? row * 4 + column : column * 4 + row;
+				toWorld[index] = flip ? -value : value;
+			}
+		}
+	}
+
+	// count transforms, kTransformSize values apart in both arrays (e.g. trajectory exports)
+	template <Layout layout, CameraAxes axes, typename T>
+	inline void ConvertBatch(const float* hololensToWorld, size_t count, T* toWorld)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			Convert<layout, axes, T>(hololensToWorld + i * kTransformSize, toWorld + i * kTransformSize);
+		}
+	}
+
+	// Camera to world transform expected by SolAR: row-major, OpenCV camera axes
+	template <typename T>
+	inline void ToSolARPose(const float* hololensCamToWorld, T* solarCamToWorld)
+	{
+		Convert<Layout::RowMajor, CameraAxes::OpenCV, T>(hololensCamToWorld, solarCamToWorld);
+	}
+
+	// [R | t], row-major
+	template <CameraAxes axes, typename T>
+	inline void ToMatrix3x4(const float* hololensToWorld, T* toWorld)
+	{
+		T transform[kTransformSize];
+		Convert<Layout::RowMajor, axes, T>(hololensToWorld, transform);
+		for (size_t i = 0; i < kMatrix3x4Size; ++i)
+		{
+			toWorld[i] = transform[i];
+		}
+	}
+
+	// rotation: unit quaternion (x, y, z, w) of R, w >= 0
+	template <CameraAxes axes>
+	inline void ToQuaternionTranslation(const float* hololensToWorld, float rotation[4], float translation[3])
+	{
+		float m[kTransformSize];
+		Convert<Layout::RowMajor, axes, float>(hololensToWorld, m);
+		translation[0] = m[3];
+		translation[1] = m[7];
+		translation[2] = m[11];
+
+		// Shepperd's method: solve for the largest of the four components, the others are
+		// obtained by division by it
+		float x, y, z, w;
+		const float trace = m[0] + m[5] + m[10];
+		if (trace > 0.f)
+		{
+			const float s = 2.f * std::sqrt(1.f + trace);
+			w = 0.25f * s;
+			x = (m[9] - m[6]) / s;
+			y = (m[2] - m[8]) / s;
+			z = (m[4] - m[1]) / s;
+		}
+		else if (m[0] > m[5] && m[0] > m[10])
+		{
+			const float s = 2.f * std::sqrt(1.f + m[0] - m[5] - m[10]);
+			w = (m[9] - m[6]) / s;
+			x = 0.25f * s;
+			y = (m[1] + m[4]) / s;
+			z = (m[2] + m[8]) / s;
+		}
+		else if (m[5] > m[10])
+		{
+			const float s = 2.f * std::sqrt(1.f + m[5] - m[0] - m[10]);
+			w = (m[2] - m[8]) / s;
+			x = (m[1] + m[4]) / s;
+			y = 0.25f * s;
+			z = (m[6] + m[9]) / s;
+		}
+		else
+		{
+			const float s = 2.f * std::sqrt(1.f + m[10] - m[0] - m[5]);
+			w = (m[4] - m[1]) / s;
+			x = (m[2] + m[8]) / s;
+			y = (m[6] + m[9]) / s;
+			z = 0.25f * s;
+		}
+
+		// Sensor rotations are not exactly orthonormal. q and -q are the same rotation, the one
+		// with w >= 0 is returned whatever the branch taken.
+		const float norm = std::copysign(std::sqrt(x * x + y * y + z * z + w * w), w);
+		rotation[0] = x / norm;
+		rotation[1] = y / norm;
+		rotation[2] = z / norm;
+		rotation[3] = w / norm;
+	}
+
+	template <typename T>
+	inline void FromMatrix3x4(const float* matrix3x4, T* toWorld)
+	{
+		for (size_t i = 0; i < kMatrix3x4Size; ++i)
+		{
+			toWorld[i] = static_cast<T>(matrix3x4[i]);
+		}
+		toWorld[12] = T(0);
+		toWorld[13] = T(0);
+		toWorld[14] = T(0);
+		toWorld[15] = T(1);
+	}
+
+	// Row-major 4x4 transform, e.g. the SolAR pose of a PV frame from its compact form
+	template <typename T>
+	inline void FromQuaternionTranslation(const float rotation[4], const float translation[3], T* toWorld)
+	{
+		const T x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+		toWorld[0] = T(1) - T(2) * (y * y + z * z);
+		toWorld[1] = T(2) * (x * y - z * w);
+		toWorld[2] = T(2) * (x * z + y * w);
+		toWorld[3] = translation[0];
+		toWorld[4] = T(2) * (x * y + z * w);
+		toWorld[5] = T(1) - T(2) * (x * x + z * z);
+		toWorld[6] = T(2) * (y * z - x * w);
+		toWorld[7] = translation[1];
+		toWorld[8] = T(2) * (x * z - y * w);
+		toWorld[9] = T(2) * (y * z + x * w);
+		toWorld[10] = T(1) - T(2) * (x * x + y * y);
+		toWorld[11] = translation[2];
+		toWorld[12] = T(0);
+		toWorld[13] = T(0);
+		toWorld[14] = T(0);
+		toWorld[15] = T(1);
+	}
+}
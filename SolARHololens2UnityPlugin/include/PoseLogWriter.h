@@ -0,0 +1,69 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Text log of per-frame poses and metadata (eye gaze file, CSV trajectories), streamed to disk
+// while recording. Records are formatted in a preallocated chunk which is written and flushed
+// when full and on Close(): memory use does not depend on the recording length, and at most one
+// chunk is lost if the application is killed.
+// Not thread safe, lock from caller. No platform dependency.
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class PoseLogWriter
+{
+public:
+	// A few seconds of any log at 30 Hz
+	static constexpr size_t kDefaultChunkSize = 16 * 1024;
+	// Longest record accepted by WriteRecord()
+	static constexpr size_t kMaxValueCount = 32;
+
+	explicit PoseLogWriter(size_t chunkSize = kDefaultChunkSize);
+	~PoseLogWriter() { Close(); }
+
+	PoseLogWriter(const PoseLogWriter&) = delete;
+	PoseLogWriter& operator=(const PoseLogWriter&) = delete;
+
+	// Truncate path. Any previously opened file is closed first.
+	bool Open(const std::filesystem::path& path);
+	// Write the pending chunk and close the file
+	void Close();
+	bool IsOpen() const { return m_file.is_open(); }
+
+	// line is written as is, followed by a new line
+	void WriteLine(const std::string& line);
+	// "timestamp,values[0],...,values[count - 1]" followed by a new line. Values are printed
+	// like std::ostream does by default, so that files are unchanged from the in-memory logs.
+	void WriteRecord(int64_t timestamp, const float* values, size_t count);
+
+	// Lines written since Open()
+	uint64_t GetLineCount() const { return m_lineCount; }
+
+private:
+	// Make room for size bytes in the chunk, writing it if needed
+	char* Reserve(size_t size);
+	void WriteChunk();
+
+	std::ofstream m_file;
+	std::vector<char> m_chunk;
+	size_t m_chunkUsed = 0;
+	uint64_t m_lineCount = 0;
+};
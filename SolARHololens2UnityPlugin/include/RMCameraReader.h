@@ -11,11 +11,23 @@
 
 #pragma once
 
+#include "FrameQuality.h"
+#include "FrameRateController.h"
+#include "FrameSequence.h"
+#include "FrameSubscription.h"
+#include "LatencyTrace.h"
+#include "LockProfiler.h"
 #include "ResearchModeApi.h"
 #include "Tar.h"
+#include "TaskExecutor.h"
 #include "TimeConverter.h"
+#include "Trajectory.h"
 
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
 #include <mutex>
+#include <thread>
 #include <winrt/Windows.Perception.Spatial.h>
 #include <winrt/Windows.Perception.Spatial.Preview.h>
 
@@ -24,7 +36,7 @@
 // See also https://docs.microsoft.com/en-us/windows/mixed-reality/locatable-camera
 struct FrameLocation
 {
-	long long timestamp;	
+	long long timestamp;
 	winrt::Windows::Foundation::Numerics::float4x4 rigToWorldtransform;
 };
 
@@ -41,6 +53,9 @@ struct RMFrame
 	uint32_t height;
 };
 
+// Sensor agnostic part of a Research Mode camera reader: consent, stream, locator, recording
+// storage and calibration. Frame type dependent code lives in RMCameraReaderT specializations
+// (see VlcCameraReader.h and DepthCameraReader.h).
 class RMCameraReader
 {
 public:
@@ -50,93 +65,342 @@ public:
 		m_pRMSensor->AddRef();
 		m_pSensorFrame = nullptr;
 
+		// The sensor type of a reader never changes, no need to query it for each frame
+		m_sensorType = m_pRMSensor->GetSensorType();
+
 		m_camConsentGiven = camConsentGiven;
 		m_camAccessConsent = camAccessConsent;
 
 		// Get GUID identifying the rigNode to
 		// initialize the SpatialLocator
 		SetLocator(guid);
-		// Reserve for 10 seconds at 30fps (holds for VLC)
-		m_frameLocations.reserve(10 * 30);
-
-		//m_pCameraUpdateThread = new std::thread(CameraUpdateThread, this, camConsentGiven, camAccessConsent);
-		//m_pWriteThread = new std::thread(CameraWriteThread, this);
 	}
 
 	// Return false if thread is already running
-	bool start();
+	virtual bool start() = 0;
 	void stop();
 
-	void SetStorageFolder(const winrt::Windows::Storage::StorageFolder& storageFolder);
+	// Frames are staged in stagingArena if set (burst recording), written by the write tasks otherwise
+	void SetStorageFolder(const winrt::Windows::Storage::StorageFolder& storageFolder, const std::shared_ptr<StagingArena>& stagingArena = nullptr);
 	void SetWorldCoordSystem(const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& coordSystem);
-	void ResetStorageFolder();	
+	void ResetStorageFolder();
 
 	virtual ~RMCameraReader()
 	{
 		stop();
+		m_framePublisher.CloseAll();
+
+		if (m_pSensorFrame)
+		{
+			m_pSensorFrame->Release();
+		}
 
 		if (m_pRMSensor)
 		{
 			m_pRMSensor->CloseStream();
 			m_pRMSensor->Release();
 		}
-
-		//m_pWriteThread->join();
 	}
 
 	bool computeIntrinsics(float& fx, float& fy, float& cx, float& cy, float& avgReprojErr);
-//	winrt::com_array<uint8_t> getSensorData(uint64_t& timestamp, winrt::com_array<double>& PVtoWorldtransform, uint32_t& pixelBufferSize, uint32_t& width, uint32_t& height);
-	winrt::com_array<uint8_t> getVlcSensorData(uint64_t& timestamp, winrt::com_array<double>& PVtoWorldtransform, uint32_t& pixelBufferSize, uint32_t& width, uint32_t& height, bool flip);
-	winrt::com_array<uint16_t> getDepthSensorData(uint64_t& timestamp, winrt::com_array<double>& PVtoWorldtransform, uint32_t& pixelBufferSize, uint32_t& width, uint32_t& height);
-	uint32_t getWidth();
-	uint32_t getHeight();
+	// Rig to camera extrinsics, row-major as in <sensor>_extrinsics.txt, and the unit ray of each
+	// pixel center (x, y, z per pixel, z is 0 where the mapping fails) as in <sensor>_lut.bin.
+	// Return false until the resolution is known.
+	bool getCalibration(float extrinsics[16], std::vector<float>& rays);
+	// Resolution is cached from the first frame received after the stream is opened,
+	// 0 is returned until then.
+	uint32_t getWidth() const;
+	uint32_t getHeight() const;
+	ResearchModeSensorType getSensorType() const { return m_sensorType; }
+	StreamFrameCounters getFrameCounters();
+
+	// Block until a frame with a sequence number other than lastSeenSequence is available,
+	// the reader is stopped or timeoutMs expires. Returns the status a getter called with
+	// lastSeenSequence would report, without consuming the frame.
+	FrameRequestStatus waitForNextFrame(uint64_t lastSeenSequence, uint32_t timeoutMs, uint64_t& sequence);
+
+	// Push-based access: every frame is delivered once to each subscriber of the publisher
+	FramePublisher& getFramePublisher() { return m_framePublisher; }
+
+	// Decimation of the stream at the source, frames dropped here are never seen by getters,
+	// subscribers nor recording
+	void setFrameRate(const FrameRateSettings& settings) { m_rateController.Configure(settings); }
+	// Keyframe selection, applied at the source after rate control
+	KeyframeSelector& getKeyframeSelector() { return m_keyframeSelector; }
+	// Blurry frames filter, applied at the source before keyframe selection (0 disables it)
+	void setSharpnessThreshold(float minSharpness) { m_sharpnessFilter.SetThreshold(minSharpness); }
+	// Stage latencies of the frames of this stream
+	PipelineTracer& getPipelineTracer() { return m_tracer; }
 
 protected:
-	static void CameraUpdateThread(RMCameraReader* pReader, HANDLE camConsentGiven, ResearchModeSensorConsent* camAccessConsent);
-	static void CameraWriteThread(RMCameraReader* pReader);
+	// m_frameSequence.Request(), tracing the first pickup of each frame.
+	// Lock on m_sensorFrameMutex from caller
+	FrameRequestStatus RequestFrame(uint64_t lastSeenSequence);
 
-	bool IsNewTimestamp(IResearchModeSensorFrame* pSensorFrame);
+	// Wait for sensor access consent, then open the sensor stream.
+	// Return false if access is denied or the stream cannot be opened.
+	bool WaitForConsentAndOpenStream();
+	void CloseStream();
 
-	void SaveFrame(IResearchModeSensorFrame* pSensorFrame);
-	void SaveVLC(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorVLCFrame* pVLCFrame);
-	void SaveDepth(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorDepthFrame* pDepthFrame);
+	// Lock on m_sensorFrameMutex from caller
+	void CacheResolution(IResearchModeSensorFrame* pSensorFrame);
+	// Fill the sensor agnostic part of a shared frame from the latest frame.
+	// Lock on m_sensorFrameMutex from caller
+	void FillSharedFrameHeader(SharedFrame& frame) const;
 
 	void DumpCalibration();
 
 	void SetLocator(const GUID& guid);
+	// Append the location of m_pSensorFrame to m_poseLog.
+	// Lock on m_sensorFrameMutex and m_storageMutex from caller
 	bool AddFrameLocation();
-	void DumpFrameLocations();
-	bool updateFrameLocation();
+	// Rig to world transform at the given frame timestamp, false if the rig cannot be located
+	bool LocateFrame(UINT64 hostTicks, FrameLocation& location) const;
 
+	static std::string CreateHeader(const ResearchModeSensorResolution& resolution, int maxBitmapValue);
 
 	HANDLE m_camConsentGiven;
 	ResearchModeSensorConsent* m_camAccessConsent;
 
+	ResearchModeSensorType m_sensorType;
+	ResearchModeSensorResolution m_resolution{};
+	std::atomic<bool> m_hasResolution = false;
+
 	// Mutex to access sensor frame
-	std::mutex m_sensorFrameMutex;
+	ProfiledMutex m_sensorFrameMutex{ "RMCameraReader::m_sensorFrameMutex" };
 	IResearchModeSensor* m_pRMSensor = nullptr;
 	IResearchModeSensorFrame* m_pSensorFrame = nullptr;
+	// Host ticks timestamp and sequence number of m_pSensorFrame
+	UINT64 m_frameTimestamp = 0;
+	FrameSequence m_frameSequence;
+	// Signalled by the update thread each time a new frame is stored, and on stop()
+	std::condition_variable_any m_frameCondVar;
+	FramePublisher m_framePublisher;
+	FrameRateController m_rateController;
+	KeyframeSelector m_keyframeSelector;
+	SharpnessFilter m_sharpnessFilter;
+	// Sharpness score of m_pSensorFrame, FrameQuality::kNoScore if not scored
+	float m_frameSharpness = FrameQuality::kNoScore;
+	PipelineTracer m_tracer;
+	// Pipeline stamps of m_pSensorFrame, up to PipelineStage::Copied
+	FrameTrace m_frameTrace;
+	// Sequence number of the last frame written by the write tasks
+	uint64_t m_lastSavedSequence = 0;
 
 	std::atomic<bool> m_fExit = false;
 	std::unique_ptr<std::thread> m_pCameraUpdateThread;
-	std::unique_ptr<std::thread> m_pWriteThread;
+	// Set by start() when a storage folder is set: each new frame schedules a write task, which
+	// writes the latest frame. A late storage skips frames instead of queuing them.
+	std::atomic<bool> m_isRecording = false;
+	SerialTaskQueue m_writeQueue{ TaskExecutor::GetShared(), TaskPriority::Recording, 1 };
 
 	// Mutex to access storage folder
-	std::mutex m_storageMutex;
+	ProfiledMutex m_storageMutex{ "RMCameraReader::m_storageMutex" };
 	// conditional variable to enable / disable writing to disk
-	std::condition_variable m_storageCondVar;
+	std::condition_variable_any m_storageCondVar;
 	winrt::Windows::Storage::StorageFolder m_storageFolder = nullptr;
-	std::unique_ptr<Io::Tarball> m_tarball;
+	std::unique_ptr<Io::StagedTarball> m_tarball;
+	// <sensor>_rig2world.traj, streamed by the write tasks, lock on m_storageMutex
+	TrajectoryWriter m_poseLog;
 
 	TimeConverter m_converter;
-	UINT64 m_prevTimestamp = 0;
 
 	winrt::Windows::Perception::Spatial::SpatialLocator m_locator = nullptr;
 	winrt::Windows::Perception::Spatial::SpatialCoordinateSystem m_worldCoordSystem = nullptr;
-	std::vector<FrameLocation> m_frameLocations;
-	FrameLocation m_frameLocation;
+	// Location of m_pSensorFrame, identity transform if not m_frameLocated
+	FrameLocation m_frameLocation{ 0, winrt::Windows::Foundation::Numerics::float4x4::identity() };
+	bool m_frameLocated = false;
+};
+
+// Compile-time specialization of RMCameraReader for one Research Mode frame interface
+// (IResearchModeSensorVLCFrame, IResearchModeSensorDepthFrame).
+// The typed frame interface is queried once by the update thread when a frame is acquired,
+// getters and recording then work on m_pTypedFrame without any interface discovery.
+// Derived must provide: void SaveFrame(IResearchModeSensorFrame*, TFrame*)
+//                       void FillSharedFrameData(TFrame*, SharedFrame&)
+//                       float ComputeSharpness(IResearchModeSensorFrame*, TFrame*)
+template <class Derived, class TFrame>
+class RMCameraReaderT : public RMCameraReader
+{
+public:
+	using RMCameraReader::RMCameraReader;
+
+	virtual ~RMCameraReaderT()
+	{
+		// Threads and tasks must be done before the frames they use are released
+		stop();
+
+		if (m_pTypedFrame)
+		{
+			m_pTypedFrame->Release();
+		}
+	}
+
+	bool start() override
+	{
+		if (m_pCameraUpdateThread)
+		{
+			// Already started, or not stopped yet
+			return false;
+		}
+
+		m_fExit = false;
+		m_isRecording = static_cast<bool>(m_storageFolder);
+		m_pCameraUpdateThread = std::make_unique<std::thread>(CameraUpdateThread, static_cast<Derived*>(this));
+
+		return true;
+	}
+
+protected:
+	static void CameraUpdateThread(Derived* pReader)
+	{
+		ScopedThreadProfile profile("RMCameraReader::CameraUpdateThread");
+		if (!pReader->WaitForConsentAndOpenStream())
+		{
+			return;
+		}
+
+		while (!pReader->m_fExit && pReader->m_pRMSensor)
+		{
+			IResearchModeSensorFrame* pSensorFrame = nullptr;
+			if (FAILED(pReader->m_pRMSensor->GetNextBuffer(&pSensorFrame)))
+			{
+				continue;
+			}
+
+			FrameTrace trace;
+			trace.Mark(PipelineStage::Acquired);
+
+			ResearchModeSensorTimestamp timestamp;
+			if (FAILED(pSensorFrame->GetTimeStamp(&timestamp)))
+			{
+				pSensorFrame->Release();
+				continue;
+			}
+			// Host ticks are on the clock of PipelineClockNow()
+			trace.Set(PipelineStage::Exposure, timestamp.HostTicks);
+
+			// Decimation happens before pose lookup, interface query and copy
+			FrameRateController& rateController = pReader->m_rateController;
+			if (!rateController.AcceptTimestamp(timestamp.HostTicks))
+			{
+				pSensorFrame->Release();
+				continue;
+			}
+
+			FrameLocation location;
+			const bool located = pReader->LocateFrame(timestamp.HostTicks, location);
+			trace.Mark(PipelineStage::Located);
+			const KeyframePose keyframePose = located ? ToKeyframePose(location.rigToWorldtransform) : KeyframePose{};
+			if (located && rateController.RequiresPose() && !rateController.AcceptPose(keyframePose))
+			{
+				pSensorFrame->Release();
+				continue;
+			}
+
+			TFrame* pTypedFrame = nullptr;
+			if (FAILED(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pTypedFrame))))
+			{
+				pSensorFrame->Release();
+				continue;
+			}
+
+			const float sharpness = pReader->ComputeSharpness(pSensorFrame, pTypedFrame);
+			if (!pReader->m_sharpnessFilter.Accept(sharpness))
+			{
+				pTypedFrame->Release();
+				pSensorFrame->Release();
+				continue;
+			}
+
+			const uint64_t absoluteTimestamp = pReader->m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds(checkAndConvertUnsigned(timestamp.HostTicks))).count();
+			if (!pReader->m_keyframeSelector.Evaluate(absoluteTimestamp, located ? &keyframePose : nullptr))
+			{
+				pTypedFrame->Release();
+				pSensorFrame->Release();
+				continue;
+			}
+
+			if (located)
+			{
+				rateController.Commit(timestamp.HostTicks, keyframePose);
+			}
+			else
+			{
+				rateController.Commit(timestamp.HostTicks);
+			}
+			trace.Mark(PipelineStage::Converted);
+
+			// Only copy the frame out of the sensor buffer if someone subscribed to it
+			std::shared_ptr<SharedFrame> sharedFrame;
+			if (pReader->m_framePublisher.HasSubscribers())
+			{
+				sharedFrame = pReader->m_framePublisher.AllocateFrame();
+			}
 
-//	winrt::com_array<uint8_t> getVlcSensorData(uint64_t& timestamp, winrt::com_array<double>& PVtoWorldtransform, uint32_t& pixelBufferSize, uint32_t& width, uint32_t& height);
-//	winrt::com_array<uint16_t> getDepthSensorData(uint64_t& timestamp, winrt::com_array<double>& PVtoWorldtransform, uint32_t& pixelBufferSize, uint32_t& width, uint32_t& height);
+			{
+				std::lock_guard<ProfiledMutex> guard(pReader->m_sensorFrameMutex);
+				if (pReader->m_pSensorFrame)
+				{
+					pReader->m_pSensorFrame->Release();
+					pReader->m_pTypedFrame->Release();
+				}
+				pReader->m_pSensorFrame = pSensorFrame;
+				pReader->m_pTypedFrame = pTypedFrame;
+				pReader->m_frameTimestamp = timestamp.HostTicks;
+				pReader->m_frameSharpness = sharpness;
+				trace.sequence = pReader->m_frameSequence.Produce();
+				pReader->CacheResolution(pSensorFrame);
+				// A frame which cannot be located does not keep the pose of the previous one
+				pReader->m_frameLocation = located ? location : FrameLocation{ static_cast<long long>(absoluteTimestamp), winrt::Windows::Foundation::Numerics::float4x4::identity() };
+				pReader->m_frameLocated = located;
+
+				if (sharedFrame)
+				{
+					pReader->FillSharedFrameHeader(*sharedFrame);
+					pReader->FillSharedFrameData(pTypedFrame, *sharedFrame);
+				}
+
+				trace.Mark(PipelineStage::Copied);
+				pReader->m_frameTrace = trace;
+			}
+			pReader->m_frameCondVar.notify_all();
+
+			if (sharedFrame)
+			{
+				pReader->m_framePublisher.Publish(sharedFrame);
+			}
+			trace.Mark(PipelineStage::Published);
+			pReader->m_tracer.Complete(trace);
+
+			if (pReader->m_isRecording)
+			{
+				pReader->m_writeQueue.Schedule([pReader]() { WriteLatestFrame(pReader); });
+			}
+		}
+
+		pReader->CloseStream();
+	}
+
+	// Task of m_writeQueue
+	static void WriteLatestFrame(Derived* pReader)
+	{
+		std::lock_guard<ProfiledMutex> storage_guard(pReader->m_storageMutex);
+		// Recording may have stopped since the task was scheduled
+		if (pReader->m_storageFolder == nullptr)
+		{
+			return;
+		}
+
+		std::lock_guard<ProfiledMutex> reader_guard(pReader->m_sensorFrameMutex);
+		if (pReader->m_pSensorFrame && pReader->m_frameSequence.Latest() != pReader->m_lastSavedSequence)
+		{
+			pReader->m_lastSavedSequence = pReader->m_frameSequence.Latest();
+			pReader->AddFrameLocation();
+			pReader->SaveFrame(pReader->m_pSensorFrame, pReader->m_pTypedFrame);
+		}
+	}
 
+	// Typed interface of m_pSensorFrame, guarded by m_sensorFrameMutex
+	TFrame* m_pTypedFrame = nullptr;
 };
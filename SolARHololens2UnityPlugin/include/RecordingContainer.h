@@ -0,0 +1,298 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Single-file multi-sensor recordings (.slrec): every stream of a capture interleaved in timestamp
+// order, so that replay reads one file sequentially instead of merging per-sensor archives.
+//
+// Layout (little endian): a RecordingFileHeader followed by chunks, each
+//   RecordingChunkHeader
+//   RecordingIndexEntry[recordCount]		type, stream, timestamp and offset of each record
+//   records: RecordingRecordHeader, payload padded to a multiple of 8 bytes
+// Chunks are independent: a chunk truncated by a crash is ignored, the previous ones stay readable.
+// Records are in timestamp order within a chunk and across chunks, except records which reached
+// the writer later than its reorder window (see RecordingWriterStats::lateRecords).
+//
+// Payloads by RecordingRecordType:
+//   Image, Depth	SolARHL2FrameMetadata then the pixels, encoded with the NetworkCodec of the
+//					record header (NetworkProtocol.h) when the file is compressed
+//   Imu			SharedImuSample array
+//   Pose			SharedHeadPose
+//   Gaze			RecordingGaze
+//   Calibration	RecordingCalibration then width x height x 3 floats: unit ray of each pixel
+//   Governor		RecordingGovernorEvent (RecordingGovernor.h): quality change of a stream, frames
+//					of the stream which follow it are decimated or downscaled accordingly
+//
+// RecordingReader maps the file and reads records in place.
+// No platform dependency but the file mapping (Win32 or POSIX).
+
+#include "LockProfiler.h"
+#include "NetworkProtocol.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+enum class RecordingRecordType : uint16_t
+{
+	Image = 1,
+	Depth = 2,
+	Imu = 3,
+	Pose = 4,
+	Gaze = 5,
+	Calibration = 6,
+	Governor = 7
+};
+
+// Records of the chunk may be encoded (RecordingRecordHeader::codec)
+constexpr uint32_t kRecordingChunkCompressed = 1 << 0;
+
+struct RecordingFileHeader
+{
+	// 2: pose validity in SolARHL2FrameMetadata
+	static constexpr uint32_t kVersion = 2;
+
+	char magic[8] = { 'S', 'O', 'L', 'R', 'E', 'C', '\0', '\0' };
+	uint32_t version = kVersion;
+	uint32_t headerSize = 0;
+	uint32_t chunkHeaderSize = 0;
+	uint32_t indexEntrySize = 0;
+	uint32_t recordHeaderSize = 0;
+	uint32_t flags = 0;
+	uint64_t reserved[4] = {};
+};
+static_assert(sizeof(RecordingFileHeader) == 64, "RecordingFileHeader is part of the file format");
+
+struct RecordingChunkHeader
+{
+	static constexpr uint32_t kMagic = 0x4B4E4843;		// "CHNK"
+
+	uint32_t magic = kMagic;
+	uint32_t flags = 0;
+	uint32_t recordCount = 0;
+	uint32_t reserved = 0;
+	uint64_t size = 0;					// whole chunk, header included
+	uint64_t firstTimestamp = 0;
+	uint64_t lastTimestamp = 0;
+	uint64_t reserved2 = 0;
+};
+static_assert(sizeof(RecordingChunkHeader) == 48, "RecordingChunkHeader is part of the file format");
+
+struct RecordingIndexEntry
+{
+	uint64_t timestamp;
+	uint64_t offset;					// of the record header, from the chunk header
+	RecordingRecordType type;
+	uint16_t stream;					// SharedStream
+	uint32_t size;						// stored payload
+};
+static_assert(sizeof(RecordingIndexEntry) == 24, "RecordingIndexEntry is part of the file format");
+
+struct RecordingRecordHeader
+{
+	uint64_t timestamp;					// absolute, in hundreds of nanoseconds
+	RecordingRecordType type;
+	uint16_t stream;
+	NetworkCodec codec;					// pixels of Image and Depth records
+	uint16_t reserved;
+	uint32_t size;						// stored payload
+	uint32_t rawSize;					// payload once decoded
+};
+static_assert(sizeof(RecordingRecordHeader) == 24, "RecordingRecordHeader is part of the file format");
+
+struct RecordingGaze
+{
+	float origin[3];
+	float direction[3];
+};
+
+struct RecordingCalibration
+{
+	uint32_t width;
+	uint32_t height;
+	float extrinsics[16];				// rig to camera, row-major
+};
+
+struct RecordingWriterSettings
+{
+	static constexpr size_t kDefaultChunkSize = 4u << 20;
+	static constexpr uint64_t kDefaultReorderWindow = 2'000'000;		// 200 ms
+	static constexpr size_t kDefaultMaxPendingBytes = 256u << 20;
+
+	// Chunks are written when they reach this size
+	size_t chunkSize = kDefaultChunkSize;
+	// Records are held that long (in timestamp units) so that slower streams can be interleaved
+	uint64_t reorderWindow = kDefaultReorderWindow;
+	// Records waiting for the I/O thread, above which new records are dropped
+	size_t maxPendingBytes = kDefaultMaxPendingBytes;
+	// Encode Image and Depth pixels with the lossless codecs of NetworkProtocol.h
+	bool compress = false;
+};
+
+struct RecordingWriterStats
+{
+	uint64_t records = 0;				// written
+	uint64_t chunks = 0;
+	uint64_t bytes = 0;
+	uint64_t droppedRecords = 0;		// over maxPendingBytes
+	uint64_t lateRecords = 0;			// written after records with a later timestamp
+	size_t pendingBytes = 0;
+};
+
+// Writes records of any thread to a recording file. Write*() copy or reference the record and
+// return, the records are sorted, encoded and written by the I/O thread of the writer.
+class RecordingWriter
+{
+public:
+	RecordingWriter() = default;
+	~RecordingWriter() { Close(); }
+
+	RecordingWriter(const RecordingWriter&) = delete;
+	RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+	// Truncate path and write the header
+	bool Open(const std::filesystem::path& path, const RecordingWriterSettings& settings = RecordingWriterSettings());
+	// Write the pending records and close the file
+	void Close();
+	bool IsOpen();
+
+	// Generic record: header (copied) followed by data. data is referenced until written if
+	// owner is set, copied otherwise. Return false if the record was dropped.
+	bool Write(RecordingRecordType type, uint16_t stream, uint64_t timestamp,
+			   const void* pHeader, size_t headerSize, const uint8_t* pData, size_t dataSize,
+			   std::shared_ptr<const void> owner = nullptr);
+	// Image or Depth record, depending on metadata.bytesPerPixel
+	bool WriteFrame(SharedStream stream, const SolARHL2FrameMetadata& metadata, const uint8_t* pPixels,
+					std::shared_ptr<const void> owner = nullptr);
+	bool WriteImu(SharedStream stream, const SharedImuSample* pSamples, size_t count);
+	bool WritePose(const SharedHeadPose& pose);
+	bool WriteGaze(uint64_t timestamp, const RecordingGaze& gaze);
+	bool WriteCalibration(SharedStream stream, uint64_t timestamp, const RecordingCalibration& calibration, const float* pRays);
+
+	// Encode the frames of stream, whatever settings.compress. Any thread.
+	void SetStreamCompression(uint16_t stream, bool compress);
+
+	RecordingWriterStats GetStats();
+	const RecordingWriterSettings& GetSettings() const { return m_settings; }
+
+private:
+	struct PendingRecord
+	{
+		uint64_t timestamp;
+		uint64_t order;					// arrival order, breaks timestamp ties
+		RecordingRecordType type;
+		uint16_t stream;
+		std::vector<uint8_t> header;
+		const uint8_t* pData;
+		size_t dataSize;
+		std::vector<uint8_t> copy;		// pData points to it if there is no owner
+		std::shared_ptr<const void> owner;
+	};
+
+	static void IoThread(RecordingWriter* pWriter);
+	// I/O thread: append record to the current chunk, write the chunk when full
+	void AppendRecord(const PendingRecord& record);
+	void WriteChunk();
+
+	RecordingWriterSettings m_settings;
+	std::atomic<uint32_t> m_compressedStreams{ 0 };
+
+	ProfiledMutex m_mutex{ "RecordingWriter::m_mutex" };
+	std::condition_variable_any m_condVar;
+	std::vector<std::unique_ptr<PendingRecord>> m_incoming;
+	size_t m_pendingBytes = 0;
+	uint64_t m_nextOrder = 0;
+	bool m_closing = false;
+	RecordingWriterStats m_stats;
+	std::unique_ptr<std::thread> m_pIoThread;
+
+	// I/O thread only: records of m_incoming are moved to the m_reorder heap, the earliest one is
+	// written once the latest timestamp is more than reorderWindow ahead of it
+	std::vector<std::unique_ptr<PendingRecord>> m_reorder;
+	uint64_t m_latestTimestamp = 0;
+	std::ofstream m_file;
+	std::vector<uint8_t> m_records;
+	std::vector<RecordingIndexEntry> m_index;
+	std::vector<uint8_t> m_encoded;
+	RecordingChunkHeader m_chunkHeader;
+	uint64_t m_lastTimestamp = 0;
+};
+
+// Record read in place
+struct RecordingRecord
+{
+	uint64_t timestamp = 0;
+	RecordingRecordType type = RecordingRecordType::Image;
+	uint16_t stream = 0;
+	NetworkCodec codec = NetworkCodec::Raw;
+	const uint8_t* pPayload = nullptr;
+	uint32_t size = 0;
+	uint32_t rawSize = 0;
+};
+
+// Read-only memory mapping of a recording file
+class RecordingReader
+{
+public:
+	RecordingReader() = default;
+	~RecordingReader() { Close(); }
+
+	RecordingReader(const RecordingReader&) = delete;
+	RecordingReader& operator=(const RecordingReader&) = delete;
+
+	// Return false if the file cannot be mapped or is not a recording of a known version
+	bool Open(const std::filesystem::path& path);
+	void Close();
+
+	size_t GetChunkCount() const { return m_chunks.size(); }
+	const RecordingChunkHeader& GetChunkHeader(size_t chunk) const { return *m_chunks[chunk]; }
+	uint64_t GetRecordCount() const { return m_recordCount; }
+
+	// Index of the first chunk which may hold records at or after timestamp
+	size_t SeekChunk(uint64_t timestamp) const;
+	RecordingRecord GetRecord(size_t chunk, size_t index) const;
+
+	// Demultiplexing: call callback with the records of the selected streams, in file order,
+	// from chunk firstChunk. Filtering only reads the chunk indexes. The callback returns false
+	// to stop. typeMask and streamMask have bit (1 << type) and (1 << stream) set, ~0u for all.
+	void ForEachRecord(uint32_t typeMask, uint32_t streamMask, const std::function<bool(const RecordingRecord&)>& callback,
+					   size_t firstChunk = 0) const;
+
+	// Image or Depth record: metadata and decoded pixels. False if malformed.
+	static bool DecodeFrame(const RecordingRecord& record, SolARHL2FrameMetadata& metadata, std::vector<uint8_t>& pixels);
+
+private:
+	const RecordingIndexEntry* Index(size_t chunk) const
+	{
+		return reinterpret_cast<const RecordingIndexEntry*>(reinterpret_cast<const uint8_t*>(m_chunks[chunk]) + sizeof(RecordingChunkHeader));
+	}
+
+	const uint8_t* m_pData = nullptr;
+	size_t m_size = 0;
+	void* m_fileHandle = nullptr;
+	void* m_mappingHandle = nullptr;
+
+	std::vector<const RecordingChunkHeader*> m_chunks;
+	uint64_t m_recordCount = 0;
+};
@@ -0,0 +1,130 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Feedback between the storage and the recorded streams: the governor measures the sustained
+// write bandwidth and the queue depth of the recording writer, and the bandwidth of each stream.
+// When the writer falls behind (queue filling up, streams producing more than the storage
+// writes, or over a fixed budget), it degrades one stream by one quality level; once the
+// writer has kept up for a while, it restores one level.
+//
+// Streams are degraded in reverse priority order, the lowest priority stream first through all
+// its levels, and restored in priority order. Quality levels of a stream, from full quality:
+//   lossless compression (streams with a codec), 1/2 frame rate, 1/2 resolution, 1/4 frame rate,
+//   1/8 frame rate
+// No platform dependency.
+
+#include "SharedMemoryRing.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct RecordingGovernorSettings
+{
+	// Writer queue fill ratios: degrade above high, restore below low
+	double highWatermark = 0.5;
+	double lowWatermark = 0.15;
+	// Recorded bytes per second not to exceed, 0 to only follow the storage
+	uint64_t budgetBytesPerSecond = 0;
+	// Evaluations with the writer keeping up before one level is restored
+	uint32_t restorePeriods = 6;
+};
+
+// What a stream records at its current level
+struct RecordingStreamQuality
+{
+	uint32_t level = 0;
+	bool compress = false;
+	uint32_t keepEveryNth = 1;
+	uint32_t resolutionDivisor = 1;
+};
+
+enum class RecordingGovernorReason : uint16_t
+{
+	QueueFull = 1,		// writer queue over highWatermark
+	Backlog = 2,		// streams produce faster than the storage writes, the queue grows
+	Budget = 3,			// over budgetBytesPerSecond
+	Recovered = 4		// level restored
+};
+
+// Adjustment of one stream, recorded as RecordingRecordType::Governor
+struct RecordingGovernorEvent
+{
+	uint16_t stream;					// SharedStream
+	RecordingGovernorReason reason;
+	uint32_t level;
+	uint32_t compress;
+	uint32_t keepEveryNth;
+	uint32_t resolutionDivisor;
+	uint32_t reserved;
+	uint64_t writeBytesPerSecond;		// sustained write bandwidth
+	uint64_t inputBytesPerSecond;		// all streams
+	uint64_t streamBytesPerSecond;		// adjusted stream, before the adjustment
+	uint64_t pendingBytes;
+};
+static_assert(sizeof(RecordingGovernorEvent) == 56, "RecordingGovernorEvent is part of the recording format");
+
+class RecordingGovernor
+{
+public:
+	static constexpr size_t kMaxStreams = 32;
+
+	explicit RecordingGovernor(const RecordingGovernorSettings& settings = RecordingGovernorSettings());
+
+	// priority: governed streams, highest priority first. canCompress: streams with a codec.
+	// Call before the recording starts.
+	void SetPriority(const std::vector<SharedStream>& priority, const std::vector<SharedStream>& canCompress);
+
+	// Any thread: bytes submitted for stream, and the quality to record it at
+	void AddInput(SharedStream stream, size_t bytes);
+	RecordingStreamQuality GetQuality(SharedStream stream) const;
+
+	// Called periodically by a single thread, seconds since the previous call. writtenBytes is
+	// cumulative. Append the adjustments made, at most one per call.
+	void Update(double seconds, uint64_t writtenBytes, size_t pendingBytes, size_t pendingCapacity,
+				std::vector<RecordingGovernorEvent>& events);
+
+	uint64_t GetWriteBytesPerSecond() const { return m_writeBytesPerSecond; }
+	uint64_t GetAdjustmentCount() const { return m_adjustments; }
+
+	static RecordingStreamQuality GetLevelQuality(uint32_t level, bool canCompress);
+	static uint32_t GetMaxLevel(bool canCompress);
+
+private:
+	struct Stream
+	{
+		std::atomic<uint64_t> inputBytes{ 0 };
+		std::atomic<uint32_t> level{ 0 };
+		bool governed = false;
+		bool canCompress = false;
+		uint64_t lastInputBytes = 0;
+		double bytesPerSecond = 0.;
+	};
+
+	RecordingGovernorSettings m_settings;
+	Stream m_streams[kMaxStreams];
+	std::vector<SharedStream> m_priority;
+
+	uint64_t m_lastWrittenBytes = 0;
+	size_t m_lastPendingBytes = 0;
+	bool m_hasMeasure = false;
+	std::atomic<uint64_t> m_writeBytesPerSecond{ 0 };
+	uint32_t m_calmPeriods = 0;
+	std::atomic<uint64_t> m_adjustments{ 0 };
+};
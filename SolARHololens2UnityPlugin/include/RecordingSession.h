@@ -0,0 +1,113 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Records the plugin streams to a single recording file (RecordingContainer.h): frames are
+// subscribed to through their FramePublisher and referenced until the writer has written them,
+// IMU samples are drained from the readers by a polling thread, head poses and eye gaze are
+// pushed by the caller. The calibration of a camera is recorded with its first frame.
+// With a RecordingGovernor, frames are decimated, downscaled or compressed as it decides, and
+// its adjustments are recorded.
+// Readers and frame publishers must outlive the RecordingSession.
+
+#include "FrameSubscription.h"
+#include "ImuReader.h"
+#include "RecordingContainer.h"
+#include "RecordingGovernor.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Fill the calibration of a camera and its rays, false if not available yet
+using RecordingCalibrationSource = std::function<bool(RecordingCalibration& calibration, std::vector<float>& rays)>;
+
+class RecordingSession
+{
+public:
+	// Subscription queue of each frame stream: the writer does not block, the queue only absorbs
+	// scheduling hiccups of the delivery tasks (recording priority)
+	static constexpr size_t kFrameQueueCapacity = 8;
+
+	RecordingSession() = default;
+	~RecordingSession() { Close(); }
+
+	RecordingSession(const RecordingSession&) = delete;
+	RecordingSession& operator=(const RecordingSession&) = delete;
+
+	static constexpr uint32_t kGovernorPeriodMs = 500;
+
+	bool Open(const std::filesystem::path& path, const RecordingWriterSettings& settings = RecordingWriterSettings());
+	// Unsubscribe from the streams, then write the pending records and close the file
+	void Close();
+
+	// Call between Open() and Close(), before adding the streams. priority: governed streams,
+	// highest priority first (see RecordingGovernor.h).
+	void EnableGovernor(const RecordingGovernorSettings& settings, const std::vector<SharedStream>& priority);
+
+	// Call between Open() and Close()
+	void AddFrameStream(SharedStream stream, FramePublisher& publisher, RecordingCalibrationSource calibration = nullptr);
+	void AddImuStream(SharedStream stream, const ImuReader& reader);
+
+	void WritePose(const SharedHeadPose& pose) { m_writer.WritePose(pose); }
+	void WriteGaze(uint64_t timestamp, const RecordingGaze& gaze) { m_writer.WriteGaze(timestamp, gaze); }
+
+	RecordingWriterStats GetStats() { return m_writer.GetStats(); }
+	// Sustained write bandwidth and adjustment count, 0 without governor
+	uint64_t GetWriteBytesPerSecond() const { return m_governor ? m_governor->GetWriteBytesPerSecond() : 0; }
+	uint64_t GetGovernorAdjustmentCount() const { return m_governor ? m_governor->GetAdjustmentCount() : 0; }
+
+private:
+	struct FrameStream
+	{
+		SharedStream stream;
+		RecordingCalibrationSource calibration;
+		bool calibrationWritten = false;
+		uint64_t frameCount = 0;
+		std::vector<uint8_t> downscaled;
+		std::unique_ptr<FrameCallbackSubscription> subscription;
+	};
+
+	struct ImuStream
+	{
+		SharedStream stream;
+		const ImuReader* pReader = nullptr;
+		uint64_t lastIndex = 0;
+		std::vector<ImuSample> samples;
+		std::vector<SharedImuSample> batch;
+	};
+
+	// Called by the delivery tasks of the subscription of stream
+	void WriteFrame(FrameStream& stream, const SharedFramePtr& frame);
+	// Drains the IMU readers and runs the governor
+	static void PollThread(RecordingSession* pSession);
+	void UpdateGovernor(double seconds);
+
+	RecordingWriter m_writer;
+	std::unique_ptr<RecordingGovernor> m_governor;
+	// Of the last frame, governor adjustments are recorded with it
+	std::atomic<uint64_t> m_lastTimestamp = 0;
+	std::vector<RecordingGovernorEvent> m_governorEvents;
+	std::vector<std::unique_ptr<FrameStream>> m_frameStreams;
+
+	ProfiledMutex m_pollMutex{ "RecordingSession::m_pollMutex" };
+	std::vector<std::unique_ptr<ImuStream>> m_imuStreams;
+	std::atomic<bool> m_fExit = false;
+	std::unique_ptr<std::thread> m_pPollThread;
+};
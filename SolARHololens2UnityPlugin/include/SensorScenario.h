@@ -12,7 +12,9 @@
 #pragma once
 
 #include "ResearchModeApi.h"
-#include "RMCameraReader.h"
+#include "DepthCameraReader.h"
+#include "ImuReader.h"
+#include "VlcCameraReader.h"
 
 
 class SensorScenario
@@ -23,13 +25,21 @@ public:
 
 	void InitializeSensors();
 	void InitializeCameraReaders();	
-	void StartRecording(const winrt::Windows::Storage::StorageFolder& folder, const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem);
+	void InitializeImuReaders();
+	void StartRecording(const winrt::Windows::Storage::StorageFolder& folder, const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem,
+						const std::shared_ptr<StagingArena>& stagingArena = nullptr);
 	void StopRecording();
 
 	static void CamAccessOnComplete(ResearchModeSensorConsent consent);
+	static void ImuAccessOnComplete(ResearchModeSensorConsent consent);
 
+	// All enabled readers, used for sensor agnostic operations (start, stop, recording, resolution)
 	std::map<ResearchModeSensorType, std::shared_ptr<RMCameraReader>> m_cameraReaders;
-	std::shared_ptr<RMCameraReader> m_depthCameraReader;
+	// Typed views on the same readers, used to fetch frames without runtime type checks
+	std::map<ResearchModeSensorType, std::shared_ptr<VlcCameraReader>> m_vlcCameraReaders;
+	std::shared_ptr<DepthCameraReader> m_depthCameraReader;
+	// IMU readers, started and stopped with the camera readers
+	std::map<ResearchModeSensorType, std::shared_ptr<ImuReader>> m_imuReaders;
 
 private:
 	void GetRigNodeId(GUID& outGuid) const;
@@ -47,4 +57,7 @@ private:
 	IResearchModeSensor* m_pRRCameraSensor = nullptr;
 	IResearchModeSensor* m_pLTSensor = nullptr;
 	IResearchModeSensor* m_pAHATSensor = nullptr;		
+	IResearchModeSensor* m_pAccelSensor = nullptr;
+	IResearchModeSensor* m_pGyroSensor = nullptr;
+	IResearchModeSensor* m_pMagSensor = nullptr;
 };
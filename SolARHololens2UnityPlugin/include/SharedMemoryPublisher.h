@@ -0,0 +1,90 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Publishes the plugin streams to shared memory rings (SharedMemoryRing.h) for out-of-process
+// consumers: frames are subscribed to through their FramePublisher and copied once into the ring
+// of their stream, IMU samples are drained from the readers by a polling thread, head poses are
+// pushed by the caller.
+// Readers and frame publishers must outlive the SharedMemoryPublisher.
+
+#include "FrameSubscription.h"
+#include "ImuReader.h"
+#include "SharedMemoryRing.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class SharedMemoryPublisher
+{
+public:
+	static constexpr uint32_t kDefaultFrameSlotCount = 4;
+	static constexpr uint32_t kImuSlotCount = 256;
+	static constexpr uint32_t kMaxImuSamplesPerRecord = 64;
+	static constexpr uint32_t kHeadPoseSlotCount = 256;
+
+	explicit SharedMemoryPublisher(uint32_t frameSlotCount = kDefaultFrameSlotCount);
+	~SharedMemoryPublisher();
+
+	SharedMemoryPublisher(const SharedMemoryPublisher&) = delete;
+	SharedMemoryPublisher& operator=(const SharedMemoryPublisher&) = delete;
+
+	// The ring is created on the first frame, sized for it. Larger frames are dropped.
+	void AddFrameStream(SharedStream stream, FramePublisher& publisher);
+	bool AddImuStream(SharedStream stream, const ImuReader& reader);
+	bool EnableHeadPoses();
+	void PublishHeadPose(const SharedHeadPose& pose);
+
+	// Frames which did not fit in their ring
+	uint64_t GetDroppedFrameCount() const { return m_droppedFrames; }
+
+private:
+	struct FrameStream
+	{
+		SharedStream stream;
+		SharedMemoryRingWriter ring;
+		bool failed = false;
+		std::unique_ptr<FrameCallbackSubscription> subscription;
+	};
+
+	struct ImuStream
+	{
+		const ImuReader* pReader = nullptr;
+		SharedMemoryRingWriter ring;
+		uint64_t lastIndex = 0;
+		std::vector<ImuSample> samples;
+		std::vector<SharedImuSample> batch;
+	};
+
+	// Called by the delivery tasks of the subscription of stream
+	void WriteFrame(FrameStream& stream, const SharedFrame& frame);
+	static void ImuThread(SharedMemoryPublisher* pPublisher);
+
+	const uint32_t m_frameSlotCount;
+	std::vector<std::unique_ptr<FrameStream>> m_frameStreams;
+	std::atomic<uint64_t> m_droppedFrames{ 0 };
+
+	ProfiledMutex m_imuMutex{ "SharedMemoryPublisher::m_imuMutex" };
+	std::vector<std::unique_ptr<ImuStream>> m_imuStreams;
+	std::atomic<bool> m_fExit = false;
+	std::unique_ptr<std::thread> m_pImuThread;
+
+	SharedMemoryRingWriter m_headPoseRing;
+};
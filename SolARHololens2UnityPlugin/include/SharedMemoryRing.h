@@ -0,0 +1,217 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Ring of records in a named shared memory region, written by one producer process and read in
+// place by any number of consumer processes, without locks on either side.
+//
+// Layout: a SharedRingHeader followed by slotCount slots, each a SharedSlotHeader and up to
+// slotCapacity bytes of payload, 64-byte aligned. Record n (1-based) goes to slot (n - 1) % slotCount.
+// Each slot is a sequence lock: its version is odd while the producer writes it, then 2n once
+// record n is complete. A reader checks the version before and after reading the payload in place;
+// a mismatch means the producer overwrote the slot meanwhile and the read must be discarded.
+// The producer never waits for readers: slow readers lose the oldest records.
+//
+// This header and SharedMemoryRing.cpp are the consumer library: they only depend on the
+// standard library, SolARHololens2PluginApi.h and the Win32 or POSIX shared memory API.
+//
+// Region names: "/<name>" in the POSIX shared memory namespace, the "Local\<name>" file mapping on
+// Windows. Created from the UWP app, "Local\" resolves to the named object namespace of its app
+// container (AppContainerNamedObjects\<package SID>), not to the session namespace of desktop
+// processes: only processes of the same package open the rings by name. A desktop consumer on the
+// device would need the path returned by GetAppContainerNamedObjectPath() for the package, which
+// this library does not resolve.
+
+#include "SolARHololens2PluginApi.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Ring counters are shared between processes");
+
+struct SharedRingHeader
+{
+	// 2: pose validity in SolARHL2FrameMetadata
+	static constexpr uint32_t kVersion = 2;
+
+	char magic[8] = { 'S', 'O', 'L', 'S', 'H', 'M', 'R', '\0' };
+	uint32_t version = kVersion;
+	uint32_t headerSize = 0;
+	uint32_t slotCount = 0;
+	uint32_t slotStride = 0;		// bytes between two slot headers
+	uint32_t slotCapacity = 0;		// maximum payload size
+	uint32_t recordType = 0;		// SharedRecordType
+	// Records written so far, the latest one is record writeCount
+	std::atomic<uint64_t> writeCount{ 0 };
+	// Lets a new producer replace the region of a crashed one (POSIX regions outlive processes)
+	uint64_t producerProcessId = 0;
+	uint64_t reserved[2] = {};
+};
+static_assert(sizeof(SharedRingHeader) == 64, "SharedRingHeader is shared between processes");
+
+struct SharedSlotHeader
+{
+	std::atomic<uint64_t> version{ 0 };
+	uint64_t timestamp = 0;
+	uint32_t size = 0;
+	uint32_t reserved[11] = {};
+};
+static_assert(sizeof(SharedSlotHeader) == 64, "SharedSlotHeader is shared between processes");
+
+class SharedMemoryRegion
+{
+public:
+	SharedMemoryRegion() = default;
+	~SharedMemoryRegion() { Close(); }
+
+	SharedMemoryRegion(const SharedMemoryRegion&) = delete;
+	SharedMemoryRegion& operator=(const SharedMemoryRegion&) = delete;
+
+	// Producer: fail if a region of that name exists
+	bool Create(const std::string& name, size_t size);
+	// Consumer: read-only mapping
+	bool Open(const std::string& name);
+	void Close();
+	// Remove the name of a region left by a dead producer, mappings are kept. No-op on Windows,
+	// where the region is freed with its last handle.
+	static void Remove(const std::string& name);
+
+	uint8_t* GetData() const { return m_pData; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	std::string m_name;
+	uint8_t* m_pData = nullptr;
+	size_t m_size = 0;
+	void* m_mappingHandle = nullptr;
+	bool m_isOwner = false;
+};
+
+// Single producer. Not thread safe.
+class SharedMemoryRingWriter
+{
+public:
+	// Fail if another live producer owns the name
+	bool Create(const std::string& name, uint32_t slotCount, uint32_t slotCapacity, uint32_t recordType);
+	void Close() { m_region.Close(); m_pHeader = nullptr; }
+	bool IsOpen() const { return m_pHeader != nullptr; }
+
+	uint32_t GetSlotCapacity() const { return m_pHeader ? m_pHeader->slotCapacity : 0; }
+
+	// Payload of the next record, nullptr if size exceeds the slot capacity. The slot is marked
+	// as being written: readers discard it until Commit().
+	uint8_t* BeginWrite(uint32_t size);
+	void Commit(uint64_t timestamp);
+	// BeginWrite(), copy, Commit()
+	bool Write(uint64_t timestamp, const void* pData, uint32_t size);
+
+private:
+	SharedSlotHeader* Slot(uint64_t record) const;
+
+	SharedMemoryRegion m_region;
+	SharedRingHeader* m_pHeader = nullptr;
+	uint64_t m_pendingRecord = 0;
+	uint32_t m_pendingSize = 0;
+};
+
+// Record read in place. data is only meaningful if SharedMemoryRingReader::IsValid() still
+// returns true once the caller is done with it.
+struct SharedRecordView
+{
+	uint64_t record = 0;
+	uint64_t timestamp = 0;
+	const uint8_t* data = nullptr;
+	uint32_t size = 0;
+};
+
+class SharedMemoryRingReader
+{
+public:
+	bool Open(const std::string& name);
+	void Close() { m_region.Close(); m_pHeader = nullptr; }
+	bool IsOpen() const { return m_pHeader != nullptr; }
+
+	uint32_t GetRecordType() const { return m_pHeader ? m_pHeader->recordType : 0; }
+	uint32_t GetSlotCount() const { return m_pHeader ? m_pHeader->slotCount : 0; }
+	// Number of the latest complete record, 0 if none
+	uint64_t GetLatestRecord() const;
+	// Oldest record number still in the ring
+	uint64_t GetOldestRecord() const;
+
+	// Zero copy: false if the record is not in the ring (overwritten, not written yet, or being written)
+	bool Peek(uint64_t record, SharedRecordView& view) const;
+	// Whether the slot of view was not overwritten since Peek()
+	bool IsValid(const SharedRecordView& view) const;
+	// Peek(), copy, IsValid()
+	bool Read(uint64_t record, SharedRecordView& view, std::vector<uint8_t>& data) const;
+
+private:
+	const SharedSlotHeader* Slot(uint64_t record) const;
+
+	SharedMemoryRegion m_region;
+	const SharedRingHeader* m_pHeader = nullptr;
+};
+
+// Streams published by the plugin (SharedMemoryPublisher), one ring each
+enum class SharedStream : uint32_t
+{
+	PV,
+	LEFT_FRONT,
+	LEFT_LEFT,
+	RIGHT_FRONT,
+	RIGHT_RIGHT,
+	DEPTH,
+	IMU_ACCEL,
+	IMU_GYRO,
+	IMU_MAG,
+	HEAD_POSE
+};
+
+enum class SharedRecordType : uint32_t
+{
+	Frame = 1,		// SolARHL2FrameMetadata followed by metadata.dataSize bytes of pixels
+	ImuSamples = 2,	// SharedImuSample array, record timestamp is the one of the last sample
+	HeadPose = 3	// SharedHeadPose
+};
+
+// Calibrated IMU sample, as ImuSample of the WinRT API
+struct SharedImuSample
+{
+	uint64_t index;
+	uint64_t timestamp;		// absolute, in hundreds of nanoseconds
+	uint64_t sensorTicks;	// IMU clock, in nanoseconds
+	float x;
+	float y;
+	float z;
+	float temperature;
+};
+
+// Head pose in the coordinate system of the frame transforms, as HeadPoseSample of the WinRT API
+struct SharedHeadPose
+{
+	uint64_t timestamp;		// absolute, in hundreds of nanoseconds
+	float position[3];
+	float forward[3];
+	float up[3];
+	uint32_t reserved;
+};
+
+// "SolARHL2_<stream>", e.g. "SolARHL2_LEFT_FRONT"
+std::string GetSharedStreamName(SharedStream stream);
@@ -0,0 +1,130 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Flat C API of the plugin, for native code and Unity [DllImport] callers, exported by the
+// component DLL next to the WinRT class (see SolARHololens2UnityPlugin.def).
+//
+// A stream handle subscribes to the frames of one enabled stream of the SolARHololens2ResearchMode
+// instance created by the application. Acquired frames point into the buffers published by the
+// capture threads, nothing is copied or marshalled: pixels stay valid until the frame is released,
+// after which the buffer is recycled for a later frame.
+//
+//   SolARHL2Stream* stream = NULL;
+//   if (SolARHL2_OpenStream(SOLARHL2_STREAM_LEFT_FRONT, 0, 0, &stream) == SOLARHL2_OK)
+//   {
+//       SolARHL2Frame frame;
+//       while (SolARHL2_AcquireFrame(stream, 100, &frame) != SOLARHL2_STREAM_CLOSED)
+//       {
+//           ... read frame.data, frame.metadata ...
+//           SolARHL2_ReleaseFrame(stream, &frame);
+//       }
+//       SolARHL2_CloseStream(stream);
+//   }
+//
+// Functions can be called from any thread, a stream handle must not be used concurrently.
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define SOLARHL2_API __stdcall
+#else
+#define SOLARHL2_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SOLARHL2_API_VERSION 2
+
+// Same values as the SensorStream enum of the WinRT API
+typedef enum SolARHL2StreamId
+{
+	SOLARHL2_STREAM_PV = 0,
+	SOLARHL2_STREAM_LEFT_FRONT = 1,
+	SOLARHL2_STREAM_LEFT_LEFT = 2,
+	SOLARHL2_STREAM_RIGHT_FRONT = 3,
+	SOLARHL2_STREAM_RIGHT_RIGHT = 4,
+	SOLARHL2_STREAM_DEPTH = 5
+} SolARHL2StreamId;
+
+typedef enum SolARHL2Result
+{
+	SOLARHL2_OK = 0,
+	SOLARHL2_NO_FRAME = 1,          // no frame before the timeout
+	SOLARHL2_STREAM_CLOSED = 2,     // stream stopped, close the handle
+	SOLARHL2_NOT_AVAILABLE = 3,     // no plugin instance, or stream not enabled or not started
+	SOLARHL2_INVALID_ARGUMENT = 4,
+	SOLARHL2_TOO_MANY_FRAMES = 5    // maxAcquiredFrames frames are held, release one first
+} SolARHL2Result;
+
+typedef struct SolARHL2FrameMetadata
+{
+	uint64_t sequence;
+	uint64_t timestamp;             // absolute, in hundreds of nanoseconds
+	// Sensor to world transform, row-major, column vector convention. PV frames use the SolAR
+	// camera axes (x right, y down, z forward), as GetPvData(), other streams the rig axes.
+	// Identity if poseValid is 0.
+	float toWorldTransform[16];
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytesPerPixel;         // 4 (PV, BGRA), 1 (VLC), 2 (depth)
+	uint32_t planeCount;            // 2 for depth: depth plane followed by the AB plane
+	uint32_t dataSize;              // bytes, width * height * bytesPerPixel * planeCount
+	float sharpness;                // -1 if not scored
+	uint32_t poseValid;             // 1 if the sensor was located at timestamp, 0 otherwise
+	uint32_t reserved;
+} SolARHL2FrameMetadata;
+
+typedef struct SolARHL2Frame
+{
+	SolARHL2FrameMetadata metadata;
+	const uint8_t* data;
+	uint32_t slot;                  // reserved, identifies the frame for SolARHL2_ReleaseFrame()
+	uint32_t reserved;
+} SolARHL2Frame;
+
+typedef struct SolARHL2StreamStats
+{
+	uint64_t received;              // frames published to the handle
+	uint64_t dropped;               // frames replaced in the queue before being acquired
+	uint32_t acquired;              // frames currently held
+	uint32_t reserved;
+} SolARHL2StreamStats;
+
+typedef struct SolARHL2Stream SolARHL2Stream;
+
+uint32_t SOLARHL2_API SolARHL2_GetApiVersion(void);
+
+// queueCapacity: frames queued before the oldest is dropped, 0 for default (4).
+// maxAcquiredFrames: frames held at the same time, 0 for default (2).
+// The stream must be enabled and the plugin started.
+SolARHL2Result SOLARHL2_API SolARHL2_OpenStream(
+	SolARHL2StreamId streamId, uint32_t queueCapacity, uint32_t maxAcquiredFrames, SolARHL2Stream** stream);
+// Release the frames still held and free the handle
+void SOLARHL2_API SolARHL2_CloseStream(SolARHL2Stream* stream);
+
+// Oldest queued frame, waiting up to timeoutMs (0 to poll)
+SolARHL2Result SOLARHL2_API SolARHL2_AcquireFrame(SolARHL2Stream* stream, uint32_t timeoutMs, SolARHL2Frame* frame);
+void SOLARHL2_API SolARHL2_ReleaseFrame(SolARHL2Stream* stream, SolARHL2Frame* frame);
+
+SolARHL2Result SOLARHL2_API SolARHL2_GetStreamStats(SolARHL2Stream* stream, SolARHL2StreamStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
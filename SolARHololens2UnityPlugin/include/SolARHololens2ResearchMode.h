@@ -30,6 +30,13 @@
 #include "Cannon/TrackedHands.h"
 
 
+#include "EyeGazeStream.h"
+#include "NetworkStreamServer.h"
+#include "RecordingSession.h"
+#include "SharedMemoryPublisher.h"
+#include "ImuPreintegration.h"
+#include "LockProfiler.h"
+#include "TimeConverter.h"
 #include "VideoFrameProcessor.h"
 
 namespace winrt::SolARHololens2UnityPlugin::implementation
@@ -52,7 +59,8 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
     struct SolARHololens2ResearchMode : SolARHololens2ResearchModeT<SolARHololens2ResearchMode>
     {
 
-        SolARHololens2ResearchMode() = default;
+        SolARHololens2ResearchMode();
+        ~SolARHololens2ResearchMode();
 
         void SetSpatialCoordinateSystem( Windows::Perception::Spatial::SpatialCoordinateSystem unitySpatialCoodinateSystem );
 
@@ -60,6 +68,8 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
         void EnablePv();
         void EnableVlc(RMSensorType sensorType);
         void EnableDepth(bool isLongThrow);
+        void EnableImu(ImuSensor sensor);
+        void EnableEyeGaze();
         // return false when attempting to change recording state while running
         bool EnableRecording();
         bool DisableRecording();
@@ -74,11 +84,13 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
 //        void InitializeRGBSensor();
         //void StartRGBSensorCapture();
         //void StopRGBSensorCapture();
-        com_array<uint8_t> GetPvData( uint64_t& timestamp, com_array<double>& PVtoWorldtransform,
+        com_array<uint8_t> GetPvData( uint64_t lastSeenSequence, FrameStatus& status, uint64_t& sequence,
+                                      uint64_t& timestamp, float& sharpness, com_array<double>& PVtoWorldtransform,
                                       float& fx, float& fy, uint32_t& pixelBufferSize,
                                       uint32_t& width, uint32_t& height, bool flip = false );
         uint32_t GetPvWidth();
         uint32_t GetPvHeight();
+        FrameCounters GetPvFrameCounters();
         std::mutex murgb;
         
         // Research Mode cameras
@@ -94,7 +106,11 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
                                 float& cy,
                                 float& avgReprojErr );
         com_array<uint8_t> GetVlcData( const RMSensorType sensor,
+                                       uint64_t lastSeenSequence,
+                                       FrameStatus& status,
+                                       uint64_t& sequence,
                                        uint64_t& timestamp,
+                                       float& sharpness,
                                        com_array<double>& PVtoWorldtransform,
                                        float& fx,
                                        float& fy,
@@ -102,9 +118,14 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
                                        uint32_t& width,
                                        uint32_t& height,
                                        bool flip);
+        FrameCounters GetVlcFrameCounters(RMSensorType sensor);
         uint32_t GetDepthWidth();
         uint32_t GetDepthHeight();
-        com_array<uint16_t> GetDepthData( uint64_t& timestamp,
+        FrameCounters GetDepthFrameCounters();
+        com_array<uint16_t> GetDepthData( uint64_t lastSeenSequence,
+                                          FrameStatus& status,
+                                          uint64_t& sequence,
+                                          uint64_t& timestamp,
                                           com_array<double>& PVtoWorldtransform,
                                           float& fx,
                                           float& fy,
@@ -112,10 +133,92 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
                                           uint32_t& width,
                                           uint32_t& height );
 
+        com_array<uint8_t> GetPvFrame( uint64_t lastSeenSequence, FrameStatus& status, FrameMetadata& metadata, bool flip );
+        com_array<uint8_t> GetVlcFrame( RMSensorType sensor,
+                                        uint64_t lastSeenSequence,
+                                        FrameStatus& status,
+                                        FrameMetadata& metadata,
+                                        bool flip );
+        com_array<uint16_t> GetDepthFrame( uint64_t lastSeenSequence, FrameStatus& status, FrameMetadata& metadata );
+        void SetPoseFormat( SensorStream stream, PoseFormat format );
+        com_array<double> GetPoseTransform( FramePose const& pose );
+
+        com_array<ImuSample> GetImuSamples( ImuSensor sensor, uint64_t sinceIndex, uint64_t& lostSamples );
+        bool PreintegrateImu( SensorStream stream,
+                              uint64_t fromTimestamp,
+                              uint64_t toTimestamp,
+                              com_array<double>& deltaRotation,
+                              com_array<double>& deltaVelocity,
+                              com_array<double>& deltaPosition,
+                              com_array<double>& covariance,
+                              com_array<double>& biasJacobians,
+                              double& deltaTime );
+        void SetImuPreintegrationSettings( ImuPreintegrationSettings const& settings );
+
+        com_array<EyeGazeSample> GetEyeGazeSamples( uint64_t sinceTimestamp );
+        bool GetEyeGazeAtTimestamp( SensorStream stream, uint64_t timestamp, EyeGazeSample& sample );
+        bool GetHeadPoseAtTimestamp( SensorStream stream, uint64_t timestamp, HeadPoseSample& pose );
+
+        void SetStreamRate( SensorStream stream, StreamRateSettings const& settings );
+        void SetKeyframeSelection( SensorStream stream, KeyframeSelection const& settings );
+        KeyframeSelectionStats GetKeyframeSelectionStats( SensorStream stream );
+        void SetSharpnessThreshold( SensorStream stream, float minSharpness );
+
+        PipelineStats GetPipelineStats( SensorStream stream );
+        void ResetPipelineStats( SensorStream stream );
+        hstring ExportPipelineTrace();
+
+        hstring GetLockProfileReport();
+        void ResetLockProfile();
+
+        com_array<ExecutorQueueStats> GetExecutorStats();
+        void ResetExecutorStats();
+
+        bool EnableSharedMemoryTransport( uint32_t frameSlots );
+        void DisableSharedMemoryTransport();
+
+        bool StartNetworkStreaming( NetworkStreamingSettings const& settings );
+        void StopNetworkStreaming();
+        NetworkStreamingStats GetNetworkStreamingStats();
+
+        bool SetRecordingFormat( RecordingFormat format, bool compress );
+        RecordingStats GetRecordingStats();
+        bool SetThroughputGovernor( ThroughputGovernorSettings const& settings, array_view<SensorStream const> priority );
+        bool SetBurstRecording( BurstRecordingSettings const& settings );
+        BurstRecordingStats GetBurstRecordingStats();
+
+        FrameStatus WaitForNextFrame( SensorStream stream,
+                                      uint64_t lastSeenSequence,
+                                      uint32_t timeoutMs,
+                                      uint64_t& sequence );
+        winrt::Windows::Foundation::IAsyncOperation<FrameStatus> WaitForNextFrameAsync( SensorStream stream,
+                                                                                        uint64_t lastSeenSequence,
+                                                                                        uint32_t timeoutMs );
+
+        // Native only (not exposed in the IDL): publisher of a stream, to subscribe to its frames
+        // from C++ code. Return nullptr if the stream is not enabled.
+        FramePublisher* GetFramePublisher( SensorStream stream );
+        // Native only: keyframe selector of a stream, gives access to its decision history
+        KeyframeSelector* GetKeyframeSelector( SensorStream stream );
+        // Native only: latency tracer of a stream
+        PipelineTracer* GetPipelineTracer( SensorStream stream );
+        // Native only: call function with the most recently constructed instance, which cannot be
+        // destroyed meanwhile. Return false if there is none. Used by the flat C API
+        // (SolARHololens2PluginApi.h), which has no reference on the instance created by Unity.
+        static bool WithActiveInstance( const std::function<void( SolARHololens2ResearchMode& )>& function );
+
         static ResearchModeSensorType toHololensRMSensorType(RMSensorType sType);
+        static ResearchModeSensorType toHololensRMSensorType(SensorStream stream);
+        static ResearchModeSensorType toHololensRMSensorType(ImuSensor sensor);
+        static SensorStream toSensorStream(RMSensorType sensor);
+        static FrameStatus toFrameStatus(FrameRequestStatus status);
+        static FrameCounters toFrameCounters(const StreamFrameCounters& counters);
+        static StageLatency toStageLatency(const LatencyStats& stats);
 
 
     private:
+        com_array<uint8_t> CopyPvPixels( bool flip ) const;
+
         MixedReality m_mixedReality;
 
         /* Supported ResearchMode streams:
@@ -125,7 +228,10 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
             RIGHT_FRONT,
             RIGHT_RIGHT,
             DEPTH_AHAT,
-            DEPTH_LONG_THROW
+            DEPTH_LONG_THROW,
+            IMU_ACCEL,
+            IMU_GYRO,
+            IMU_MAG
         }*/
         // TODO(jmhenaff): thing about using std::set. Easier to add without checking presence, easy to remove
         // if necessary, with extract()/node_handle (c++ 17)
@@ -178,6 +284,59 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
         //    ResearchModeSensorType::RIGHT_RIGHT*/
         //};
         std::unique_ptr<SensorScenario> m_sensorScenario = nullptr;
+
+        // Rate settings requested by the application, applied to readers when they are created
+        std::map<SensorStream, FrameRateSettings> m_streamRateSettings;
+        std::map<SensorStream, KeyframeSettings> m_keyframeSettings;
+        std::map<SensorStream, float> m_sharpnessThresholds;
+        // Read by the Get*Frame() getters, QuaternionTranslation if not set
+        std::map<SensorStream, PoseFormat> m_poseFormats;
+        FramePose GetFramePose( SensorStream stream, const winrt::Windows::Foundation::Numerics::float4x4& sensorToWorld, bool poseValid );
+        ImuPreintegrationParameters m_imuPreintegrationParameters;
+        void ApplyStreamSettings( SensorStream stream );
+
+        // Eye gaze sampled at render rate, nullptr if EYE is not enabled
+        std::unique_ptr<EyeGazeStream> m_eyeGazeStream = nullptr;
+        void RecordEyeGaze();
+
+        // MixedReality world coordinate system to the one of camera frame transforms (Unity's when
+        // set), updated once per Update() call so that lookups do not query the system
+        void UpdateWorldToFrameTransform();
+        bool GetWorldToFrameTransform( XMMATRIX& transform );
+        ProfiledMutex m_worldToFrameMutex{ "SolARHololens2ResearchMode::m_worldToFrameMutex" };
+        XMFLOAT4X4 m_worldToFrameTransform;
+        bool m_isWorldToFrameTransformValid = false;
+
+        // Frame timestamps of VLC streams are host ticks, PV, depth and render loop ones are absolute (FrameClock.h)
+        TimeConverter m_timeConverter;
+        uint64_t ToAbsoluteTimestamp( SensorStream stream, uint64_t timestamp ) const;
+
+        // Reader of a Research Mode stream, nullptr for PV or if the stream is not enabled
+        RMCameraReader* GetRMCameraReader( SensorStream stream );
+
+        // Declared after the readers it subscribes to, so that it is destroyed first
+        std::unique_ptr<SharedMemoryPublisher> m_sharedMemoryPublisher = nullptr;
+        std::unique_ptr<NetworkStreamServer> m_networkStreamServer = nullptr;
+        void PublishHeadPose();
+
+        RecordingFormat m_recordingFormat = RecordingFormat::SeparateFiles;
+        bool m_compressRecording = false;
+        // Container recording in progress, written by Update() (poses, gaze) and the recording
+        // coroutine, lock on m_recordingSessionMutex
+        ProfiledMutex m_recordingSessionMutex{ "SolARHololens2ResearchMode::m_recordingSessionMutex" };
+        std::unique_ptr<RecordingSession> m_recordingSession = nullptr;
+        RecordingWriterStats m_lastRecordingStats;
+        uint64_t m_lastWriteBytesPerSecond = 0;
+        uint64_t m_lastGovernorAdjustments = 0;
+        ThroughputGovernorSettings m_governorSettings{};
+        std::vector<SharedStream> m_governorPriority;
+        bool StartContainerRecording( const std::filesystem::path& path );
+        void StopContainerRecording();
+
+        BurstRecordingSettings m_burstSettings{};
+        // Arena of the current SeparateFiles recording, nullptr if burst recording is disabled
+        std::shared_ptr<StagingArena> m_stagingArena = nullptr;
+        StagingArenaStats m_lastStagingStats;
     };
 }
 namespace winrt::SolARHololens2UnityPlugin::factory_implementation
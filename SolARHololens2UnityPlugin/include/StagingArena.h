@@ -0,0 +1,150 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Burst recording: records (named files of the recording tarballs) are copied into a memory arena
+// allocated once for the whole capture, and written to their sink by a flush thread, either in the
+// background or only once the capture stopped. Capture threads never wait for the storage.
+//
+// The arena is a pool of fixed-size pages: a record takes as many pages as it needs, not
+// necessarily contiguous, so that any staged record can be evicted and its pages reused. The
+// budget is strict: when the arena is full, the overflow policy decides what is lost.
+// No platform dependency but the priority of the flush thread (Windows only).
+
+#include "LockProfiler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class StagingFlushMode
+{
+	Background,	// Write records as they come, on a below normal priority thread
+	AfterStop	// Keep records in memory until Flush()
+};
+
+enum class StagingOverflowPolicy
+{
+	WriteThrough,	// Write the incoming record synchronously: nothing is lost, the capture thread waits
+	DropNewest,		// Drop the incoming record: the recording keeps an uninterrupted run of the first records
+	DropOldest		// Evict the oldest staged records: the recording keeps the latest records
+};
+
+struct StagingArenaSettings
+{
+	static constexpr size_t kDefaultBudgetBytes = 512u << 20;
+	static constexpr size_t kDefaultPageSize = 64u << 10;
+
+	// Memory of the arena, allocated and touched by the constructor
+	size_t budgetBytes = kDefaultBudgetBytes;
+	size_t pageSize = kDefaultPageSize;
+	StagingFlushMode flushMode = StagingFlushMode::Background;
+	StagingOverflowPolicy overflowPolicy = StagingOverflowPolicy::WriteThrough;
+};
+
+struct StagingArenaStats
+{
+	size_t budgetBytes = 0;
+	size_t stagedBytes = 0;				// staged records not written yet
+	size_t peakStagedBytes = 0;
+	uint64_t stagedRecords = 0;
+	uint64_t flushedRecords = 0;
+	uint64_t flushedBytes = 0;
+	uint64_t overflows = 0;				// records which did not fit, handled by overflowPolicy
+	StagingOverflowPolicy overflowPolicy = StagingOverflowPolicy::WriteThrough;
+	uint64_t writtenThroughRecords = 0;
+	uint64_t droppedRecords = 0;		// incoming (DropNewest) or evicted (DropOldest)
+};
+
+struct StagingPiece
+{
+	const uint8_t* pData;
+	size_t size;
+};
+
+// Destination of staged records. Called by the flush thread, and by the capture threads with
+// StagingOverflowPolicy::WriteThrough: implementations serialize their writes.
+class StagingSink
+{
+public:
+	virtual ~StagingSink() = default;
+	// Record data is the concatenation of pieces, dataSize bytes
+	virtual void WriteRecord(const std::string& name, const std::vector<StagingPiece>& pieces, size_t dataSize) = 0;
+};
+
+class StagingArena
+{
+public:
+	explicit StagingArena(const StagingArenaSettings& settings = StagingArenaSettings());
+	// Write the staged records
+	~StagingArena();
+
+	StagingArena(const StagingArena&) = delete;
+	StagingArena& operator=(const StagingArena&) = delete;
+
+	// Copy the record into the arena, the sink is referenced until the record is written.
+	// Return false if the record was dropped.
+	bool Stage(const std::shared_ptr<StagingSink>& sink, const std::string& name, const uint8_t* pData, size_t dataSize);
+
+	// Write every staged record and return once they are written (start writing in AfterStop mode)
+	void Flush();
+
+	StagingArenaStats GetStats();
+	const StagingArenaSettings& GetSettings() const { return m_settings; }
+
+private:
+	static constexpr uint32_t kNoPage = UINT32_MAX;
+
+	struct Record
+	{
+		std::shared_ptr<StagingSink> sink;
+		uint32_t firstPage;
+		size_t nameSize;
+		size_t dataSize;
+	};
+
+	static void FlushThread(StagingArena* pArena);
+	// Lock on m_mutex from caller. Return kNoPage if there are not enough free pages.
+	uint32_t AllocatePages(size_t count);
+	void FreePages(uint32_t firstPage);
+	// Pieces of count bytes of the page chain from firstPage, skipping offset bytes
+	void GetPieces(uint32_t firstPage, size_t offset, size_t count, std::vector<StagingPiece>& pieces) const;
+	uint8_t* Page(uint32_t page) const { return m_memory.get() + static_cast<size_t>(page) * m_settings.pageSize; }
+
+	StagingArenaSettings m_settings;
+	std::unique_ptr<uint8_t[]> m_memory;
+	// Next page of the record, or of the free list
+	std::vector<uint32_t> m_nextPage;
+
+	ProfiledMutex m_mutex{ "StagingArena::m_mutex" };
+	std::condition_variable_any m_condVar;
+	std::condition_variable_any m_flushedCondVar;
+	uint32_t m_freeList = kNoPage;
+	size_t m_freePageCount = 0;
+	std::deque<Record> m_records;
+	bool m_flushRequested = false;
+	bool m_writing = false;
+	StagingArenaStats m_stats;
+	std::atomic<bool> m_fExit = false;
+	std::unique_ptr<std::thread> m_pFlushThread;
+};
@@ -11,9 +11,13 @@
 
 #pragma once
 
+#include "StagingArena.h"
+
 #include <intrin.h>
 #include <winrt/Windows.Storage.h>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 namespace Io
@@ -31,9 +35,41 @@ namespace Io
 
 		// Add a file to the tarball
 		void AddFile(const std::wstring& fileName, const uint8_t* fileData, const size_t fileSize);
+		// Same, with a UTF-8 file name and the data in pieces
+		void AddFile(const std::string& fileName, const std::vector<StagingPiece>& pieces, const size_t fileSize);
 
 	private:
+		void WriteHeader(const std::string& fileName, const size_t fileSize);
+		void WritePadding(const size_t fileSize);
+
 		// The file handler to the tarball
 		std::ofstream m_tarballFile;
 	};
+
+	// Tarball whose files are copied into a staging arena (burst recording) and written by its
+	// flush thread, or written directly if there is no arena. The tarball is closed once the
+	// StagedTarball is destroyed and its last staged file is written.
+	class StagedTarball
+	{
+	public:
+		StagedTarball(const std::wstring& tarballFileName, std::shared_ptr<StagingArena> arena);
+
+		void AddFile(const std::wstring& fileName, const uint8_t* fileData, const size_t fileSize);
+
+	private:
+		class Sink : public StagingSink
+		{
+		public:
+			explicit Sink(const std::wstring& tarballFileName) : m_tarball(tarballFileName) {}
+			void WriteRecord(const std::string& name, const std::vector<StagingPiece>& pieces, size_t dataSize) override;
+
+		private:
+			// The flush thread and write through capture threads
+			ProfiledMutex m_mutex{ "StagedTarball::Sink::m_mutex" };
+			Tarball m_tarball;
+		};
+
+		std::shared_ptr<Sink> m_sink;
+		std::shared_ptr<StagingArena> m_arena;
+	};
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Read-only memory mapping of the tarballs written by Io::Tarball (<sensor>.tar of the recordings):
+// the headers are scanned once on Open() into an index of the files, whose data are then read in
+// place, without extraction. A file truncated by a crash ends the index, the previous ones stay
+// readable.
+// No platform dependency but the file mapping (Win32 or POSIX).
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace Io
+{
+	struct TarballEntry
+	{
+		std::string name;
+		const uint8_t* pData;
+		size_t size;
+	};
+
+	class TarballReader
+	{
+	public:
+		TarballReader() = default;
+		~TarballReader() { Close(); }
+
+		TarballReader(const TarballReader&) = delete;
+		TarballReader& operator=(const TarballReader&) = delete;
+
+		// Return false if the file cannot be mapped or does not start with a valid header
+		bool Open(const std::filesystem::path& path);
+		void Close();
+
+		// In archive order
+		const std::vector<TarballEntry>& GetEntries() const { return m_entries; }
+
+	private:
+		const uint8_t* m_pData = nullptr;
+		size_t m_size = 0;
+		void* m_fileHandle = nullptr;
+		void* m_mappingHandle = nullptr;
+
+		std::vector<TarballEntry> m_entries;
+	};
+}
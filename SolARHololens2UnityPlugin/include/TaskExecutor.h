@@ -0,0 +1,148 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Shared executor of the background work of the plugin: frame delivery to the transports, PV
+// conversion, recording and meshing run as short tasks on one pool of workers (one per core,
+// Eigen NonBlockingThreadPool work stealing) instead of one thread per stream and consumer.
+//
+// Tasks are queued per priority class. The pool runs up to one token per worker, which, whichever
+// worker picks it, runs the oldest task of the highest non-empty class until none is left: capture
+// work overtakes queued recording or meshing work, but a running task is never preempted, so
+// tasks must stay short (one frame, one surface) and must not wait on sensors, sockets or other
+// tasks. Threads blocking on such waits (sensor GetNextBuffer, socket accept, file writers)
+// stay dedicated.
+//
+// SerialTaskQueue runs the tasks of one producer in order, one at a time, on the executor.
+// No platform dependency.
+
+#include "LockProfiler.h"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+
+// Highest first
+enum class TaskPriority
+{
+	Capture,	// live frames delivered to the transports
+	Conversion,	// PV frame location, scoring and pixel format conversion
+	Recording,	// frame encoding and storage
+	Background	// meshing, access requests
+};
+
+constexpr size_t kTaskPriorityCount = 4;
+
+// Tasks of one priority class since the executor was created or the last ResetStats()
+struct TaskClassStats
+{
+	uint64_t submitted = 0;
+	uint64_t started = 0;
+	uint64_t completed = 0;
+	uint64_t queued = 0;		// waiting for a worker
+	uint64_t maxQueued = 0;
+	uint64_t waitTotal = 0;		// from Schedule() to start, hundreds of nanoseconds
+	uint64_t waitMax = 0;
+	uint64_t runTotal = 0;		// hundreds of nanoseconds
+	uint64_t runMax = 0;
+	// Share of the time of all the workers spent running tasks of the class
+	double utilization = 0.;
+};
+
+class TaskExecutor
+{
+public:
+	using Task = std::function<void()>;
+
+	// threadCount 0 for one worker per hardware thread
+	explicit TaskExecutor(unsigned threadCount = 0);
+	// Run the queued tasks, then join the workers
+	~TaskExecutor();
+
+	TaskExecutor(const TaskExecutor&) = delete;
+	TaskExecutor& operator=(const TaskExecutor&) = delete;
+
+	// Executor of the plugin. Never destroyed: its workers are not joined while the DLL unloads.
+	static TaskExecutor& GetShared();
+
+	void Schedule(TaskPriority priority, Task task);
+
+	unsigned GetThreadCount() const { return m_threadCount; }
+	// Indexed by TaskPriority
+	std::array<TaskClassStats, kTaskPriorityCount> GetStats();
+	void ResetStats();
+
+private:
+	using Clock = std::chrono::steady_clock;
+	struct QueuedTask
+	{
+		Task task;
+		Clock::time_point scheduledAt;
+	};
+	struct WorkerPool;
+
+	// Body of the pool tokens
+	void RunTasks();
+
+	const unsigned m_threadCount;
+	ProfiledMutex m_mutex{ "TaskExecutor::m_mutex" };
+	unsigned m_activeTokens = 0;
+	std::array<std::deque<QueuedTask>, kTaskPriorityCount> m_queues;
+	std::array<TaskClassStats, kTaskPriorityCount> m_stats;
+	Clock::time_point m_statsStart;
+	// Last member: destroyed, thus joined, first
+	std::unique_ptr<WorkerPool> m_pool;
+};
+
+// Tasks of one producer run in submission order, one at a time, on a TaskExecutor.
+// Each task is a separate executor task, so that a long queue does not hold a worker.
+class SerialTaskQueue
+{
+public:
+	// capacity: tasks waiting to run (the running one not counted), 0 for unbounded
+	SerialTaskQueue(TaskExecutor& executor, TaskPriority priority, size_t capacity = 0);
+	// Wait()
+	~SerialTaskQueue();
+
+	SerialTaskQueue(const SerialTaskQueue&) = delete;
+	SerialTaskQueue& operator=(const SerialTaskQueue&) = delete;
+
+	// Return false, dropping task, if capacity tasks are already waiting. With a capacity of 1 and
+	// tasks which process the latest state of their producer, work is coalesced when late.
+	bool Schedule(TaskExecutor::Task task);
+	// Until the waiting and running tasks are done. Not from a task of this queue.
+	void Wait();
+
+	uint64_t GetRejectedCount();
+
+private:
+	void RunNext();
+
+	TaskExecutor& m_executor;
+	const TaskPriority m_priority;
+	const size_t m_capacity;
+	ProfiledMutex m_mutex{ "SerialTaskQueue::m_mutex" };
+	std::condition_variable_any m_condVar;
+	std::deque<TaskExecutor::Task> m_tasks;
+	// A task of the queue is scheduled on the executor or running
+	bool m_isActive = false;
+	uint64_t m_rejected = 0;
+};
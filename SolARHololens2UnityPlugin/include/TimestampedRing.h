@@ -0,0 +1,148 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "LockProfiler.h"
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Fixed size ring of values pushed with increasing timestamps, e.g. once per render frame.
+// Storage is allocated at construction; when the ring is full the oldest values are overwritten.
+// Writers push at display rate, so a mutex is enough to serialize them with readers.
+// No platform dependency.
+template <class T>
+class TimestampedRing
+{
+public:
+	struct Entry
+	{
+		uint64_t timestamp = 0;
+		T value{};
+	};
+
+	// Capacity is at least 2, so that any buffered timestamp can be bracketed. site names the
+	// lock of the ring in LockProfiler reports.
+	TimestampedRing(size_t capacity, const char* site)
+		: m_entries(capacity > 2 ? capacity : 2), m_mutex(site)
+	{
+	}
+
+	// Return false, and drop the value, if timestamp is not greater than the last pushed one
+	bool Push(uint64_t timestamp, const T& value)
+	{
+		std::lock_guard<ProfiledMutex> lock(m_mutex);
+		if (m_size > 0 && timestamp <= At(m_size - 1).timestamp)
+		{
+			return false;
+		}
+
+		Entry& entry = m_entries[(m_first + m_size) % m_entries.size()];
+		entry.timestamp = timestamp;
+		entry.value = value;
+		if (m_size < m_entries.size())
+		{
+			m_size++;
+		}
+		else
+		{
+			m_first = (m_first + 1) % m_entries.size();
+		}
+		return true;
+	}
+
+	// Append entries with a timestamp greater than sinceTimestamp to entries, oldest first
+	void Read(uint64_t sinceTimestamp, std::vector<Entry>& entries) const
+	{
+		std::lock_guard<ProfiledMutex> lock(m_mutex);
+		const size_t first = FirstAfter(sinceTimestamp);
+		entries.reserve(entries.size() + (m_size - first));
+		for (size_t i = first; i < m_size; ++i)
+		{
+			entries.push_back(At(i));
+		}
+	}
+
+	// Entries such that before.timestamp <= timestamp <= after.timestamp (the same entry if the
+	// timestamp matches one exactly). Return false if timestamp is outside the buffered window.
+	bool FindBracket(uint64_t timestamp, Entry& before, Entry& after) const
+	{
+		std::lock_guard<ProfiledMutex> lock(m_mutex);
+		if (m_size == 0 || timestamp < At(0).timestamp || timestamp > At(m_size - 1).timestamp)
+		{
+			return false;
+		}
+
+		// First entry after timestamp, or m_size when timestamp is the newest one
+		const size_t next = FirstAfter(timestamp);
+		before = At(next - 1);
+		after = (next < m_size && before.timestamp != timestamp) ? At(next) : before;
+		return true;
+	}
+
+	// Timestamps of the oldest and newest buffered entries. Return false if the ring is empty.
+	bool GetWindow(uint64_t& oldest, uint64_t& newest) const
+	{
+		std::lock_guard<ProfiledMutex> lock(m_mutex);
+		if (m_size == 0)
+		{
+			return false;
+		}
+		oldest = At(0).timestamp;
+		newest = At(m_size - 1).timestamp;
+		return true;
+	}
+
+	void Clear()
+	{
+		std::lock_guard<ProfiledMutex> lock(m_mutex);
+		m_first = 0;
+		m_size = 0;
+	}
+
+	size_t Capacity() const { return m_entries.size(); }
+
+private:
+	// i-th entry from the oldest one, m_mutex must be held
+	const Entry& At(size_t i) const { return m_entries[(m_first + i) % m_entries.size()]; }
+
+	// Position of the first entry with a timestamp greater than timestamp, m_mutex must be held
+	size_t FirstAfter(uint64_t timestamp) const
+	{
+		size_t low = 0;
+		size_t high = m_size;
+		while (low < high)
+		{
+			const size_t middle = low + (high - low) / 2;
+			if (At(middle).timestamp <= timestamp)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+		return low;
+	}
+
+	std::vector<Entry> m_entries;
+	size_t m_first = 0;
+	size_t m_size = 0;
+	mutable ProfiledMutex m_mutex;
+};
@@ -0,0 +1,156 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Binary trajectory files (.traj), the recorded form of the rig2world and PV pose logs.
+//
+// Layout (little endian): a TrajectoryHeader followed by fixed-size records
+//   int64   timestamp
+//   float   pose[16]	TrajectoryPoseFormat::Matrix: row-major 4x4 transform (column vector
+//						convention), the values of a legacy CSV line in the same order
+//   float   pose[7]	TrajectoryPoseFormat::QuaternionTranslation: tx, ty, tz, qx, qy, qz, qw
+//   float   focal[2]	fx, fy, if kTrajectoryHasFocalLength
+//   padding to a multiple of 8 bytes
+// The record count is derived from the file size, a record truncated by a crash is ignored.
+//
+// TrajectoryReader maps the file and reads records in place. Conversions from and to the legacy
+// CSV files (<sensor>_rig2world.txt, <datetime>_pv.txt) are provided for existing tools.
+// No platform dependency but the file mapping (Win32 or POSIX).
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+enum class TrajectoryPoseFormat : uint16_t
+{
+	Matrix = 0,
+	QuaternionTranslation = 1
+};
+
+constexpr uint16_t kTrajectoryHasFocalLength = 1 << 0;
+// principalPoint, imageWidth and imageHeight are set
+constexpr uint16_t kTrajectoryHasIntrinsics = 1 << 1;
+
+struct TrajectoryHeader
+{
+	static constexpr uint32_t kVersion = 1;
+
+	char magic[8] = { 'S', 'O', 'L', 'T', 'R', 'A', 'J', '\0' };
+	uint32_t version = kVersion;
+	uint32_t headerSize = 0;
+	uint32_t recordSize = 0;
+	TrajectoryPoseFormat poseFormat = TrajectoryPoseFormat::Matrix;
+	uint16_t flags = 0;
+	float principalPoint[2] = { 0.f, 0.f };
+	uint32_t imageWidth = 0;
+	uint32_t imageHeight = 0;
+	uint64_t reserved = 0;
+};
+static_assert(sizeof(TrajectoryHeader) == 48, "TrajectoryHeader is part of the file format");
+
+size_t GetTrajectoryPoseSize(TrajectoryPoseFormat format);
+size_t GetTrajectoryRecordSize(TrajectoryPoseFormat format, uint16_t flags);
+
+// Streams records to disk in fixed-size chunks, see PoseLogWriter. Not thread safe, lock from caller.
+class TrajectoryWriter
+{
+public:
+	static constexpr size_t kDefaultChunkSize = 16 * 1024;
+
+	explicit TrajectoryWriter(size_t chunkSize = kDefaultChunkSize);
+	~TrajectoryWriter() { Close(); }
+
+	TrajectoryWriter(const TrajectoryWriter&) = delete;
+	TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+	// Truncate path and write the header. Any previously opened file is closed first.
+	bool Open(const std::filesystem::path& path, TrajectoryPoseFormat format, bool hasFocalLength);
+	// Write the pending chunk and close the file
+	void Close();
+	bool IsOpen() const { return m_file.is_open(); }
+
+	// Can be called at any time, the header is rewritten with the next chunk
+	void SetIntrinsics(float cx, float cy, uint32_t width, uint32_t height);
+
+	// transform: row-major 4x4 (see file layout). Rotation is converted to a quaternion for
+	// TrajectoryPoseFormat::QuaternionTranslation. focalLength is ignored if the file has none.
+	void Write(int64_t timestamp, const float transform[16], const float* focalLength = nullptr);
+
+	uint64_t GetRecordCount() const { return m_recordCount; }
+
+private:
+	void WriteChunk();
+
+	std::ofstream m_file;
+	TrajectoryHeader m_header;
+	bool m_isHeaderDirty = false;
+	std::vector<char> m_chunk;
+	size_t m_chunkUsed = 0;
+	uint64_t m_recordCount = 0;
+};
+
+// Read-only memory mapping of a trajectory file, records are accessed in place
+class TrajectoryReader
+{
+public:
+	TrajectoryReader() = default;
+	~TrajectoryReader() { Close(); }
+
+	TrajectoryReader(const TrajectoryReader&) = delete;
+	TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+	// Return false if the file cannot be mapped or is not a trajectory file of a known version
+	bool Open(const std::filesystem::path& path);
+	void Close();
+
+	const TrajectoryHeader& GetHeader() const { return m_header; }
+	size_t GetRecordCount() const { return m_recordCount; }
+
+	int64_t GetTimestamp(size_t index) const;
+	// Pose as stored, GetTrajectoryPoseSize() floats
+	const float* GetPose(size_t index) const;
+	// fx, fy, nullptr if the file has no focal length
+	const float* GetFocalLength(size_t index) const;
+	// Pose as a row-major 4x4 transform, whatever the stored format
+	void GetTransform(size_t index, float transform[16]) const;
+
+	// Index of the first record whose timestamp is not less than timestamp (records are in
+	// timestamp order), GetRecordCount() if none
+	size_t LowerBound(int64_t timestamp) const;
+
+private:
+	const uint8_t* Record(size_t index) const { return m_pRecords + index * m_header.recordSize; }
+
+	const uint8_t* m_pData = nullptr;
+	size_t m_size = 0;
+	void* m_fileHandle = nullptr;
+	void* m_mappingHandle = nullptr;
+
+	TrajectoryHeader m_header;
+	const uint8_t* m_pRecords = nullptr;
+	size_t m_recordCount = 0;
+};
+
+// Legacy CSV files: timestamp followed by the 16 transform values, with fx and fy before them
+// and an intrinsics header line "cx,cy,width,height" when the trajectory has a focal length
+// (<datetime>_pv.txt). Output is identical to the files written before the binary format.
+bool ConvertTrajectoryToCsv(const std::filesystem::path& trajectoryPath, const std::filesystem::path& csvPath);
+// hasFocalLength selects the PV layout
+bool ConvertCsvToTrajectory(const std::filesystem::path& csvPath, const std::filesystem::path& trajectoryPath,
+	bool hasFocalLength, TrajectoryPoseFormat format = TrajectoryPoseFormat::Matrix);
@@ -8,17 +8,30 @@
 #include <winrt/Windows.Graphics.Imaging.h>
 #include "TimeConverter.h"
 #include "Tar.h"
+#include "FrameQuality.h"
+#include "FrameRateController.h"
+#include "FrameSequence.h"
+#include "FrameSubscription.h"
+#include "LatencyTrace.h"
+#include "LockProfiler.h"
+#include "TaskExecutor.h"
+#include "Trajectory.h"
+#include <condition_variable>
 #include <mutex>
 #include <shared_mutex>
-#include <thread>
 
 // Structur used to store per-frame PV information:timestamp, PV2world transform, focal length, pixel buffer
 struct PVFrame
 {
     long long timestamp = 0;
+    uint64_t sequence = 0;
     winrt::Windows::Foundation::Numerics::float4x4 PVtoWorldtransform{ 0.f,0.f,0.f,0.f,0.f,0.f,0.f,0.f,0.f,0.f,0.f,0.f,0.f,0.f,0.f,0.f };
+    // False if the camera could not be located at timestamp, PVtoWorldtransform is then the identity
+    bool poseValid = false;
     float fx = 0.f;
     float fy = 0.f;
+    // Sharpness score of the frame (see FrameQuality.h)
+    float sharpness = FrameQuality::kNoScore;
     uint8_t* pixelBufferData = nullptr; 
     uint32_t pixelBufferSize = 0; 
     uint32_t width = 0; 
@@ -36,7 +49,8 @@ public:
 
     virtual ~VideoFrameProcessor()
     {
-        m_fExit = true;
+        // Conversion and recording tasks must be done before m_RGBFrame is released
+        StopRecording();
         
         // desallocate m_RGBFrame
         if (m_RGBFrame.pixelBufferData != nullptr)
@@ -44,14 +58,28 @@ public:
             delete[] m_RGBFrame.pixelBufferData;
             m_RGBFrame.pixelBufferData = NULL;
             m_RGBFrame.pixelBufferData = 0;
-            m_RGBByteArrayNewAvailable = false;
         }
-        m_pGrabThread->join();
+        m_framePublisher.CloseAll();
     }
 
-    void     CopyLastFrame(PVFrame& to_RGBFrame);
+    // Copy latest frame unless its sequence number is lastSeenSequence,
+    // to_RGBFrame buffer is (re)allocated if needed
+    FrameRequestStatus CopyLastFrame(PVFrame& to_RGBFrame, uint64_t lastSeenSequence);
     uint32_t GetRGBByteArraySize();
-    bool     GetRGBByteArrayNewAvailable();
+    StreamFrameCounters GetFrameCounters();
+    // Block until a frame other than lastSeenSequence has been converted, recording is stopped
+    // or timeoutMs expires. The frame is not consumed.
+    FrameRequestStatus WaitForNextFrame(uint64_t lastSeenSequence, uint32_t timeoutMs, uint64_t& sequence);
+    // Push-based access: every converted frame (BGRA 8) is delivered once to each subscriber
+    FramePublisher& GetFramePublisher() { return m_framePublisher; }
+    // Decimation at the source: dropped frames are neither located, converted nor copied
+    void SetFrameRate(const FrameRateSettings& settings) { m_rateController.Configure(settings); }
+    // Keyframe selection, applied at the source after rate control
+    KeyframeSelector& GetKeyframeSelector() { return m_keyframeSelector; }
+    // Blurry frames filter, applied at the source before keyframe selection (0 disables it)
+    void SetSharpnessThreshold(float minSharpness) { m_sharpnessFilter.SetThreshold(minSharpness); }
+    // Stage latencies of the PV frames
+    PipelineTracer& GetPipelineTracer() { return m_tracer; }
     uint32_t GetNbFrameArrived();
     uint32_t GetNbFrameConverted();
     uint32_t GetNbFrameCopyInContext();
@@ -61,10 +89,12 @@ public:
     //void StartRGBSensorCapture();
     //void StopRGBSensorCapture();
 
-    void VideoFrameProcessor::Clear();
     winrt::Windows::Foundation::IAsyncAction InitializeAsync();
-    bool DumpDataToDisk(const winrt::Windows::Storage::StorageFolder& folder, const std::wstring& datetime_path);
-    void StartRecording(const winrt::Windows::Storage::StorageFolder& storageFolder, const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem);
+    // Start converting the arriving frames. When storageFolder is set, frames are saved in
+    // <sensor>.tar and their timestamp, focal length and pose are streamed to <datetime_path>_pv.traj
+    // Frames are staged in stagingArena if set (burst recording)
+    void StartRecording(const winrt::Windows::Storage::StorageFolder& storageFolder, const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem, const std::wstring& datetime_path,
+                        const std::shared_ptr<StagingArena>& stagingArena = nullptr);
     void StopRecording();
 
 protected:
@@ -77,34 +107,53 @@ private:
     winrt::Windows::Media::Capture::Frames::MediaFrameReader m_mediaFrameReader = nullptr;
     
     winrt::event_token m_OnFrameArrivedRegistration;
-    std::shared_mutex m_frameMutex;
+    ProfiledSharedMutex m_frameMutex{ "VideoFrameProcessor::m_frameMutex" };
     winrt::Windows::Media::Capture::Frames::MediaFrameReference m_latestFrame = nullptr;
     
     long long m_latestTimestamp = 0;
+    // PipelineClockNow() when m_latestFrame arrived
+    uint64_t m_latestFrameArrival = 0;
     
     TimeConverter m_converter;
     winrt::Windows::Perception::Spatial::SpatialCoordinateSystem m_worldCoordSystem = nullptr;
     bool m_isWorldCoordSystemSet = false; 
 
-    // grabbing thread
-    static void CameraGrabThread(VideoFrameProcessor* pProcessor);
-    // TODO(jmhenaff): replace by unique_ptr
-    std::thread* m_pGrabThread = nullptr;
+    // Conversion task: converts m_latestFrame, if not processed yet, and updates m_RGBFrame.
+    // Each arriving frame schedules one while converting, a late conversion skips frames.
+    void ConvertLatestFrame();
+    SerialTaskQueue m_conversionQueue{ TaskExecutor::GetShared(), TaskPriority::Conversion, 1 };
+    // Set between StartRecording() and StopRecording(), lock on m_frameMutex
+    bool m_isConverting = false;
     bool m_fExit = false;
     PVFrame   m_RGBFrame;
 
+    // Recording tasks, in frame order. Frames are skipped when the storage is late.
+    static constexpr size_t kMaxPendingRecordedFrames = 4;
+    SerialTaskQueue m_recordingQueue{ TaskExecutor::GetShared(), TaskPriority::Recording, kMaxPendingRecordedFrames };
 
-    void AddLogFrame();
-    std::vector<PVFrame> m_PVFrameLog;
+    // Append the metadata of a converted frame (no pixel data) to m_poseLog, along with intrinsics
+    // for the first one. Lock on m_storageMutex from caller
+    void AddLogFrame(const winrt::Windows::Media::Devices::Core::CameraIntrinsics& intrinsics, const PVFrame& metadata);
 
     // Storage
-    std::mutex m_storageMutex;
+    ProfiledMutex m_storageMutex{ "VideoFrameProcessor::m_storageMutex" };
     winrt::Windows::Storage::StorageFolder m_storageFolder = nullptr;
-    std::unique_ptr<Io::Tarball> m_tarball;
+    std::unique_ptr<Io::StagedTarball> m_tarball;
+    TrajectoryWriter m_poseLog;
+
+
+    // Sequence numbers of converted frames, lock on m_frameMutex
+    FrameSequence m_frameSequence;
+    // Signalled by the conversion tasks each time a frame is converted, and on StopRecording()
+    std::condition_variable_any m_frameCondVar;
+    FramePublisher m_framePublisher;
+    FrameRateController m_rateController;
+    KeyframeSelector m_keyframeSelector;
+    SharpnessFilter m_sharpnessFilter;
+    PipelineTracer m_tracer;
+    // Pipeline stamps of m_RGBFrame up to PipelineStage::Copied, lock on m_frameMutex
+    FrameTrace m_frameTrace;
 
-
-    bool      m_RGBByteArrayNewAvailable = false;
-    
     // frame counters 
     uint32_t  m_NbFrameArrived = 0;
     uint32_t  m_NbFrameConverted = 0;
@@ -0,0 +1,40 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "RMCameraReader.h"
+
+// Reader for the visible light tracking cameras (LEFT_FRONT, LEFT_LEFT, RIGHT_FRONT, RIGHT_RIGHT)
+class VlcCameraReader : public RMCameraReaderT<VlcCameraReader, IResearchModeSensorVLCFrame>
+{
+public:
+	using RMCameraReaderT::RMCameraReaderT;
+
+	// Return an empty array unless status is FrameRequestStatus::NewFrame.
+	// rigToWorldtransform is the identity, and poseValid false, if the rig could not be located.
+	winrt::com_array<uint8_t> getVlcSensorData(uint64_t lastSeenSequence, FrameRequestStatus& status, uint64_t& sequence, uint64_t& timestamp, float& sharpness, winrt::Windows::Foundation::Numerics::float4x4& rigToWorldtransform, bool& poseValid, uint32_t& pixelBufferSize, uint32_t& width, uint32_t& height, bool flip);
+
+protected:
+	friend class RMCameraReaderT<VlcCameraReader, IResearchModeSensorVLCFrame>;
+
+	// Lock on m_storageMutex and m_sensorFrameMutex from caller
+	void SaveFrame(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorVLCFrame* pVLCFrame);
+	// Lock on m_sensorFrameMutex from caller
+	void FillSharedFrameData(IResearchModeSensorVLCFrame* pVLCFrame, SharedFrame& frame);
+	// Called by the update thread before the frame is stored, no lock required
+	float ComputeSharpness(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorVLCFrame* pVLCFrame);
+};
@@ -0,0 +1,1116 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DatasetExporter.h"
+#include "RecordingContainer.h"
+#include "TarballReader.h"
+#include "Trajectory.h"
+
+#include <Eigen/Dense>
+#include <unsupported/Eigen/CXX11/ThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // From 1601-01-01 to 1970-01-01, in hundreds of nanoseconds
+    constexpr uint64_t kUnixEpochTicks = 116444736000000000ull;
+    // TUM depth images: 5000 per meter, HoloLens 2 depth: millimeters
+    constexpr uint32_t kTumDepthScale = 5;
+    // Poses of SeparateFiles recordings are matched to the frame timestamps within 1 ms
+    constexpr uint64_t kPoseTolerance = 10000;
+    // Trajectory files of SeparateFiles recordings
+    const char kRigToWorldSuffix[] = "_rig2world.traj";
+    const char kPvTrajectorySuffix[] = "_pv.traj";
+
+    // VLC cameras, in the order of the EuRoC cam folders and of the ground truth fallback
+    const SharedStream kVlcStreams[] = { SharedStream::LEFT_FRONT, SharedStream::RIGHT_FRONT,
+                                         SharedStream::LEFT_LEFT, SharedStream::RIGHT_RIGHT };
+
+    enum class FrameSource
+    {
+        Record,     // Image or Depth record of a Container recording
+        Pgm,        // VLC or depth file of a tarball
+        Bgra        // PV file of a tarball, raw pixels
+    };
+
+    struct FrameJob
+    {
+        SharedStream stream;
+        uint64_t timestamp;
+        FrameSource source;
+        RecordingRecord record;
+        const uint8_t* pData;
+        size_t size;
+        uint32_t width;             // FrameSource::Bgra
+        uint32_t height;
+        bool hasPose;
+        float pose[16];
+        bool isWritten;
+    };
+
+    struct PoseSample
+    {
+        uint64_t timestamp;
+        float transform[16];        // row-major
+    };
+
+    // Image in PNG sample order: rows of 8-bit gray, 16-bit big endian gray or 8-bit RGB
+    struct PngImage
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint8_t bitDepth = 8;
+        uint8_t colorType = 0;      // 0: gray, 2: RGB
+        std::vector<uint8_t> pixels;
+
+        size_t RowSize() const { return static_cast<size_t>(width) * (colorType == 2 ? 3 : 1) * (bitDepth / 8); }
+    };
+
+    struct StreamOutput
+    {
+        std::filesystem::path folder;       // of the images
+        std::string listPrefix;             // of the image names in the list file
+        std::ofstream list;
+    };
+
+    uint32_t Crc32(const uint8_t* pData, size_t size, uint32_t crc = 0)
+    {
+        static const auto kTable = []
+        {
+            std::vector<uint32_t> table(256);
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                table[n] = c;
+            }
+            return table;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc = kTable[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void AppendBigEndian32(std::vector<uint8_t>& buffer, uint32_t value)
+    {
+        buffer.push_back(static_cast<uint8_t>(value >> 24));
+        buffer.push_back(static_cast<uint8_t>(value >> 16));
+        buffer.push_back(static_cast<uint8_t>(value >> 8));
+        buffer.push_back(static_cast<uint8_t>(value));
+    }
+
+    void AppendPngChunk(std::vector<uint8_t>& png, const char type[4], const uint8_t* pData, size_t size)
+    {
+        AppendBigEndian32(png, static_cast<uint32_t>(size));
+        const size_t typeOffset = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), pData, pData + size);
+        AppendBigEndian32(png, Crc32(png.data() + typeOffset, size + 4));
+    }
+
+    // PNG whose zlib stream is made of stored (not compressed) deflate blocks: no dependency and
+    // no encoding cost, any decoder reads it. idat is scratch memory kept between calls.
+    void EncodePng(const PngImage& image, std::vector<uint8_t>& idat, std::vector<uint8_t>& png)
+    {
+        static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        constexpr size_t kMaxStoredBlock = 65535;
+        constexpr uint32_t kAdlerModulo = 65521;
+        constexpr size_t kAdlerRun = 5552;
+
+        const size_t rowSize = image.RowSize();
+        const size_t rawSize = image.height * (rowSize + 1);
+        const size_t blockCount = std::max<size_t>(1, (rawSize + kMaxStoredBlock - 1) / kMaxStoredBlock);
+        idat.clear();
+        idat.reserve(2 + rawSize + blockCount * 5 + 4);
+        idat.push_back(0x78);
+        idat.push_back(0x01);
+
+        // Rows with filter type 0, cut into stored blocks
+        uint32_t adlerA = 1;
+        uint32_t adlerB = 0;
+        size_t rawOffset = 0;
+        size_t blockLeft = 0;
+        auto append = [&](const uint8_t* pData, size_t size)
+        {
+            while (size > 0)
+            {
+                if (blockLeft == 0)
+                {
+                    blockLeft = std::min(kMaxStoredBlock, rawSize - rawOffset);
+                    const uint16_t length = static_cast<uint16_t>(blockLeft);
+                    idat.push_back(rawOffset + blockLeft == rawSize ? 1 : 0);
+                    idat.push_back(static_cast<uint8_t>(length));
+                    idat.push_back(static_cast<uint8_t>(length >> 8));
+                    idat.push_back(static_cast<uint8_t>(~length));
+                    idat.push_back(static_cast<uint8_t>(~length >> 8));
+                }
+                const size_t count = std::min(size, blockLeft);
+                idat.insert(idat.end(), pData, pData + count);
+                // Sums cannot overflow 32 bits within kAdlerRun bytes
+                for (size_t run = 0; run < count; run += kAdlerRun)
+                {
+                    const size_t runEnd = std::min(count, run + kAdlerRun);
+                    for (size_t i = run; i < runEnd; ++i)
+                    {
+                        adlerA += pData[i];
+                        adlerB += adlerA;
+                    }
+                    adlerA %= kAdlerModulo;
+                    adlerB %= kAdlerModulo;
+                }
+                pData += count;
+                size -= count;
+                rawOffset += count;
+                blockLeft -= count;
+            }
+        };
+        static const uint8_t kFilterNone = 0;
+        for (uint32_t row = 0; row < image.height; ++row)
+        {
+            append(&kFilterNone, 1);
+            append(image.pixels.data() + row * rowSize, rowSize);
+        }
+        AppendBigEndian32(idat, (adlerB << 16) | adlerA);
+
+        std::vector<uint8_t> header;
+        AppendBigEndian32(header, image.width);
+        AppendBigEndian32(header, image.height);
+        header.push_back(image.bitDepth);
+        header.push_back(image.colorType);
+        header.push_back(0);        // deflate
+        header.push_back(0);        // adaptive filtering
+        header.push_back(0);        // no interlace
+
+        png.assign(kSignature, kSignature + sizeof(kSignature));
+        AppendPngChunk(png, "IHDR", header.data(), header.size());
+        AppendPngChunk(png, "IDAT", idat.data(), idat.size());
+        AppendPngChunk(png, "IEND", nullptr, 0);
+    }
+
+    // Binary PGM written by the camera readers: "P5\n<width> <height>\n<max>\n" then the pixels,
+    // 16-bit big endian if max > 255
+    bool ParsePgm(const uint8_t* pData, size_t size, uint32_t& width, uint32_t& height, uint32_t& maxValue, size_t& pixelsOffset)
+    {
+        if (size < 2 || pData[0] != 'P' || pData[1] != '5')
+        {
+            return false;
+        }
+        size_t offset = 2;
+        uint32_t values[3];
+        for (uint32_t& value : values)
+        {
+            while (offset < size && std::isspace(pData[offset]))
+            {
+                ++offset;
+            }
+            if (offset == size || !std::isdigit(pData[offset]))
+            {
+                return false;
+            }
+            value = 0;
+            while (offset < size && std::isdigit(pData[offset]))
+            {
+                value = value * 10 + (pData[offset++] - '0');
+            }
+        }
+        // A single white space precedes the pixels
+        width = values[0];
+        height = values[1];
+        maxValue = values[2];
+        pixelsOffset = offset + 1;
+        const size_t pixelsSize = static_cast<size_t>(width) * height * (maxValue > 255 ? 2 : 1);
+        return maxValue > 0 && maxValue < 65536 && pixelsOffset <= size && size - pixelsOffset >= pixelsSize;
+    }
+
+    void StoreBigEndian16(uint8_t* pDestination, uint32_t value)
+    {
+        value = std::min<uint32_t>(value, 0xFFFF);
+        pDestination[0] = static_cast<uint8_t>(value >> 8);
+        pDestination[1] = static_cast<uint8_t>(value);
+    }
+
+    // Decode the frame of job into image. pixels is scratch memory kept between calls.
+    bool DecodeFrame(const FrameJob& job, uint32_t depthScale, std::vector<uint8_t>& pixels, PngImage& image)
+    {
+        if (job.source == FrameSource::Record)
+        {
+            SolARHL2FrameMetadata metadata;
+            if (!RecordingReader::DecodeFrame(job.record, metadata, pixels))
+            {
+                return false;
+            }
+            image.width = metadata.width;
+            image.height = metadata.height;
+            const size_t pixelCount = static_cast<size_t>(metadata.width) * metadata.height;
+            switch (metadata.bytesPerPixel)
+            {
+            case 1:
+                image.bitDepth = 8;
+                image.colorType = 0;
+                image.pixels.assign(pixels.begin(), pixels.begin() + pixelCount);
+                return true;
+            case 2:
+                // Depth plane, the AB plane follows it
+                image.bitDepth = 16;
+                image.colorType = 0;
+                image.pixels.resize(pixelCount * 2);
+                for (size_t i = 0; i < pixelCount; ++i)
+                {
+                    const uint32_t value = pixels[2 * i] | (pixels[2 * i + 1] << 8);
+                    StoreBigEndian16(&image.pixels[2 * i], value * depthScale);
+                }
+                return true;
+            case 4:
+                image.bitDepth = 8;
+                image.colorType = 2;
+                image.pixels.resize(pixelCount * 3);
+                for (size_t i = 0; i < pixelCount; ++i)
+                {
+                    image.pixels[3 * i] = pixels[4 * i + 2];
+                    image.pixels[3 * i + 1] = pixels[4 * i + 1];
+                    image.pixels[3 * i + 2] = pixels[4 * i];
+                }
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        if (job.source == FrameSource::Pgm)
+        {
+            uint32_t maxValue = 0;
+            size_t pixelsOffset = 0;
+            if (!ParsePgm(job.pData, job.size, image.width, image.height, maxValue, pixelsOffset))
+            {
+                return false;
+            }
+            const uint8_t* pPixels = job.pData + pixelsOffset;
+            const size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+            image.colorType = 0;
+            image.bitDepth = maxValue > 255 ? 16 : 8;
+            if (image.bitDepth == 8 || depthScale == 1)
+            {
+                image.pixels.assign(pPixels, pPixels + pixelCount * (image.bitDepth / 8));
+                return true;
+            }
+            image.pixels.resize(pixelCount * 2);
+            for (size_t i = 0; i < pixelCount; ++i)
+            {
+                const uint32_t value = (pPixels[2 * i] << 8) | pPixels[2 * i + 1];
+                StoreBigEndian16(&image.pixels[2 * i], value * depthScale);
+            }
+            return true;
+        }
+
+        // Rows of the PV buffer may be padded
+        if (job.height == 0 || job.size / job.height < static_cast<size_t>(job.width) * 4)
+        {
+            return false;
+        }
+        const size_t stride = job.size / job.height;
+        image.width = job.width;
+        image.height = job.height;
+        image.bitDepth = 8;
+        image.colorType = 2;
+        image.pixels.resize(static_cast<size_t>(job.width) * job.height * 3);
+        uint8_t* pDestination = image.pixels.data();
+        for (uint32_t row = 0; row < job.height; ++row)
+        {
+            const uint8_t* pSource = job.pData + row * stride;
+            for (uint32_t column = 0; column < job.width; ++column, pSource += 4, pDestination += 3)
+            {
+                pDestination[0] = pSource[2];
+                pDestination[1] = pSource[1];
+                pDestination[2] = pSource[0];
+            }
+        }
+        return true;
+    }
+
+    // Closest record of trajectory within kPoseTolerance
+    bool FindPose(const TrajectoryReader& trajectory, uint64_t timestamp, float transform[16])
+    {
+        const size_t count = trajectory.GetRecordCount();
+        const size_t next = trajectory.LowerBound(static_cast<int64_t>(timestamp));
+        size_t best = count;
+        uint64_t bestDistance = kPoseTolerance + 1;
+        for (size_t index : { next, next - 1 })
+        {
+            if (index < count)
+            {
+                const int64_t recordTimestamp = trajectory.GetTimestamp(index);
+                const uint64_t distance = recordTimestamp > static_cast<int64_t>(timestamp) ? recordTimestamp - timestamp
+                                                                                            : timestamp - recordTimestamp;
+                if (distance < bestDistance)
+                {
+                    best = index;
+                    bestDistance = distance;
+                }
+            }
+        }
+        if (best == count)
+        {
+            return false;
+        }
+        trajectory.GetTransform(best, transform);
+        return true;
+    }
+
+    // Unit quaternion (x, y, z, w) of the rotation of a row-major transform
+    void ToQuaternion(const float transform[16], float rotation[4])
+    {
+        const Eigen::Map<const Eigen::Matrix<float, 4, 4, Eigen::RowMajor>> matrix(transform);
+        const Eigen::Quaternionf quaternion = Eigen::Quaternionf(Eigen::Matrix3f(matrix.topLeftCorner<3, 3>())).normalized();
+        rotation[0] = quaternion.x();
+        rotation[1] = quaternion.y();
+        rotation[2] = quaternion.z();
+        rotation[3] = quaternion.w();
+    }
+
+    // Head to world transform, HoloLens axes: the head looks along -z
+    PoseSample ToPoseSample(const SharedHeadPose& headPose)
+    {
+        const Eigen::Vector3f z = -Eigen::Vector3f(headPose.forward[0], headPose.forward[1], headPose.forward[2]).normalized();
+        const Eigen::Vector3f x = Eigen::Vector3f(headPose.up[0], headPose.up[1], headPose.up[2]).cross(z).normalized();
+        const Eigen::Vector3f y = z.cross(x);
+
+        PoseSample sample;
+        sample.timestamp = headPose.timestamp;
+        Eigen::Map<Eigen::Matrix<float, 4, 4, Eigen::RowMajor>> matrix(sample.transform);
+        matrix.setIdentity();
+        matrix.block<3, 1>(0, 0) = x;
+        matrix.block<3, 1>(0, 1) = y;
+        matrix.block<3, 1>(0, 2) = z;
+        matrix.block<3, 1>(0, 3) = Eigen::Vector3f(headPose.position[0], headPose.position[1], headPose.position[2]);
+        return sample;
+    }
+
+    uint64_t ToUnixNanoseconds(uint64_t timestamp)
+    {
+        return (timestamp >= kUnixEpochTicks ? timestamp - kUnixEpochTicks : timestamp) * 100;
+    }
+
+    // Timestamp of the file names and lists of layout
+    std::string FormatTimestamp(DatasetLayout layout, uint64_t timestamp)
+    {
+        char text[32];
+        switch (layout)
+        {
+        case DatasetLayout::EuRoC:
+            std::snprintf(text, sizeof(text), "%llu", static_cast<unsigned long long>(ToUnixNanoseconds(timestamp)));
+            break;
+        case DatasetLayout::TUM:
+        {
+            // Printed from integers, a double would round the microseconds
+            const uint64_t microseconds = ToUnixNanoseconds(timestamp) / 1000;
+            std::snprintf(text, sizeof(text), "%llu.%06llu", static_cast<unsigned long long>(microseconds / 1000000),
+                          static_cast<unsigned long long>(microseconds % 1000000));
+            break;
+        }
+        default:
+            std::snprintf(text, sizeof(text), "%llu", static_cast<unsigned long long>(timestamp));
+            break;
+        }
+        return text;
+    }
+
+    std::string GetStreamName(SharedStream stream)
+    {
+        // GetSharedStreamName() without its "SolARHL2_" prefix
+        const std::string name = GetSharedStreamName(stream);
+        return name.substr(name.find('_') + 1);
+    }
+
+    std::string ToLower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+    // Image folder and list of a frame stream, with the header of the list
+    bool OpenStreamOutput(DatasetLayout layout, const std::filesystem::path& output, SharedStream stream, StreamOutput& streamOutput)
+    {
+        std::filesystem::path listPath;
+        std::string header;
+        switch (layout)
+        {
+        case DatasetLayout::EuRoC:
+        {
+            std::string sensor = "depth0";
+            for (size_t i = 0; i < sizeof(kVlcStreams) / sizeof(kVlcStreams[0]); ++i)
+            {
+                if (kVlcStreams[i] == stream)
+                {
+                    sensor = "cam" + std::to_string(i);
+                }
+            }
+            if (stream == SharedStream::PV)
+            {
+                sensor = "cam4";
+            }
+            streamOutput.folder = output / "mav0" / sensor / "data";
+            listPath = output / "mav0" / sensor / "data.csv";
+            header = "#timestamp [ns],filename";
+            break;
+        }
+        case DatasetLayout::TUM:
+        {
+            const std::string folder = stream == SharedStream::PV ? "rgb" : (stream == SharedStream::DEPTH ? "depth" : ToLower(GetStreamName(stream)));
+            streamOutput.folder = output / folder;
+            streamOutput.listPrefix = folder + "/";
+            listPath = output / (folder + ".txt");
+            header = "# timestamp filename";
+            break;
+        }
+        default:
+            streamOutput.folder = output / GetStreamName(stream) / "images";
+            streamOutput.listPrefix = "images/";
+            listPath = output / GetStreamName(stream) / "frames.csv";
+            header = "#timestamp,filename,sensor to world transform (row-major 4x4)";
+            break;
+        }
+
+        std::error_code errorCode;
+        std::filesystem::create_directories(streamOutput.folder, errorCode);
+        streamOutput.list.open(listPath, std::ios::out | std::ios::trunc);
+        if (errorCode || !streamOutput.list.is_open())
+        {
+            return false;
+        }
+        streamOutput.list << header << "\n" << std::setprecision(9);
+        return true;
+    }
+
+    // Frames, IMU samples and poses in the exported range of a recording
+    struct RecordingContent
+    {
+        std::vector<FrameJob> jobs;
+        std::map<SharedStream, std::vector<SharedImuSample>> imuSamples;
+        std::vector<PoseSample> headPoses;
+        // Rig to world poses of the VLC cameras, whether exported or not (ground truth fallback)
+        std::map<SharedStream, std::vector<PoseSample>> vlcPoses;
+    };
+
+    struct TimeRange
+    {
+        uint64_t start;
+        uint64_t end;
+
+        bool Contains(uint64_t timestamp) const { return timestamp >= start && timestamp <= end; }
+    };
+
+    TimeRange GetTimeRange(uint64_t firstTimestamp, const DatasetExportSettings& settings)
+    {
+        const auto saturatedAdd = [](uint64_t a, uint64_t b) { return b > UINT64_MAX - a ? UINT64_MAX : a + b; };
+        return { saturatedAdd(firstTimestamp, settings.startOffset), saturatedAdd(firstTimestamp, settings.endOffset) };
+    }
+
+    bool IsVlcStream(SharedStream stream)
+    {
+        return std::find(std::begin(kVlcStreams), std::end(kVlcStreams), stream) != std::end(kVlcStreams);
+    }
+
+    bool ReadContainer(const RecordingReader& reader, const DatasetExportSettings& settings, RecordingContent& content, std::string& error)
+    {
+        if (reader.GetChunkCount() == 0)
+        {
+            error = "empty recording";
+            return false;
+        }
+        const TimeRange range = GetTimeRange(reader.GetChunkHeader(0).firstTimestamp, settings);
+
+        uint32_t vlcMask = 0;
+        for (SharedStream stream : kVlcStreams)
+        {
+            vlcMask |= GetStreamBit(stream);
+        }
+        const uint32_t typeMask = (1u << static_cast<uint32_t>(RecordingRecordType::Image)) |
+                                  (1u << static_cast<uint32_t>(RecordingRecordType::Depth)) |
+                                  (1u << static_cast<uint32_t>(RecordingRecordType::Imu)) |
+                                  (1u << static_cast<uint32_t>(RecordingRecordType::Pose));
+        reader.ForEachRecord(typeMask, settings.streamMask | vlcMask, [&](const RecordingRecord& record)
+        {
+            // Records are in timestamp order, but for the few late ones
+            if (record.timestamp > range.end)
+            {
+                return false;
+            }
+            if (record.timestamp < range.start)
+            {
+                return true;
+            }
+
+            const SharedStream stream = static_cast<SharedStream>(record.stream);
+            const bool isSelected = (settings.streamMask & GetStreamBit(stream)) != 0;
+            switch (record.type)
+            {
+            case RecordingRecordType::Image:
+            case RecordingRecordType::Depth:
+            {
+                if (record.size < sizeof(SolARHL2FrameMetadata))
+                {
+                    break;
+                }
+                SolARHL2FrameMetadata metadata;
+                std::memcpy(&metadata, record.pPayload, sizeof(metadata));
+                if (IsVlcStream(stream) && metadata.poseValid)
+                {
+                    PoseSample sample;
+                    sample.timestamp = record.timestamp;
+                    std::memcpy(sample.transform, metadata.toWorldTransform, sizeof(sample.transform));
+                    content.vlcPoses[stream].push_back(sample);
+                }
+                if (isSelected)
+                {
+                    FrameJob job{};
+                    job.stream = stream;
+                    job.timestamp = record.timestamp;
+                    job.source = FrameSource::Record;
+                    job.record = record;
+                    job.hasPose = metadata.poseValid != 0;
+                    std::memcpy(job.pose, metadata.toWorldTransform, sizeof(job.pose));
+                    content.jobs.push_back(job);
+                }
+                break;
+            }
+            case RecordingRecordType::Imu:
+                if (isSelected)
+                {
+                    const auto* pSamples = reinterpret_cast<const SharedImuSample*>(record.pPayload);
+                    auto& samples = content.imuSamples[stream];
+                    for (size_t i = 0; i < record.size / sizeof(SharedImuSample); ++i)
+                    {
+                        if (range.Contains(pSamples[i].timestamp))
+                        {
+                            samples.push_back(pSamples[i]);
+                        }
+                    }
+                }
+                break;
+            case RecordingRecordType::Pose:
+                if (isSelected && record.size >= sizeof(SharedHeadPose))
+                {
+                    SharedHeadPose headPose;
+                    std::memcpy(&headPose, record.pPayload, sizeof(headPose));
+                    content.headPoses.push_back(ToPoseSample(headPose));
+                }
+                break;
+            default:
+                break;
+            }
+            return true;
+        }, reader.SeekChunk(range.start));
+        return true;
+    }
+
+    // Stream of a sensor tarball, from the friendly name of the research mode sensor
+    bool GetTarballStream(const std::string& name, SharedStream& stream)
+    {
+        static const std::pair<const char*, SharedStream> kNames[] = {
+            { "PV", SharedStream::PV },
+            { "VLC LF", SharedStream::LEFT_FRONT },
+            { "VLC RF", SharedStream::RIGHT_FRONT },
+            { "VLC LL", SharedStream::LEFT_LEFT },
+            { "VLC RR", SharedStream::RIGHT_RIGHT } };
+        for (const auto& entry : kNames)
+        {
+            if (name == entry.first)
+            {
+                stream = entry.second;
+                return true;
+            }
+        }
+        // "Depth Long Throw" or "Depth AHaT"
+        if (name.compare(0, 5, "Depth") == 0)
+        {
+            stream = SharedStream::DEPTH;
+            return true;
+        }
+        return false;
+    }
+
+    // Mappings of a SeparateFiles recording, referenced by the jobs until they are written
+    struct SeparateFiles
+    {
+        std::vector<std::unique_ptr<Io::TarballReader>> tarballs;
+        std::map<SharedStream, std::unique_ptr<TrajectoryReader>> trajectories;
+    };
+
+    bool ReadSeparateFiles(const std::filesystem::path& folder, const DatasetExportSettings& settings, SeparateFiles& files,
+                           RecordingContent& content, std::string& error)
+    {
+        struct TarballFile
+        {
+            SharedStream stream;
+            const Io::TarballEntry* pEntry;
+            uint64_t timestamp;
+        };
+        std::vector<TarballFile> tarballFiles;
+        uint64_t firstTimestamp = UINT64_MAX;
+
+        std::error_code errorCode;
+        for (const auto& entry : std::filesystem::directory_iterator(folder, errorCode))
+        {
+            const std::string fileName = entry.path().filename().string();
+            const std::string stem = entry.path().stem().string();
+            SharedStream stream = SharedStream::PV;
+            if (entry.path().extension() == ".tar" && GetTarballStream(stem, stream))
+            {
+                auto tarball = std::make_unique<Io::TarballReader>();
+                if (!tarball->Open(entry.path()))
+                {
+                    continue;
+                }
+                for (const Io::TarballEntry& file : tarball->GetEntries())
+                {
+                    // <timestamp>.pgm, <timestamp>.bytes; <timestamp>_ab.pgm are not exported
+                    char* pEnd = nullptr;
+                    const uint64_t timestamp = std::strtoull(file.name.c_str(), &pEnd, 10);
+                    if (pEnd == file.name.c_str() || *pEnd != '.')
+                    {
+                        continue;
+                    }
+                    firstTimestamp = std::min(firstTimestamp, timestamp);
+                    tarballFiles.push_back({ stream, &file, timestamp });
+                }
+                files.tarballs.push_back(std::move(tarball));
+            }
+            else if (entry.path().extension() == ".traj")
+            {
+                const size_t suffixSize = sizeof(kRigToWorldSuffix) - 1;
+                const bool isPv = fileName.size() > sizeof(kPvTrajectorySuffix) - 1 &&
+                                  fileName.compare(fileName.size() - (sizeof(kPvTrajectorySuffix) - 1), std::string::npos, kPvTrajectorySuffix) == 0;
+                const bool isRig = fileName.size() > suffixSize &&
+                                   fileName.compare(fileName.size() - suffixSize, std::string::npos, kRigToWorldSuffix) == 0 &&
+                                   GetTarballStream(fileName.substr(0, fileName.size() - suffixSize), stream);
+                if (isPv || isRig)
+                {
+                    auto trajectory = std::make_unique<TrajectoryReader>();
+                    if (trajectory->Open(entry.path()))
+                    {
+                        files.trajectories[isPv ? SharedStream::PV : stream] = std::move(trajectory);
+                    }
+                }
+            }
+        }
+        if (errorCode || tarballFiles.empty())
+        {
+            error = "no sensor tarball in " + folder.string();
+            return false;
+        }
+        const TimeRange range = GetTimeRange(firstTimestamp, settings);
+
+        for (const TarballFile& file : tarballFiles)
+        {
+            if (!range.Contains(file.timestamp) || (settings.streamMask & GetStreamBit(file.stream)) == 0)
+            {
+                continue;
+            }
+            FrameJob job{};
+            job.stream = file.stream;
+            job.timestamp = file.timestamp;
+            job.source = file.stream == SharedStream::PV ? FrameSource::Bgra : FrameSource::Pgm;
+            job.pData = file.pEntry->pData;
+            job.size = file.pEntry->size;
+
+            const auto trajectory = files.trajectories.find(file.stream);
+            if (trajectory != files.trajectories.end())
+            {
+                job.hasPose = FindPose(*trajectory->second, file.timestamp, job.pose);
+                // The PV resolution is only recorded in its trajectory
+                const TrajectoryHeader& header = trajectory->second->GetHeader();
+                if (header.flags & kTrajectoryHasIntrinsics)
+                {
+                    job.width = header.imageWidth;
+                    job.height = header.imageHeight;
+                }
+            }
+            if (job.source == FrameSource::Bgra && job.height == 0)
+            {
+                continue;
+            }
+            content.jobs.push_back(job);
+        }
+
+        for (SharedStream stream : kVlcStreams)
+        {
+            const auto trajectory = files.trajectories.find(stream);
+            if (trajectory == files.trajectories.end())
+            {
+                continue;
+            }
+            auto& poses = content.vlcPoses[stream];
+            for (size_t i = trajectory->second->LowerBound(static_cast<int64_t>(range.start)); i < trajectory->second->GetRecordCount(); ++i)
+            {
+                PoseSample sample;
+                sample.timestamp = static_cast<uint64_t>(trajectory->second->GetTimestamp(i));
+                if (sample.timestamp > range.end)
+                {
+                    break;
+                }
+                trajectory->second->GetTransform(i, sample.transform);
+                poses.push_back(sample);
+            }
+        }
+        return true;
+    }
+
+    bool WriteGroundTruth(DatasetLayout layout, const std::filesystem::path& output, const std::vector<PoseSample>& poses)
+    {
+        std::filesystem::path path;
+        std::string header;
+        char separator = ',';
+        if (layout == DatasetLayout::EuRoC)
+        {
+            path = output / "mav0" / "state_groundtruth_estimate0";
+            header = "#timestamp, p_RS_R_x [m], p_RS_R_y [m], p_RS_R_z [m], q_RS_w [], q_RS_x [], q_RS_y [], q_RS_z []";
+        }
+        else
+        {
+            path = output;
+            header = "# timestamp tx ty tz qx qy qz qw";
+            separator = ' ';
+        }
+        std::error_code errorCode;
+        std::filesystem::create_directories(path, errorCode);
+        std::ofstream file(path / (layout == DatasetLayout::EuRoC ? "data.csv" : "groundtruth.txt"), std::ios::out | std::ios::trunc);
+        if (!file.is_open())
+        {
+            return false;
+        }
+        file << header << "\n" << std::setprecision(9);
+        for (const PoseSample& pose : poses)
+        {
+            float rotation[4];
+            ToQuaternion(pose.transform, rotation);
+            file << FormatTimestamp(layout, pose.timestamp) << separator << pose.transform[3] << separator << pose.transform[7]
+                 << separator << pose.transform[11] << separator;
+            if (layout == DatasetLayout::EuRoC)
+            {
+                file << rotation[3] << separator << rotation[0] << separator << rotation[1] << separator << rotation[2] << "\n";
+            }
+            else
+            {
+                file << rotation[0] << separator << rotation[1] << separator << rotation[2] << separator << rotation[3] << "\n";
+            }
+        }
+        return file.good();
+    }
+
+    bool WriteImu(DatasetLayout layout, const std::filesystem::path& output,
+                  const std::map<SharedStream, std::vector<SharedImuSample>>& imuSamples, uint64_t& count)
+    {
+        static const std::vector<SharedImuSample> kNoSamples;
+        const auto getSamples = [&](SharedStream stream) -> const std::vector<SharedImuSample>&
+        {
+            const auto samples = imuSamples.find(stream);
+            return samples != imuSamples.end() ? samples->second : kNoSamples;
+        };
+        std::error_code errorCode;
+
+        if (layout == DatasetLayout::EuRoC)
+        {
+            // Gyroscope rate, the accelerometer is linearly interpolated at its timestamps
+            const auto& gyroscope = getSamples(SharedStream::IMU_GYRO);
+            const auto& accelerometer = getSamples(SharedStream::IMU_ACCEL);
+            if (gyroscope.empty() || accelerometer.empty())
+            {
+                return true;
+            }
+            std::filesystem::create_directories(output / "mav0" / "imu0", errorCode);
+            std::ofstream file(output / "mav0" / "imu0" / "data.csv", std::ios::out | std::ios::trunc);
+            file << "#timestamp [ns],w_RS_S_x [rad s^-1],w_RS_S_y [rad s^-1],w_RS_S_z [rad s^-1],"
+                    "a_RS_S_x [m s^-2],a_RS_S_y [m s^-2],a_RS_S_z [m s^-2]\n" << std::setprecision(9);
+            size_t next = 0;
+            for (const SharedImuSample& sample : gyroscope)
+            {
+                while (next < accelerometer.size() && accelerometer[next].timestamp < sample.timestamp)
+                {
+                    ++next;
+                }
+                if (next == 0 || next == accelerometer.size())
+                {
+                    continue;
+                }
+                const SharedImuSample& before = accelerometer[next - 1];
+                const SharedImuSample& after = accelerometer[next];
+                const float t = after.timestamp > before.timestamp ?
+                    static_cast<float>(sample.timestamp - before.timestamp) / static_cast<float>(after.timestamp - before.timestamp) : 0.f;
+                file << FormatTimestamp(layout, sample.timestamp) << "," << sample.x << "," << sample.y << "," << sample.z << ","
+                     << before.x + t * (after.x - before.x) << "," << before.y + t * (after.y - before.y) << ","
+                     << before.z + t * (after.z - before.z) << "\n";
+                ++count;
+            }
+            return file.good();
+        }
+
+        if (layout == DatasetLayout::TUM)
+        {
+            const auto& accelerometer = getSamples(SharedStream::IMU_ACCEL);
+            if (accelerometer.empty())
+            {
+                return true;
+            }
+            std::ofstream file(output / "accelerometer.txt", std::ios::out | std::ios::trunc);
+            file << "# accelerometer data\n# timestamp ax ay az\n" << std::setprecision(9);
+            for (const SharedImuSample& sample : accelerometer)
+            {
+                file << FormatTimestamp(layout, sample.timestamp) << " " << sample.x << " " << sample.y << " " << sample.z << "\n";
+            }
+            count += accelerometer.size();
+            return file.good();
+        }
+
+        for (const auto& samples : imuSamples)
+        {
+            std::ofstream file(output / (ToLower(GetStreamName(samples.first)) + ".csv"), std::ios::out | std::ios::trunc);
+            file << "#timestamp,x,y,z,temperature,sensor ticks [ns]\n" << std::setprecision(9);
+            for (const SharedImuSample& sample : samples.second)
+            {
+                file << sample.timestamp << "," << sample.x << "," << sample.y << "," << sample.z << "," << sample.temperature << ","
+                     << sample.sensorTicks << "\n";
+            }
+            count += samples.second.size();
+            if (!file.good())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool ExportDataset(const std::filesystem::path& input, const std::filesystem::path& output,
+                   const DatasetExportSettings& settings, DatasetExportStats& stats, std::string& error)
+{
+    stats = DatasetExportStats();
+
+    // Both are kept open while the jobs read them in place
+    RecordingReader container;
+    SeparateFiles separateFiles;
+    RecordingContent content;
+    if (std::filesystem::is_directory(input))
+    {
+        if (!ReadSeparateFiles(input, settings, separateFiles, content, error))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        if (!container.Open(input))
+        {
+            error = "cannot read recording " + input.string();
+            return false;
+        }
+        if (!ReadContainer(container, settings, content, error))
+        {
+            return false;
+        }
+    }
+
+    std::error_code errorCode;
+    std::filesystem::create_directories(output, errorCode);
+    if (errorCode)
+    {
+        error = "cannot create " + output.string();
+        return false;
+    }
+
+    // Jobs interleaved across streams in timestamp order, so that the workers convert the streams
+    // side by side and the lists are written in order
+    std::stable_sort(content.jobs.begin(), content.jobs.end(),
+                     [](const FrameJob& a, const FrameJob& b) { return a.timestamp < b.timestamp; });
+    std::map<SharedStream, StreamOutput> streamOutputs;
+    for (const FrameJob& job : content.jobs)
+    {
+        if (streamOutputs.count(job.stream) == 0 && !OpenStreamOutput(settings.layout, output, job.stream, streamOutputs[job.stream]))
+        {
+            error = "cannot write the " + GetStreamName(job.stream) + " stream to " + output.string();
+            return false;
+        }
+    }
+
+    const uint32_t depthScale = settings.layout == DatasetLayout::TUM ? kTumDepthScale : 1;
+    std::atomic<uint64_t> frames{ 0 };
+    std::atomic<uint64_t> imageBytes{ 0 };
+    {
+        const unsigned threadCount = settings.threadCount > 0 ? settings.threadCount : std::max(1u, std::thread::hardware_concurrency());
+        Eigen::NonBlockingThreadPool pool(static_cast<int>(threadCount));
+        std::mutex mutex;
+        std::condition_variable condVar;
+        size_t remaining = content.jobs.size();
+
+        for (FrameJob& job : content.jobs)
+        {
+            const std::filesystem::path path = streamOutputs[job.stream].folder / (FormatTimestamp(settings.layout, job.timestamp) + ".png");
+            pool.Schedule([&, path, pJob = &job]()
+            {
+                // Per worker scratch memory
+                thread_local std::vector<uint8_t> pixels;
+                thread_local std::vector<uint8_t> idat;
+                thread_local std::vector<uint8_t> png;
+                thread_local PngImage image;
+
+                if (DecodeFrame(*pJob, depthScale, pixels, image))
+                {
+                    EncodePng(image, idat, png);
+                    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+                    file.write(reinterpret_cast<const char*>(png.data()), png.size());
+                    pJob->isWritten = file.good();
+                    if (pJob->isWritten)
+                    {
+                        ++frames;
+                        imageBytes += png.size();
+                    }
+                }
+
+                std::lock_guard<std::mutex> guard(mutex);
+                if (--remaining == 0)
+                {
+                    condVar.notify_one();
+                }
+            });
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        condVar.wait(lock, [&] { return remaining == 0; });
+    }
+    stats.frames = frames;
+    stats.imageBytes = imageBytes;
+    stats.failedFrames = content.jobs.size() - stats.frames;
+
+    for (const FrameJob& job : content.jobs)
+    {
+        if (!job.isWritten)
+        {
+            continue;
+        }
+        const std::string timestamp = FormatTimestamp(settings.layout, job.timestamp);
+        StreamOutput& streamOutput = streamOutputs[job.stream];
+        const char separator = settings.layout == DatasetLayout::TUM ? ' ' : ',';
+        streamOutput.list << timestamp << separator << streamOutput.listPrefix << timestamp << ".png";
+        if (settings.layout == DatasetLayout::SolAR && job.hasPose)
+        {
+            for (float value : job.pose)
+            {
+                streamOutput.list << "," << value;
+            }
+        }
+        streamOutput.list << "\n";
+    }
+    for (auto& streamOutput : streamOutputs)
+    {
+        streamOutput.second.list.close();
+        if (streamOutput.second.list.fail())
+        {
+            error = "cannot write the " + GetStreamName(streamOutput.first) + " list";
+            return false;
+        }
+    }
+
+    if (!WriteImu(settings.layout, output, content.imuSamples, stats.imuSamples))
+    {
+        error = "cannot write the IMU samples";
+        return false;
+    }
+
+    if (settings.streamMask & GetStreamBit(SharedStream::HEAD_POSE))
+    {
+        if (settings.layout == DatasetLayout::SolAR)
+        {
+            std::ofstream file(output / "head_pose.csv", std::ios::out | std::ios::trunc);
+            file << "#timestamp,head to world transform (row-major 4x4)\n" << std::setprecision(9);
+            for (const PoseSample& pose : content.headPoses)
+            {
+                file << pose.timestamp;
+                for (float value : pose.transform)
+                {
+                    file << "," << value;
+                }
+                file << "\n";
+            }
+            stats.poses = content.headPoses.size();
+        }
+        else
+        {
+            const std::vector<PoseSample>* pGroundTruth = &content.headPoses;
+            for (SharedStream stream : kVlcStreams)
+            {
+                if (pGroundTruth->empty())
+                {
+                    pGroundTruth = &content.vlcPoses[stream];
+                }
+            }
+            if (!pGroundTruth->empty() && !WriteGroundTruth(settings.layout, output, *pGroundTruth))
+            {
+                error = "cannot write the ground truth";
+                return false;
+            }
+            stats.poses = pGroundTruth->size();
+        }
+    }
+    return true;
+}
+
+bool ParseStreamName(const std::string& name, SharedStream& stream)
+{
+    for (uint32_t i = 0; i <= static_cast<uint32_t>(SharedStream::HEAD_POSE); ++i)
+    {
+        if (ToLower(GetStreamName(static_cast<SharedStream>(i))) == ToLower(name))
+        {
+            stream = static_cast<SharedStream>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseDatasetLayout(const std::string& name, DatasetLayout& layout)
+{
+    static const std::pair<const char*, DatasetLayout> kLayouts[] = {
+        { "euroc", DatasetLayout::EuRoC }, { "tum", DatasetLayout::TUM }, { "solar", DatasetLayout::SolAR } };
+    for (const auto& entry : kLayouts)
+    {
+        if (ToLower(name) == entry.first)
+        {
+            layout = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
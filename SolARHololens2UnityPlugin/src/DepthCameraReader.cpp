@@ -0,0 +1,187 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DepthCameraReader.h"
+
+using winrt::com_array;
+
+namespace Depth
+{
+    enum InvalidationMasks
+    {
+        Invalid = 0x80,
+    };
+    static constexpr UINT16 AHAT_INVALID_VALUE = 4090;
+}
+
+winrt::com_array<uint16_t> DepthCameraReader::getDepthSensorData(uint64_t lastSeenSequence, FrameRequestStatus& status, uint64_t& sequence, uint64_t& timestamp, winrt::Windows::Foundation::Numerics::float4x4& rigToWorldtransform, bool& poseValid, uint32_t& pixelBufferSize, uint32_t& width, uint32_t& height)
+{
+    std::lock_guard<ProfiledMutex> reader_guard(m_sensorFrameMutex);
+    status = RequestFrame( lastSeenSequence );
+    sequence = m_frameSequence.Latest();
+    if ( status == FrameRequestStatus::NewFrame )
+    {
+        const UINT16* pAbImage = nullptr;
+        size_t outAbBufferCount = 0;
+
+        const UINT16* pDepth = nullptr;
+        size_t outDepthBufferCount = 0;
+
+        const BYTE* pSigma = nullptr;
+        size_t outSigmaBufferCount = 0;
+
+        timestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds((long long)m_frameTimestamp)).count();
+
+        if (m_isLongThrow)
+        {
+            winrt::check_hresult(m_pTypedFrame->GetSigmaBuffer(&pSigma, &outSigmaBufferCount));
+        }
+
+        winrt::check_hresult(m_pTypedFrame->GetAbDepthBuffer(&pAbImage, &outAbBufferCount));
+        winrt::check_hresult(m_pTypedFrame->GetBuffer(&pDepth, &outDepthBufferCount));
+
+        assert(outAbBufferCount == outDepthBufferCount);
+        if (m_isLongThrow)
+        {
+            assert(outAbBufferCount == outSigmaBufferCount);
+        }
+
+        com_array<UINT16> tempBuffer(outDepthBufferCount * 2);
+        for (size_t i = 0; i < outAbBufferCount; ++i)
+        {
+            const bool invalid = m_isLongThrow ? ((pSigma[i] & Depth::InvalidationMasks::Invalid) > 0) :
+                                                 (pDepth[i] >= Depth::AHAT_INVALID_VALUE);
+
+            tempBuffer[i] = invalid ? 0 : pDepth[i];
+            tempBuffer[i + outDepthBufferCount] = pAbImage[i];
+        }
+
+        width = m_resolution.Width;
+        height = m_resolution.Height;
+        pixelBufferSize = m_resolution.Width * m_resolution.Height;
+
+        rigToWorldtransform = m_frameLocation.rigToWorldtransform;
+        poseValid = m_frameLocated;
+
+        return tempBuffer;
+    }
+
+    return winrt::com_array<UINT16>();
+}
+
+void DepthCameraReader::FillSharedFrameData(IResearchModeSensorDepthFrame* pDepthFrame, SharedFrame& frame)
+{
+    const UINT16* pAbImage = nullptr;
+    size_t outAbBufferCount = 0;
+
+    const UINT16* pDepth = nullptr;
+    size_t outDepthBufferCount = 0;
+
+    const BYTE* pSigma = nullptr;
+    size_t outSigmaBufferCount = 0;
+
+    if (m_isLongThrow)
+    {
+        winrt::check_hresult(pDepthFrame->GetSigmaBuffer(&pSigma, &outSigmaBufferCount));
+    }
+
+    winrt::check_hresult(pDepthFrame->GetAbDepthBuffer(&pAbImage, &outAbBufferCount));
+    winrt::check_hresult(pDepthFrame->GetBuffer(&pDepth, &outDepthBufferCount));
+
+    assert(outAbBufferCount == outDepthBufferCount);
+
+    frame.bytesPerPixel = sizeof(UINT16);
+    frame.planeCount = 2;
+    frame.data.resize(2 * outDepthBufferCount * sizeof(UINT16));
+
+    UINT16* pDepthPlane = reinterpret_cast<UINT16*>(frame.data.data());
+    for (size_t i = 0; i < outDepthBufferCount; ++i)
+    {
+        const bool invalid = m_isLongThrow ? ((pSigma[i] & Depth::InvalidationMasks::Invalid) > 0) :
+                                             (pDepth[i] >= Depth::AHAT_INVALID_VALUE);
+        pDepthPlane[i] = invalid ? 0 : pDepth[i];
+    }
+    std::memcpy(pDepthPlane + outDepthBufferCount, pAbImage, outAbBufferCount * sizeof(UINT16));
+}
+
+void DepthCameraReader::SaveFrame(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorDepthFrame* pDepthFrame)
+{
+    const UINT16* pAbImage = nullptr;
+    size_t outAbBufferCount = 0;
+    wchar_t outputAbPath[MAX_PATH];
+
+    const UINT16* pDepth = nullptr;
+    size_t outDepthBufferCount = 0;
+    wchar_t outputDepthPath[MAX_PATH];
+
+    const BYTE* pSigma = nullptr;
+    size_t outSigmaBufferCount = 0;
+
+    HundredsOfNanoseconds timestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds((long long)m_frameTimestamp));
+
+    if (m_isLongThrow)
+    {
+        winrt::check_hresult(pDepthFrame->GetSigmaBuffer(&pSigma, &outSigmaBufferCount));
+    }
+
+    winrt::check_hresult(pDepthFrame->GetAbDepthBuffer(&pAbImage, &outAbBufferCount));
+    winrt::check_hresult(pDepthFrame->GetBuffer(&pDepth, &outDepthBufferCount));
+
+    // Get header for AB and Depth (16 bits)
+    // Prepare the data to save for AB
+    const std::string abHeaderString = CreateHeader(m_resolution, 65535);
+    swprintf_s(outputAbPath, L"%llu_ab.pgm", timestamp.count());
+    std::vector<BYTE> abPgmData;
+    abPgmData.reserve(abHeaderString.size() + outAbBufferCount * sizeof(UINT16));
+    abPgmData.insert(abPgmData.end(), abHeaderString.c_str(), abHeaderString.c_str() + abHeaderString.size());
+
+    // Prepare the data to save for Depth
+    const std::string depthHeaderString = CreateHeader(m_resolution, 65535);
+    swprintf_s(outputDepthPath, L"%llu.pgm", timestamp.count());
+    std::vector<BYTE> depthPgmData;
+    depthPgmData.reserve(depthHeaderString.size() + outDepthBufferCount * sizeof(UINT16));
+    depthPgmData.insert(depthPgmData.end(), depthHeaderString.c_str(), depthHeaderString.c_str() + depthHeaderString.size());
+
+    assert(outAbBufferCount == outDepthBufferCount);
+    if (m_isLongThrow)
+        assert(outAbBufferCount == outSigmaBufferCount);
+    // Validate depth
+    for (size_t i = 0; i < outAbBufferCount; ++i)
+    {
+        UINT16 abVal;
+        UINT16 d;
+        const bool invalid = m_isLongThrow ? ((pSigma[i] & Depth::InvalidationMasks::Invalid) > 0) :
+                                             (pDepth[i] >= Depth::AHAT_INVALID_VALUE);
+        if (invalid)
+        {
+            d = 0;
+        }
+        else
+        {
+            d = pDepth[i];
+        }
+
+        abVal = pAbImage[i];
+
+        abPgmData.push_back((BYTE)(abVal >> 8));
+        abPgmData.push_back((BYTE)abVal);
+        depthPgmData.push_back((BYTE)(d >> 8));
+        depthPgmData.push_back((BYTE)d);
+    }
+
+    m_tarball->AddFile(outputAbPath, &abPgmData[0], abPgmData.size());
+    m_tarball->AddFile(outputDepthPath, &depthPgmData[0], depthPgmData.size());
+}
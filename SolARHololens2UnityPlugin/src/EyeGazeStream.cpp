@@ -0,0 +1,96 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "EyeGazeStream.h"
+
+#include <cmath>
+
+EyeGazeStream::EyeGazeStream(size_t capacity)
+    : m_samples(capacity, "EyeGazeStream::m_samples")
+{
+}
+
+bool EyeGazeStream::Record(uint64_t timestamp, const EyeGaze& gaze)
+{
+    if (!m_samples.Push(timestamp, gaze))
+    {
+        return false;
+    }
+
+    std::lock_guard<ProfiledMutex> guard(m_logMutex);
+    if (m_log.IsOpen())
+    {
+        const float values[] = { gaze.origin[0], gaze.origin[1], gaze.origin[2],
+                                 gaze.direction[0], gaze.direction[1], gaze.direction[2] };
+        m_log.WriteRecord(static_cast<int64_t>(timestamp), values, 6);
+    }
+    return true;
+}
+
+bool EyeGazeStream::GetGazeAtTimestamp(uint64_t timestamp, EyeGaze& gaze) const
+{
+    Entry before;
+    Entry after;
+    if (!m_samples.FindBracket(timestamp, before, after) ||
+        after.timestamp - before.timestamp > kMaxInterpolationGap)
+    {
+        return false;
+    }
+
+    gaze = Interpolate(before, after, timestamp);
+    return true;
+}
+
+bool EyeGazeStream::StartRecording(const std::wstring& path)
+{
+    std::lock_guard<ProfiledMutex> guard(m_logMutex);
+    return m_log.Open(path);
+}
+
+void EyeGazeStream::StopRecording()
+{
+    std::lock_guard<ProfiledMutex> guard(m_logMutex);
+    m_log.Close();
+}
+
+EyeGaze EyeGazeStream::Interpolate(const Entry& before, const Entry& after, uint64_t timestamp)
+{
+    if (after.timestamp <= before.timestamp)
+    {
+        return before.value;
+    }
+
+    const float alpha = static_cast<float>(timestamp - before.timestamp) / static_cast<float>(after.timestamp - before.timestamp);
+    EyeGaze gaze;
+    float norm = 0.f;
+    for (int i = 0; i < 3; ++i)
+    {
+        gaze.origin[i] = before.value.origin[i] + alpha * (after.value.origin[i] - before.value.origin[i]);
+        gaze.direction[i] = before.value.direction[i] + alpha * (after.value.direction[i] - before.value.direction[i]);
+        norm += gaze.direction[i] * gaze.direction[i];
+    }
+
+    // Directions a render frame apart are close, normalized lerp is accurate enough
+    norm = std::sqrt(norm);
+    if (norm > 0.f)
+    {
+        for (float& d : gaze.direction)
+        {
+            d /= norm;
+        }
+    }
+    return gaze;
+}
@@ -0,0 +1,161 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FrameQuality.h"
+
+#include <cstddef>
+
+#if defined(_M_ARM64) || defined(__aarch64__)
+#define FRAME_QUALITY_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    // Running sums of the Laplacian over the sampled pixels
+    struct LaplacianSums
+    {
+        int64_t sum = 0;
+        uint64_t sumOfSquares = 0;
+        uint64_t count = 0;
+    };
+
+    // Laplacian of pixel x of a row, BytesPerPixel and Channel select the luminance byte
+    template <uint32_t BytesPerPixel, uint32_t Channel>
+    inline int32_t Laplacian(const uint8_t* pUp, const uint8_t* pRow, const uint8_t* pDown, uint32_t x)
+    {
+        const uint32_t i = x * BytesPerPixel + Channel;
+        return 4 * static_cast<int32_t>(pRow[i])
+               - pUp[i] - pDown[i] - pRow[i - BytesPerPixel] - pRow[i + BytesPerPixel];
+    }
+
+    template <uint32_t BytesPerPixel, uint32_t Channel>
+    void AccumulateRowScalar(const uint8_t* pUp, const uint8_t* pRow, const uint8_t* pDown,
+                             uint32_t xBegin, uint32_t xEnd, LaplacianSums& sums)
+    {
+        for (uint32_t x = xBegin; x < xEnd; ++x)
+        {
+            const int64_t lap = Laplacian<BytesPerPixel, Channel>(pUp, pRow, pDown, x);
+            sums.sum += lap;
+            sums.sumOfSquares += static_cast<uint64_t>(lap * lap);
+        }
+        sums.count += xEnd > xBegin ? xEnd - xBegin : 0;
+    }
+
+#ifdef FRAME_QUALITY_NEON
+    // Load the luminance byte of 8 consecutive pixels
+    template <uint32_t BytesPerPixel, uint32_t Channel>
+    inline int16x8_t LoadLuminance8(const uint8_t* p);
+
+    template <>
+    inline int16x8_t LoadLuminance8<1, 0>(const uint8_t* p)
+    {
+        return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)));
+    }
+
+    template <>
+    inline int16x8_t LoadLuminance8<4, 1>(const uint8_t* p)
+    {
+        return vreinterpretq_s16_u16(vmovl_u8(vld4_u8(p).val[1]));
+    }
+
+    // Process pixels [1, 1 + 8 * n[ of the row with NEON, return the first pixel left to process
+    template <uint32_t BytesPerPixel, uint32_t Channel>
+    uint32_t AccumulateRowNeon(const uint8_t* pUp, const uint8_t* pRow, const uint8_t* pDown,
+                               uint32_t width, LaplacianSums& sums)
+    {
+        int32x4_t sum = vdupq_n_s32(0);
+        uint64x2_t sumOfSquares = vdupq_n_u64(0);
+
+        // Right neighbours of the last pixel of a block must stay in the row
+        uint32_t x = 1;
+        for (; x + 8 < width; x += 8)
+        {
+            const uint32_t offset = x * BytesPerPixel;
+            const int16x8_t up = LoadLuminance8<BytesPerPixel, Channel>(pUp + offset);
+            const int16x8_t down = LoadLuminance8<BytesPerPixel, Channel>(pDown + offset);
+            const int16x8_t left = LoadLuminance8<BytesPerPixel, Channel>(pRow + offset - BytesPerPixel);
+            const int16x8_t right = LoadLuminance8<BytesPerPixel, Channel>(pRow + offset + BytesPerPixel);
+            const int16x8_t center = LoadLuminance8<BytesPerPixel, Channel>(pRow + offset);
+
+            // |lap| <= 1020, fits in 16 bits
+            const int16x8_t lap = vsubq_s16(vshlq_n_s16(center, 2),
+                                            vaddq_s16(vaddq_s16(up, down), vaddq_s16(left, right)));
+
+            sum = vpadalq_s16(sum, lap);
+            const int32x4_t squaresLow = vmull_s16(vget_low_s16(lap), vget_low_s16(lap));
+            const int32x4_t squaresHigh = vmull_s16(vget_high_s16(lap), vget_high_s16(lap));
+            sumOfSquares = vpadalq_u32(sumOfSquares, vreinterpretq_u32_s32(squaresLow));
+            sumOfSquares = vpadalq_u32(sumOfSquares, vreinterpretq_u32_s32(squaresHigh));
+        }
+
+        sums.sum += static_cast<int64_t>(vgetq_lane_s32(sum, 0)) + vgetq_lane_s32(sum, 1)
+                    + vgetq_lane_s32(sum, 2) + vgetq_lane_s32(sum, 3);
+        sums.sumOfSquares += vgetq_lane_u64(sumOfSquares, 0) + vgetq_lane_u64(sumOfSquares, 1);
+        sums.count += x - 1;
+        return x;
+    }
+#endif
+
+    template <uint32_t BytesPerPixel, uint32_t Channel>
+    float Sharpness(const uint8_t* pImage, uint32_t width, uint32_t height, uint32_t stride, uint32_t rowStep)
+    {
+        if (!pImage || width < 3 || height < 3)
+        {
+            return FrameQuality::kNoScore;
+        }
+        if (rowStep == 0)
+        {
+            rowStep = 1;
+        }
+
+        LaplacianSums sums;
+        for (uint32_t y = 1; y + 1 < height; y += rowStep)
+        {
+            const uint8_t* pRow = pImage + static_cast<size_t>(y) * stride;
+            const uint8_t* pUp = pRow - stride;
+            const uint8_t* pDown = pRow + stride;
+
+            uint32_t x = 1;
+#ifdef FRAME_QUALITY_NEON
+            x = AccumulateRowNeon<BytesPerPixel, Channel>(pUp, pRow, pDown, width, sums);
+#endif
+            AccumulateRowScalar<BytesPerPixel, Channel>(pUp, pRow, pDown, x, width - 1, sums);
+        }
+
+        if (sums.count == 0)
+        {
+            return FrameQuality::kNoScore;
+        }
+
+        const double mean = static_cast<double>(sums.sum) / sums.count;
+        const double meanOfSquares = static_cast<double>(sums.sumOfSquares) / sums.count;
+        return static_cast<float>(meanOfSquares - mean * mean);
+    }
+}
+
+namespace FrameQuality
+{
+    float SharpnessGray8(const uint8_t* pImage, uint32_t width, uint32_t height, uint32_t stride, uint32_t rowStep)
+    {
+        return Sharpness<1, 0>(pImage, width, height, stride, rowStep);
+    }
+
+    float SharpnessBgra8(const uint8_t* pImage, uint32_t width, uint32_t height, uint32_t stride, uint32_t rowStep)
+    {
+        return Sharpness<4, 1>(pImage, width, height, stride, rowStep);
+    }
+}
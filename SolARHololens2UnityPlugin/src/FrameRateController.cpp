@@ -0,0 +1,101 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FrameRateController.h"
+
+namespace
+{
+    constexpr double kTicksPerSecond = 10'000'000.0;
+    // Sensor frame intervals jitter, accept a frame slightly earlier than the target period
+    // so that e.g. a 15 fps target on a 30 fps sensor keeps every other frame
+    constexpr double kPeriodTolerance = 0.1;
+}
+
+void FrameRateController::Configure(const FrameRateSettings& settings)
+{
+    std::lock_guard<ProfiledMutex> guard(m_settingsMutex);
+    m_settings = settings;
+}
+
+FrameRateSettings FrameRateController::GetSettings()
+{
+    std::lock_guard<ProfiledMutex> guard(m_settingsMutex);
+    return m_settings;
+}
+
+bool FrameRateController::AcceptTimestamp(uint64_t timestamp)
+{
+    const FrameRateSettings settings = GetSettings();
+
+    const uint64_t arrivalIndex = m_arrivalIndex++;
+    if (settings.keepEveryNth > 1 && (arrivalIndex % settings.keepEveryNth) != 0)
+    {
+        m_decimated++;
+        return false;
+    }
+
+    if (settings.targetFps > 0.f && m_hasKeptFrame)
+    {
+        const double period = kTicksPerSecond / settings.targetFps;
+        const double elapsed = static_cast<double>(timestamp - m_lastKeptTimestamp);
+        if (elapsed < period * (1.0 - kPeriodTolerance))
+        {
+            m_decimated++;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FrameRateController::RequiresPose()
+{
+    const FrameRateSettings settings = GetSettings();
+    return settings.minTranslation > 0.f || settings.minRotationDeg > 0.f;
+}
+
+bool FrameRateController::AcceptPose(const KeyframePose& toWorldTransform)
+{
+    if (!m_hasKeptTransform)
+    {
+        return true;
+    }
+
+    const FrameRateSettings settings = GetSettings();
+    const bool translated = settings.minTranslation > 0.f &&
+                            KeyframeSelector::TranslationDistance(m_lastKeptTransform, toWorldTransform) >= settings.minTranslation;
+    const bool rotated = settings.minRotationDeg > 0.f &&
+                         KeyframeSelector::RotationAngleDeg(m_lastKeptTransform, toWorldTransform) >= settings.minRotationDeg;
+    if (!translated && !rotated)
+    {
+        m_decimated++;
+        return false;
+    }
+    return true;
+}
+
+void FrameRateController::Commit(uint64_t timestamp, const KeyframePose& toWorldTransform)
+{
+    Commit(timestamp);
+    m_hasKeptTransform = true;
+    m_lastKeptTransform = toWorldTransform;
+}
+
+void FrameRateController::Commit(uint64_t timestamp)
+{
+    m_hasKeptFrame = true;
+    m_lastKeptTimestamp = timestamp;
+}
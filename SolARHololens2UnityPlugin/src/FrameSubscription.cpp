@@ -0,0 +1,287 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FrameSubscription.h"
+#include "PoseConversion.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+void FillFrameMetadata(const SharedFrame& frame, bool solarCameraAxes, SolARHL2FrameMetadata& metadata)
+{
+    metadata.sequence = frame.sequence;
+    metadata.timestamp = frame.timestamp;
+    // Frames which could not be located hold the identity, whatever the axes
+    if (solarCameraAxes && frame.poseValid)
+    {
+        PoseConversion::ToSolARPose(frame.toWorldTransform.data(), metadata.toWorldTransform);
+    }
+    else
+    {
+        PoseConversion::Convert<PoseConversion::Layout::RowMajor, PoseConversion::CameraAxes::HoloLens>(
+            frame.toWorldTransform.data(), metadata.toWorldTransform);
+    }
+    metadata.width = frame.width;
+    metadata.height = frame.height;
+    metadata.bytesPerPixel = frame.bytesPerPixel;
+    metadata.planeCount = frame.planeCount;
+    metadata.dataSize = static_cast<uint32_t>(frame.data.size());
+    metadata.sharpness = frame.sharpness;
+    metadata.poseValid = frame.poseValid ? 1 : 0;
+    metadata.reserved = 0;
+}
+
+SharedFramePool::SharedFramePool(size_t maxPooledFrames)
+    : m_storage(std::make_shared<Storage>())
+{
+    m_storage->maxPooledFrames = maxPooledFrames;
+    m_storage->frames.reserve(maxPooledFrames);
+}
+
+std::shared_ptr<SharedFrame> SharedFramePool::Allocate()
+{
+    std::unique_ptr<SharedFrame> frame;
+    {
+        std::lock_guard<ProfiledMutex> guard(m_storage->mutex);
+        if (!m_storage->frames.empty())
+        {
+            frame = std::move(m_storage->frames.back());
+            m_storage->frames.pop_back();
+        }
+    }
+    if (!frame)
+    {
+        frame = std::make_unique<SharedFrame>();
+    }
+
+    std::weak_ptr<Storage> storage = m_storage;
+    return std::shared_ptr<SharedFrame>(frame.release(), [storage](SharedFrame* pFrame) { Recycle(storage, pFrame); });
+}
+
+size_t SharedFramePool::GetPooledCount()
+{
+    std::lock_guard<ProfiledMutex> guard(m_storage->mutex);
+    return m_storage->frames.size();
+}
+
+void SharedFramePool::Recycle(const std::weak_ptr<Storage>& storage, SharedFrame* pFrame)
+{
+    std::unique_ptr<SharedFrame> frame(pFrame);
+    auto locked = storage.lock();
+    if (!locked)
+    {
+        // Pool destroyed, e.g. the stream was stopped while the frame was held
+        return;
+    }
+
+    // Reset the header, keep the data buffer
+    std::vector<uint8_t> data = std::move(frame->data);
+    *frame = SharedFrame();
+    data.clear();
+    frame->data = std::move(data);
+
+    std::lock_guard<ProfiledMutex> guard(locked->mutex);
+    if (locked->frames.size() < locked->maxPooledFrames)
+    {
+        locked->frames.push_back(std::move(frame));
+    }
+}
+
+FrameSubscriber::FrameSubscriber(size_t capacity, DropPolicy dropPolicy, std::function<void()> onPush)
+    : m_capacity(capacity > 0 ? capacity : 1), m_dropPolicy(dropPolicy), m_onPush(std::move(onPush))
+{
+}
+
+void FrameSubscriber::Push(const SharedFramePtr& frame)
+{
+    {
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        if (m_closed)
+        {
+            return;
+        }
+
+        m_received++;
+        if (m_queue.size() >= m_capacity)
+        {
+            m_dropped++;
+            if (m_dropPolicy == DropPolicy::DropNewest)
+            {
+                return;
+            }
+            m_queue.pop_front();
+        }
+        m_queue.push_back(frame);
+        // Under the lock: once Close() returned, the notified object can be destroyed
+        if (m_onPush)
+        {
+            m_onPush();
+        }
+    }
+    m_condVar.notify_one();
+}
+
+bool FrameSubscriber::TryPop(SharedFramePtr& frame)
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    if (m_queue.empty())
+    {
+        return false;
+    }
+    frame = std::move(m_queue.front());
+    m_queue.pop_front();
+    return true;
+}
+
+bool FrameSubscriber::WaitPop(SharedFramePtr& frame, uint32_t timeoutMs)
+{
+    std::unique_lock<ProfiledMutex> lock(m_mutex);
+    m_condVar.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]()
+    {
+        return m_closed || !m_queue.empty();
+    });
+
+    if (m_closed || m_queue.empty())
+    {
+        return false;
+    }
+    frame = std::move(m_queue.front());
+    m_queue.pop_front();
+    return true;
+}
+
+void FrameSubscriber::Close()
+{
+    {
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        m_closed = true;
+        m_queue.clear();
+    }
+    m_condVar.notify_all();
+}
+
+bool FrameSubscriber::IsClosed()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    return m_closed;
+}
+
+uint64_t FrameSubscriber::GetReceivedCount()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    return m_received;
+}
+
+uint64_t FrameSubscriber::GetDroppedCount()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    return m_dropped;
+}
+
+FrameCallbackSubscription::FrameCallbackSubscription(FrameCallback callback, size_t capacity, DropPolicy dropPolicy, TaskPriority priority)
+    : m_callback(std::move(callback)),
+      m_deliveryQueue(TaskExecutor::GetShared(), priority, 1),
+      m_subscriber(std::make_shared<FrameSubscriber>(capacity, dropPolicy, [this]() { m_deliveryQueue.Schedule([this]() { Deliver(); }); }))
+{
+    assert(m_callback);
+}
+
+FrameCallbackSubscription::~FrameCallbackSubscription()
+{
+    // No delivery is scheduled after that
+    m_subscriber->Close();
+    m_deliveryQueue.Wait();
+}
+
+void FrameCallbackSubscription::Deliver()
+{
+    SharedFramePtr frame;
+    while (m_subscriber->TryPop(frame))
+    {
+        m_callback(frame);
+    }
+}
+
+std::shared_ptr<FrameSubscriber> FramePublisher::Subscribe(size_t capacity, DropPolicy dropPolicy)
+{
+    auto subscriber = std::make_shared<FrameSubscriber>(capacity, dropPolicy);
+
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    m_subscribers.push_back(subscriber);
+    return subscriber;
+}
+
+std::unique_ptr<FrameCallbackSubscription> FramePublisher::Subscribe(FrameCallback callback, size_t capacity, DropPolicy dropPolicy, TaskPriority priority)
+{
+    auto subscription = std::make_unique<FrameCallbackSubscription>(std::move(callback), capacity, dropPolicy, priority);
+
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    m_subscribers.push_back(subscription->GetSubscriber());
+    return subscription;
+}
+
+void FramePublisher::Unsubscribe(const std::shared_ptr<FrameSubscriber>& subscriber)
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    m_subscribers.erase(std::remove_if(m_subscribers.begin(), m_subscribers.end(),
+        [&subscriber](const std::weak_ptr<FrameSubscriber>& s)
+        {
+            auto locked = s.lock();
+            return !locked || locked == subscriber;
+        }),
+        m_subscribers.end());
+    subscriber->Close();
+}
+
+bool FramePublisher::HasSubscribers()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    return std::any_of(m_subscribers.begin(), m_subscribers.end(),
+        [](const std::weak_ptr<FrameSubscriber>& s) { return !s.expired(); });
+}
+
+void FramePublisher::Publish(const SharedFramePtr& frame)
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    auto it = m_subscribers.begin();
+    while (it != m_subscribers.end())
+    {
+        if (auto subscriber = it->lock())
+        {
+            subscriber->Push(frame);
+            ++it;
+        }
+        else
+        {
+            // Subscriber has been released, unsubscribe it
+            it = m_subscribers.erase(it);
+        }
+    }
+}
+
+void FramePublisher::CloseAll()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    for (const auto& s : m_subscribers)
+    {
+        if (auto subscriber = s.lock())
+        {
+            subscriber->Close();
+        }
+    }
+    m_subscribers.clear();
+}
@@ -0,0 +1,75 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HeadPoseHistory.h"
+
+#include <Eigen/Dense>
+
+using Eigen::Matrix3f;
+using Eigen::Quaternionf;
+using Eigen::Vector3f;
+
+namespace
+{
+    // Rotation whose columns are the right, up and backward axes of the head (forward is -Z)
+    Quaternionf ToOrientation(const HeadPose& pose)
+    {
+        const Vector3f backward = -Vector3f(pose.forward).normalized();
+        // Up may not be exactly orthogonal to forward, project it
+        const Vector3f up = (Vector3f(pose.up) - Vector3f(pose.up).dot(backward) * backward).normalized();
+
+        Matrix3f rotation;
+        rotation.col(0) = up.cross(backward);
+        rotation.col(1) = up;
+        rotation.col(2) = backward;
+        return Quaternionf(rotation);
+    }
+}
+
+HeadPoseLookup HeadPoseHistory::Lookup(uint64_t timestamp, HeadPose& pose) const
+{
+    Entry before;
+    Entry after;
+    if (!m_poses.FindBracket(timestamp, before, after))
+    {
+        return HeadPoseLookup::OutsideWindow;
+    }
+    if (after.timestamp - before.timestamp > kMaxInterpolationGap)
+    {
+        return HeadPoseLookup::TrackingGap;
+    }
+
+    pose = Interpolate(before, after, timestamp);
+    return HeadPoseLookup::Interpolated;
+}
+
+HeadPose HeadPoseHistory::Interpolate(const Entry& before, const Entry& after, uint64_t timestamp)
+{
+    if (after.timestamp <= before.timestamp)
+    {
+        return before.value;
+    }
+
+    const float alpha = static_cast<float>(timestamp - before.timestamp) / static_cast<float>(after.timestamp - before.timestamp);
+
+    HeadPose pose;
+    Vector3f::Map(pose.position) = (1.f - alpha) * Vector3f(before.value.position) + alpha * Vector3f(after.value.position);
+
+    const Matrix3f rotation = ToOrientation(before.value).slerp(alpha, ToOrientation(after.value)).toRotationMatrix();
+    Vector3f::Map(pose.forward) = -rotation.col(2);
+    Vector3f::Map(pose.up) = rotation.col(1);
+    return pose;
+}
@@ -0,0 +1,214 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ImuPreintegration.h"
+
+#include <algorithm>
+#include <cmath>
+
+using Eigen::Matrix3d;
+using Eigen::Vector3d;
+
+namespace
+{
+    constexpr double kTicksPerSecond = 10'000'000.0;
+    constexpr double kSmallAngle = 1e-8;
+
+    Matrix3d Skew(const Vector3d& v)
+    {
+        Matrix3d m;
+        m << 0.0, -v.z(), v.y(),
+             v.z(), 0.0, -v.x(),
+             -v.y(), v.x(), 0.0;
+        return m;
+    }
+
+    // Rotation matrix of the rotation vector phi
+    Matrix3d Exp(const Vector3d& phi)
+    {
+        const double angle = phi.norm();
+        const Matrix3d phiHat = Skew(phi);
+        if (angle < kSmallAngle)
+        {
+            return Matrix3d::Identity() + phiHat;
+        }
+        return Matrix3d::Identity() + std::sin(angle) / angle * phiHat +
+               (1.0 - std::cos(angle)) / (angle * angle) * phiHat * phiHat;
+    }
+
+    Matrix3d RightJacobian(const Vector3d& phi)
+    {
+        const double angle = phi.norm();
+        const Matrix3d phiHat = Skew(phi);
+        if (angle < kSmallAngle)
+        {
+            return Matrix3d::Identity() - 0.5 * phiHat;
+        }
+        const double angle2 = angle * angle;
+        return Matrix3d::Identity() - (1.0 - std::cos(angle)) / angle2 * phiHat +
+               (angle - std::sin(angle)) / (angle2 * angle) * phiHat * phiHat;
+    }
+
+    // Integration accumulates rounding errors, keep deltaRotation a rotation
+    Matrix3d Orthonormalize(const Matrix3d& r)
+    {
+        const Eigen::Quaterniond q(r);
+        return q.normalized().toRotationMatrix();
+    }
+
+    // Linear interpolation of a sample stream sorted on clock, for increasing times
+    class SampleInterpolator
+    {
+    public:
+        SampleInterpolator(const std::vector<ImuSample>& samples, uint64_t ImuSample::* clock)
+            : m_samples(samples), m_clock(clock)
+        {
+        }
+
+        Vector3d At(double time)
+        {
+            while (m_next + 1 < m_samples.size() && static_cast<double>(m_samples[m_next].*m_clock) < time)
+            {
+                ++m_next;
+            }
+            const ImuSample& after = m_samples[m_next];
+            const ImuSample& before = m_samples[m_next > 0 ? m_next - 1 : 0];
+            const double t0 = static_cast<double>(before.*m_clock);
+            const double t1 = static_cast<double>(after.*m_clock);
+            const double alpha = t1 > t0 ? std::clamp((time - t0) / (t1 - t0), 0.0, 1.0) : 1.0;
+            return (1.0 - alpha) * Vector3d(before.x, before.y, before.z) + alpha * Vector3d(after.x, after.y, after.z);
+        }
+
+    private:
+        const std::vector<ImuSample>& m_samples;
+        uint64_t ImuSample::* m_clock;
+        size_t m_next = 0;
+    };
+
+    bool Covers(const std::vector<ImuSample>& samples, uint64_t ImuSample::* clock, uint64_t startTime, uint64_t endTime)
+    {
+        return !samples.empty() && samples.front().*clock <= startTime && samples.back().*clock >= endTime;
+    }
+}
+
+ImuPreintegrator::ImuPreintegrator(const ImuPreintegrationParameters& parameters)
+    : m_parameters(parameters)
+{
+}
+
+void ImuPreintegrator::Reset(uint64_t startTime)
+{
+    m_result = PreintegratedImu();
+    m_result.startTime = startTime;
+    m_result.endTime = startTime;
+}
+
+void ImuPreintegrator::Integrate(const Vector3d& angularRate, const Vector3d& acceleration, double dt)
+{
+    if (dt <= 0.0)
+    {
+        return;
+    }
+
+    PreintegratedImu& r = m_result;
+    const Vector3d omega = angularRate - m_parameters.gyroBias;
+    const Vector3d acc = acceleration - m_parameters.accelBias;
+    const Matrix3d accHat = Skew(acc);
+    const double dt2 = dt * dt;
+
+    const Matrix3d stepRotation = Exp(omega * dt);
+    const Matrix3d jr = RightJacobian(omega * dt);
+
+    // Noise propagation, error state [rotation, velocity, position], noise [gyro, accel]
+    Eigen::Matrix<double, 9, 9> a = Eigen::Matrix<double, 9, 9>::Identity();
+    a.block<3, 3>(0, 0) = stepRotation.transpose();
+    a.block<3, 3>(3, 0) = -r.deltaRotation * accHat * dt;
+    a.block<3, 3>(6, 0) = -0.5 * r.deltaRotation * accHat * dt2;
+    a.block<3, 3>(6, 3) = Matrix3d::Identity() * dt;
+
+    Eigen::Matrix<double, 9, 6> b = Eigen::Matrix<double, 9, 6>::Zero();
+    b.block<3, 3>(0, 0) = jr * dt;
+    b.block<3, 3>(3, 3) = r.deltaRotation * dt;
+    b.block<3, 3>(6, 3) = 0.5 * r.deltaRotation * dt2;
+
+    // Discrete noise covariance from the continuous densities
+    Eigen::Matrix<double, 6, 6> noise = Eigen::Matrix<double, 6, 6>::Zero();
+    noise.diagonal().head<3>().setConstant(m_parameters.gyroNoiseDensity * m_parameters.gyroNoiseDensity / dt);
+    noise.diagonal().tail<3>().setConstant(m_parameters.accelNoiseDensity * m_parameters.accelNoiseDensity / dt);
+
+    r.covariance = a * r.covariance * a.transpose() + b * noise * b.transpose();
+
+    // Bias Jacobians, using the deltas before this step
+    r.dP_dba += r.dV_dba * dt - 0.5 * r.deltaRotation * dt2;
+    r.dP_dbg += r.dV_dbg * dt - 0.5 * r.deltaRotation * accHat * r.dR_dbg * dt2;
+    r.dV_dba -= r.deltaRotation * dt;
+    r.dV_dbg -= r.deltaRotation * accHat * r.dR_dbg * dt;
+    r.dR_dbg = stepRotation.transpose() * r.dR_dbg - jr * dt;
+
+    // Deltas
+    r.deltaPosition += r.deltaVelocity * dt + 0.5 * r.deltaRotation * acc * dt2;
+    r.deltaVelocity += r.deltaRotation * acc * dt;
+    r.deltaRotation = Orthonormalize(r.deltaRotation * stepRotation);
+
+    r.deltaTime += dt;
+}
+
+bool ImuPreintegrator::IntegrateInterval(const std::vector<ImuSample>& gyroSamples,
+                                         const std::vector<ImuSample>& accelSamples,
+                                         uint64_t ImuSample::* clock,
+                                         uint64_t startTime,
+                                         uint64_t endTime,
+                                         const ImuPreintegrationParameters& parameters,
+                                         PreintegratedImu& result)
+{
+    if (endTime <= startTime ||
+        !Covers(gyroSamples, clock, startTime, endTime) ||
+        !Covers(accelSamples, clock, startTime, endTime))
+    {
+        return false;
+    }
+
+    ImuPreintegrator integrator(parameters);
+    integrator.Reset(startTime);
+    SampleInterpolator gyro(gyroSamples, clock);
+    SampleInterpolator accel(accelSamples, clock);
+
+    uint32_t sampleCount = 0;
+    uint64_t stepStart = startTime;
+    for (const ImuSample& sample : gyroSamples)
+    {
+        const uint64_t sampleTime = sample.*clock;
+        if (sampleTime <= stepStart)
+        {
+            continue;
+        }
+        const uint64_t stepEnd = std::min(sampleTime, endTime);
+        const double middle = 0.5 * (static_cast<double>(stepStart) + static_cast<double>(stepEnd));
+        integrator.Integrate(gyro.At(middle), accel.At(middle), (stepEnd - stepStart) / kTicksPerSecond);
+        sampleCount++;
+
+        stepStart = stepEnd;
+        if (stepStart >= endTime)
+        {
+            break;
+        }
+    }
+
+    result = integrator.Result();
+    result.endTime = endTime;
+    result.sampleCount = sampleCount;
+    return true;
+}
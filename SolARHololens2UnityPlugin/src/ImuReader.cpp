@@ -0,0 +1,195 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ImuReader.h"
+#include "LockProfiler.h"
+
+namespace
+{
+    const float* SampleValues(const AccelDataStruct& sample) { return sample.AccelValues; }
+    const float* SampleValues(const GyroDataStruct& sample) { return sample.GyroValues; }
+    const float* SampleValues(const MagDataStruct& sample) { return sample.MagValues; }
+
+    float SampleTemperature(const AccelDataStruct& sample) { return sample.temperature; }
+    float SampleTemperature(const GyroDataStruct& sample) { return sample.temperature; }
+    float SampleTemperature(const MagDataStruct&) { return 0.f; }
+}
+
+ImuReader::ImuReader(IResearchModeSensor* pSensor, HANDLE imuConsentGiven, ResearchModeSensorConsent* imuAccessConsent, size_t ringCapacity)
+    : m_samples(ringCapacity)
+{
+    m_pRMSensor = pSensor;
+    m_pRMSensor->AddRef();
+    m_sensorType = m_pRMSensor->GetSensorType();
+
+    m_imuConsentGiven = imuConsentGiven;
+    m_imuAccessConsent = imuAccessConsent;
+}
+
+ImuReader::~ImuReader()
+{
+    stop();
+
+    if (m_pRMSensor)
+    {
+        m_pRMSensor->CloseStream();
+        m_pRMSensor->Release();
+    }
+}
+
+bool ImuReader::start()
+{
+    if (m_pImuUpdateThread)
+    {
+        return false;
+    }
+
+    m_fExit = false;
+    m_pImuUpdateThread = std::make_unique<std::thread>(ImuUpdateThread, this);
+    return true;
+}
+
+void ImuReader::stop()
+{
+    if (m_pImuUpdateThread)
+    {
+        m_fExit = true;
+        m_pImuUpdateThread->join();
+        m_pImuUpdateThread = nullptr;
+    }
+}
+
+bool ImuReader::WaitForConsentAndOpenStream()
+{
+    if (WaitForSingleObject(m_imuConsentGiven, INFINITE) != WAIT_OBJECT_0)
+    {
+        return false;
+    }
+
+    if (*m_imuAccessConsent != ResearchModeSensorConsent::Allowed)
+    {
+        OutputDebugString(L"IMU access is denied");
+        return false;
+    }
+
+    if (FAILED(m_pRMSensor->OpenStream()))
+    {
+        m_pRMSensor->Release();
+        m_pRMSensor = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void ImuReader::ImuUpdateThread(ImuReader* pReader)
+{
+    ScopedThreadProfile profile("ImuReader::ImuUpdateThread");
+    if (!pReader->WaitForConsentAndOpenStream())
+    {
+        return;
+    }
+
+    while (!pReader->m_fExit && pReader->m_pRMSensor)
+    {
+        IResearchModeSensorFrame* pSensorFrame = nullptr;
+        if (FAILED(pReader->m_pRMSensor->GetNextBuffer(&pSensorFrame)))
+        {
+            continue;
+        }
+
+        pReader->DrainFrame(pSensorFrame);
+        pSensorFrame->Release();
+    }
+
+    if (pReader->m_pRMSensor)
+    {
+        pReader->m_pRMSensor->CloseStream();
+    }
+}
+
+void ImuReader::DrainFrame(IResearchModeSensorFrame* pSensorFrame)
+{
+    size_t count = 0;
+    switch (m_sensorType)
+    {
+    case IMU_ACCEL:
+    {
+        IResearchModeAccelFrame* pAccelFrame = nullptr;
+        if (SUCCEEDED(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pAccelFrame))))
+        {
+            const AccelDataStruct* pSamples = nullptr;
+            if (SUCCEEDED(pAccelFrame->GetCalibratedAccelarationSamples(&pSamples, &count)))
+            {
+                PushSamples(pSamples, count);
+            }
+            pAccelFrame->Release();
+        }
+        break;
+    }
+    case IMU_GYRO:
+    {
+        IResearchModeGyroFrame* pGyroFrame = nullptr;
+        if (SUCCEEDED(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pGyroFrame))))
+        {
+            const GyroDataStruct* pSamples = nullptr;
+            if (SUCCEEDED(pGyroFrame->GetCalibratedGyroSamples(&pSamples, &count)))
+            {
+                PushSamples(pSamples, count);
+            }
+            pGyroFrame->Release();
+        }
+        break;
+    }
+    case IMU_MAG:
+    {
+        IResearchModeMagFrame* pMagFrame = nullptr;
+        if (SUCCEEDED(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pMagFrame))))
+        {
+            const MagDataStruct* pSamples = nullptr;
+            if (SUCCEEDED(pMagFrame->GetMagnetometerSamples(&pSamples, &count)))
+            {
+                PushSamples(pSamples, count);
+            }
+            pMagFrame->Release();
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+template <class TSample>
+void ImuReader::PushSamples(const TSample* pSamples, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const TSample& in = pSamples[i];
+        const float* values = SampleValues(in);
+
+        ImuSample sample;
+        // SocTicks are host ticks, like sensor frame timestamps
+        sample.timestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds(checkAndConvertUnsigned(in.SocTicks))).count();
+        sample.hostTicks = in.SocTicks;
+        sample.sensorTicks = in.VinylHupTicks;
+        sample.x = values[0];
+        sample.y = values[1];
+        sample.z = values[2];
+        sample.temperature = SampleTemperature(in);
+        m_samples.Push(sample);
+    }
+}
@@ -0,0 +1,240 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "KeyframeSelector.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr double kTicksPerSecond = 10'000'000.0;
+    constexpr float kPi = 3.14159265358979f;
+    constexpr float kRadToDeg = 180.f / kPi;
+
+    struct Vec3
+    {
+        float x, y, z;
+    };
+
+    // Rows of the pose: 0 to 2 are the sensor axes in world coordinates, 3 is its position
+    Vec3 Row(const KeyframePose& pose, int row)
+    {
+        return Vec3{ pose[row * 4], pose[row * 4 + 1], pose[row * 4 + 2] };
+    }
+
+    float Dot(const Vec3& a, const Vec3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+}
+
+KeyframeSelector::KeyframeSelector(size_t historySize)
+{
+    m_history.resize(historySize > 0 ? historySize : 1);
+}
+
+void KeyframeSelector::Configure(const KeyframeSettings& settings)
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    m_settings = settings;
+    m_hasKeyframe = false;
+    m_hasKeyframePose = false;
+}
+
+KeyframeSettings KeyframeSelector::GetSettings()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    return m_settings;
+}
+
+bool KeyframeSelector::IsEnabled()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    return m_settings.enabled;
+}
+
+bool KeyframeSelector::Evaluate(uint64_t timestamp, const KeyframePose* pPose)
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    if (!m_settings.enabled)
+    {
+        return true;
+    }
+
+    KeyframeDecision decision;
+    decision.index = ++m_evaluationCount;
+    decision.timestamp = timestamp;
+
+    if (!pPose)
+    {
+        decision.reasons |= KeyframeReasonNoPose;
+    }
+
+    if (!m_hasKeyframe || (pPose && !m_hasKeyframePose))
+    {
+        // Nothing to compare with
+        decision.isKeyframe = true;
+        decision.reasons |= KeyframeReasonFirst;
+    }
+    else
+    {
+        decision.elapsedSec = timestamp > m_keyframeTimestamp ?
+            static_cast<float>((timestamp - m_keyframeTimestamp) / kTicksPerSecond) : 0.f;
+
+        bool motion = false;
+        if (pPose)
+        {
+            decision.translation = TranslationDistance(m_keyframePose, *pPose);
+            decision.rotationDeg = RotationAngleDeg(m_keyframePose, *pPose);
+            decision.overlap = EstimateOverlap(m_keyframePose, *pPose, m_settings);
+
+            if (m_settings.minTranslation > 0.f && decision.translation >= m_settings.minTranslation)
+            {
+                decision.reasons |= KeyframeReasonTranslation;
+                motion = true;
+            }
+            if (m_settings.minRotationDeg > 0.f && decision.rotationDeg >= m_settings.minRotationDeg)
+            {
+                decision.reasons |= KeyframeReasonRotation;
+                motion = true;
+            }
+            if (motion && m_settings.maxOverlap > 0.f && m_settings.maxOverlap < 1.f && decision.overlap > m_settings.maxOverlap)
+            {
+                decision.reasons |= KeyframeReasonOverlapGated;
+                m_stats.rejectedByOverlap++;
+                motion = false;
+            }
+        }
+
+        const bool timeout = m_settings.maxIntervalSec > 0.f && decision.elapsedSec >= m_settings.maxIntervalSec;
+        if (timeout)
+        {
+            decision.reasons |= KeyframeReasonTime;
+        }
+
+        decision.isKeyframe = motion || timeout;
+    }
+
+    m_stats.evaluated++;
+    if (decision.isKeyframe)
+    {
+        m_stats.emitted++;
+        if (decision.reasons & KeyframeReasonTranslation)
+        {
+            m_stats.byTranslation++;
+        }
+        if (decision.reasons & KeyframeReasonRotation)
+        {
+            m_stats.byRotation++;
+        }
+        if (decision.reasons & KeyframeReasonTime)
+        {
+            m_stats.byTime++;
+        }
+
+        m_hasKeyframe = true;
+        m_keyframeTimestamp = timestamp;
+        if (pPose)
+        {
+            m_hasKeyframePose = true;
+            m_keyframePose = *pPose;
+        }
+    }
+
+    Record(decision);
+    return decision.isKeyframe;
+}
+
+void KeyframeSelector::Record(const KeyframeDecision& decision)
+{
+    // Lock on m_mutex from caller
+    m_history[(decision.index - 1) % m_history.size()] = decision;
+}
+
+std::vector<KeyframeDecision> KeyframeSelector::GetDecisions(uint64_t sinceIndex)
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+
+    const uint64_t oldestIndex = m_evaluationCount > m_history.size() ? m_evaluationCount - m_history.size() + 1 : 1;
+    const uint64_t firstIndex = std::max(sinceIndex + 1, oldestIndex);
+
+    std::vector<KeyframeDecision> decisions;
+    if (firstIndex > m_evaluationCount)
+    {
+        return decisions;
+    }
+    decisions.reserve(static_cast<size_t>(m_evaluationCount - firstIndex + 1));
+    for (uint64_t index = firstIndex; index <= m_evaluationCount; ++index)
+    {
+        decisions.push_back(m_history[(index - 1) % m_history.size()]);
+    }
+    return decisions;
+}
+
+KeyframeStats KeyframeSelector::GetStats()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    return m_stats;
+}
+
+float KeyframeSelector::TranslationDistance(const KeyframePose& a, const KeyframePose& b)
+{
+    const float dx = a[12] - b[12];
+    const float dy = a[13] - b[13];
+    const float dz = a[14] - b[14];
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+float KeyframeSelector::RotationAngleDeg(const KeyframePose& a, const KeyframePose& b)
+{
+    // trace(Ra^T * Rb) = 1 + 2 cos(angle)
+    float trace = 0.f;
+    for (int row = 0; row < 3; ++row)
+    {
+        trace += Dot(Row(a, row), Row(b, row));
+    }
+    const float cosAngle = std::clamp((trace - 1.f) * 0.5f, -1.f, 1.f);
+    return std::acos(cosAngle) * kRadToDeg;
+}
+
+float KeyframeSelector::EstimateOverlap(const KeyframePose& from, const KeyframePose& to, const KeyframeSettings& settings)
+{
+    const Vec3 fromX = Row(from, 0);
+    const Vec3 fromY = Row(from, 1);
+    const Vec3 fromZ = Row(from, 2);
+
+    // Sensors look along -Z: express the new optical axis in the reference sensor frame
+    const Vec3 toZ = Row(to, 2);
+    const Vec3 forward{ -toZ.x, -toZ.y, -toZ.z };
+    const float fx = Dot(forward, fromX);
+    const float fy = Dot(forward, fromY);
+    const float fz = -Dot(forward, fromZ);
+
+    // Lateral translation in the reference sensor frame
+    const Vec3 delta{ to[12] - from[12], to[13] - from[13], to[14] - from[14] };
+    const float depth = settings.sceneDepth > 0.f ? settings.sceneDepth : 1.f;
+
+    // Rotating towards +X and moving along +X both shift the image the same way
+    const float shiftH = std::atan2(fx, fz) + std::atan2(Dot(delta, fromX), depth);
+    const float shiftV = std::atan2(fy, fz) + std::atan2(Dot(delta, fromY), depth);
+
+    const float fovH = std::max(settings.horizontalFovDeg, 1.f) / kRadToDeg;
+    const float fovV = std::max(settings.verticalFovDeg, 1.f) / kRadToDeg;
+    const float overlapH = std::max(0.f, 1.f - std::fabs(shiftH) / fovH);
+    const float overlapV = std::max(0.f, 1.f - std::fabs(shiftV) / fovV);
+    return overlapH * overlapV;
+}
@@ -0,0 +1,287 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LatencyTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+    constexpr uint64_t kNoMin = std::numeric_limits<uint64_t>::max();
+
+    uint32_t MostSignificantBit(uint64_t value)
+    {
+        uint32_t msb = 0;
+        while (value >>= 1)
+        {
+            msb++;
+        }
+        return msb;
+    }
+}
+
+const char* ToString(PipelineStage stage)
+{
+    switch (stage)
+    {
+    case PipelineStage::Exposure:
+        return "Exposure";
+    case PipelineStage::Acquired:
+        return "Acquired";
+    case PipelineStage::Located:
+        return "Located";
+    case PipelineStage::Converted:
+        return "Converted";
+    case PipelineStage::Copied:
+        return "Copied";
+    case PipelineStage::Published:
+        return "Published";
+    case PipelineStage::PickedUp:
+        return "PickedUp";
+    default:
+        return "Unknown";
+    }
+}
+
+uint64_t PipelineClockNow()
+{
+    using HundredsOfNanoseconds = std::chrono::duration<int64_t, std::ratio<1, 10'000'000>>;
+    return static_cast<uint64_t>(std::chrono::duration_cast<HundredsOfNanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    Reset();
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t value)
+{
+    if (value < kSubBucketCount)
+    {
+        return static_cast<size_t>(value);
+    }
+    const uint32_t shift = MostSignificantBit(value) - kSubBucketBits;
+    return (shift + 1) * kSubBucketCount + static_cast<size_t>((value >> shift) - kSubBucketCount);
+}
+
+uint64_t LatencyHistogram::BucketMidpoint(size_t index)
+{
+    if (index < 2 * kSubBucketCount)
+    {
+        return index;
+    }
+    const uint32_t shift = static_cast<uint32_t>(index / kSubBucketCount) - 1;
+    const uint64_t lower = static_cast<uint64_t>(index % kSubBucketCount + kSubBucketCount) << shift;
+    return lower + ((uint64_t(1) << shift) >> 1);
+}
+
+void LatencyHistogram::Record(uint64_t value)
+{
+    m_buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t min = m_min.load(std::memory_order_relaxed);
+    while (value < min && !m_min.compare_exchange_weak(min, value, std::memory_order_relaxed))
+    {
+    }
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+    {
+    }
+
+    // Published last, readers use it as the number of samples
+    m_count.fetch_add(1, std::memory_order_release);
+}
+
+LatencyStats LatencyHistogram::GetStats() const
+{
+    LatencyStats stats;
+    stats.count = m_count.load(std::memory_order_acquire);
+    if (stats.count == 0)
+    {
+        return stats;
+    }
+    stats.min = m_min.load(std::memory_order_relaxed);
+    stats.max = m_max.load(std::memory_order_relaxed);
+    stats.mean = static_cast<double>(m_sum.load(std::memory_order_relaxed)) / static_cast<double>(stats.count);
+
+    // Buckets may hold a few samples more than count, recorded meanwhile
+    const uint64_t p50Rank = (stats.count * 50 + 99) / 100;
+    const uint64_t p90Rank = (stats.count * 90 + 99) / 100;
+    const uint64_t p99Rank = (stats.count * 99 + 99) / 100;
+    uint64_t cumulated = 0;
+    for (size_t i = 0; i < kBucketCount && cumulated < p99Rank; ++i)
+    {
+        const uint64_t bucketCount = m_buckets[i].load(std::memory_order_relaxed);
+        if (bucketCount == 0)
+        {
+            continue;
+        }
+        const uint64_t value = std::clamp(BucketMidpoint(i), stats.min, stats.max);
+        if (cumulated < p50Rank && cumulated + bucketCount >= p50Rank)
+        {
+            stats.p50 = value;
+        }
+        if (cumulated < p90Rank && cumulated + bucketCount >= p90Rank)
+        {
+            stats.p90 = value;
+        }
+        if (cumulated + bucketCount >= p99Rank)
+        {
+            stats.p99 = value;
+        }
+        cumulated += bucketCount;
+    }
+    return stats;
+}
+
+void LatencyHistogram::Reset()
+{
+    for (std::atomic<uint64_t>& bucket : m_buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_sum.store(0, std::memory_order_relaxed);
+    m_min.store(kNoMin, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+    m_count.store(0, std::memory_order_release);
+}
+
+PipelineTracer::PipelineTracer()
+{
+    m_recent.resize(kRecentTraceCount);
+}
+
+void PipelineTracer::Complete(const FrameTrace& trace)
+{
+    Record(trace, PipelineStage::Acquired, PipelineStage::Published);
+
+    std::lock_guard<std::mutex> lock(m_recentMutex);
+    Store(trace);
+}
+
+void PipelineTracer::PickedUp(FrameTrace trace)
+{
+    trace.Mark(PipelineStage::PickedUp);
+    Record(trace, PipelineStage::PickedUp, PipelineStage::PickedUp);
+
+    std::lock_guard<std::mutex> lock(m_recentMutex);
+    Store(trace);
+}
+
+void PipelineTracer::Reset()
+{
+    for (LatencyHistogram& histogram : m_histograms)
+    {
+        histogram.Reset();
+    }
+
+    std::lock_guard<std::mutex> lock(m_recentMutex);
+    std::fill(m_recent.begin(), m_recent.end(), FrameTrace());
+}
+
+std::vector<FrameTrace> PipelineTracer::GetRecentTraces() const
+{
+    std::vector<FrameTrace> traces;
+    {
+        std::lock_guard<std::mutex> lock(m_recentMutex);
+        std::copy_if(m_recent.begin(), m_recent.end(), std::back_inserter(traces), [](const FrameTrace& trace) { return trace.sequence != 0; });
+    }
+    std::sort(traces.begin(), traces.end(), [](const FrameTrace& a, const FrameTrace& b) { return a.sequence < b.sequence; });
+    return traces;
+}
+
+void PipelineTracer::Record(const FrameTrace& trace, PipelineStage first, PipelineStage last)
+{
+    const uint64_t exposure = trace.Get(PipelineStage::Exposure);
+    if (exposure == 0)
+    {
+        return;
+    }
+    for (size_t stage = static_cast<size_t>(first); stage <= static_cast<size_t>(last); ++stage)
+    {
+        const uint64_t stamp = trace.stamps[stage];
+        if (stamp != 0)
+        {
+            // Sensor timestamps may be slightly ahead of the host clock
+            m_histograms[stage].Record(stamp > exposure ? stamp - exposure : 0);
+        }
+    }
+}
+
+void PipelineTracer::Store(const FrameTrace& trace)
+{
+    // The producer and the consumer may store the same frame in any order, keep both parts
+    FrameTrace& slot = m_recent[trace.sequence % kRecentTraceCount];
+    if (slot.sequence != trace.sequence)
+    {
+        slot = trace;
+        return;
+    }
+    for (size_t stage = 0; stage < kPipelineStageCount; ++stage)
+    {
+        if (trace.stamps[stage] != 0)
+        {
+            slot.stamps[stage] = trace.stamps[stage];
+        }
+    }
+}
+
+std::string ToChromeTrace(const std::vector<std::pair<std::string, const PipelineTracer*>>& streams)
+{
+    std::ostringstream json;
+    json.precision(1);
+    json << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool first = true;
+    auto separator = [&]() -> std::ostringstream& {
+        json << (first ? "\n" : ",\n");
+        first = false;
+        return json;
+    };
+
+    for (size_t tid = 0; tid < streams.size(); ++tid)
+    {
+        separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+                    << ",\"args\":{\"name\":\"" << streams[tid].first << "\"}}";
+
+        for (const FrameTrace& trace : streams[tid].second->GetRecentTraces())
+        {
+            // One event per stage, from the previous reached stage. Timestamps in microseconds.
+            uint64_t previous = trace.Get(PipelineStage::Exposure);
+            for (size_t stage = 1; stage < kPipelineStageCount; ++stage)
+            {
+                const uint64_t stamp = trace.stamps[stage];
+                if (stamp == 0 || previous == 0 || stamp < previous)
+                {
+                    continue;
+                }
+                separator() << "{\"name\":\"" << ToString(static_cast<PipelineStage>(stage)) << "\",\"cat\":\"" << streams[tid].first
+                            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+                            << ",\"ts\":" << previous / 10.0 << ",\"dur\":" << (stamp - previous) / 10.0
+                            << ",\"args\":{\"sequence\":" << trace.sequence << "}}";
+                previous = stamp;
+            }
+        }
+    }
+
+    json << "\n]}\n";
+    return json.str();
+}
@@ -0,0 +1,297 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LockProfiler.h"
+
+#ifdef SOLAR_PROFILE_LOCKS
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+    using ThreadClock = HANDLE;
+#else
+    using ThreadClock = clockid_t;
+#endif
+
+    struct ThreadRecord
+    {
+        uint32_t id = 0;
+        std::string name;
+        ThreadClock clock{};
+        bool alive = true;
+        uint64_t wallStart = 0;
+        uint64_t wallEnd = 0;
+        uint64_t cpuStart = 0;
+        uint64_t cpuEnd = 0;
+        std::atomic<uint64_t> waitTotal = 0;
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<LockSiteStats>> sites;
+        std::vector<std::shared_ptr<ThreadRecord>> threads;
+        uint32_t nextThreadId = 1;
+    };
+
+    Registry& GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    thread_local ThreadRecord* t_currentThread = nullptr;
+
+    ThreadClock OpenCurrentThreadClock()
+    {
+#ifdef _WIN32
+        return OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, GetCurrentThreadId());
+#else
+        clockid_t clock = CLOCK_THREAD_CPUTIME_ID;
+        pthread_getcpuclockid(pthread_self(), &clock);
+        return clock;
+#endif
+    }
+
+    void CloseThreadClock(ThreadClock clock)
+    {
+#ifdef _WIN32
+        if (clock)
+        {
+            CloseHandle(clock);
+        }
+#else
+        (void)clock;
+#endif
+    }
+
+    // User and kernel time of a live thread, in hundreds of nanoseconds
+    uint64_t GetCpuTime(ThreadClock clock)
+    {
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+        if (!clock || !GetThreadTimes(clock, &creation, &exit, &kernel, &user))
+        {
+            return 0;
+        }
+        auto toUInt64 = [](const FILETIME& time) { return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+        return toUInt64(kernel) + toUInt64(user);
+#else
+        timespec time;
+        if (clock_gettime(clock, &time) != 0)
+        {
+            return 0;
+        }
+        return static_cast<uint64_t>(time.tv_sec) * 10'000'000 + static_cast<uint64_t>(time.tv_nsec) / 100;
+#endif
+    }
+
+    std::string ThreadName(const Registry& registry, uint32_t id)
+    {
+        if (id == 0)
+        {
+            return "-";
+        }
+        for (const std::shared_ptr<ThreadRecord>& thread : registry.threads)
+        {
+            if (thread->id == id)
+            {
+                return thread->name;
+            }
+        }
+        return "#" + std::to_string(id);
+    }
+
+    double ToMs(uint64_t hns)
+    {
+        return hns / 10'000.0;
+    }
+}
+
+uint64_t LockProfiling::Now()
+{
+    using HundredsOfNanoseconds = std::chrono::duration<int64_t, std::ratio<1, 10'000'000>>;
+    return static_cast<uint64_t>(std::chrono::duration_cast<HundredsOfNanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+std::shared_ptr<LockSiteStats> LockProfiling::RegisterSite(const char* site)
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.sites.push_back(std::make_shared<LockSiteStats>(site));
+    return registry.sites.back();
+}
+
+uint32_t LockProfiling::CurrentThreadId()
+{
+    return t_currentThread ? t_currentThread->id : 0;
+}
+
+void LockProfiling::AddCurrentThreadWait(uint64_t wait)
+{
+    if (t_currentThread)
+    {
+        t_currentThread->waitTotal.fetch_add(wait, std::memory_order_relaxed);
+    }
+}
+
+void LockProfiling::UpdateMax(std::atomic<uint64_t>& maximum, uint64_t value)
+{
+    uint64_t current = maximum.load(std::memory_order_relaxed);
+    while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+ScopedThreadProfile::ScopedThreadProfile(const char* name)
+{
+    auto thread = std::make_shared<ThreadRecord>();
+    thread->name = name;
+    thread->clock = OpenCurrentThreadClock();
+    thread->wallStart = LockProfiling::Now();
+    thread->cpuStart = GetCpuTime(thread->clock);
+
+    Registry& registry = GetRegistry();
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        thread->id = registry.nextThreadId++;
+        registry.threads.push_back(thread);
+    }
+    m_id = thread->id;
+    t_currentThread = thread.get();
+}
+
+ScopedThreadProfile::~ScopedThreadProfile()
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto it = std::find_if(registry.threads.begin(), registry.threads.end(), [this](const std::shared_ptr<ThreadRecord>& thread) { return thread->id == m_id; });
+    if (it != registry.threads.end())
+    {
+        ThreadRecord& thread = **it;
+        thread.wallEnd = LockProfiling::Now();
+        thread.cpuEnd = GetCpuTime(thread.clock);
+        thread.alive = false;
+        CloseThreadClock(thread.clock);
+        thread.clock = ThreadClock{};
+    }
+    t_currentThread = nullptr;
+}
+
+std::string LockProfiler::Report()
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(3);
+
+    // Several instances of the same site (e.g. one per camera reader) are listed separately
+    report << "Lock site | acquisitions | contended | wait total ms | wait max ms | hold total ms | hold max ms | shared | owner | last contender\n";
+    for (const std::shared_ptr<LockSiteStats>& site : registry.sites)
+    {
+        const uint64_t acquisitions = site->acquisitions.load(std::memory_order_relaxed);
+        const uint64_t shared = site->sharedAcquisitions.load(std::memory_order_relaxed);
+        if (acquisitions == 0 && shared == 0)
+        {
+            continue;
+        }
+        report << site->site
+               << " | " << acquisitions
+               << " | " << site->contended.load(std::memory_order_relaxed)
+               << " | " << ToMs(site->waitTotal.load(std::memory_order_relaxed))
+               << " | " << ToMs(site->waitMax.load(std::memory_order_relaxed))
+               << " | " << ToMs(site->holdTotal.load(std::memory_order_relaxed))
+               << " | " << ToMs(site->holdMax.load(std::memory_order_relaxed))
+               << " | " << shared
+               << " | " << ThreadName(registry, site->owner.load(std::memory_order_relaxed))
+               << " | " << ThreadName(registry, site->lastContender.load(std::memory_order_relaxed)) << "\n";
+    }
+
+    // Idle is the wall time neither running nor waiting on a profiled lock (sleep, I/O, sensor waits)
+    report << "\nThread | state | wall ms | cpu ms | cpu % | lock wait ms | idle ms\n";
+    const uint64_t now = LockProfiling::Now();
+    for (const std::shared_ptr<ThreadRecord>& thread : registry.threads)
+    {
+        const uint64_t wall = (thread->alive ? now : thread->wallEnd) - thread->wallStart;
+        const uint64_t cpuEnd = thread->alive ? GetCpuTime(thread->clock) : thread->cpuEnd;
+        const uint64_t cpu = cpuEnd > thread->cpuStart ? cpuEnd - thread->cpuStart : 0;
+        const uint64_t wait = thread->waitTotal.load(std::memory_order_relaxed);
+        const uint64_t busy = cpu + wait;
+        report << thread->name
+               << " | " << (thread->alive ? "running" : "exited")
+               << " | " << ToMs(wall)
+               << " | " << ToMs(cpu)
+               << " | " << std::setprecision(1) << (wall ? 100.0 * cpu / wall : 0.0) << std::setprecision(3)
+               << " | " << ToMs(wait)
+               << " | " << ToMs(wall > busy ? wall - busy : 0) << "\n";
+    }
+    return report.str();
+}
+
+void LockProfiler::Reset()
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    // Sites only referenced by the registry belong to destroyed locks
+    registry.sites.erase(std::remove_if(registry.sites.begin(), registry.sites.end(), [](const std::shared_ptr<LockSiteStats>& site) { return site.use_count() == 1; }), registry.sites.end());
+    for (const std::shared_ptr<LockSiteStats>& site : registry.sites)
+    {
+        site->acquisitions.store(0, std::memory_order_relaxed);
+        site->contended.store(0, std::memory_order_relaxed);
+        site->waitTotal.store(0, std::memory_order_relaxed);
+        site->waitMax.store(0, std::memory_order_relaxed);
+        site->holdTotal.store(0, std::memory_order_relaxed);
+        site->holdMax.store(0, std::memory_order_relaxed);
+        site->sharedAcquisitions.store(0, std::memory_order_relaxed);
+    }
+
+    registry.threads.erase(std::remove_if(registry.threads.begin(), registry.threads.end(), [](const std::shared_ptr<ThreadRecord>& thread) { return !thread->alive; }), registry.threads.end());
+    const uint64_t now = LockProfiling::Now();
+    for (const std::shared_ptr<ThreadRecord>& thread : registry.threads)
+    {
+        thread->wallStart = now;
+        thread->cpuStart = GetCpuTime(thread->clock);
+        thread->waitTotal.store(0, std::memory_order_relaxed);
+    }
+}
+
+#else
+
+std::string LockProfiler::Report()
+{
+    return std::string();
+}
+
+void LockProfiler::Reset()
+{
+}
+
+#endif
@@ -0,0 +1,308 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "NetworkProtocol.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace
+{
+    constexpr uint32_t kBlockSize = 16;
+
+    template <typename T>
+    uint32_t ZigZag(T pixel, T prediction)
+    {
+        using Signed = std::make_signed_t<T>;
+        constexpr int kBits = 8 * sizeof(T);
+        const auto residual = static_cast<Signed>(static_cast<T>(pixel - prediction));
+        return static_cast<T>((static_cast<uint32_t>(residual) << 1) ^ static_cast<uint32_t>(residual >> (kBits - 1)));
+    }
+
+    template <typename T>
+    T UnZigZag(uint32_t value, T prediction)
+    {
+        return static_cast<T>(prediction + static_cast<T>((value >> 1) ^ (0u - (value & 1))));
+    }
+
+    uint32_t BitWidth(uint32_t value)
+    {
+        uint32_t bits = 0;
+        while (value)
+        {
+            bits++;
+            value >>= 1;
+        }
+        return bits;
+    }
+
+    // Block: one byte of bit width, then kBlockSize values of that width, LSB first (2 x width bytes)
+    template <typename T>
+    void Encode(const T* pPixels, uint32_t width, uint32_t rows, std::vector<uint8_t>& encoded)
+    {
+        const size_t count = static_cast<size_t>(width) * rows;
+        encoded.reserve(encoded.size() + count * sizeof(T) + count / kBlockSize + 1);
+
+        uint32_t block[kBlockSize];
+        uint32_t x = 0;
+        for (size_t first = 0; first < count; first += kBlockSize)
+        {
+            const size_t blockCount = std::min<size_t>(kBlockSize, count - first);
+            uint32_t mask = 0;
+            for (size_t i = 0; i < kBlockSize; ++i)
+            {
+                if (i < blockCount)
+                {
+                    const size_t index = first + i;
+                    const T prediction = x > 0 ? pPixels[index - 1] : (index >= width ? pPixels[index - width] : T(0));
+                    block[i] = ZigZag<T>(pPixels[index], prediction);
+                    x = (x + 1 == width) ? 0 : x + 1;
+                }
+                else
+                {
+                    block[i] = 0;
+                }
+                mask |= block[i];
+            }
+
+            const uint32_t bits = BitWidth(mask);
+            encoded.push_back(static_cast<uint8_t>(bits));
+            uint64_t accumulator = 0;
+            uint32_t accumulated = 0;
+            for (uint32_t i = 0; i < kBlockSize; ++i)
+            {
+                accumulator |= static_cast<uint64_t>(block[i]) << accumulated;
+                accumulated += bits;
+                while (accumulated >= 8)
+                {
+                    encoded.push_back(static_cast<uint8_t>(accumulator));
+                    accumulator >>= 8;
+                    accumulated -= 8;
+                }
+            }
+        }
+    }
+
+    template <typename T>
+    bool Decode(const uint8_t* pEncoded, size_t encodedSize, uint32_t width, uint32_t rows, T* pPixels)
+    {
+        const size_t count = static_cast<size_t>(width) * rows;
+        const uint8_t* pEnd = pEncoded + encodedSize;
+        uint32_t x = 0;
+        for (size_t first = 0; first < count; first += kBlockSize)
+        {
+            if (pEncoded == pEnd)
+            {
+                return false;
+            }
+            const uint32_t bits = *pEncoded++;
+            if (bits > 8 * sizeof(T) || static_cast<size_t>(pEnd - pEncoded) < 2 * bits)
+            {
+                return false;
+            }
+
+            const uint8_t* pNextBlock = pEncoded + 2 * bits;
+            const size_t blockCount = std::min<size_t>(kBlockSize, count - first);
+            const uint32_t valueMask = (1u << bits) - 1;
+            uint64_t accumulator = 0;
+            uint32_t accumulated = 0;
+            for (size_t i = 0; i < blockCount; ++i)
+            {
+                while (accumulated < bits)
+                {
+                    accumulator |= static_cast<uint64_t>(*pEncoded++) << accumulated;
+                    accumulated += 8;
+                }
+                const uint32_t value = static_cast<uint32_t>(accumulator) & valueMask;
+                accumulator >>= bits;
+                accumulated -= bits;
+
+                const size_t index = first + i;
+                const T prediction = x > 0 ? pPixels[index - 1] : (index >= width ? pPixels[index - width] : T(0));
+                pPixels[index] = UnZigZag<T>(value, prediction);
+                x = (x + 1 == width) ? 0 : x + 1;
+            }
+            // Skips the padding of the last block
+            pEncoded = pNextBlock;
+        }
+        return pEncoded == pEnd;
+    }
+
+    uint32_t GetBytesPerPixel(NetworkCodec codec)
+    {
+        switch (codec)
+        {
+        case NetworkCodec::Gray8:
+            return 1;
+        case NetworkCodec::Depth16:
+            return 2;
+        default:
+            return 0;
+        }
+    }
+
+    template <typename T>
+    bool ReadPayload(const uint8_t* pPayload, uint32_t payloadSize, T& value)
+    {
+        if (payloadSize != sizeof(T))
+        {
+            return false;
+        }
+        std::memcpy(&value, pPayload, sizeof(T));
+        return true;
+    }
+}
+
+void AppendNetworkMessage(std::vector<uint8_t>& buffer, NetworkMessageType type, SharedStream stream,
+                          uint64_t timestamp, const void* pPayload, size_t payloadSize, NetworkCodec codec)
+{
+    NetworkMessageHeader header;
+    header.type = static_cast<uint16_t>(type);
+    header.codec = static_cast<uint16_t>(codec);
+    header.stream = static_cast<uint32_t>(stream);
+    header.payloadSize = static_cast<uint32_t>(payloadSize);
+    header.timestamp = timestamp;
+
+    const size_t offset = buffer.size();
+    buffer.resize(offset + sizeof(header) + payloadSize);
+    std::memcpy(buffer.data() + offset, &header, sizeof(header));
+    if (payloadSize > 0)
+    {
+        std::memcpy(buffer.data() + offset + sizeof(header), pPayload, payloadSize);
+    }
+}
+
+size_t AppendFrameMessage(std::vector<uint8_t>& buffer, SharedStream stream, const SolARHL2FrameMetadata& metadata,
+                          const uint8_t* pPixels, NetworkCodec codec)
+{
+    if (GetBytesPerPixel(codec) != metadata.bytesPerPixel)
+    {
+        codec = NetworkCodec::Raw;
+    }
+
+    // Header first, its codec and payload size are patched once the pixels are encoded
+    const size_t offset = buffer.size();
+    AppendNetworkMessage(buffer, NetworkMessageType::Frame, stream, metadata.timestamp, &metadata, sizeof(metadata), codec);
+    const size_t pixelsOffset = buffer.size();
+    if (codec != NetworkCodec::Raw)
+    {
+        EncodePixels(codec, pPixels, metadata.width, metadata.height * metadata.planeCount, buffer);
+        if (buffer.size() - pixelsOffset >= metadata.dataSize)
+        {
+            // Noisy image, not worth decoding
+            buffer.resize(pixelsOffset);
+            codec = NetworkCodec::Raw;
+        }
+    }
+    if (codec == NetworkCodec::Raw)
+    {
+        buffer.insert(buffer.end(), pPixels, pPixels + metadata.dataSize);
+    }
+
+    NetworkMessageHeader header;
+    std::memcpy(&header, buffer.data() + offset, sizeof(header));
+    header.codec = static_cast<uint16_t>(codec);
+    header.payloadSize = static_cast<uint32_t>(buffer.size() - offset - sizeof(header));
+    std::memcpy(buffer.data() + offset, &header, sizeof(header));
+    return buffer.size() - pixelsOffset;
+}
+
+void EncodePixels(NetworkCodec codec, const uint8_t* pPixels, uint32_t width, uint32_t rows, std::vector<uint8_t>& encoded)
+{
+    switch (codec)
+    {
+    case NetworkCodec::Gray8:
+        Encode(pPixels, width, rows, encoded);
+        break;
+    case NetworkCodec::Depth16:
+        Encode(reinterpret_cast<const uint16_t*>(pPixels), width, rows, encoded);
+        break;
+    default:
+        // Raw pixels are sent as is
+        break;
+    }
+}
+
+bool DecodePixels(NetworkCodec codec, const uint8_t* pEncoded, size_t encodedSize, uint32_t width, uint32_t rows, uint8_t* pPixels)
+{
+    switch (codec)
+    {
+    case NetworkCodec::Gray8:
+        return Decode(pEncoded, encodedSize, width, rows, pPixels);
+    case NetworkCodec::Depth16:
+        return Decode(pEncoded, encodedSize, width, rows, reinterpret_cast<uint16_t*>(pPixels));
+    default:
+        return false;
+    }
+}
+
+bool ParseNetworkMessage(const NetworkMessageHeader& header, const uint8_t* pPayload, NetworkMessage& message)
+{
+    message.header = header;
+    switch (static_cast<NetworkMessageType>(header.type))
+    {
+    case NetworkMessageType::Hello:
+        return ReadPayload(pPayload, header.payloadSize, message.hello);
+    case NetworkMessageType::FramePose:
+        return ReadPayload(pPayload, header.payloadSize, message.framePose);
+    case NetworkMessageType::HeadPose:
+        return ReadPayload(pPayload, header.payloadSize, message.headPose);
+    case NetworkMessageType::ImuSamples:
+        if (header.payloadSize % sizeof(SharedImuSample) != 0)
+        {
+            return false;
+        }
+        message.imuSamples.resize(header.payloadSize / sizeof(SharedImuSample));
+        if (header.payloadSize > 0)
+        {
+            std::memcpy(message.imuSamples.data(), pPayload, header.payloadSize);
+        }
+        return true;
+    case NetworkMessageType::Frame:
+        break;
+    default:
+        return false;
+    }
+
+    if (header.payloadSize < sizeof(SolARHL2FrameMetadata))
+    {
+        return false;
+    }
+    std::memcpy(&message.frame, pPayload, sizeof(SolARHL2FrameMetadata));
+    const SolARHL2FrameMetadata& frame = message.frame;
+    const uint8_t* pPixels = pPayload + sizeof(SolARHL2FrameMetadata);
+    const size_t pixelsSize = header.payloadSize - sizeof(SolARHL2FrameMetadata);
+    if (frame.dataSize > kMaxNetworkPayloadSize ||
+        static_cast<uint64_t>(frame.width) * frame.height * frame.planeCount * frame.bytesPerPixel != frame.dataSize)
+    {
+        return false;
+    }
+
+    message.pixels.resize(frame.dataSize);
+    const auto codec = static_cast<NetworkCodec>(header.codec);
+    if (codec == NetworkCodec::Raw)
+    {
+        if (pixelsSize != frame.dataSize)
+        {
+            return false;
+        }
+        std::memcpy(message.pixels.data(), pPixels, pixelsSize);
+        return true;
+    }
+    return GetBytesPerPixel(codec) == frame.bytesPerPixel &&
+           DecodePixels(codec, pPixels, pixelsSize, frame.width, frame.height * frame.planeCount, message.pixels.data());
+}
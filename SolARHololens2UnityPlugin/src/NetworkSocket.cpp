@@ -0,0 +1,322 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "NetworkSocket.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+// Winsock is part of WindowsApp.lib, the umbrella library of UWP apps
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketHandle = SOCKET;
+using SocketLength = int;
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketHandle = int;
+using SocketLength = socklen_t;
+#endif
+
+namespace
+{
+#ifdef _WIN32
+    // WSAStartup() once per process, never cleaned up: the DLL may stream until the app exits
+    bool InitializeWinsock()
+    {
+        static const bool initialized = []
+        {
+            WSADATA data;
+            return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        }();
+        return initialized;
+    }
+#else
+    bool InitializeWinsock()
+    {
+        return true;
+    }
+#endif
+
+    SocketHandle ToSocket(intptr_t handle)
+    {
+        return static_cast<SocketHandle>(handle);
+    }
+
+    bool Resolve(const std::string& host, uint16_t port, sockaddr_in& address)
+    {
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        addrinfo* pResult = nullptr;
+        if (getaddrinfo(host.c_str(), nullptr, &hints, &pResult) != 0 || !pResult)
+        {
+            return false;
+        }
+        std::memcpy(&address, pResult->ai_addr, sizeof(address));
+        address.sin_port = htons(port);
+        freeaddrinfo(pResult);
+        return true;
+    }
+
+    bool Poll(SocketHandle socket, short events, uint32_t timeoutMs)
+    {
+#ifdef _WIN32
+        WSAPOLLFD descriptor{ socket, events, 0 };
+        const int result = WSAPoll(&descriptor, 1, timeoutMs > 0 ? static_cast<int>(timeoutMs) : -1);
+#else
+        pollfd descriptor{ socket, events, 0 };
+        const int result = poll(&descriptor, 1, timeoutMs > 0 ? static_cast<int>(timeoutMs) : -1);
+#endif
+        return result > 0;
+    }
+}
+
+NetworkSocket& NetworkSocket::operator=(NetworkSocket&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        m_handle = other.m_handle;
+        other.m_handle = kInvalidHandle;
+    }
+    return *this;
+}
+
+bool NetworkSocket::Listen(uint16_t port)
+{
+    Close();
+    if (!InitializeWinsock())
+    {
+        return false;
+    }
+
+    const SocketHandle socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    m_handle = static_cast<intptr_t>(socket);
+    if (!IsOpen())
+    {
+        return false;
+    }
+    const int reuse = 1;
+    setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(socket, SOMAXCONN) != 0)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool NetworkSocket::Accept(NetworkSocket& client, uint32_t timeoutMs)
+{
+    if (!IsOpen() || !WaitReadable(timeoutMs))
+    {
+        return false;
+    }
+    const SocketHandle socket = accept(ToSocket(m_handle), nullptr, nullptr);
+    NetworkSocket accepted;
+    accepted.m_handle = static_cast<intptr_t>(socket);
+    if (!accepted.IsOpen())
+    {
+        return false;
+    }
+    client = std::move(accepted);
+    return true;
+}
+
+bool NetworkSocket::Connect(const std::string& host, uint16_t port)
+{
+    Close();
+    sockaddr_in address{};
+    if (!InitializeWinsock() || !Resolve(host, port, address))
+    {
+        return false;
+    }
+
+    const SocketHandle socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    m_handle = static_cast<intptr_t>(socket);
+    if (!IsOpen() || connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        Close();
+        return false;
+    }
+    SetNoDelay();
+    return true;
+}
+
+bool NetworkSocket::OpenUdp(uint16_t port, const std::string& host, uint16_t destinationPort)
+{
+    Close();
+    if (!InitializeWinsock())
+    {
+        return false;
+    }
+
+    const SocketHandle socket = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    m_handle = static_cast<intptr_t>(socket);
+    if (!IsOpen())
+    {
+        return false;
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        Close();
+        return false;
+    }
+    // Connected UDP socket: Send() goes to the destination, errors are reported
+    if (!host.empty() &&
+        (!Resolve(host, destinationPort, address) ||
+         connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0))
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool NetworkSocket::Send(const void* pData, size_t size)
+{
+    const char* pBytes = static_cast<const char*>(pData);
+    while (size > 0)
+    {
+#ifdef _WIN32
+        const int sent = send(ToSocket(m_handle), pBytes, static_cast<int>(std::min<size_t>(size, INT32_MAX)), 0);
+#else
+        const ssize_t sent = send(ToSocket(m_handle), pBytes, size, MSG_NOSIGNAL);
+#endif
+        if (sent <= 0)
+        {
+            return false;
+        }
+        pBytes += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool NetworkSocket::Receive(void* pData, size_t size, uint32_t timeoutMs)
+{
+    char* pBytes = static_cast<char*>(pData);
+    while (size > 0)
+    {
+        if (timeoutMs > 0 && !WaitReadable(timeoutMs))
+        {
+            return false;
+        }
+#ifdef _WIN32
+        const int received = recv(ToSocket(m_handle), pBytes, static_cast<int>(std::min<size_t>(size, INT32_MAX)), 0);
+#else
+        const ssize_t received = recv(ToSocket(m_handle), pBytes, size, 0);
+#endif
+        if (received <= 0)
+        {
+            return false;
+        }
+        pBytes += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+size_t NetworkSocket::ReceiveDatagram(void* pData, size_t capacity, uint32_t timeoutMs)
+{
+    if (!IsOpen() || !WaitReadable(timeoutMs))
+    {
+        return 0;
+    }
+    const auto received = recv(ToSocket(m_handle), static_cast<char*>(pData), static_cast<int>(capacity), 0);
+    return received > 0 ? static_cast<size_t>(received) : 0;
+}
+
+void NetworkSocket::SetNoDelay()
+{
+    // Poses and IMU batches are small and latency sensitive, the server batches them itself
+    const int noDelay = 1;
+    setsockopt(ToSocket(m_handle), IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+}
+
+void NetworkSocket::SetSendTimeout(uint32_t timeoutMs)
+{
+#ifdef _WIN32
+    const DWORD timeout = timeoutMs;
+#else
+    const timeval timeout{ static_cast<time_t>(timeoutMs / 1000), static_cast<suseconds_t>((timeoutMs % 1000) * 1000) };
+#endif
+    setsockopt(ToSocket(m_handle), SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+}
+
+void NetworkSocket::SetSendBufferSize(uint32_t size)
+{
+    const int bufferSize = static_cast<int>(size);
+    setsockopt(ToSocket(m_handle), SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&bufferSize), sizeof(bufferSize));
+}
+
+uint16_t NetworkSocket::GetLocalPort() const
+{
+    sockaddr_in address{};
+    SocketLength length = sizeof(address);
+    if (!IsOpen() || getsockname(ToSocket(m_handle), reinterpret_cast<sockaddr*>(&address), &length) != 0)
+    {
+        return 0;
+    }
+    return ntohs(address.sin_port);
+}
+
+void NetworkSocket::Shutdown()
+{
+    if (IsOpen())
+    {
+#ifdef _WIN32
+        shutdown(ToSocket(m_handle), SD_BOTH);
+#else
+        shutdown(ToSocket(m_handle), SHUT_RDWR);
+#endif
+    }
+}
+
+void NetworkSocket::Close()
+{
+    if (!IsOpen())
+    {
+        return;
+    }
+#ifdef _WIN32
+    closesocket(ToSocket(m_handle));
+#else
+    close(ToSocket(m_handle));
+#endif
+    m_handle = kInvalidHandle;
+}
+
+bool NetworkSocket::WaitReadable(uint32_t timeoutMs) const
+{
+    return Poll(ToSocket(m_handle), POLLIN, timeoutMs);
+}
@@ -0,0 +1,109 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "NetworkStreamReceiver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    constexpr uint32_t kHelloTimeoutMs = 2000;
+    // Largest pose message, with room for future fields
+    constexpr size_t kMaxDatagramSize = 1024;
+}
+
+bool NetworkStreamReceiver::Connect(const std::string& host, uint16_t port, uint32_t streamMask)
+{
+    if (!m_socket.Connect(host, port))
+    {
+        return false;
+    }
+
+    NetworkHello hello;
+    hello.streamMask = streamMask;
+    std::vector<uint8_t> message;
+    AppendNetworkMessage(message, NetworkMessageType::Hello, SharedStream::PV, 0, &hello, sizeof(hello));
+    NetworkMessage reply;
+    if (!m_socket.Send(message.data(), message.size()) || !Receive(reply, kHelloTimeoutMs) ||
+        reply.header.type != static_cast<uint16_t>(NetworkMessageType::Hello) || reply.hello.version != NetworkHello::kVersion)
+    {
+        m_socket.Close();
+        return false;
+    }
+    m_availableStreams = reply.hello.streamMask;
+    return true;
+}
+
+bool NetworkStreamReceiver::Receive(NetworkMessage& message, uint32_t timeoutMs)
+{
+    // Only a timeout before the message keeps the connection, the end of stream closes it
+    if (!m_socket.IsOpen() || (timeoutMs > 0 && !m_socket.WaitReadable(timeoutMs)))
+    {
+        return false;
+    }
+    // The rest of the message follows its first byte closely, its own timeout only detects stalls
+    const uint32_t messageTimeoutMs = timeoutMs > 0 ? std::max<uint32_t>(timeoutMs, kHelloTimeoutMs) : 0;
+    NetworkMessageHeader header;
+    if (!m_socket.Receive(&header, sizeof(header), messageTimeoutMs) ||
+        header.magic != NetworkMessageHeader::kMagic || header.payloadSize > kMaxNetworkPayloadSize)
+    {
+        m_socket.Close();
+        return false;
+    }
+    m_payload.resize(header.payloadSize);
+    if (!m_socket.Receive(m_payload.data(), m_payload.size(), messageTimeoutMs) ||
+        !ParseNetworkMessage(header, m_payload.data(), message))
+    {
+        m_socket.Close();
+        return false;
+    }
+    return true;
+}
+
+bool NetworkPoseReceiver::Receive(NetworkMessage& message, uint32_t timeoutMs)
+{
+    m_datagram.resize(kMaxDatagramSize);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (true)
+    {
+        uint32_t remainingMs = 0;
+        if (timeoutMs > 0)
+        {
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline)
+            {
+                return false;
+            }
+            remainingMs = static_cast<uint32_t>(std::max<long long>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count(), 1));
+        }
+        const size_t size = m_socket.ReceiveDatagram(m_datagram.data(), m_datagram.size(), remainingMs);
+        NetworkMessageHeader header;
+        if (size >= sizeof(header))
+        {
+            std::memcpy(&header, m_datagram.data(), sizeof(header));
+            if (header.magic == NetworkMessageHeader::kMagic && header.payloadSize == size - sizeof(header) &&
+                (header.type == static_cast<uint16_t>(NetworkMessageType::FramePose) ||
+                 header.type == static_cast<uint16_t>(NetworkMessageType::HeadPose)) &&
+                ParseNetworkMessage(header, m_datagram.data() + sizeof(header), message))
+            {
+                return true;
+            }
+        }
+    }
+}
@@ -0,0 +1,429 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "NetworkStreamServer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+
+namespace
+{
+    // Period of the checks of the accept thread for exit and disconnected clients
+    constexpr uint32_t kAcceptPollMs = 200;
+    constexpr uint32_t kHelloTimeoutMs = 2000;
+    // IMU sensors deliver batches every few milliseconds
+    constexpr auto kImuPollPeriod = std::chrono::milliseconds(4);
+    // Frames are a few hundred kilobytes, let the kernel buffer a couple of them
+    constexpr uint32_t kSocketSendBufferSize = 1u << 20;
+}
+
+void NetworkStreamServer::AddFrameStream(SharedStream stream, FramePublisher& publisher, NetworkCodec codec)
+{
+    auto frameStream = std::make_unique<FrameStream>();
+    frameStream->stream = stream;
+    frameStream->pPublisher = &publisher;
+    frameStream->codec = codec;
+    m_frameStreams.push_back(std::move(frameStream));
+    m_availableStreams |= GetStreamBit(stream);
+}
+
+void NetworkStreamServer::AddImuStream(SharedStream stream, const ImuSampleRing& samples)
+{
+    auto imuStream = std::make_unique<ImuStream>();
+    imuStream->stream = stream;
+    imuStream->pSamples = &samples;
+    m_imuStreams.push_back(std::move(imuStream));
+    m_availableStreams |= GetStreamBit(stream);
+}
+
+bool NetworkStreamServer::Start(const NetworkStreamSettings& settings)
+{
+    Stop();
+    m_settings = settings;
+    if (!m_listener.Listen(settings.tcpPort))
+    {
+        return false;
+    }
+    if (!settings.udpPoseHost.empty() && !m_udpSocket.OpenUdp(0, settings.udpPoseHost, settings.udpPosePort))
+    {
+        m_listener.Close();
+        return false;
+    }
+
+    m_fExit = false;
+    for (auto& frameStream : m_frameStreams)
+    {
+        const FrameStream* pFrameStream = frameStream.get();
+        frameStream->subscription = frameStream->pPublisher->Subscribe([this, pFrameStream](const SharedFramePtr& frame)
+        {
+            SendFrame(*pFrameStream, *frame);
+        });
+    }
+    for (auto& imuStream : m_imuStreams)
+    {
+        imuStream->lastIndex = imuStream->pSamples->LastIndex();
+    }
+    if (!m_imuStreams.empty())
+    {
+        m_pImuThread = std::make_unique<std::thread>(ImuThread, this);
+    }
+    m_pAcceptThread = std::make_unique<std::thread>(AcceptThread, this);
+    return true;
+}
+
+void NetworkStreamServer::Stop()
+{
+    m_fExit = true;
+    if (m_pAcceptThread && m_pAcceptThread->joinable())
+    {
+        m_pAcceptThread->join();
+    }
+    m_pAcceptThread.reset();
+    // No broadcast after that
+    for (auto& frameStream : m_frameStreams)
+    {
+        frameStream->subscription.reset();
+    }
+    if (m_pImuThread && m_pImuThread->joinable())
+    {
+        m_pImuThread->join();
+    }
+    m_pImuThread.reset();
+
+    std::vector<std::unique_ptr<Client>> clients;
+    {
+        std::lock_guard<ProfiledMutex> guard(m_clientsMutex);
+        clients.swap(m_clients);
+    }
+    for (auto& client : clients)
+    {
+        {
+            std::lock_guard<ProfiledMutex> guard(client->mutex);
+            client->closed = true;
+        }
+        client->condVar.notify_all();
+        client->socket.Shutdown();
+        client->pSenderThread->join();
+    }
+
+    m_listener.Close();
+    m_udpSocket.Close();
+}
+
+void NetworkStreamServer::PublishHeadPose(const SharedHeadPose& pose)
+{
+    if (m_udpSocket.IsOpen())
+    {
+        SendDatagram(NetworkMessageType::HeadPose, SharedStream::HEAD_POSE, pose.timestamp, &pose, sizeof(pose));
+    }
+    if (IsWanted(SharedStream::HEAD_POSE))
+    {
+        auto message = std::make_shared<std::vector<uint8_t>>();
+        AppendNetworkMessage(*message, NetworkMessageType::HeadPose, SharedStream::HEAD_POSE, pose.timestamp, &pose, sizeof(pose));
+        Broadcast(SharedStream::HEAD_POSE, message, false);
+    }
+}
+
+NetworkStreamStats NetworkStreamServer::GetStats()
+{
+    NetworkStreamStats stats;
+    {
+        std::lock_guard<ProfiledMutex> guard(m_clientsMutex);
+        stats.clients = static_cast<uint32_t>(m_clients.size());
+    }
+    stats.sentMessages = m_sentMessages;
+    stats.sentBytes = m_sentBytes;
+    stats.droppedFrames = m_droppedFrames;
+    stats.rawFrameBytes = m_rawFrameBytes;
+    stats.encodedFrameBytes = m_encodedFrameBytes;
+    return stats;
+}
+
+void NetworkStreamServer::SendFrame(const FrameStream& stream, const SharedFrame& frame)
+{
+    const bool wanted = IsWanted(stream.stream);
+    if (!wanted && !m_udpSocket.IsOpen())
+    {
+        return;
+    }
+
+    SolARHL2FrameMetadata metadata{};
+    FillFrameMetadata(frame, stream.stream == SharedStream::PV, metadata);
+    if (m_udpSocket.IsOpen())
+    {
+        NetworkFramePose pose{};
+        pose.sequence = metadata.sequence;
+        std::memcpy(pose.toWorldTransform, metadata.toWorldTransform, sizeof(pose.toWorldTransform));
+        pose.poseValid = metadata.poseValid;
+        SendDatagram(NetworkMessageType::FramePose, stream.stream, metadata.timestamp, &pose, sizeof(pose));
+    }
+    if (wanted)
+    {
+        auto message = std::make_shared<std::vector<uint8_t>>();
+        m_encodedFrameBytes += AppendFrameMessage(*message, stream.stream, metadata, frame.data.data(), stream.codec);
+        m_rawFrameBytes += frame.data.size();
+        Broadcast(stream.stream, message, true);
+    }
+}
+
+bool NetworkStreamServer::IsWanted(SharedStream stream)
+{
+    std::lock_guard<ProfiledMutex> guard(m_clientsMutex);
+    return std::any_of(m_clients.begin(), m_clients.end(), [stream](const std::unique_ptr<Client>& client)
+    {
+        return (client->streamMask & GetStreamBit(stream)) != 0;
+    });
+}
+
+void NetworkStreamServer::Broadcast(SharedStream stream, const MessagePtr& message, bool isFrame)
+{
+    std::lock_guard<ProfiledMutex> guard(m_clientsMutex);
+    for (auto& client : m_clients)
+    {
+        if (client->streamMask & GetStreamBit(stream))
+        {
+            Enqueue(*client, message, isFrame);
+        }
+    }
+}
+
+void NetworkStreamServer::Enqueue(Client& client, const MessagePtr& message, bool isFrame)
+{
+    const size_t size = message->size();
+    {
+        std::lock_guard<ProfiledMutex> guard(client.mutex);
+        if (client.closed)
+        {
+            return;
+        }
+        if (isFrame)
+        {
+            // Oldest frames first, then the new one: the client gets the latest frames it can keep up with
+            while (client.queuedBytes + size > m_settings.maxQueuedBytes)
+            {
+                auto oldestFrame = std::find_if(client.queue.begin(), client.queue.end(), [](const QueuedMessage& queued)
+                {
+                    return queued.isFrame;
+                });
+                if (oldestFrame == client.queue.end())
+                {
+                    break;
+                }
+                client.queuedBytes -= oldestFrame->message->size();
+                client.queue.erase(oldestFrame);
+                m_droppedFrames++;
+            }
+            if (client.queuedBytes + size > m_settings.maxQueuedBytes)
+            {
+                m_droppedFrames++;
+                return;
+            }
+        }
+        else if (client.queuedBytes + size > 2 * m_settings.maxQueuedBytes)
+        {
+            // Not even reading the small messages, the sender thread exits
+            client.closed = true;
+            client.socket.Shutdown();
+            client.condVar.notify_all();
+            return;
+        }
+        client.queue.push_back({ message, isFrame });
+        client.queuedBytes += size;
+    }
+    client.condVar.notify_one();
+}
+
+void NetworkStreamServer::SendDatagram(NetworkMessageType type, SharedStream stream, uint64_t timestamp, const void* pPayload, size_t size)
+{
+    std::lock_guard<ProfiledMutex> guard(m_udpMutex);
+    m_datagram.clear();
+    AppendNetworkMessage(m_datagram, type, stream, timestamp, pPayload, size);
+    // Lost datagrams are not retried, the next pose supersedes them
+    if (m_udpSocket.Send(m_datagram.data(), m_datagram.size()))
+    {
+        m_sentMessages++;
+        m_sentBytes += m_datagram.size();
+    }
+}
+
+void NetworkStreamServer::AcceptThread(NetworkStreamServer* pServer)
+{
+    ScopedThreadProfile profile("NetworkStreamServer::AcceptThread");
+
+    while (!pServer->m_fExit)
+    {
+        // Reap the clients whose sender thread exited
+        std::vector<std::unique_ptr<Client>> closedClients;
+        {
+            std::lock_guard<ProfiledMutex> guard(pServer->m_clientsMutex);
+            auto closed = std::stable_partition(pServer->m_clients.begin(), pServer->m_clients.end(), [](const std::unique_ptr<Client>& client)
+            {
+                std::lock_guard<ProfiledMutex> clientGuard(client->mutex);
+                return !client->closed;
+            });
+            std::move(closed, pServer->m_clients.end(), std::back_inserter(closedClients));
+            pServer->m_clients.erase(closed, pServer->m_clients.end());
+        }
+        for (auto& client : closedClients)
+        {
+            client->condVar.notify_all();
+            client->pSenderThread->join();
+        }
+
+        NetworkSocket socket;
+        if (!pServer->m_listener.Accept(socket, kAcceptPollMs))
+        {
+            continue;
+        }
+
+        NetworkMessageHeader header;
+        NetworkMessage hello;
+        std::vector<uint8_t> payload(sizeof(NetworkHello));
+        if (!socket.Receive(&header, sizeof(header), kHelloTimeoutMs) || header.magic != NetworkMessageHeader::kMagic ||
+            header.type != static_cast<uint16_t>(NetworkMessageType::Hello) || header.payloadSize != sizeof(NetworkHello) ||
+            !socket.Receive(payload.data(), payload.size(), kHelloTimeoutMs) ||
+            !ParseNetworkMessage(header, payload.data(), hello) || hello.hello.version != NetworkHello::kVersion)
+        {
+            continue;
+        }
+        {
+            std::lock_guard<ProfiledMutex> guard(pServer->m_clientsMutex);
+            if (pServer->m_clients.size() >= pServer->m_settings.maxClients)
+            {
+                continue;
+            }
+        }
+
+        NetworkHello reply;
+        reply.streamMask = pServer->m_availableStreams;
+        std::vector<uint8_t> replyMessage;
+        AppendNetworkMessage(replyMessage, NetworkMessageType::Hello, SharedStream::PV, 0, &reply, sizeof(reply));
+        if (!socket.Send(replyMessage.data(), replyMessage.size()))
+        {
+            continue;
+        }
+
+        auto client = std::make_unique<Client>();
+        client->streamMask = (hello.hello.streamMask != 0 ? hello.hello.streamMask : ~0u) & pServer->m_availableStreams;
+        socket.SetNoDelay();
+        socket.SetSendTimeout(kSendTimeoutMs);
+        socket.SetSendBufferSize(kSocketSendBufferSize);
+        client->socket = std::move(socket);
+        client->pSenderThread = std::make_unique<std::thread>(SenderThread, pServer, client.get());
+        std::lock_guard<ProfiledMutex> guard(pServer->m_clientsMutex);
+        pServer->m_clients.push_back(std::move(client));
+    }
+}
+
+void NetworkStreamServer::SenderThread(NetworkStreamServer* pServer, Client* pClient)
+{
+    ScopedThreadProfile profile("NetworkStreamServer::SenderThread");
+
+    std::vector<uint8_t> batch;
+    batch.reserve(kMaxBatchBytes);
+    uint64_t batchMessages = 0;
+    MessagePtr largeMessage;
+    bool connected = true;
+    while (connected)
+    {
+        // Take either a batch of small messages or one large message, the rest stays droppable
+        {
+            std::unique_lock<ProfiledMutex> lock(pClient->mutex);
+            pClient->condVar.wait(lock, [pClient] { return pClient->closed || !pClient->queue.empty(); });
+            if (pClient->closed)
+            {
+                break;
+            }
+            while (!pClient->queue.empty())
+            {
+                const MessagePtr& message = pClient->queue.front().message;
+                if (message->size() >= kMaxBatchBytes)
+                {
+                    if (!batch.empty())
+                    {
+                        break;
+                    }
+                    largeMessage = message;
+                }
+                else if (batch.size() + message->size() > kMaxBatchBytes)
+                {
+                    break;
+                }
+                else
+                {
+                    batch.insert(batch.end(), message->begin(), message->end());
+                    batchMessages++;
+                }
+                pClient->queuedBytes -= message->size();
+                pClient->queue.pop_front();
+                if (largeMessage)
+                {
+                    break;
+                }
+            }
+        }
+
+        const std::vector<uint8_t>& data = largeMessage ? *largeMessage : batch;
+        connected = pClient->socket.Send(data.data(), data.size());
+        pServer->m_sentMessages += largeMessage ? 1 : batchMessages;
+        pServer->m_sentBytes += data.size();
+        largeMessage.reset();
+        batch.clear();
+        batchMessages = 0;
+    }
+
+    std::lock_guard<ProfiledMutex> guard(pClient->mutex);
+    pClient->closed = true;
+    pClient->queue.clear();
+    pClient->queuedBytes = 0;
+}
+
+void NetworkStreamServer::ImuThread(NetworkStreamServer* pServer)
+{
+    ScopedThreadProfile profile("NetworkStreamServer::ImuThread");
+
+    while (!pServer->m_fExit)
+    {
+        for (auto& imuStream : pServer->m_imuStreams)
+        {
+            imuStream->samples.clear();
+            imuStream->pSamples->Read(imuStream->lastIndex, imuStream->samples);
+            if (imuStream->samples.empty())
+            {
+                continue;
+            }
+            imuStream->lastIndex = imuStream->samples.back().index;
+            if (!pServer->IsWanted(imuStream->stream))
+            {
+                continue;
+            }
+
+            imuStream->batch.clear();
+            for (const ImuSample& sample : imuStream->samples)
+            {
+                imuStream->batch.push_back({ sample.index, sample.timestamp, sample.sensorTicks,
+                                             sample.x, sample.y, sample.z, sample.temperature });
+            }
+            auto message = std::make_shared<std::vector<uint8_t>>();
+            AppendNetworkMessage(*message, NetworkMessageType::ImuSamples, imuStream->stream, imuStream->batch.back().timestamp,
+                                 imuStream->batch.data(), imuStream->batch.size() * sizeof(SharedImuSample));
+            pServer->Broadcast(imuStream->stream, message, false);
+        }
+        std::this_thread::sleep_for(kImuPollPeriod);
+    }
+}
@@ -0,0 +1,120 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PluginApiStream.h"
+
+#include <algorithm>
+#include <vector>
+
+struct SolARHL2Stream
+{
+    SolARHL2StreamId streamId = SOLARHL2_STREAM_PV;
+    std::shared_ptr<FrameSubscriber> subscriber;
+    // Frames handed out to the caller, indexed by SolARHL2Frame::slot, nullptr if free
+    std::vector<SharedFramePtr> acquiredFrames;
+};
+
+namespace
+{
+    constexpr uint32_t kDefaultMaxAcquiredFrames = 2;
+}
+
+SolARHL2Result CreatePluginApiStream(
+    SolARHL2StreamId streamId, std::shared_ptr<FrameSubscriber> subscriber, uint32_t maxAcquiredFrames, SolARHL2Stream** stream)
+{
+    if (!stream || !subscriber)
+    {
+        return SOLARHL2_INVALID_ARGUMENT;
+    }
+
+    auto handle = std::make_unique<SolARHL2Stream>();
+    handle->streamId = streamId;
+    handle->subscriber = std::move(subscriber);
+    handle->acquiredFrames.resize(maxAcquiredFrames > 0 ? maxAcquiredFrames : kDefaultMaxAcquiredFrames);
+    *stream = handle.release();
+    return SOLARHL2_OK;
+}
+
+uint32_t SOLARHL2_API SolARHL2_GetApiVersion(void)
+{
+    return SOLARHL2_API_VERSION;
+}
+
+void SOLARHL2_API SolARHL2_CloseStream(SolARHL2Stream* stream)
+{
+    if (!stream)
+    {
+        return;
+    }
+    // The publisher drops its weak reference on the next frame
+    stream->subscriber->Close();
+    delete stream;
+}
+
+SolARHL2Result SOLARHL2_API SolARHL2_AcquireFrame(SolARHL2Stream* stream, uint32_t timeoutMs, SolARHL2Frame* frame)
+{
+    if (!stream || !frame)
+    {
+        return SOLARHL2_INVALID_ARGUMENT;
+    }
+
+    // Find a slot first, so that a popped frame is never lost
+    auto slot = std::find(stream->acquiredFrames.begin(), stream->acquiredFrames.end(), nullptr);
+    if (slot == stream->acquiredFrames.end())
+    {
+        return SOLARHL2_TOO_MANY_FRAMES;
+    }
+
+    SharedFramePtr sharedFrame;
+    const bool popped = (timeoutMs == 0) ? stream->subscriber->TryPop(sharedFrame)
+                                         : stream->subscriber->WaitPop(sharedFrame, timeoutMs);
+    if (!popped)
+    {
+        return stream->subscriber->IsClosed() ? SOLARHL2_STREAM_CLOSED : SOLARHL2_NO_FRAME;
+    }
+
+    FillFrameMetadata(*sharedFrame, stream->streamId == SOLARHL2_STREAM_PV, frame->metadata);
+    frame->data = sharedFrame->data.data();
+    frame->slot = static_cast<uint32_t>(slot - stream->acquiredFrames.begin());
+    frame->reserved = 0;
+    *slot = std::move(sharedFrame);
+    return SOLARHL2_OK;
+}
+
+void SOLARHL2_API SolARHL2_ReleaseFrame(SolARHL2Stream* stream, SolARHL2Frame* frame)
+{
+    if (!stream || !frame || frame->slot >= stream->acquiredFrames.size())
+    {
+        return;
+    }
+    // Last reference returns the buffer to the pool of the stream
+    stream->acquiredFrames[frame->slot].reset();
+    frame->data = nullptr;
+}
+
+SolARHL2Result SOLARHL2_API SolARHL2_GetStreamStats(SolARHL2Stream* stream, SolARHL2StreamStats* stats)
+{
+    if (!stream || !stats)
+    {
+        return SOLARHL2_INVALID_ARGUMENT;
+    }
+    stats->received = stream->subscriber->GetReceivedCount();
+    stats->dropped = stream->subscriber->GetDroppedCount();
+    stats->acquired = static_cast<uint32_t>(stream->acquiredFrames.size() -
+        std::count(stream->acquiredFrames.begin(), stream->acquiredFrames.end(), nullptr));
+    stats->reserved = 0;
+    return SOLARHL2_OK;
+}
@@ -0,0 +1,119 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PoseLogWriter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // "%g" of a float is at most 13 characters (e.g. "-1.17549e-38"), plus the separator
+    constexpr size_t kMaxValueLength = 16;
+    constexpr size_t kMaxTimestampLength = 24;
+}
+
+PoseLogWriter::PoseLogWriter(size_t chunkSize)
+    : m_chunk(std::max(chunkSize, kMaxTimestampLength + kMaxValueCount * kMaxValueLength + 1))
+{
+}
+
+bool PoseLogWriter::Open(const std::filesystem::path& path)
+{
+    Close();
+    // Text mode, as the in-memory logs were written
+    m_file.open(path, std::ios::out | std::ios::trunc);
+    m_lineCount = 0;
+    return m_file.is_open();
+}
+
+void PoseLogWriter::Close()
+{
+    if (m_file.is_open())
+    {
+        WriteChunk();
+        m_file.close();
+    }
+    m_chunkUsed = 0;
+}
+
+void PoseLogWriter::WriteLine(const std::string& line)
+{
+    if (!m_file.is_open())
+    {
+        return;
+    }
+
+    if (line.size() + 1 > m_chunk.size())
+    {
+        // Longer than a chunk, bypass it
+        WriteChunk();
+        m_file << line << "\n";
+        m_file.flush();
+    }
+    else
+    {
+        char* pLine = Reserve(line.size() + 1);
+        std::memcpy(pLine, line.data(), line.size());
+        pLine[line.size()] = '\n';
+        m_chunkUsed += line.size() + 1;
+    }
+    m_lineCount++;
+}
+
+void PoseLogWriter::WriteRecord(int64_t timestamp, const float* values, size_t count)
+{
+    assert(count <= kMaxValueCount);
+    if (!m_file.is_open())
+    {
+        return;
+    }
+    count = std::min(count, kMaxValueCount);
+
+    const size_t maxLength = kMaxTimestampLength + count * kMaxValueLength + 1;
+    char* pRecord = Reserve(maxLength);
+    int length = std::snprintf(pRecord, maxLength, "%lld", static_cast<long long>(timestamp));
+    for (size_t i = 0; i < count; ++i)
+    {
+        length += std::snprintf(pRecord + length, maxLength - length, ",%g", values[i]);
+    }
+    pRecord[length++] = '\n';
+
+    m_chunkUsed += length;
+    m_lineCount++;
+}
+
+char* PoseLogWriter::Reserve(size_t size)
+{
+    if (m_chunkUsed + size > m_chunk.size())
+    {
+        WriteChunk();
+    }
+    return m_chunk.data() + m_chunkUsed;
+}
+
+void PoseLogWriter::WriteChunk()
+{
+    if (m_chunkUsed == 0)
+    {
+        return;
+    }
+    m_file.write(m_chunk.data(), m_chunkUsed);
+    m_file.flush();
+    m_chunkUsed = 0;
+}
@@ -26,79 +26,46 @@
 //*********************************************************
 
 #include "RMCameraReader.h"
-#include "Utils.h"
+#include "PoseConversion.h"
 
 #include <sstream>
 #include <iostream>
 
-using namespace bcom::hololensdemo;
 
 using namespace winrt::Windows::Perception;
 using namespace winrt::Windows::Perception::Spatial;
 using namespace winrt::Windows::Foundation::Numerics;
 using namespace winrt::Windows::Storage;
 
-using winrt::com_array;
-
-namespace Depth
-{
-    enum InvalidationMasks
-    {
-        Invalid = 0x80,
-    };
-    static constexpr UINT16 AHAT_INVALID_VALUE = 4090;
-}
-
-bool RMCameraReader::start()
-{
-    if (m_pCameraUpdateThread || m_pWriteThread)
-    {
-        // Already started, or not stopped yet
-        return false;
-    }
-
-    if (!m_pCameraUpdateThread)
-    {
-        m_fExit = false;
-		m_pCameraUpdateThread = std::make_unique<std::thread>(CameraUpdateThread,
-                                                                this,
-                                                                m_camConsentGiven,
-                                                                m_camAccessConsent);
-    }
-
-    if (m_storageFolder && !m_pWriteThread)
-    {
-        m_pWriteThread = std::make_unique<std::thread>(CameraWriteThread, this);
-    }
-
-    return true;
-}
-
 void RMCameraReader::stop()
 {
     if (m_pCameraUpdateThread)
     {
         m_fExit = true;
+        {
+            // Take the lock so that a waiter cannot miss the notification between
+            // checking m_fExit and going to sleep
+            std::lock_guard<ProfiledMutex> reader_guard(m_sensorFrameMutex);
+        }
+        m_frameCondVar.notify_all();
         m_pCameraUpdateThread->join();
         m_pCameraUpdateThread = nullptr;
     }
 
-    if (m_pWriteThread)
-    {
-        m_pWriteThread->join();
-        m_pWriteThread = nullptr;
-    }
+    // No write task is scheduled once the update thread is joined
+    m_isRecording = false;
+    m_writeQueue.Wait();
 }
 
-void RMCameraReader::CameraUpdateThread(RMCameraReader* pCameraReader, HANDLE camConsentGiven, ResearchModeSensorConsent* camAccessConsent)
+bool RMCameraReader::WaitForConsentAndOpenStream()
 {
 	HRESULT hr = S_OK;
 
-    DWORD waitResult = WaitForSingleObject(camConsentGiven, INFINITE);
+    DWORD waitResult = WaitForSingleObject(m_camConsentGiven, INFINITE);
 
     if (waitResult == WAIT_OBJECT_0)
     {
-        switch (*camAccessConsent)
+        switch (*m_camAccessConsent)
         {
         case ResearchModeSensorConsent::Allowed:
             OutputDebugString(L"Access is granted");
@@ -130,105 +97,75 @@ void RMCameraReader::CameraUpdateThread(RMCameraReader* pCameraReader, HANDLE ca
         hr = E_UNEXPECTED;
     }
 
-    if (SUCCEEDED(hr))
+    if (FAILED(hr))
     {
-        hr = pCameraReader->m_pRMSensor->OpenStream();
-
-        if (FAILED(hr))
-        {
-            pCameraReader->m_pRMSensor->Release();
-            pCameraReader->m_pRMSensor = nullptr;
-        }
+        return false;
+    }
 
-        while (!pCameraReader->m_fExit && pCameraReader->m_pRMSensor)
-        {
-            HRESULT hr = S_OK;
-            IResearchModeSensorFrame* pSensorFrame = nullptr;
+    hr = m_pRMSensor->OpenStream();
 
-            hr = pCameraReader->m_pRMSensor->GetNextBuffer(&pSensorFrame);
+    if (FAILED(hr))
+    {
+        m_pRMSensor->Release();
+        m_pRMSensor = nullptr;
+        return false;
+    }
 
-            if (SUCCEEDED(hr))
-            {
-                std::lock_guard<std::mutex> guard(pCameraReader->m_sensorFrameMutex);
-                if (pCameraReader->m_pSensorFrame)
-                {
-                    pCameraReader->m_pSensorFrame->Release();
-                }
-                pCameraReader->m_pSensorFrame = pSensorFrame;
-                pCameraReader->updateFrameLocation();
-            }
-        }
+    return true;
+}
 
-        pCameraReader->m_worldCoordSystem = nullptr;
+void RMCameraReader::CloseStream()
+{
+    m_worldCoordSystem = nullptr;
 
-        if (pCameraReader->m_pRMSensor)
-        {
-            pCameraReader->m_pRMSensor->CloseStream();
-        }
+    if (m_pRMSensor)
+    {
+        m_pRMSensor->CloseStream();
     }
 }
 
-void RMCameraReader::CameraWriteThread(RMCameraReader* pReader)
+void RMCameraReader::CacheResolution(IResearchModeSensorFrame* pSensorFrame)
 {
-    while (!pReader->m_fExit)
+    // Resolution is fixed for a given stream, only query it for the first frame
+    if (m_hasResolution)
     {
-        std::unique_lock<std::mutex> storage_lock(pReader->m_storageMutex);
-        assert(pReader->m_storageFolder);
-        //if (pReader->m_storageFolder == nullptr)
-        //{
-        //    pReader->m_storageCondVar.wait(storage_lock);
-        //}
-        
-        std::lock_guard<std::mutex> reader_guard(pReader->m_sensorFrameMutex);
-        if (pReader->m_pSensorFrame)
-        {
-            if (pReader->IsNewTimestamp(pReader->m_pSensorFrame))
-            {
-                pReader->SaveFrame(pReader->m_pSensorFrame);
-            }
-        }       
-    }	
+        return;
+    }
+
+    if (SUCCEEDED(pSensorFrame->GetResolution(&m_resolution)))
+    {
+        m_hasResolution = true;
+    }
 }
 
-void RMCameraReader::DumpCalibration()
-{   
-    // Get frame resolution (could also be stored once at the beginning of the capture)
-    ResearchModeSensorResolution resolution;
+bool RMCameraReader::getCalibration(float extrinsics[16], std::vector<float>& rays)
+{
+    if (!m_hasResolution)
     {
-        std::lock_guard<std::mutex> guard(m_sensorFrameMutex);
-        // Assuming we are at the end of the capture
-        assert(m_pSensorFrame != nullptr);
-        winrt::check_hresult(m_pSensorFrame->GetResolution(&resolution)); 
+        return false;
     }
+    const ResearchModeSensorResolution resolution = m_resolution;
 
     // Get camera sensor object
-    IResearchModeCameraSensor* pCameraSensor = nullptr;    
+    IResearchModeCameraSensor* pCameraSensor = nullptr;
     HRESULT hr = m_pRMSensor->QueryInterface(IID_PPV_ARGS(&pCameraSensor));
     winrt::check_hresult(hr);
 
     // Get extrinsics (rotation and translation) with respect to the rigNode
-    wchar_t outputExtrinsicsPath[MAX_PATH] = {};
-    swprintf_s(outputExtrinsicsPath, L"%s\\%s_extrinsics.txt", m_storageFolder.Path().data(), m_pRMSensor->GetFriendlyName());
-
-    std::ofstream fileExtrinsics(outputExtrinsicsPath);
     DirectX::XMFLOAT4X4 cameraViewMatrix;
-
     pCameraSensor->GetCameraExtrinsicsMatrix(&cameraViewMatrix);
+    for (size_t row = 0; row < 4; row++)
+    {
+        for (size_t col = 0; col < 4; col++)
+        {
+            extrinsics[row * 4 + col] = cameraViewMatrix.m[col][row];
+        }
+    }
 
-    fileExtrinsics << cameraViewMatrix.m[0][0] << "," << cameraViewMatrix.m[1][0] << "," << cameraViewMatrix.m[2][0] << "," << cameraViewMatrix.m[3][0] << "," 
-                   << cameraViewMatrix.m[0][1] << "," << cameraViewMatrix.m[1][1] << "," << cameraViewMatrix.m[2][1] << "," << cameraViewMatrix.m[3][1] << "," 
-                   << cameraViewMatrix.m[0][2] << "," << cameraViewMatrix.m[1][2] << "," << cameraViewMatrix.m[2][2] << "," << cameraViewMatrix.m[3][2] << "," 
-                   << cameraViewMatrix.m[0][3] << "," << cameraViewMatrix.m[1][3] << "," << cameraViewMatrix.m[2][3] << "," << cameraViewMatrix.m[3][3] << "\n";
-    
-    fileExtrinsics.close();
-
-    wchar_t outputPath[MAX_PATH] = {};    
-    swprintf_s(outputPath, L"%s\\%s_lut.bin", m_storageFolder.Path().data(), m_pRMSensor->GetFriendlyName());
-    
     float uv[2];
     float xy[2];
-    std::vector<float> lutTable(size_t(resolution.Width * resolution.Height) * 3);
-    auto pLutTable = lutTable.data();
+    rays.resize(size_t(resolution.Width * resolution.Height) * 3);
+    auto pLutTable = rays.data();
 
     for (size_t y = 0; y < resolution.Height; y++)
     {
@@ -256,50 +193,47 @@ void RMCameraReader::DumpCalibration()
             *pLutTable++ = xy[1];
             *pLutTable++ = z;
         }
-    }    
+    }
     pCameraSensor->Release();
-
-    // Save binary LUT to disk
-    std::ofstream file(outputPath, std::ios::out | std::ios::binary);
-	file.write(reinterpret_cast<char*> (lutTable.data()), lutTable.size() * sizeof(float));
-    file.close();
+    return true;
 }
 
-void RMCameraReader::DumpFrameLocations()
-{
-    wchar_t outputPath[MAX_PATH] = {};
-    swprintf_s(outputPath, L"%s\\%s_rig2world.txt", m_storageFolder.Path().data(), m_pRMSensor->GetFriendlyName());
-    
-    std::ofstream file(outputPath);
-    for (const FrameLocation& location : m_frameLocations)
+void RMCameraReader::DumpCalibration()
+{   
+    // Assuming we are at the end of the capture, resolution has been cached with the first frame
+    assert(m_hasResolution);
+    float extrinsics[16];
+    std::vector<float> lutTable;
+    if (!getCalibration(extrinsics, lutTable))
     {
-        file << location.timestamp << "," <<
-            location.rigToWorldtransform.m11 << "," << location.rigToWorldtransform.m21 << "," << location.rigToWorldtransform.m31 << "," << location.rigToWorldtransform.m41 << "," <<
-            location.rigToWorldtransform.m12 << "," << location.rigToWorldtransform.m22 << "," << location.rigToWorldtransform.m32 << "," << location.rigToWorldtransform.m42 << "," <<
-            location.rigToWorldtransform.m13 << "," << location.rigToWorldtransform.m23 << "," << location.rigToWorldtransform.m33 << "," << location.rigToWorldtransform.m43 << "," <<
-            location.rigToWorldtransform.m14 << "," << location.rigToWorldtransform.m24 << "," << location.rigToWorldtransform.m34 << "," << location.rigToWorldtransform.m44 << std::endl;
+        return;
     }
-    file.close();
 
-    m_frameLocations.clear();
+    wchar_t outputExtrinsicsPath[MAX_PATH] = {};
+    swprintf_s(outputExtrinsicsPath, L"%s\\%s_extrinsics.txt", m_storageFolder.Path().data(), m_pRMSensor->GetFriendlyName());
+
+    std::ofstream fileExtrinsics(outputExtrinsicsPath);
+    for (size_t i = 0; i < 16; i++)
+    {
+        fileExtrinsics << extrinsics[i] << (i < 15 ? "," : "\n");
+    }
+    fileExtrinsics.close();
+
+    wchar_t outputPath[MAX_PATH] = {};    
+    swprintf_s(outputPath, L"%s\\%s_lut.bin", m_storageFolder.Path().data(), m_pRMSensor->GetFriendlyName());
+
+    // Save binary LUT to disk
+    std::ofstream file(outputPath, std::ios::out | std::ios::binary);
+	file.write(reinterpret_cast<char*> (lutTable.data()), lutTable.size() * sizeof(float));
+    file.close();
 }
 
 bool RMCameraReader::computeIntrinsics( float& fx, float& fy, float& cx, float& cy, float& avgReprojErr )
 {
-  // TODO: use a code similar to the following one to get resolution dynamically
-  // This does not work currently because camera must be started for m_pSensorFrame to
-  // hold a value.
-  // Get frame resolution (could also be stored once at the beginning of the capture)
-  // ResearchModeSensorResolution resolution;
-  //{
-  //  std::lock_guard<std::mutex> guard( m_sensorFrameMutex );
-  //  // Assuming we are at the end of the capture
-  //  assert( m_pSensorFrame != nullptr );
-  //  winrt::check_hresult( m_pSensorFrame->GetResolution( &resolution ) );
-  //}
-
-  size_t sensorFrameWidth = 640;
-  size_t sensorFrameHeight = 480;
+  // Resolution is only known once the camera has been started and delivered a frame,
+  // fall back to the VLC resolution otherwise.
+  size_t sensorFrameWidth = m_hasResolution ? m_resolution.Width : 640;
+  size_t sensorFrameHeight = m_hasResolution ? m_resolution.Height : 480;
 
   // Get camera sensor object
   IResearchModeCameraSensor* pCameraSensor = nullptr;
@@ -406,412 +340,80 @@ bool RMCameraReader::computeIntrinsics( float& fx, float& fy, float& cx, float&
   return true;
 }
 
-winrt::com_array<uint8_t> RMCameraReader::getVlcSensorData(uint64_t& timestamp, winrt::com_array<double>& PVtoWorldtransform, uint32_t& pixelBufferSize, uint32_t& width, uint32_t& height, bool flip)
+uint32_t RMCameraReader::getWidth() const
 {
-    std::lock_guard<std::mutex> reader_guard(m_sensorFrameMutex);
-    // Call this only to update m_prevTimestamp
-    IsNewTimestamp( m_pSensorFrame );
-    if ( m_pSensorFrame )
-    {
-        timestamp = static_cast<uint64_t>(m_prevTimestamp);
-
-        // TODO(jmhenaff): convert frame
-        // Copy last frame, release mutex and process afterwards ?
-
-        IResearchModeSensorVLCFrame* pVLCFrame = nullptr;
-        auto hr = m_pSensorFrame->QueryInterface(IID_PPV_ARGS(&pVLCFrame));
-        if (FAILED(hr))
-        {
-            // TODO(jmhenaff): handle error, depth frame
-            throw std::runtime_error("Cannot call 'getVlcSensorData()' on a camera reader assigned to a non-VLC sensor");
-            // return winrt::com_array<uint8_t>();
-        }
-
-        //// TODO(jmhenaff): do something with this?
-        //UINT32 gain = 0;
-        //UINT64 exposure = 0;
-        //pVLCFrame->GetGain(&gain);
-        //pVLCFrame->GetExposure(&exposure);
-
-        ResearchModeSensorResolution resolution;
-        winrt::check_hresult(m_pSensorFrame->GetResolution(&resolution));
-
-        // Get data buffer (8 bits grayscale)
-        const BYTE* pImage = nullptr;
-        size_t outBufferCount = 0;
-        winrt::check_hresult(pVLCFrame->GetBuffer(&pImage, &outBufferCount));
-        pVLCFrame->Release();
-
-        assert(outBufferCount == resolution.Width * resolution.Height);
-
-        // Solution 1
-        //// Convert to grayscale RGB8 (32 bits)
-        //com_array<UINT8> tempBuffer(resolution.Width * resolution.Height * 3);
-        //for (UINT y = 0; y < resolution.Height; ++y)
-        //{
-        //    for (UINT x = 0; x < resolution.Width; ++x)
-        //    {
-        //        BYTE inputPixel = pImage[resolution.Width * y + x];
-        //        tempBuffer[resolution.Width * y + x] = inputPixel;
-        //        tempBuffer[resolution.Width * y + x + 1] = inputPixel;
-        //        tempBuffer[resolution.Width * y + x + 2] = inputPixel;
-        //    }
-        //}
-
-        width = resolution.Width;
-        height = resolution.Height;
-        pixelBufferSize = resolution.Width * resolution.Height;
-
-        //// Solution 2 - let caller convert it to RGB texture
-        //// Copy grayscale image as single channel 8 bit format
-        com_array<UINT8> tempBuffer(outBufferCount);
-        if ( !flip )
-        {
-          for ( int i = 0; i < outBufferCount; ++i )
-          {
-            tempBuffer[i] = pImage[i];
-          }
-        }
-        else
-        {
-          for ( int x = 0; x < width; x++ )
-          {
-            for ( int y = 0; y < height; y++ )
-            {
-              tempBuffer[x + y * width] = pImage[x + ( height - y - 1 ) * width];
-            }
-          }
-        }
-
-        // Matrix needs to be transposed for SolAR
-        std::array<double, 16> VLCtoWorldtransform_values;
-        VLCtoWorldtransform_values[0] = m_frameLocation.rigToWorldtransform.m11;
-        VLCtoWorldtransform_values[1] = m_frameLocation.rigToWorldtransform.m21;
-        VLCtoWorldtransform_values[2] = m_frameLocation.rigToWorldtransform.m31;
-        VLCtoWorldtransform_values[3] = m_frameLocation.rigToWorldtransform.m41;
-        VLCtoWorldtransform_values[4] = m_frameLocation.rigToWorldtransform.m12;
-        VLCtoWorldtransform_values[5] = m_frameLocation.rigToWorldtransform.m22;
-        VLCtoWorldtransform_values[6] = m_frameLocation.rigToWorldtransform.m32;
-        VLCtoWorldtransform_values[7] = m_frameLocation.rigToWorldtransform.m42;
-        VLCtoWorldtransform_values[8] = m_frameLocation.rigToWorldtransform.m13;
-        VLCtoWorldtransform_values[9] = m_frameLocation.rigToWorldtransform.m23;
-        VLCtoWorldtransform_values[10] = m_frameLocation.rigToWorldtransform.m33;
-        VLCtoWorldtransform_values[11] = m_frameLocation.rigToWorldtransform.m43;
-        VLCtoWorldtransform_values[12] = m_frameLocation.rigToWorldtransform.m14;
-        VLCtoWorldtransform_values[13] = m_frameLocation.rigToWorldtransform.m24;
-        VLCtoWorldtransform_values[14] = m_frameLocation.rigToWorldtransform.m34;
-        VLCtoWorldtransform_values[15] = m_frameLocation.rigToWorldtransform.m44;
-
-
-        std::array<double, 16> PVLCtoWorldtransformSolar_values;
-        PVLCtoWorldtransformSolar_values.fill(0);
-        
-        // Utils::convertToSolARPose(VLCtoWorldtransform_values, PVLCtoWorldtransformSolar_values);
-        PVLCtoWorldtransformSolar_values = VLCtoWorldtransform_values;
-
-        // PVtoWorldtransform = com_array<double>(std::move_iterator(VLCtoWorldtransform_values), std::move_iterator(VLCtoWorldtransform_values + 16 * sizeof(double)));
-        PVtoWorldtransform = com_array<double>(PVLCtoWorldtransformSolar_values.begin(), PVLCtoWorldtransformSolar_values.end());
-
-        return tempBuffer;
-        // com_array<UINT8> tempBuffer = com_array<UINT8>(std::move_iterator(pImage), std::move_iterator(pImage + outBufferCount));
-        
-    }
-
-    return winrt::com_array<uint8_t>();
+    return m_hasResolution ? m_resolution.Width : 0;
 }
 
-winrt::com_array<uint16_t> RMCameraReader::getDepthSensorData(uint64_t& timestamp, winrt::com_array<double>& PVtoWorldtransform, uint32_t& pixelBufferSize, uint32_t& width, uint32_t& height)
+uint32_t RMCameraReader::getHeight() const
 {
-  std::lock_guard<std::mutex> reader_guard(m_sensorFrameMutex);
-  if ( m_pSensorFrame && IsNewTimestamp( m_pSensorFrame ) )
-    {
-        timestamp = static_cast<uint64_t>(m_prevTimestamp);
-
-        IResearchModeSensorDepthFrame* pDepthFrame = nullptr;
-        auto hr = m_pSensorFrame->QueryInterface(IID_PPV_ARGS(&pDepthFrame));
-        if (FAILED(hr))
-        {
-            // TODO(jmhenaff): find better design if possible (introduce sensor reader types to rely on polymorphism, or anything else...
-            throw std::runtime_error("Cannot call 'getDepthSensorData()' on a camera reader assigned to a non-depth sensor");
-            //return winrt::com_array<uint8_t>();
-        }
-
-        ResearchModeSensorResolution resolution;
-        m_pSensorFrame->GetResolution(&resolution);
-
-        bool isLongThrow = (m_pRMSensor->GetSensorType() == DEPTH_LONG_THROW);
-
-        const UINT16* pAbImage = nullptr;
-        size_t outAbBufferCount = 0;
-        wchar_t outputAbPath[MAX_PATH];
-
-        const UINT16* pDepth = nullptr;
-        size_t outDepthBufferCount = 0;
-        wchar_t outputDepthPath[MAX_PATH];
-
-        const BYTE* pSigma = nullptr;
-        size_t outSigmaBufferCount = 0;
-
-        timestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds((long long)m_prevTimestamp)).count();
-
-        if (isLongThrow)
-        {
-            winrt::check_hresult(pDepthFrame->GetSigmaBuffer(&pSigma, &outSigmaBufferCount));
-        }
-
-        winrt::check_hresult(pDepthFrame->GetAbDepthBuffer(&pAbImage, &outAbBufferCount));
-        winrt::check_hresult(pDepthFrame->GetBuffer(&pDepth, &outDepthBufferCount));
-
-        pDepthFrame->Release();
-
-        assert(outAbBufferCount == outDepthBufferCount);
-        if (isLongThrow)
-        {
-            assert(outAbBufferCount == outSigmaBufferCount);
-        }
-            
-        com_array<UINT16> tempBuffer(outDepthBufferCount * 2);
-        for (size_t i = 0; i < outAbBufferCount; ++i)
-        {
-            UINT16 abVal;
-            UINT16 d;
-            const bool invalid = isLongThrow ? ((pSigma[i] & Depth::InvalidationMasks::Invalid) > 0) :
-                                                (pDepth[i] >= Depth::AHAT_INVALID_VALUE);
-            if (invalid)
-            {
-                d = 0;
-            }
-            else
-            {
-                d = pDepth[i];
-            }
-
-            abVal = pAbImage[i];
-
-            tempBuffer[i] = d;
-            tempBuffer[i + outDepthBufferCount] = abVal;
-        }
-
-        width = resolution.Width;
-        height = resolution.Height;
-        pixelBufferSize = resolution.Width * resolution.Height;
-
-        std::array<double, 16> VLCtoWorldtransform_values;
-        VLCtoWorldtransform_values[0] = m_frameLocation.rigToWorldtransform.m11;
-        VLCtoWorldtransform_values[1] = m_frameLocation.rigToWorldtransform.m12;
-        VLCtoWorldtransform_values[2] = m_frameLocation.rigToWorldtransform.m13;
-        VLCtoWorldtransform_values[3] = m_frameLocation.rigToWorldtransform.m14;
-        VLCtoWorldtransform_values[4] = m_frameLocation.rigToWorldtransform.m21;
-        VLCtoWorldtransform_values[5] = m_frameLocation.rigToWorldtransform.m22;
-        VLCtoWorldtransform_values[6] = m_frameLocation.rigToWorldtransform.m23;
-        VLCtoWorldtransform_values[7] = m_frameLocation.rigToWorldtransform.m24;
-        VLCtoWorldtransform_values[8] = m_frameLocation.rigToWorldtransform.m31;
-        VLCtoWorldtransform_values[9] = m_frameLocation.rigToWorldtransform.m32;
-        VLCtoWorldtransform_values[10] = m_frameLocation.rigToWorldtransform.m33;
-        VLCtoWorldtransform_values[11] = m_frameLocation.rigToWorldtransform.m34;
-        VLCtoWorldtransform_values[12] = m_frameLocation.rigToWorldtransform.m41;
-        VLCtoWorldtransform_values[13] = m_frameLocation.rigToWorldtransform.m42;
-        VLCtoWorldtransform_values[14] = m_frameLocation.rigToWorldtransform.m43;
-        VLCtoWorldtransform_values[15] = m_frameLocation.rigToWorldtransform.m44;
-
-        std::array<double, 16> PVLCtoWorldtransformSolar_values;
-        PVLCtoWorldtransformSolar_values.fill(0);
-        // Utils::convertToSolARPose(VLCtoWorldtransform_values, PVLCtoWorldtransformSolar_values);
-        PVLCtoWorldtransformSolar_values = VLCtoWorldtransform_values;
-
-        // PVtoWorldtransform = com_array<double>(std::move_iterator(VLCtoWorldtransform_values), std::move_iterator(VLCtoWorldtransform_values + 16 * sizeof(double)));
-        PVtoWorldtransform = com_array<double>(PVLCtoWorldtransformSolar_values.begin(), PVLCtoWorldtransformSolar_values.end());
-
-        return tempBuffer;
-        
-    }
-
-    return winrt::com_array<UINT16>();
+    return m_hasResolution ? m_resolution.Height : 0;
 }
 
-
-//com_array<uint8_t> RMCameraReader::getSensorData(uint64_t& timestamp, com_array<double>& PVtoWorldtransform, uint32_t& pixelBufferSize, uint32_t& width, uint32_t& height)
-//{
-//    // TODO(jmhenaff): compute sensor type once instead of doing this here (perf)
-//
-//    IResearchModeSensorVLCFrame* pVLCFrame = nullptr;
-//    IResearchModeSensorDepthFrame* pDepthFrame = nullptr;
-//
-//    HRESULT hr = m_pSensorFrame->QueryInterface(IID_PPV_ARGS(&pVLCFrame));
-//
-//    if (FAILED(hr))
-//    {
-//        hr = m_pSensorFrame->QueryInterface(IID_PPV_ARGS(&pDepthFrame));
-//    }
-//    
-//    com_array<uint8_t> result;
-//
-//    if (pVLCFrame)
-//    {
-//        com_array<uint8_t> result = getVlcSensorData(timestamp, PVtoWorldtransform, pixelBufferSize, width, height);
-//        pVLCFrame->Release();
-//    }
-//
-//    if (pDepthFrame)
-//    {
-//        com_array<uint8_t> result = getDepthSensorData(timestamp, PVtoWorldtransform, pixelBufferSize, width, height);
-//        pDepthFrame->Release();
-//    }
-//
-//    return result;
-//
-//
-//
-//
-//
-//    //std::lock_guard<std::mutex> reader_guard(m_sensorFrameMutex);
-//    //if (m_pSensorFrame)
-//    //{
-//    //    if (IsNewTimestamp(m_pSensorFrame))
-//    //    {
-//    //        timestamp = static_cast<uint64_t>(m_prevTimestamp);
-//
-//    //        // TODO(jmhenaff): convert frame
-//    //        // Copy last frame, release mutex and process afterwards ?
-//    //        
-//    //        IResearchModeSensorVLCFrame* pVLCFrame = nullptr;
-//    //        auto hr = m_pSensorFrame->QueryInterface(IID_PPV_ARGS(&pVLCFrame));
-//    //        if (FAILED(hr))
-//    //        {
-//    //            // TODO(jmhenaff): handle error, depth frame
-//    //            return winrt::com_array<uint8_t>();
-//    //        }
-//
-//    //        //// TODO(jmhenaff): do something with this?
-//    //        //UINT32 gain = 0;
-//    //        //UINT64 exposure = 0;
-//    //        //pVLCFrame->GetGain(&gain);
-//    //        //pVLCFrame->GetExposure(&exposure);
-//
-//    //        // Get resolution
-//    //        ResearchModeSensorResolution resolution;
-//    //        m_pSensorFrame->GetResolution(&resolution);
-//
-//    //        // Get data buffer (8 bits grayscale)
-//    //        const BYTE* pImage = nullptr;
-//    //        size_t outBufferCount = 0;
-//    //        pVLCFrame->GetBuffer(&pImage, &outBufferCount);
-//    //        pVLCFrame->Release();
-//
-//    //        // Convert to RGB8 (32 bits)
-//    //        com_array<UINT8> tempBuffer(resolution.Width * resolution.Height);
-//    //        for (UINT i = 0; i < resolution.Height; i++)
-//    //        {
-//    //            for (UINT j = 0; j < resolution.Width; j++)
-//    //            {
-//    //                BYTE inputPixel = pImage[resolution.Width * i + j];
-//    //                tempBuffer[resolution.Width * i + j] = inputPixel;
-//    //            }
-//    //        }
-//    //        width = resolution.Width;
-//    //        height = resolution.Height;
-//    //        pixelBufferSize = resolution.Width * resolution.Height;
-//
-//    //        std::array<double, 16> VLCtoWorldtransform_values;
-//    //        VLCtoWorldtransform_values[0] = m_frameLocation.rigToWorldtransform.m11;
-//    //        VLCtoWorldtransform_values[1] = m_frameLocation.rigToWorldtransform.m12;
-//    //        VLCtoWorldtransform_values[2] = m_frameLocation.rigToWorldtransform.m13;
-//    //        VLCtoWorldtransform_values[3] = m_frameLocation.rigToWorldtransform.m14;
-//    //        VLCtoWorldtransform_values[4] = m_frameLocation.rigToWorldtransform.m21;
-//    //        VLCtoWorldtransform_values[5] = m_frameLocation.rigToWorldtransform.m22;
-//    //        VLCtoWorldtransform_values[6] = m_frameLocation.rigToWorldtransform.m23;
-//    //        VLCtoWorldtransform_values[7] = m_frameLocation.rigToWorldtransform.m24;
-//    //        VLCtoWorldtransform_values[8] = m_frameLocation.rigToWorldtransform.m31;
-//    //        VLCtoWorldtransform_values[9] = m_frameLocation.rigToWorldtransform.m32;
-//    //        VLCtoWorldtransform_values[10] = m_frameLocation.rigToWorldtransform.m33;
-//    //        VLCtoWorldtransform_values[11] = m_frameLocation.rigToWorldtransform.m34;
-//    //        VLCtoWorldtransform_values[12] = m_frameLocation.rigToWorldtransform.m41;
-//    //        VLCtoWorldtransform_values[13] = m_frameLocation.rigToWorldtransform.m42;
-//    //        VLCtoWorldtransform_values[14] = m_frameLocation.rigToWorldtransform.m43;
-//    //        VLCtoWorldtransform_values[15] = m_frameLocation.rigToWorldtransform.m44;
-//    //        
-//    //        std::array<double, 16> PVLCtoWorldtransformSolar_values;
-//    //        PVLCtoWorldtransformSolar_values.fill(0);
-//    //        Utils::convertToSolARPose(VLCtoWorldtransform_values, PVLCtoWorldtransformSolar_values);
-//    //     
-//    //        // PVtoWorldtransform = com_array<double>(std::move_iterator(VLCtoWorldtransform_values), std::move_iterator(VLCtoWorldtransform_values + 16 * sizeof(double)));
-//    //        PVtoWorldtransform = com_array<double>(PVLCtoWorldtransformSolar_values.begin(), PVLCtoWorldtransformSolar_values.end());
-//
-//    //        return tempBuffer;
-//    //        // com_array<UINT8> tempBuffer = com_array<UINT8>(std::move_iterator(pImage), std::move_iterator(pImage + outBufferCount));
-//    //    }
-//    //}
-//    //return winrt::com_array<uint8_t>();
-//}
-
-uint32_t RMCameraReader::getWidth()
+void RMCameraReader::SetLocator(const GUID& guid)
 {
-    std::lock_guard<std::mutex> reader_guard(m_sensorFrameMutex);
-
-    if (!m_pSensorFrame)
-    {
-        return 0;
-    }
-
-    ResearchModeSensorResolution resolution;
-    auto res = m_pSensorFrame->GetResolution(&resolution);
-    return resolution.Width;
+    m_locator = Preview::SpatialGraphInteropPreview::CreateLocatorForNode(guid);
 }
 
-uint32_t RMCameraReader::getHeight()
+void RMCameraReader::FillSharedFrameHeader(SharedFrame& frame) const
 {
-    std::lock_guard<std::mutex> reader_guard(m_sensorFrameMutex);
-    
-    if (!m_pSensorFrame)
-    {
-        return 0;
-    }
-
-    ResearchModeSensorResolution resolution; 
-    auto res = m_pSensorFrame->GetResolution(&resolution);
-    return resolution.Height;
+    frame.sequence = m_frameSequence.Latest();
+    frame.timestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds(checkAndConvertUnsigned(m_frameTimestamp))).count();
+    frame.toWorldTransform = ToKeyframePose(m_frameLocation.rigToWorldtransform);
+    frame.poseValid = m_frameLocated;
+    frame.width = m_resolution.Width;
+    frame.height = m_resolution.Height;
+    frame.sharpness = m_frameSharpness;
 }
 
-void RMCameraReader::SetLocator(const GUID& guid)
+StreamFrameCounters RMCameraReader::getFrameCounters()
 {
-    m_locator = Preview::SpatialGraphInteropPreview::CreateLocatorForNode(guid);
+    std::lock_guard<ProfiledMutex> reader_guard(m_sensorFrameMutex);
+    StreamFrameCounters counters = m_frameSequence.Counters();
+    counters.decimated = m_rateController.GetDecimatedCount();
+    counters.blurry = m_sharpnessFilter.GetRejectedCount();
+    return counters;
 }
 
-bool RMCameraReader::IsNewTimestamp(IResearchModeSensorFrame* pSensorFrame)
+FrameRequestStatus RMCameraReader::RequestFrame(uint64_t lastSeenSequence)
 {
-    ResearchModeSensorTimestamp timestamp;
-    winrt::check_hresult(pSensorFrame->GetTimeStamp(&timestamp));
-
-    if (m_prevTimestamp == timestamp.HostTicks)
+    const bool pickedUp = !m_frameSequence.IsLatestServed();
+    const FrameRequestStatus status = m_frameSequence.Request(lastSeenSequence);
+    if (status == FrameRequestStatus::NewFrame && pickedUp)
     {
-        return false;
+        m_tracer.PickedUp(m_frameTrace);
     }
+    return status;
+}
 
-    m_prevTimestamp = timestamp.HostTicks;
-
-    return true;
+FrameRequestStatus RMCameraReader::waitForNextFrame(uint64_t lastSeenSequence, uint32_t timeoutMs, uint64_t& sequence)
+{
+    std::unique_lock<ProfiledMutex> reader_lock(m_sensorFrameMutex);
+    return m_frameSequence.Wait(reader_lock, m_frameCondVar, lastSeenSequence, timeoutMs, [this]() { return m_fExit.load(); }, sequence);
 }
 
-void RMCameraReader::SetStorageFolder(const StorageFolder& storageFolder)
+void RMCameraReader::SetStorageFolder(const StorageFolder& storageFolder, const std::shared_ptr<StagingArena>& stagingArena)
 {
     if (storageFolder)
     {
-        std::lock_guard<std::mutex> storage_guard(m_storageMutex);
+        std::lock_guard<ProfiledMutex> storage_guard(m_storageMutex);
         m_storageFolder = storageFolder;
         wchar_t fileName[MAX_PATH] = {};
         swprintf_s(fileName, L"%s\\%s.tar", m_storageFolder.Path().data(), m_pRMSensor->GetFriendlyName());
-        m_tarball.reset(new Io::Tarball(fileName));
+        m_tarball.reset(new Io::StagedTarball(fileName, stagingArena));
+        swprintf_s(fileName, L"%s\\%s_rig2world.traj", m_storageFolder.Path().data(), m_pRMSensor->GetFriendlyName());
+        m_poseLog.Open(fileName, TrajectoryPoseFormat::Matrix, false);
         m_storageCondVar.notify_all();
     }
 }
 
 void RMCameraReader::ResetStorageFolder()
 {
-    std::lock_guard<std::mutex> storage_guard(m_storageMutex);
+    std::lock_guard<ProfiledMutex> storage_guard(m_storageMutex);
     if (m_storageFolder)
     {
         DumpCalibration();
-        DumpFrameLocations();
+        m_poseLog.Close();
         m_tarball.reset();
         m_storageFolder = nullptr;
     }
@@ -822,7 +424,7 @@ void RMCameraReader::SetWorldCoordSystem(const SpatialCoordinateSystem& coordSys
     m_worldCoordSystem = coordSystem;
 }
 
-std::string CreateHeader(const ResearchModeSensorResolution& resolution, int maxBitmapValue)
+std::string RMCameraReader::CreateHeader(const ResearchModeSensorResolution& resolution, int maxBitmapValue)
 {
     std::string bitmapFormat = "P5"; 
 
@@ -835,193 +437,35 @@ std::string CreateHeader(const ResearchModeSensorResolution& resolution, int max
     return header.str();
 }
 
-void RMCameraReader::SaveDepth(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorDepthFrame* pDepthFrame)
-{        
-    // Get resolution (will be used for PGM header)
-    ResearchModeSensorResolution resolution;    
-    pSensorFrame->GetResolution(&resolution);   
-            
-    bool isLongThrow = (m_pRMSensor->GetSensorType() == DEPTH_LONG_THROW);
-
-    const UINT16* pAbImage = nullptr;
-    size_t outAbBufferCount = 0;
-    wchar_t outputAbPath[MAX_PATH];
-
-    const UINT16* pDepth = nullptr;
-    size_t outDepthBufferCount = 0;
-    wchar_t outputDepthPath[MAX_PATH];
-
-    const BYTE* pSigma = nullptr;
-    size_t outSigmaBufferCount = 0;
-
-    HundredsOfNanoseconds timestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds((long long)m_prevTimestamp));
-
-    if (isLongThrow)
-    {
-        winrt::check_hresult(pDepthFrame->GetSigmaBuffer(&pSigma, &outSigmaBufferCount));
-    }
-
-    winrt::check_hresult(pDepthFrame->GetAbDepthBuffer(&pAbImage, &outAbBufferCount));
-    winrt::check_hresult(pDepthFrame->GetBuffer(&pDepth, &outDepthBufferCount));
-
-    // Get header for AB and Depth (16 bits)
-    // Prepare the data to save for AB
-    const std::string abHeaderString = CreateHeader(resolution, 65535);
-    swprintf_s(outputAbPath, L"%llu_ab.pgm", timestamp.count());
-    std::vector<BYTE> abPgmData;
-    abPgmData.reserve(abHeaderString.size() + outAbBufferCount * sizeof(UINT16));
-    abPgmData.insert(abPgmData.end(), abHeaderString.c_str(), abHeaderString.c_str() + abHeaderString.size());
-    
-    // Prepare the data to save for Depth
-    const std::string depthHeaderString = CreateHeader(resolution, 65535);
-    swprintf_s(outputDepthPath, L"%llu.pgm", timestamp.count());
-    std::vector<BYTE> depthPgmData;
-    depthPgmData.reserve(depthHeaderString.size() + outDepthBufferCount * sizeof(UINT16));
-    depthPgmData.insert(depthPgmData.end(), depthHeaderString.c_str(), depthHeaderString.c_str() + depthHeaderString.size());
-    
-    assert(outAbBufferCount == outDepthBufferCount);
-    if (isLongThrow)
-        assert(outAbBufferCount == outSigmaBufferCount);
-    // Validate depth
-    for (size_t i = 0; i < outAbBufferCount; ++i)
-    {
-        UINT16 abVal;
-        UINT16 d;
-        const bool invalid = isLongThrow ? ((pSigma[i] & Depth::InvalidationMasks::Invalid) > 0) :
-                                           (pDepth[i] >= Depth::AHAT_INVALID_VALUE);
-        if (invalid)
-        {
-            d = 0;
-        }
-        else
-        {            
-            d = pDepth[i];
-        }
-
-        abVal = pAbImage[i];
-
-        abPgmData.push_back((BYTE)(abVal >> 8));
-        abPgmData.push_back((BYTE)abVal);
-        depthPgmData.push_back((BYTE)(d >> 8));
-        depthPgmData.push_back((BYTE)d);
-    }
-
-    m_tarball->AddFile(outputAbPath, &abPgmData[0], abPgmData.size());
-    m_tarball->AddFile(outputDepthPath, &depthPgmData[0], depthPgmData.size());
-}
-
-void RMCameraReader::SaveVLC(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorVLCFrame* pVLCFrame)
-{        
-    wchar_t outputPath[MAX_PATH];
-
-    // Get PGM header
-    int maxBitmapValue = 255;
-    ResearchModeSensorResolution resolution;
-    winrt::check_hresult(pSensorFrame->GetResolution(&resolution));
-
-    const std::string headerString = CreateHeader(resolution, maxBitmapValue);
-
-    // Compose the output file name using absolute ticks
-    swprintf_s(outputPath, L"%llu.pgm", m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds(checkAndConvertUnsigned(m_prevTimestamp))).count());
-
-    // Convert the software bitmap to raw bytes    
-    std::vector<BYTE> pgmData;
-    size_t outBufferCount = 0;
-    const BYTE* pImage = nullptr;
-
-    winrt::check_hresult(pVLCFrame->GetBuffer(&pImage, &outBufferCount));
-
-    pgmData.reserve(headerString.size() + outBufferCount);
-    pgmData.insert(pgmData.end(), headerString.c_str(), headerString.c_str() + headerString.size());
-    pgmData.insert(pgmData.end(), pImage, pImage + outBufferCount);
-
-    m_tarball->AddFile(outputPath, &pgmData[0], pgmData.size());
-}
-
-void RMCameraReader::SaveFrame(IResearchModeSensorFrame* pSensorFrame)
-{
-    AddFrameLocation();
-
-	IResearchModeSensorVLCFrame* pVLCFrame = nullptr;
-	IResearchModeSensorDepthFrame* pDepthFrame = nullptr;
-
-    HRESULT hr = pSensorFrame->QueryInterface(IID_PPV_ARGS(&pVLCFrame));
-
-	if (FAILED(hr))
-	{
-		hr = pSensorFrame->QueryInterface(IID_PPV_ARGS(&pDepthFrame));
-	}
-
-	if (pVLCFrame)
-	{
-		SaveVLC(pSensorFrame, pVLCFrame);
-        pVLCFrame->Release();
-	}
-
-	if (pDepthFrame)
-	{		
-		SaveDepth(pSensorFrame, pDepthFrame);
-        pDepthFrame->Release();
-	}    
-}
-
 bool RMCameraReader::AddFrameLocation()
 {
-    auto timestamp = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(m_prevTimestamp)));
-    auto location = m_locator.TryLocateAtTimestamp(timestamp, m_worldCoordSystem);
-    if (!location)
+    // Location has already been looked up by the update thread when the frame was acquired
+    if (!m_frameLocated)
     {
         return false;
     }
-    const float4x4 dynamicNodeToCoordinateSystem = make_float4x4_from_quaternion(location.Orientation()) * make_float4x4_translation(location.Position());
-    auto absoluteTimestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds((long long)m_prevTimestamp)).count();
-    m_frameLocations.push_back(std::move(FrameLocation{absoluteTimestamp, dynamicNodeToCoordinateSystem}));
+    float rigToWorld[PoseConversion::kTransformSize];
+    PoseConversion::Convert<PoseConversion::Layout::RowMajor, PoseConversion::CameraAxes::HoloLens>(&m_frameLocation.rigToWorldtransform.m11, rigToWorld);
+    m_poseLog.Write(m_frameLocation.timestamp, rigToWorld);
 
     return true;
 }
 
-// TODO(jmhenaff): avoid code duplication between this and AddFrameLocation()
-bool RMCameraReader::updateFrameLocation()
+bool RMCameraReader::LocateFrame(UINT64 hostTicks, FrameLocation& location) const
 {
-    //auto timestamp = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(m_prevTimestamp)));
-    //auto location = m_locator.TryLocateAtTimestamp(timestamp, m_worldCoordSystem);
-    //if (!location)
-    //{
-    //    return false;
-    //}
-    //const float4x4 dynamicNodeToCoordinateSystem = make_float4x4_from_quaternion(location.Orientation()) * make_float4x4_translation(location.Position());
-    //auto absoluteTimestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds((long long)m_prevTimestamp)).count();
-
-    //m_frameLocation = FrameLocation{ absoluteTimestamp, dynamicNodeToCoordinateSystem };
-
-    //return true;
-
-
-    //// Initialize world coordinate with first frame location
-    //// TODO: use Cannon MixedReality methods ? (see StreamRecorder sample)
-    //if (!m_worldCoordSystem)
-    //{
-    //    SetWorldCoordSystem(m_locator.CreateStationaryFrameOfReferenceAtCurrentLocation().CoordinateSystem());
-    //}
-
     assert( m_worldCoordSystem );
 
-    auto timestamp = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(m_prevTimestamp)));
-    auto location = m_locator.TryLocateAtTimestamp(timestamp, m_worldCoordSystem);
-
-    //ISpatialCoordinateSystem* m_UnitySpatialCoordinateSystem = nullptr;
-    //spatialCoordinateSystem.as<IUnknown>()->QueryInterface(winrt::guid_of<ISpatialCoordinateSystem>(), (void**)(&m_UnitySpatialCoordinateSystem));
-    //auto location = m_locator.TryLocateAtTimestamp(timestamp, m_worldCoordSystem);
-
-    if (!location)
+    auto timestamp = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(hostTicks)));
+    auto spatialLocation = m_locator.TryLocateAtTimestamp(timestamp, m_worldCoordSystem);
+    if (!spatialLocation)
     {
         return false;
     }
 
-    const float4x4 dynamicNodeToCoordinateSystem = make_float4x4_from_quaternion(location.Orientation()) * make_float4x4_translation(location.Position());
-    auto absoluteTimestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds((long long)m_prevTimestamp)).count();
+    const float4x4 dynamicNodeToCoordinateSystem = make_float4x4_from_quaternion(spatialLocation.Orientation()) * make_float4x4_translation(spatialLocation.Position());
+    auto absoluteTimestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds(checkAndConvertUnsigned(hostTicks))).count();
 
-    m_frameLocation = FrameLocation{ absoluteTimestamp, dynamicNodeToCoordinateSystem };
+    location = FrameLocation{ absoluteTimestamp, dynamicNodeToCoordinateSystem };
 
     return true;
 }
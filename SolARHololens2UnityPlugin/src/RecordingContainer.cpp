@@ -0,0 +1,568 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RecordingContainer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr size_t kPayloadAlignment = 8;
+    // The I/O thread wakes up at least that often to write the records out of the reorder window
+    constexpr auto kIoPollPeriod = std::chrono::milliseconds(50);
+
+    size_t AlignPayload(size_t size)
+    {
+        return (size + kPayloadAlignment - 1) & ~(kPayloadAlignment - 1);
+    }
+
+    NetworkCodec GetFrameCodec(uint32_t bytesPerPixel)
+    {
+        switch (bytesPerPixel)
+        {
+        case 1:
+            return NetworkCodec::Gray8;
+        case 2:
+            return NetworkCodec::Depth16;
+        default:
+            return NetworkCodec::Raw;
+        }
+    }
+
+    template <typename T>
+    void Append(std::vector<uint8_t>& buffer, const T& value)
+    {
+        const size_t offset = buffer.size();
+        buffer.resize(offset + sizeof(T));
+        std::memcpy(buffer.data() + offset, &value, sizeof(T));
+    }
+}
+
+bool RecordingWriter::Open(const std::filesystem::path& path, const RecordingWriterSettings& settings)
+{
+    Close();
+
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open())
+    {
+        return false;
+    }
+    RecordingFileHeader header;
+    header.headerSize = sizeof(RecordingFileHeader);
+    header.chunkHeaderSize = sizeof(RecordingChunkHeader);
+    header.indexEntrySize = sizeof(RecordingIndexEntry);
+    header.recordHeaderSize = sizeof(RecordingRecordHeader);
+    header.flags = settings.compress ? kRecordingChunkCompressed : 0;
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    m_settings = settings;
+    m_compressedStreams = 0;
+    m_records.clear();
+    m_records.reserve(settings.chunkSize + settings.chunkSize / 4);
+    m_index.clear();
+    m_reorder.clear();
+    m_latestTimestamp = 0;
+    m_lastTimestamp = 0;
+    {
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        m_stats = RecordingWriterStats();
+        m_pendingBytes = 0;
+        m_closing = false;
+    }
+    m_pIoThread = std::make_unique<std::thread>(IoThread, this);
+    return true;
+}
+
+void RecordingWriter::Close()
+{
+    if (!m_pIoThread)
+    {
+        return;
+    }
+    {
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        m_closing = true;
+    }
+    m_condVar.notify_all();
+    m_pIoThread->join();
+    m_pIoThread.reset();
+    m_file.close();
+}
+
+bool RecordingWriter::IsOpen()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    return m_pIoThread && !m_closing;
+}
+
+bool RecordingWriter::Write(RecordingRecordType type, uint16_t stream, uint64_t timestamp,
+                            const void* pHeader, size_t headerSize, const uint8_t* pData, size_t dataSize,
+                            std::shared_ptr<const void> owner)
+{
+    auto record = std::make_unique<PendingRecord>();
+    record->timestamp = timestamp;
+    record->type = type;
+    record->stream = stream;
+    record->header.assign(static_cast<const uint8_t*>(pHeader), static_cast<const uint8_t*>(pHeader) + headerSize);
+    if (owner)
+    {
+        record->owner = std::move(owner);
+        record->pData = pData;
+    }
+    else
+    {
+        record->copy.assign(pData, pData + dataSize);
+        record->pData = record->copy.data();
+    }
+    record->dataSize = dataSize;
+
+    // Referenced data counts too: it holds pooled frames the capture may run out of
+    const size_t size = headerSize + dataSize;
+    {
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        if (!m_pIoThread || m_closing)
+        {
+            return false;
+        }
+        if (m_pendingBytes + size > m_settings.maxPendingBytes)
+        {
+            m_stats.droppedRecords++;
+            return false;
+        }
+        m_pendingBytes += size;
+        record->order = m_nextOrder++;
+        m_incoming.push_back(std::move(record));
+    }
+    m_condVar.notify_one();
+    return true;
+}
+
+bool RecordingWriter::WriteFrame(SharedStream stream, const SolARHL2FrameMetadata& metadata, const uint8_t* pPixels,
+                                 std::shared_ptr<const void> owner)
+{
+    const RecordingRecordType type = metadata.bytesPerPixel == 2 ? RecordingRecordType::Depth : RecordingRecordType::Image;
+    return Write(type, static_cast<uint16_t>(stream), metadata.timestamp, &metadata, sizeof(metadata),
+                 pPixels, metadata.dataSize, std::move(owner));
+}
+
+bool RecordingWriter::WriteImu(SharedStream stream, const SharedImuSample* pSamples, size_t count)
+{
+    if (count == 0)
+    {
+        return true;
+    }
+    // Timestamp of the first sample: the batch is read before any later record
+    return Write(RecordingRecordType::Imu, static_cast<uint16_t>(stream), pSamples[0].timestamp, nullptr, 0,
+                 reinterpret_cast<const uint8_t*>(pSamples), count * sizeof(SharedImuSample));
+}
+
+bool RecordingWriter::WritePose(const SharedHeadPose& pose)
+{
+    return Write(RecordingRecordType::Pose, static_cast<uint16_t>(SharedStream::HEAD_POSE), pose.timestamp,
+                 &pose, sizeof(pose), nullptr, 0);
+}
+
+bool RecordingWriter::WriteGaze(uint64_t timestamp, const RecordingGaze& gaze)
+{
+    return Write(RecordingRecordType::Gaze, 0, timestamp, &gaze, sizeof(gaze), nullptr, 0);
+}
+
+bool RecordingWriter::WriteCalibration(SharedStream stream, uint64_t timestamp, const RecordingCalibration& calibration, const float* pRays)
+{
+    const size_t rayCount = static_cast<size_t>(calibration.width) * calibration.height * 3;
+    return Write(RecordingRecordType::Calibration, static_cast<uint16_t>(stream), timestamp, &calibration, sizeof(calibration),
+                 reinterpret_cast<const uint8_t*>(pRays), rayCount * sizeof(float));
+}
+
+void RecordingWriter::SetStreamCompression(uint16_t stream, bool compress)
+{
+    if (stream >= 32)
+    {
+        return;
+    }
+    if (compress)
+    {
+        m_compressedStreams |= 1u << stream;
+    }
+    else
+    {
+        m_compressedStreams &= ~(1u << stream);
+    }
+}
+
+RecordingWriterStats RecordingWriter::GetStats()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    RecordingWriterStats stats = m_stats;
+    stats.pendingBytes = m_pendingBytes;
+    return stats;
+}
+
+void RecordingWriter::IoThread(RecordingWriter* pWriter)
+{
+    ScopedThreadProfile profile("RecordingWriter::IoThread");
+
+    // Min-heap on (timestamp, arrival order)
+    const auto isLater = [](const std::unique_ptr<PendingRecord>& a, const std::unique_ptr<PendingRecord>& b)
+    {
+        return a->timestamp != b->timestamp ? a->timestamp > b->timestamp : a->order > b->order;
+    };
+
+    std::vector<std::unique_ptr<PendingRecord>> incoming;
+    bool closing = false;
+    while (!closing)
+    {
+        {
+            std::unique_lock<ProfiledMutex> lock(pWriter->m_mutex);
+            pWriter->m_condVar.wait_for(lock, kIoPollPeriod, [pWriter] { return pWriter->m_closing || !pWriter->m_incoming.empty(); });
+            incoming.swap(pWriter->m_incoming);
+            // Write() refuses records once closing is set: incoming holds the last ones
+            closing = pWriter->m_closing;
+        }
+
+        for (auto& record : incoming)
+        {
+            pWriter->m_latestTimestamp = std::max(pWriter->m_latestTimestamp, record->timestamp);
+            pWriter->m_reorder.push_back(std::move(record));
+            std::push_heap(pWriter->m_reorder.begin(), pWriter->m_reorder.end(), isLater);
+        }
+        incoming.clear();
+
+        size_t writtenBytes = 0;
+        uint64_t writtenRecords = 0;
+        auto& reorder = pWriter->m_reorder;
+        while (!reorder.empty() &&
+               (closing || reorder.front()->timestamp + pWriter->m_settings.reorderWindow <= pWriter->m_latestTimestamp))
+        {
+            std::pop_heap(reorder.begin(), reorder.end(), isLater);
+            const PendingRecord& record = *reorder.back();
+            pWriter->AppendRecord(record);
+            writtenBytes += record.header.size() + record.dataSize;
+            writtenRecords++;
+            // Releases the frame buffer
+            reorder.pop_back();
+        }
+        if (closing)
+        {
+            pWriter->WriteChunk();
+            pWriter->m_file.flush();
+        }
+
+        std::lock_guard<ProfiledMutex> guard(pWriter->m_mutex);
+        pWriter->m_pendingBytes -= writtenBytes;
+        pWriter->m_stats.records += writtenRecords;
+    }
+}
+
+void RecordingWriter::AppendRecord(const PendingRecord& record)
+{
+    if (record.timestamp < m_lastTimestamp)
+    {
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        m_stats.lateRecords++;
+    }
+    m_lastTimestamp = std::max(m_lastTimestamp, record.timestamp);
+
+    // Pixels of frames are encoded if it pays off
+    const uint8_t* pData = record.pData;
+    size_t dataSize = record.dataSize;
+    NetworkCodec codec = NetworkCodec::Raw;
+    const bool compressStream = record.stream < 32 && (m_compressedStreams & (1u << record.stream));
+    if ((m_settings.compress || compressStream) &&
+        (record.type == RecordingRecordType::Image || record.type == RecordingRecordType::Depth) &&
+        record.header.size() == sizeof(SolARHL2FrameMetadata))
+    {
+        SolARHL2FrameMetadata metadata;
+        std::memcpy(&metadata, record.header.data(), sizeof(metadata));
+        codec = GetFrameCodec(metadata.bytesPerPixel);
+        if (codec != NetworkCodec::Raw && metadata.dataSize == dataSize)
+        {
+            m_encoded.clear();
+            EncodePixels(codec, pData, metadata.width, metadata.height * metadata.planeCount, m_encoded);
+            if (m_encoded.size() < dataSize)
+            {
+                pData = m_encoded.data();
+                dataSize = m_encoded.size();
+            }
+            else
+            {
+                codec = NetworkCodec::Raw;
+            }
+        }
+        else
+        {
+            codec = NetworkCodec::Raw;
+        }
+    }
+
+    if (m_index.empty())
+    {
+        m_chunkHeader = RecordingChunkHeader();
+        m_chunkHeader.firstTimestamp = record.timestamp;
+    }
+    if (codec != NetworkCodec::Raw)
+    {
+        m_chunkHeader.flags |= kRecordingChunkCompressed;
+    }
+    m_chunkHeader.firstTimestamp = std::min(m_chunkHeader.firstTimestamp, record.timestamp);
+    m_chunkHeader.lastTimestamp = std::max(m_chunkHeader.lastTimestamp, record.timestamp);
+
+    const uint32_t payloadSize = static_cast<uint32_t>(record.header.size() + dataSize);
+    // Offsets are relative to the records until the size of the index is known
+    m_index.push_back({ record.timestamp, m_records.size(), record.type, record.stream, payloadSize });
+
+    RecordingRecordHeader recordHeader{};
+    recordHeader.timestamp = record.timestamp;
+    recordHeader.type = record.type;
+    recordHeader.stream = record.stream;
+    recordHeader.codec = codec;
+    recordHeader.size = payloadSize;
+    recordHeader.rawSize = static_cast<uint32_t>(record.header.size() + record.dataSize);
+    Append(m_records, recordHeader);
+    m_records.insert(m_records.end(), record.header.begin(), record.header.end());
+    m_records.insert(m_records.end(), pData, pData + dataSize);
+    m_records.resize(m_records.size() + AlignPayload(payloadSize) - payloadSize, 0);
+
+    if (m_records.size() >= m_settings.chunkSize)
+    {
+        WriteChunk();
+    }
+}
+
+void RecordingWriter::WriteChunk()
+{
+    if (m_index.empty())
+    {
+        return;
+    }
+
+    const uint64_t indexSize = m_index.size() * sizeof(RecordingIndexEntry);
+    for (RecordingIndexEntry& entry : m_index)
+    {
+        entry.offset += sizeof(RecordingChunkHeader) + indexSize;
+    }
+    m_chunkHeader.recordCount = static_cast<uint32_t>(m_index.size());
+    m_chunkHeader.size = sizeof(RecordingChunkHeader) + indexSize + m_records.size();
+
+    m_file.write(reinterpret_cast<const char*>(&m_chunkHeader), sizeof(m_chunkHeader));
+    m_file.write(reinterpret_cast<const char*>(m_index.data()), indexSize);
+    m_file.write(reinterpret_cast<const char*>(m_records.data()), m_records.size());
+    // Whole chunks reach the disk: a crash loses at most the chunk being filled
+    m_file.flush();
+
+    {
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        m_stats.chunks++;
+        m_stats.bytes += m_chunkHeader.size;
+    }
+    m_index.clear();
+    m_records.clear();
+}
+
+bool RecordingReader::Open(const std::filesystem::path& path)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFile2(path.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    m_fileHandle = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(RecordingFileHeader)))
+    {
+        Close();
+        return false;
+    }
+    m_mappingHandle = CreateFileMappingFromApp(file, nullptr, PAGE_READONLY, 0, nullptr);
+    m_pData = m_mappingHandle ? static_cast<const uint8_t*>(MapViewOfFileFromApp(m_mappingHandle, FILE_MAP_READ, 0, 0)) : nullptr;
+    m_size = static_cast<size_t>(size.QuadPart);
+#else
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(RecordingFileHeader)))
+    {
+        close(file);
+        return false;
+    }
+    void* pData = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    // The mapping keeps the file referenced
+    close(file);
+    m_pData = pData != MAP_FAILED ? static_cast<const uint8_t*>(pData) : nullptr;
+    m_size = static_cast<size_t>(status.st_size);
+#endif
+    if (!m_pData)
+    {
+        Close();
+        return false;
+    }
+
+    RecordingFileHeader header;
+    std::memcpy(&header, m_pData, sizeof(header));
+    if (std::memcmp(header.magic, RecordingFileHeader().magic, sizeof(header.magic)) != 0 ||
+        header.version != RecordingFileHeader::kVersion ||
+        header.headerSize < sizeof(RecordingFileHeader) || header.headerSize > m_size ||
+        header.chunkHeaderSize != sizeof(RecordingChunkHeader) || header.indexEntrySize != sizeof(RecordingIndexEntry) ||
+        header.recordHeaderSize != sizeof(RecordingRecordHeader))
+    {
+        Close();
+        return false;
+    }
+
+    // Chunk headers only: indexes and records are validated when read
+    size_t offset = header.headerSize;
+    while (offset + sizeof(RecordingChunkHeader) <= m_size)
+    {
+        const auto* pChunk = reinterpret_cast<const RecordingChunkHeader*>(m_pData + offset);
+        const uint64_t indexEnd = sizeof(RecordingChunkHeader) + static_cast<uint64_t>(pChunk->recordCount) * sizeof(RecordingIndexEntry);
+        if (pChunk->magic != RecordingChunkHeader::kMagic || pChunk->size < indexEnd || pChunk->size > m_size - offset)
+        {
+            // Truncated by a crash
+            break;
+        }
+        m_chunks.push_back(pChunk);
+        m_recordCount += pChunk->recordCount;
+        offset += static_cast<size_t>(pChunk->size);
+    }
+    return true;
+}
+
+void RecordingReader::Close()
+{
+#ifdef _WIN32
+    if (m_pData)
+    {
+        UnmapViewOfFile(m_pData);
+    }
+    if (m_mappingHandle)
+    {
+        CloseHandle(m_mappingHandle);
+    }
+    if (m_fileHandle)
+    {
+        CloseHandle(m_fileHandle);
+    }
+#else
+    if (m_pData)
+    {
+        munmap(const_cast<uint8_t*>(m_pData), m_size);
+    }
+#endif
+    m_pData = nullptr;
+    m_size = 0;
+    m_fileHandle = nullptr;
+    m_mappingHandle = nullptr;
+    m_chunks.clear();
+    m_recordCount = 0;
+}
+
+size_t RecordingReader::SeekChunk(uint64_t timestamp) const
+{
+    return std::partition_point(m_chunks.begin(), m_chunks.end(), [timestamp](const RecordingChunkHeader* pChunk)
+    {
+        return pChunk->lastTimestamp < timestamp;
+    }) - m_chunks.begin();
+}
+
+RecordingRecord RecordingReader::GetRecord(size_t chunk, size_t index) const
+{
+    RecordingRecord record;
+    const RecordingChunkHeader* pChunk = m_chunks[chunk];
+    const RecordingIndexEntry& entry = Index(chunk)[index];
+    if (entry.offset + sizeof(RecordingRecordHeader) > pChunk->size ||
+        entry.size > pChunk->size - entry.offset - sizeof(RecordingRecordHeader))
+    {
+        // Corrupted index, the record reads as empty
+        return record;
+    }
+
+    RecordingRecordHeader header;
+    const uint8_t* pRecord = reinterpret_cast<const uint8_t*>(pChunk) + entry.offset;
+    std::memcpy(&header, pRecord, sizeof(header));
+    record.timestamp = header.timestamp;
+    record.type = header.type;
+    record.stream = header.stream;
+    record.codec = header.codec;
+    record.pPayload = pRecord + sizeof(header);
+    record.size = std::min(header.size, entry.size);
+    record.rawSize = header.rawSize;
+    return record;
+}
+
+void RecordingReader::ForEachRecord(uint32_t typeMask, uint32_t streamMask, const std::function<bool(const RecordingRecord&)>& callback,
+                                    size_t firstChunk) const
+{
+    for (size_t chunk = firstChunk; chunk < m_chunks.size(); ++chunk)
+    {
+        const RecordingIndexEntry* pIndex = Index(chunk);
+        for (size_t index = 0; index < m_chunks[chunk]->recordCount; ++index)
+        {
+            const uint32_t type = static_cast<uint32_t>(pIndex[index].type);
+            const uint32_t stream = pIndex[index].stream;
+            if (type < 32 && stream < 32 && (typeMask & (1u << type)) && (streamMask & (1u << stream)) &&
+                !callback(GetRecord(chunk, index)))
+            {
+                return;
+            }
+        }
+    }
+}
+
+bool RecordingReader::DecodeFrame(const RecordingRecord& record, SolARHL2FrameMetadata& metadata, std::vector<uint8_t>& pixels)
+{
+    if ((record.type != RecordingRecordType::Image && record.type != RecordingRecordType::Depth) ||
+        record.size < sizeof(SolARHL2FrameMetadata))
+    {
+        return false;
+    }
+    std::memcpy(&metadata, record.pPayload, sizeof(metadata));
+    const uint8_t* pPixels = record.pPayload + sizeof(metadata);
+    const size_t pixelsSize = record.size - sizeof(metadata);
+    if (static_cast<uint64_t>(metadata.width) * metadata.height * metadata.planeCount * metadata.bytesPerPixel != metadata.dataSize)
+    {
+        return false;
+    }
+
+    pixels.resize(metadata.dataSize);
+    if (record.codec == NetworkCodec::Raw)
+    {
+        if (pixelsSize != metadata.dataSize)
+        {
+            return false;
+        }
+        std::memcpy(pixels.data(), pPixels, pixelsSize);
+        return true;
+    }
+    return GetFrameCodec(metadata.bytesPerPixel) == record.codec &&
+           DecodePixels(record.codec, pPixels, pixelsSize, metadata.width, metadata.height * metadata.planeCount, pixels.data());
+}
@@ -0,0 +1,212 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RecordingGovernor.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Smoothing of the bandwidth measures, a few periods of memory
+    constexpr double kBandwidthSmoothing = 0.3;
+    // Input over write bandwidth by more than this is a backlog, below it measurement noise
+    constexpr double kBacklogRatio = 1.05;
+    // Restore only if the budget leaves room for the restored level
+    constexpr double kBudgetRestoreRatio = 0.7;
+
+    // Frame rate and resolution steps, after the optional compression level
+    const RecordingStreamQuality kLevels[] = {
+        { 0, false, 1, 1 },
+        { 0, false, 2, 1 },
+        { 0, false, 2, 2 },
+        { 0, false, 4, 2 },
+        { 0, false, 8, 2 } };
+    constexpr uint32_t kLevelCount = sizeof(kLevels) / sizeof(kLevels[0]);
+
+    double Smooth(double average, double sample, bool first)
+    {
+        return first ? sample : average + kBandwidthSmoothing * (sample - average);
+    }
+}
+
+RecordingGovernor::RecordingGovernor(const RecordingGovernorSettings& settings)
+    : m_settings(settings)
+{
+}
+
+void RecordingGovernor::SetPriority(const std::vector<SharedStream>& priority, const std::vector<SharedStream>& canCompress)
+{
+    m_priority.clear();
+    for (SharedStream stream : priority)
+    {
+        const size_t index = static_cast<size_t>(stream);
+        if (index < kMaxStreams && !m_streams[index].governed)
+        {
+            m_streams[index].governed = true;
+            m_priority.push_back(stream);
+        }
+    }
+    for (SharedStream stream : canCompress)
+    {
+        if (static_cast<size_t>(stream) < kMaxStreams)
+        {
+            m_streams[static_cast<size_t>(stream)].canCompress = true;
+        }
+    }
+}
+
+void RecordingGovernor::AddInput(SharedStream stream, size_t bytes)
+{
+    if (static_cast<size_t>(stream) < kMaxStreams)
+    {
+        m_streams[static_cast<size_t>(stream)].inputBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+RecordingStreamQuality RecordingGovernor::GetQuality(SharedStream stream) const
+{
+    if (static_cast<size_t>(stream) >= kMaxStreams)
+    {
+        return RecordingStreamQuality();
+    }
+    const Stream& state = m_streams[static_cast<size_t>(stream)];
+    return GetLevelQuality(state.level.load(std::memory_order_relaxed), state.canCompress);
+}
+
+RecordingStreamQuality RecordingGovernor::GetLevelQuality(uint32_t level, bool canCompress)
+{
+    RecordingStreamQuality quality;
+    if (canCompress)
+    {
+        if (level == 0)
+        {
+            return quality;
+        }
+        quality = kLevels[std::min(level - 1, kLevelCount - 1)];
+        quality.compress = true;
+    }
+    else
+    {
+        quality = kLevels[std::min(level, kLevelCount - 1)];
+    }
+    quality.level = level;
+    return quality;
+}
+
+uint32_t RecordingGovernor::GetMaxLevel(bool canCompress)
+{
+    return canCompress ? kLevelCount : kLevelCount - 1;
+}
+
+void RecordingGovernor::Update(double seconds, uint64_t writtenBytes, size_t pendingBytes, size_t pendingCapacity,
+                               std::vector<RecordingGovernorEvent>& events)
+{
+    if (seconds <= 0.)
+    {
+        return;
+    }
+
+    const bool first = !m_hasMeasure;
+    double inputBytesPerSecond = 0.;
+    for (SharedStream stream : m_priority)
+    {
+        Stream& state = m_streams[static_cast<size_t>(stream)];
+        const uint64_t inputBytes = state.inputBytes.load(std::memory_order_relaxed);
+        state.bytesPerSecond = Smooth(state.bytesPerSecond, (inputBytes - state.lastInputBytes) / seconds, first);
+        state.lastInputBytes = inputBytes;
+        inputBytesPerSecond += state.bytesPerSecond;
+    }
+    const double writeBytesPerSecond = Smooth(static_cast<double>(m_writeBytesPerSecond),
+                                              (writtenBytes - m_lastWrittenBytes) / seconds, first);
+    m_writeBytesPerSecond = static_cast<uint64_t>(writeBytesPerSecond);
+    m_lastWrittenBytes = writtenBytes;
+    const bool queueGrew = m_hasMeasure && pendingBytes > m_lastPendingBytes;
+    m_lastPendingBytes = pendingBytes;
+    m_hasMeasure = true;
+
+    const double fill = pendingCapacity > 0 ? static_cast<double>(pendingBytes) / pendingCapacity : 0.;
+    const double budget = static_cast<double>(m_settings.budgetBytesPerSecond);
+    RecordingGovernorReason reason = RecordingGovernorReason::Recovered;
+    if (fill > m_settings.highWatermark)
+    {
+        reason = RecordingGovernorReason::QueueFull;
+    }
+    else if (queueGrew && fill > m_settings.lowWatermark && inputBytesPerSecond > writeBytesPerSecond * kBacklogRatio)
+    {
+        reason = RecordingGovernorReason::Backlog;
+    }
+    else if (budget > 0. && inputBytesPerSecond > budget)
+    {
+        reason = RecordingGovernorReason::Budget;
+    }
+
+    RecordingGovernorEvent event{};
+    event.reason = reason;
+    event.writeBytesPerSecond = static_cast<uint64_t>(writeBytesPerSecond);
+    event.inputBytesPerSecond = static_cast<uint64_t>(inputBytesPerSecond);
+    event.pendingBytes = pendingBytes;
+
+    Stream* pAdjusted = nullptr;
+    SharedStream adjusted = SharedStream::PV;
+    if (reason != RecordingGovernorReason::Recovered)
+    {
+        m_calmPeriods = 0;
+        // Lowest priority stream which still records something and can be degraded
+        for (auto stream = m_priority.rbegin(); stream != m_priority.rend() && !pAdjusted; ++stream)
+        {
+            Stream& state = m_streams[static_cast<size_t>(*stream)];
+            if (state.bytesPerSecond > 0. && state.level < GetMaxLevel(state.canCompress))
+            {
+                pAdjusted = &state;
+                adjusted = *stream;
+                event.streamBytesPerSecond = static_cast<uint64_t>(state.bytesPerSecond);
+                state.level++;
+            }
+        }
+    }
+    else if (fill >= m_settings.lowWatermark || queueGrew || (budget > 0. && inputBytesPerSecond >= budget * kBudgetRestoreRatio))
+    {
+        m_calmPeriods = 0;
+    }
+    else if (++m_calmPeriods >= m_settings.restorePeriods)
+    {
+        m_calmPeriods = 0;
+        // Highest priority degraded stream
+        for (auto stream = m_priority.begin(); stream != m_priority.end() && !pAdjusted; ++stream)
+        {
+            Stream& state = m_streams[static_cast<size_t>(*stream)];
+            if (state.level > 0)
+            {
+                pAdjusted = &state;
+                adjusted = *stream;
+                event.streamBytesPerSecond = static_cast<uint64_t>(state.bytesPerSecond);
+                state.level--;
+            }
+        }
+    }
+
+    if (pAdjusted)
+    {
+        const RecordingStreamQuality quality = GetLevelQuality(pAdjusted->level, pAdjusted->canCompress);
+        event.stream = static_cast<uint16_t>(adjusted);
+        event.level = quality.level;
+        event.compress = quality.compress ? 1 : 0;
+        event.keepEveryNth = quality.keepEveryNth;
+        event.resolutionDivisor = quality.resolutionDivisor;
+        events.push_back(event);
+        m_adjustments++;
+    }
+}
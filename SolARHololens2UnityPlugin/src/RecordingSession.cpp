@@ -0,0 +1,211 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RecordingSession.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    // IMU sensors deliver batches every few milliseconds
+    constexpr auto kImuPollPeriod = std::chrono::milliseconds(4);
+
+    // Nearest pixel downscaling of every plane
+    void Downscale(const SolARHL2FrameMetadata& metadata, const uint8_t* pPixels, uint32_t divisor,
+                   SolARHL2FrameMetadata& downscaledMetadata, std::vector<uint8_t>& downscaled)
+    {
+        const uint32_t width = metadata.width / divisor;
+        const uint32_t height = metadata.height / divisor;
+        const size_t pixelSize = metadata.bytesPerPixel;
+        downscaledMetadata = metadata;
+        downscaledMetadata.width = width;
+        downscaledMetadata.height = height;
+        downscaledMetadata.dataSize = width * height * metadata.bytesPerPixel * metadata.planeCount;
+        downscaled.resize(downscaledMetadata.dataSize);
+
+        uint8_t* pDestination = downscaled.data();
+        for (uint32_t plane = 0; plane < metadata.planeCount; ++plane)
+        {
+            const uint8_t* pPlane = pPixels + size_t(plane) * metadata.width * metadata.height * pixelSize;
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                const uint8_t* pRow = pPlane + size_t(y) * divisor * metadata.width * pixelSize;
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    std::memcpy(pDestination, pRow + size_t(x) * divisor * pixelSize, pixelSize);
+                    pDestination += pixelSize;
+                }
+            }
+        }
+    }
+}
+
+bool RecordingSession::Open(const std::filesystem::path& path, const RecordingWriterSettings& settings)
+{
+    Close();
+    if (!m_writer.Open(path, settings))
+    {
+        return false;
+    }
+    m_fExit = false;
+    m_pPollThread = std::make_unique<std::thread>(PollThread, this);
+    return true;
+}
+
+void RecordingSession::Close()
+{
+    m_fExit = true;
+    if (m_pPollThread && m_pPollThread->joinable())
+    {
+        m_pPollThread->join();
+    }
+    m_pPollThread.reset();
+    m_imuStreams.clear();
+    // Stop the deliveries before the writer they write to
+    m_frameStreams.clear();
+    m_writer.Close();
+}
+
+void RecordingSession::EnableGovernor(const RecordingGovernorSettings& settings, const std::vector<SharedStream>& priority)
+{
+    auto governor = std::make_unique<RecordingGovernor>(settings);
+    // The PV stream is the only one without a lossless codec
+    std::vector<SharedStream> canCompress;
+    for (SharedStream stream : priority)
+    {
+        if (stream != SharedStream::PV)
+        {
+            canCompress.push_back(stream);
+        }
+    }
+    governor->SetPriority(priority, canCompress);
+
+    std::lock_guard<ProfiledMutex> guard(m_pollMutex);
+    m_governor = std::move(governor);
+}
+
+void RecordingSession::AddFrameStream(SharedStream stream, FramePublisher& publisher, RecordingCalibrationSource calibration)
+{
+    auto frameStream = std::make_unique<FrameStream>();
+    frameStream->stream = stream;
+    frameStream->calibration = std::move(calibration);
+    FrameStream* pFrameStream = frameStream.get();
+    frameStream->subscription = publisher.Subscribe([this, pFrameStream](const SharedFramePtr& frame)
+    {
+        WriteFrame(*pFrameStream, frame);
+    }, kFrameQueueCapacity, DropPolicy::DropOldest, TaskPriority::Recording);
+    m_frameStreams.push_back(std::move(frameStream));
+}
+
+void RecordingSession::AddImuStream(SharedStream stream, const ImuReader& reader)
+{
+    auto imuStream = std::make_unique<ImuStream>();
+    imuStream->stream = stream;
+    imuStream->pReader = &reader;
+    imuStream->lastIndex = reader.getLastIndex();
+
+    std::lock_guard<ProfiledMutex> guard(m_pollMutex);
+    m_imuStreams.push_back(std::move(imuStream));
+}
+
+void RecordingSession::WriteFrame(FrameStream& stream, const SharedFramePtr& frame)
+{
+    m_lastTimestamp = frame->timestamp;
+    if (stream.calibration && !stream.calibrationWritten)
+    {
+        RecordingCalibration calibration{};
+        std::vector<float> rays;
+        // Resolution is known once the first frame was received
+        if (stream.calibration(calibration, rays) && rays.size() == size_t(calibration.width) * calibration.height * 3)
+        {
+            stream.calibrationWritten = m_writer.WriteCalibration(stream.stream, frame->timestamp, calibration, rays.data());
+        }
+    }
+
+    const RecordingStreamQuality quality = m_governor ? m_governor->GetQuality(stream.stream) : RecordingStreamQuality();
+    if (stream.frameCount++ % quality.keepEveryNth != 0)
+    {
+        return;
+    }
+
+    SolARHL2FrameMetadata metadata{};
+    FillFrameMetadata(*frame, stream.stream == SharedStream::PV, metadata);
+    if (quality.resolutionDivisor > 1)
+    {
+        SolARHL2FrameMetadata downscaledMetadata;
+        Downscale(metadata, frame->data.data(), quality.resolutionDivisor, downscaledMetadata, stream.downscaled);
+        m_writer.WriteFrame(stream.stream, downscaledMetadata, stream.downscaled.data());
+        m_governor->AddInput(stream.stream, downscaledMetadata.dataSize);
+        return;
+    }
+    // The frame is referenced, not copied, until written
+    m_writer.WriteFrame(stream.stream, metadata, frame->data.data(), frame);
+    if (m_governor)
+    {
+        m_governor->AddInput(stream.stream, metadata.dataSize);
+    }
+}
+
+void RecordingSession::UpdateGovernor(double seconds)
+{
+    const RecordingWriterStats stats = m_writer.GetStats();
+    m_governorEvents.clear();
+    m_governor->Update(seconds, stats.bytes, stats.pendingBytes, m_writer.GetSettings().maxPendingBytes, m_governorEvents);
+    for (const RecordingGovernorEvent& event : m_governorEvents)
+    {
+        m_writer.SetStreamCompression(event.stream, event.compress != 0);
+        m_writer.Write(RecordingRecordType::Governor, event.stream, m_lastTimestamp, &event, sizeof(event), nullptr, 0);
+    }
+}
+
+void RecordingSession::PollThread(RecordingSession* pSession)
+{
+    ScopedThreadProfile profile("RecordingSession::PollThread");
+
+    auto lastGovernorUpdate = std::chrono::steady_clock::now();
+    while (!pSession->m_fExit)
+    {
+        {
+            std::lock_guard<ProfiledMutex> guard(pSession->m_pollMutex);
+            for (auto& imuStream : pSession->m_imuStreams)
+            {
+                imuStream->samples.clear();
+                imuStream->pReader->getSamples(imuStream->lastIndex, imuStream->samples);
+                if (imuStream->samples.empty())
+                {
+                    continue;
+                }
+                imuStream->batch.clear();
+                for (const ImuSample& sample : imuStream->samples)
+                {
+                    imuStream->batch.push_back({ sample.index, sample.timestamp, sample.sensorTicks,
+                                                 sample.x, sample.y, sample.z, sample.temperature });
+                }
+                pSession->m_writer.WriteImu(imuStream->stream, imuStream->batch.data(), imuStream->batch.size());
+                imuStream->lastIndex = imuStream->samples.back().index;
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            if (pSession->m_governor && now - lastGovernorUpdate >= std::chrono::milliseconds(kGovernorPeriodMs))
+            {
+                pSession->UpdateGovernor(std::chrono::duration<double>(now - lastGovernorUpdate).count());
+                lastGovernorUpdate = now;
+            }
+        }
+        std::this_thread::sleep_for(kImuPollPeriod);
+    }
+}
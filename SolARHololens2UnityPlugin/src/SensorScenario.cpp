@@ -34,6 +34,8 @@ HMODULE LoadLibraryA(
 
 static ResearchModeSensorConsent camAccessCheck;
 static HANDLE camConsentGiven;
+static ResearchModeSensorConsent imuAccessCheck;
+static HANDLE imuConsentGiven;
 
 SensorScenario::SensorScenario(const std::vector<ResearchModeSensorType>& kEnabledSensorTypes) :
 	m_kEnabledSensorTypes(kEnabledSensorTypes)
@@ -66,6 +68,18 @@ SensorScenario::~SensorScenario()
 	{
 		m_pAHATSensor->Release();
 	}
+	if (m_pAccelSensor)
+	{
+		m_pAccelSensor->Release();
+	}
+	if (m_pGyroSensor)
+	{
+		m_pGyroSensor->Release();
+	}
+	if (m_pMagSensor)
+	{
+		m_pMagSensor->Release();
+	}
 
 	if (m_pSensorDevice)
 	{
@@ -91,6 +105,7 @@ void SensorScenario::InitializeSensors()
 {
 	size_t sensorCount = 0;
 	camConsentGiven = CreateEvent(nullptr, true, false, nullptr);
+	imuConsentGiven = CreateEvent(nullptr, true, false, nullptr);
 
 	// Load Research Mode library
 	HMODULE hrResearchMode = LoadLibraryA("ResearchModeAPI");
@@ -108,6 +123,15 @@ void SensorScenario::InitializeSensors()
 	winrt::check_hresult(m_pSensorDevice->QueryInterface(IID_PPV_ARGS(&m_pSensorDeviceConsent)));
 	winrt::check_hresult(m_pSensorDeviceConsent->RequestCamAccessAsync(SensorScenario::CamAccessOnComplete));	
 
+	const bool isImuEnabled = std::any_of(m_kEnabledSensorTypes.begin(), m_kEnabledSensorTypes.end(), [](ResearchModeSensorType sensorType)
+	{
+		return sensorType == IMU_ACCEL || sensorType == IMU_GYRO || sensorType == IMU_MAG;
+	});
+	if (isImuEnabled)
+	{
+		winrt::check_hresult(m_pSensorDeviceConsent->RequestIMUAccessAsync(SensorScenario::ImuAccessOnComplete));
+	}
+
 	m_pSensorDevice->DisableEyeSelection();
 
 	m_pSensorDevice->GetSensorCount(&sensorCount);
@@ -176,6 +200,33 @@ void SensorScenario::InitializeSensors()
 			}
 			winrt::check_hresult(m_pSensorDevice->GetSensor(sensorDescriptor.sensorType, &m_pAHATSensor));
 		}
+
+		if (sensorDescriptor.sensorType == IMU_ACCEL)
+		{
+			if (std::find(m_kEnabledSensorTypes.begin(), m_kEnabledSensorTypes.end(), IMU_ACCEL) == m_kEnabledSensorTypes.end())
+			{
+				continue;
+			}
+			winrt::check_hresult(m_pSensorDevice->GetSensor(sensorDescriptor.sensorType, &m_pAccelSensor));
+		}
+
+		if (sensorDescriptor.sensorType == IMU_GYRO)
+		{
+			if (std::find(m_kEnabledSensorTypes.begin(), m_kEnabledSensorTypes.end(), IMU_GYRO) == m_kEnabledSensorTypes.end())
+			{
+				continue;
+			}
+			winrt::check_hresult(m_pSensorDevice->GetSensor(sensorDescriptor.sensorType, &m_pGyroSensor));
+		}
+
+		if (sensorDescriptor.sensorType == IMU_MAG)
+		{
+			if (std::find(m_kEnabledSensorTypes.begin(), m_kEnabledSensorTypes.end(), IMU_MAG) == m_kEnabledSensorTypes.end())
+			{
+				continue;
+			}
+			winrt::check_hresult(m_pSensorDevice->GetSensor(sensorDescriptor.sensorType, &m_pMagSensor));
+		}
 	}	
 }
 
@@ -185,6 +236,12 @@ void SensorScenario::CamAccessOnComplete(ResearchModeSensorConsent consent)
 	SetEvent(camConsentGiven);
 }
 
+void SensorScenario::ImuAccessOnComplete(ResearchModeSensorConsent consent)
+{
+	imuAccessCheck = consent;
+	SetEvent(imuConsentGiven);
+}
+
 void SensorScenario::InitializeCameraReaders()
 {
 	// Get RigNode id which will be used to initialize
@@ -194,60 +251,92 @@ void SensorScenario::InitializeCameraReaders()
 
 	if (m_pLFCameraSensor)
 	{
-		auto cameraReader = std::make_shared<RMCameraReader>(m_pLFCameraSensor, camConsentGiven, &camAccessCheck, guid);
+		auto cameraReader = std::make_shared<VlcCameraReader>(m_pLFCameraSensor, camConsentGiven, &camAccessCheck, guid);
 		m_cameraReaders.insert_or_assign(ResearchModeSensorType::LEFT_FRONT, cameraReader);
+		m_vlcCameraReaders.insert_or_assign(ResearchModeSensorType::LEFT_FRONT, cameraReader);
 	}
 
 	if (m_pRFCameraSensor)
 	{
-		auto cameraReader = std::make_shared<RMCameraReader>(m_pRFCameraSensor, camConsentGiven, &camAccessCheck, guid);
+		auto cameraReader = std::make_shared<VlcCameraReader>(m_pRFCameraSensor, camConsentGiven, &camAccessCheck, guid);
 		m_cameraReaders.insert_or_assign(ResearchModeSensorType::RIGHT_FRONT, cameraReader);
+		m_vlcCameraReaders.insert_or_assign(ResearchModeSensorType::RIGHT_FRONT, cameraReader);
 	}
 
 	if (m_pLLCameraSensor)
 	{
-		auto cameraReader = std::make_shared<RMCameraReader>(m_pLLCameraSensor, camConsentGiven, &camAccessCheck, guid);
+		auto cameraReader = std::make_shared<VlcCameraReader>(m_pLLCameraSensor, camConsentGiven, &camAccessCheck, guid);
 		m_cameraReaders.insert_or_assign(ResearchModeSensorType::LEFT_LEFT, cameraReader);
+		m_vlcCameraReaders.insert_or_assign(ResearchModeSensorType::LEFT_LEFT, cameraReader);
 	}
 
 	if (m_pRRCameraSensor)
 	{
-		auto cameraReader = std::make_shared<RMCameraReader>(m_pRRCameraSensor, camConsentGiven, &camAccessCheck, guid);
+		auto cameraReader = std::make_shared<VlcCameraReader>(m_pRRCameraSensor, camConsentGiven, &camAccessCheck, guid);
 		m_cameraReaders.insert_or_assign(ResearchModeSensorType::RIGHT_RIGHT, cameraReader);
+		m_vlcCameraReaders.insert_or_assign(ResearchModeSensorType::RIGHT_RIGHT, cameraReader);
 	}
 
 	if (m_pLTSensor)
 	{
-		auto cameraReader = std::make_shared<RMCameraReader>(m_pLTSensor, camConsentGiven, &camAccessCheck, guid);
+		auto cameraReader = std::make_shared<DepthCameraReader>(m_pLTSensor, camConsentGiven, &camAccessCheck, guid);
 		m_cameraReaders.insert_or_assign(ResearchModeSensorType::DEPTH_LONG_THROW, cameraReader);
 		m_depthCameraReader = cameraReader;
 	}
 
 	if (m_pAHATSensor)
 	{
-		auto cameraReader = std::make_shared<RMCameraReader>(m_pAHATSensor, camConsentGiven, &camAccessCheck, guid);
+		auto cameraReader = std::make_shared<DepthCameraReader>(m_pAHATSensor, camConsentGiven, &camAccessCheck, guid);
 		m_cameraReaders.insert_or_assign(ResearchModeSensorType::DEPTH_AHAT, cameraReader);
 		m_depthCameraReader = cameraReader;
 	}	
 }
 
+void SensorScenario::InitializeImuReaders()
+{
+	if (m_pAccelSensor)
+	{
+		m_imuReaders.insert_or_assign(ResearchModeSensorType::IMU_ACCEL, std::make_shared<ImuReader>(m_pAccelSensor, imuConsentGiven, &imuAccessCheck));
+	}
+
+	if (m_pGyroSensor)
+	{
+		m_imuReaders.insert_or_assign(ResearchModeSensorType::IMU_GYRO, std::make_shared<ImuReader>(m_pGyroSensor, imuConsentGiven, &imuAccessCheck));
+	}
+
+	if (m_pMagSensor)
+	{
+		m_imuReaders.insert_or_assign(ResearchModeSensorType::IMU_MAG, std::make_shared<ImuReader>(m_pMagSensor, imuConsentGiven, &imuAccessCheck));
+	}
+}
+
 void SensorScenario::StartRecording(const winrt::Windows::Storage::StorageFolder& folder,
-									const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem)
+									const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem,
+									const std::shared_ptr<StagingArena>& stagingArena)
 {
 	for (auto const& [sensorType, camReader] : m_cameraReaders)
 	{
 		camReader->SetWorldCoordSystem(worldCoordSystem);
-		camReader->SetStorageFolder(folder);
+		camReader->SetStorageFolder(folder, stagingArena);
 		camReader->start();
 	}
+	for (auto const& [sensorType, imuReader] : m_imuReaders)
+	{
+		imuReader->start();
+	}
 }
 
 void SensorScenario::StopRecording()
 {
 	for (auto const& [sensorType, camReader] : m_cameraReaders)
 	{
-		camReader->ResetStorageFolder();
+		// The pending write tasks complete before the tarball is closed
 		camReader->stop();
+		camReader->ResetStorageFolder();
+	}
+	for (auto const& [sensorType, imuReader] : m_imuReaders)
+	{
+		imuReader->stop();
 	}
 }
 
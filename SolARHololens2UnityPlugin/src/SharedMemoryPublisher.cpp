@@ -0,0 +1,152 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SharedMemoryPublisher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    // IMU sensors deliver batches every few milliseconds
+    constexpr auto kImuPollPeriod = std::chrono::milliseconds(4);
+}
+
+SharedMemoryPublisher::SharedMemoryPublisher(uint32_t frameSlotCount)
+    : m_frameSlotCount(frameSlotCount > 0 ? frameSlotCount : kDefaultFrameSlotCount)
+{
+}
+
+SharedMemoryPublisher::~SharedMemoryPublisher()
+{
+    m_fExit = true;
+    if (m_pImuThread && m_pImuThread->joinable())
+    {
+        m_pImuThread->join();
+    }
+    // Stop the deliveries before the rings they write to
+    for (auto& frameStream : m_frameStreams)
+    {
+        frameStream->subscription.reset();
+    }
+}
+
+void SharedMemoryPublisher::AddFrameStream(SharedStream stream, FramePublisher& publisher)
+{
+    auto frameStream = std::make_unique<FrameStream>();
+    frameStream->stream = stream;
+    FrameStream* pFrameStream = frameStream.get();
+    frameStream->subscription = publisher.Subscribe([this, pFrameStream](const SharedFramePtr& frame)
+    {
+        WriteFrame(*pFrameStream, *frame);
+    });
+    m_frameStreams.push_back(std::move(frameStream));
+}
+
+bool SharedMemoryPublisher::AddImuStream(SharedStream stream, const ImuReader& reader)
+{
+    auto imuStream = std::make_unique<ImuStream>();
+    imuStream->pReader = &reader;
+    imuStream->lastIndex = reader.getLastIndex();
+    imuStream->batch.reserve(kMaxImuSamplesPerRecord);
+    if (!imuStream->ring.Create(GetSharedStreamName(stream), kImuSlotCount,
+                                kMaxImuSamplesPerRecord * sizeof(SharedImuSample),
+                                static_cast<uint32_t>(SharedRecordType::ImuSamples)))
+    {
+        return false;
+    }
+
+    std::lock_guard<ProfiledMutex> guard(m_imuMutex);
+    m_imuStreams.push_back(std::move(imuStream));
+    if (!m_pImuThread)
+    {
+        m_pImuThread = std::make_unique<std::thread>(ImuThread, this);
+    }
+    return true;
+}
+
+bool SharedMemoryPublisher::EnableHeadPoses()
+{
+    return m_headPoseRing.Create(GetSharedStreamName(SharedStream::HEAD_POSE), kHeadPoseSlotCount,
+                                 sizeof(SharedHeadPose), static_cast<uint32_t>(SharedRecordType::HeadPose));
+}
+
+void SharedMemoryPublisher::PublishHeadPose(const SharedHeadPose& pose)
+{
+    m_headPoseRing.Write(pose.timestamp, &pose, sizeof(pose));
+}
+
+void SharedMemoryPublisher::WriteFrame(FrameStream& stream, const SharedFrame& frame)
+{
+    const size_t size = sizeof(SolARHL2FrameMetadata) + frame.data.size();
+    if (!stream.ring.IsOpen() && !stream.failed)
+    {
+        stream.failed = !stream.ring.Create(GetSharedStreamName(stream.stream), m_frameSlotCount,
+                                            static_cast<uint32_t>(size), static_cast<uint32_t>(SharedRecordType::Frame));
+    }
+
+    uint8_t* pRecord = (stream.ring.IsOpen() && size <= stream.ring.GetSlotCapacity())
+                           ? stream.ring.BeginWrite(static_cast<uint32_t>(size))
+                           : nullptr;
+    if (!pRecord)
+    {
+        m_droppedFrames++;
+        return;
+    }
+
+    SolARHL2FrameMetadata metadata{};
+    FillFrameMetadata(frame, stream.stream == SharedStream::PV, metadata);
+
+    std::memcpy(pRecord, &metadata, sizeof(metadata));
+    std::memcpy(pRecord + sizeof(metadata), frame.data.data(), frame.data.size());
+    stream.ring.Commit(frame.timestamp);
+}
+
+void SharedMemoryPublisher::ImuThread(SharedMemoryPublisher* pPublisher)
+{
+    ScopedThreadProfile profile("SharedMemoryPublisher::ImuThread");
+
+    while (!pPublisher->m_fExit)
+    {
+        {
+            std::lock_guard<ProfiledMutex> guard(pPublisher->m_imuMutex);
+            for (auto& imuStream : pPublisher->m_imuStreams)
+            {
+                imuStream->samples.clear();
+                imuStream->pReader->getSamples(imuStream->lastIndex, imuStream->samples);
+                for (size_t first = 0; first < imuStream->samples.size(); first += kMaxImuSamplesPerRecord)
+                {
+                    const size_t count = std::min<size_t>(kMaxImuSamplesPerRecord, imuStream->samples.size() - first);
+                    imuStream->batch.clear();
+                    for (size_t i = first; i < first + count; ++i)
+                    {
+                        const ImuSample& sample = imuStream->samples[i];
+                        imuStream->batch.push_back({ sample.index, sample.timestamp, sample.sensorTicks,
+                                                     sample.x, sample.y, sample.z, sample.temperature });
+                    }
+                    imuStream->ring.Write(imuStream->batch.back().timestamp, imuStream->batch.data(),
+                                          static_cast<uint32_t>(count * sizeof(SharedImuSample)));
+                }
+                if (!imuStream->samples.empty())
+                {
+                    imuStream->lastIndex = imuStream->samples.back().index;
+                }
+            }
+        }
+        std::this_thread::sleep_for(kImuPollPeriod);
+    }
+}
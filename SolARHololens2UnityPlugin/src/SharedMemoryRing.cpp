@@ -0,0 +1,386 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SharedMemoryRing.h"
+
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr size_t kSlotAlignment = 64;
+
+    uint64_t GetCurrentProcessId64()
+    {
+#ifdef _WIN32
+        return GetCurrentProcessId();
+#else
+        return static_cast<uint64_t>(getpid());
+#endif
+    }
+
+    // Whether name is a ring whose producer process exited without removing it
+    bool IsStaleRing(const std::string& name)
+    {
+#ifdef _WIN32
+        (void)name;
+        return false;
+#else
+        SharedMemoryRegion region;
+        if (!region.Open(name))
+        {
+            // Not even a complete header, a producer died while creating it
+            return true;
+        }
+        const auto* pHeader = reinterpret_cast<const SharedRingHeader*>(region.GetData());
+        const pid_t producer = static_cast<pid_t>(pHeader->producerProcessId);
+        return producer <= 0 || (kill(producer, 0) != 0 && errno == ESRCH);
+#endif
+    }
+
+    size_t AlignSlot(size_t size)
+    {
+        return (size + kSlotAlignment - 1) & ~(kSlotAlignment - 1);
+    }
+
+#ifdef _WIN32
+    std::wstring ToMappingName(const std::string& name)
+    {
+        // Session namespace, or the app container one when called from the UWP app (see SharedMemoryRing.h)
+        return L"Local\\" + std::wstring(name.begin(), name.end());
+    }
+#else
+    std::string ToMappingName(const std::string& name)
+    {
+        return "/" + name;
+    }
+#endif
+}
+
+bool SharedMemoryRegion::Create(const std::string& name, size_t size)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingFromApp(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, size, ToMappingName(name).c_str());
+    if (!mapping)
+    {
+        return false;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+    m_mappingHandle = mapping;
+    m_pData = static_cast<uint8_t*>(MapViewOfFileFromApp(mapping, FILE_MAP_WRITE, 0, size));
+#else
+    const int file = shm_open(ToMappingName(name).c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (file < 0)
+    {
+        return false;
+    }
+    void* pData = MAP_FAILED;
+    if (ftruncate(file, static_cast<off_t>(size)) == 0)
+    {
+        pData = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    }
+    close(file);
+    m_pData = pData != MAP_FAILED ? static_cast<uint8_t*>(pData) : nullptr;
+#endif
+    m_name = name;
+    m_size = size;
+    m_isOwner = true;
+    if (!m_pData)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool SharedMemoryRegion::Open(const std::string& name)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingFromApp(FILE_MAP_READ, FALSE, ToMappingName(name).c_str());
+    if (!mapping)
+    {
+        return false;
+    }
+    m_mappingHandle = mapping;
+    m_pData = static_cast<uint8_t*>(MapViewOfFileFromApp(mapping, FILE_MAP_READ, 0, 0));
+    MEMORY_BASIC_INFORMATION info;
+    m_size = (m_pData && VirtualQuery(m_pData, &info, sizeof(info))) ? info.RegionSize : 0;
+#else
+    const int file = shm_open(ToMappingName(name).c_str(), O_RDONLY, 0);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    void* pData = MAP_FAILED;
+    if (fstat(file, &status) == 0 && status.st_size > 0)
+    {
+        m_size = static_cast<size_t>(status.st_size);
+        pData = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, file, 0);
+    }
+    close(file);
+    m_pData = pData != MAP_FAILED ? static_cast<uint8_t*>(pData) : nullptr;
+#endif
+    m_name = name;
+    m_isOwner = false;
+    if (!m_pData || m_size < sizeof(SharedRingHeader))
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void SharedMemoryRegion::Remove(const std::string& name)
+{
+#ifndef _WIN32
+    shm_unlink(ToMappingName(name).c_str());
+#endif
+}
+
+void SharedMemoryRegion::Close()
+{
+#ifdef _WIN32
+    if (m_pData)
+    {
+        UnmapViewOfFile(m_pData);
+    }
+    if (m_mappingHandle)
+    {
+        CloseHandle(m_mappingHandle);
+    }
+#else
+    if (m_pData)
+    {
+        munmap(m_pData, m_size);
+    }
+    if (m_isOwner)
+    {
+        shm_unlink(ToMappingName(m_name).c_str());
+    }
+#endif
+    m_pData = nullptr;
+    m_size = 0;
+    m_mappingHandle = nullptr;
+    m_isOwner = false;
+}
+
+bool SharedMemoryRingWriter::Create(const std::string& name, uint32_t slotCount, uint32_t slotCapacity, uint32_t recordType)
+{
+    Close();
+    if (slotCount == 0)
+    {
+        return false;
+    }
+
+    const size_t slotStride = AlignSlot(sizeof(SharedSlotHeader) + slotCapacity);
+    const size_t size = sizeof(SharedRingHeader) + slotCount * slotStride;
+    if (!m_region.Create(name, size))
+    {
+        if (!IsStaleRing(name))
+        {
+            return false;
+        }
+        // Readers still mapping the old region keep it, they need to reopen the name
+        SharedMemoryRegion::Remove(name);
+        if (!m_region.Create(name, size))
+        {
+            return false;
+        }
+    }
+
+    // New regions are zero-filled: only the header needs to be constructed, slot versions are 0
+    m_pHeader = new (m_region.GetData()) SharedRingHeader();
+    m_pHeader->headerSize = sizeof(SharedRingHeader);
+    m_pHeader->slotCount = slotCount;
+    m_pHeader->slotStride = static_cast<uint32_t>(slotStride);
+    m_pHeader->slotCapacity = slotCapacity;
+    m_pHeader->recordType = recordType;
+    m_pHeader->producerProcessId = GetCurrentProcessId64();
+    m_pendingRecord = 0;
+    return true;
+}
+
+uint8_t* SharedMemoryRingWriter::BeginWrite(uint32_t size)
+{
+    if (!m_pHeader || size > m_pHeader->slotCapacity)
+    {
+        return nullptr;
+    }
+
+    m_pendingRecord = m_pHeader->writeCount.load(std::memory_order_relaxed) + 1;
+    m_pendingSize = size;
+    SharedSlotHeader* pSlot = Slot(m_pendingRecord);
+    pSlot->version.store(2 * m_pendingRecord - 1, std::memory_order_relaxed);
+    // Readers seeing any of the new payload also see the odd version
+    std::atomic_thread_fence(std::memory_order_release);
+    return reinterpret_cast<uint8_t*>(pSlot + 1);
+}
+
+void SharedMemoryRingWriter::Commit(uint64_t timestamp)
+{
+    if (!m_pHeader || m_pendingRecord == 0)
+    {
+        return;
+    }
+
+    SharedSlotHeader* pSlot = Slot(m_pendingRecord);
+    pSlot->timestamp = timestamp;
+    pSlot->size = m_pendingSize;
+    pSlot->version.store(2 * m_pendingRecord, std::memory_order_release);
+    m_pHeader->writeCount.store(m_pendingRecord, std::memory_order_release);
+    m_pendingRecord = 0;
+}
+
+bool SharedMemoryRingWriter::Write(uint64_t timestamp, const void* pData, uint32_t size)
+{
+    uint8_t* pPayload = BeginWrite(size);
+    if (!pPayload)
+    {
+        return false;
+    }
+    std::memcpy(pPayload, pData, size);
+    Commit(timestamp);
+    return true;
+}
+
+SharedSlotHeader* SharedMemoryRingWriter::Slot(uint64_t record) const
+{
+    return reinterpret_cast<SharedSlotHeader*>(
+        m_region.GetData() + m_pHeader->headerSize + ((record - 1) % m_pHeader->slotCount) * m_pHeader->slotStride);
+}
+
+bool SharedMemoryRingReader::Open(const std::string& name)
+{
+    Close();
+    if (!m_region.Open(name))
+    {
+        return false;
+    }
+
+    const auto* pHeader = reinterpret_cast<const SharedRingHeader*>(m_region.GetData());
+    if (std::memcmp(pHeader->magic, SharedRingHeader().magic, sizeof(pHeader->magic)) != 0 ||
+        pHeader->version != SharedRingHeader::kVersion ||
+        pHeader->headerSize < sizeof(SharedRingHeader) || pHeader->slotCount == 0 ||
+        pHeader->slotStride < sizeof(SharedSlotHeader) + pHeader->slotCapacity ||
+        pHeader->headerSize + static_cast<size_t>(pHeader->slotCount) * pHeader->slotStride > m_region.GetSize())
+    {
+        Close();
+        return false;
+    }
+    m_pHeader = pHeader;
+    return true;
+}
+
+uint64_t SharedMemoryRingReader::GetLatestRecord() const
+{
+    return m_pHeader ? m_pHeader->writeCount.load(std::memory_order_acquire) : 0;
+}
+
+uint64_t SharedMemoryRingReader::GetOldestRecord() const
+{
+    const uint64_t latest = GetLatestRecord();
+    if (latest == 0)
+    {
+        return 0;
+    }
+    // The slot after the latest one may be being overwritten
+    return latest >= m_pHeader->slotCount ? latest - m_pHeader->slotCount + 2 : 1;
+}
+
+bool SharedMemoryRingReader::Peek(uint64_t record, SharedRecordView& view) const
+{
+    if (!m_pHeader || record == 0)
+    {
+        return false;
+    }
+
+    const SharedSlotHeader* pSlot = Slot(record);
+    if (pSlot->version.load(std::memory_order_acquire) != 2 * record)
+    {
+        return false;
+    }
+    view.record = record;
+    view.timestamp = pSlot->timestamp;
+    view.size = pSlot->size;
+    view.data = reinterpret_cast<const uint8_t*>(pSlot + 1);
+    // Reject sizes torn by a concurrent write, IsValid() fails in that case anyway
+    if (view.size > m_pHeader->slotCapacity)
+    {
+        view.size = 0;
+    }
+    return IsValid(view);
+}
+
+bool SharedMemoryRingReader::IsValid(const SharedRecordView& view) const
+{
+    if (!m_pHeader || view.record == 0)
+    {
+        return false;
+    }
+    // Payload reads of the caller happen before the version check
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return Slot(view.record)->version.load(std::memory_order_relaxed) == 2 * view.record;
+}
+
+bool SharedMemoryRingReader::Read(uint64_t record, SharedRecordView& view, std::vector<uint8_t>& data) const
+{
+    if (!Peek(record, view))
+    {
+        return false;
+    }
+    data.assign(view.data, view.data + view.size);
+    if (!IsValid(view))
+    {
+        data.clear();
+        return false;
+    }
+    view.data = data.data();
+    return true;
+}
+
+const SharedSlotHeader* SharedMemoryRingReader::Slot(uint64_t record) const
+{
+    return reinterpret_cast<const SharedSlotHeader*>(
+        m_region.GetData() + m_pHeader->headerSize + ((record - 1) % m_pHeader->slotCount) * m_pHeader->slotStride);
+}
+
+std::string GetSharedStreamName(SharedStream stream)
+{
+    static const char* kNames[] = { "PV", "LEFT_FRONT", "LEFT_LEFT", "RIGHT_FRONT", "RIGHT_RIGHT", "DEPTH",
+                                    "IMU_ACCEL", "IMU_GYRO", "IMU_MAG", "HEAD_POSE" };
+    const auto index = static_cast<size_t>(stream);
+    return std::string("SolARHL2_") + (index < sizeof(kNames) / sizeof(kNames[0]) ? kNames[index] : "UNKNOWN");
+}
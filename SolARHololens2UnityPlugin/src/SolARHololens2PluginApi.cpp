@@ -0,0 +1,50 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// SolARHL2_OpenStream(), the only function of the flat C API depending on the plugin instance.
+// The other ones are implemented by PluginApiStream.cpp.
+
+#include "pch.h"
+#include "SolARHololens2PluginApi.h"
+#include "SolARHololens2ResearchMode.h"
+#include "PluginApiStream.h"
+
+using winrt::SolARHololens2UnityPlugin::SensorStream;
+using winrt::SolARHololens2UnityPlugin::implementation::SolARHololens2ResearchMode;
+
+SolARHL2Result SOLARHL2_API SolARHL2_OpenStream(
+    SolARHL2StreamId streamId, uint32_t queueCapacity, uint32_t maxAcquiredFrames, SolARHL2Stream** stream)
+{
+    if (!stream || streamId < SOLARHL2_STREAM_PV || streamId > SOLARHL2_STREAM_DEPTH)
+    {
+        return SOLARHL2_INVALID_ARGUMENT;
+    }
+    *stream = nullptr;
+
+    std::shared_ptr<FrameSubscriber> subscriber;
+    SolARHololens2ResearchMode::WithActiveInstance([&](SolARHololens2ResearchMode& researchMode)
+    {
+        if (FramePublisher* publisher = researchMode.GetFramePublisher(static_cast<SensorStream>(streamId)))
+        {
+            subscriber = publisher->Subscribe(queueCapacity > 0 ? queueCapacity : FramePublisher::kDefaultQueueCapacity);
+        }
+    });
+    if (!subscriber)
+    {
+        return SOLARHL2_NOT_AVAILABLE;
+    }
+    return CreatePluginApiStream(streamId, std::move(subscriber), maxAcquiredFrames, stream);
+}
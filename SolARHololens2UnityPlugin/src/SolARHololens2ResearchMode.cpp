@@ -17,9 +17,11 @@
 #include "pch.h"
 #include "SolARHololens2ResearchMode.h"
 #include "SolARHololens2ResearchMode.g.cpp"
-#include "Utils.h"
+#include "FrameClock.h"
+#include "PoseConversion.h"
 
 #include <winrt/Windows.Foundation.h>
+#include <algorithm>
 #include <ctime>
 
 #include <winrt/Windows.ApplicationModel.Core.h>
@@ -29,7 +31,6 @@ HMODULE LoadLibraryA(
     LPCSTR lpLibFileName
 );
 
-using namespace bcom::hololensdemo;
 
 using namespace DirectX;
 using namespace std;
@@ -45,6 +46,35 @@ typedef std::chrono::duration<int64_t, std::ratio<1, 10'000'000>> HundredsOfNano
 
 namespace winrt::SolARHololens2UnityPlugin::implementation
 {
+    namespace
+    {
+      // Live instances, in construction order, see WithActiveInstance()
+      ProfiledMutex s_instancesMutex{ "SolARHololens2ResearchMode::s_instancesMutex" };
+      std::vector<SolARHololens2ResearchMode*> s_instances;
+    }
+
+    SolARHololens2ResearchMode::SolARHololens2ResearchMode()
+    {
+      std::lock_guard<ProfiledMutex> guard( s_instancesMutex );
+      s_instances.push_back( this );
+    }
+
+    SolARHololens2ResearchMode::~SolARHololens2ResearchMode()
+    {
+      std::lock_guard<ProfiledMutex> guard( s_instancesMutex );
+      s_instances.erase( std::remove( s_instances.begin(), s_instances.end(), this ), s_instances.end() );
+    }
+
+    bool SolARHololens2ResearchMode::WithActiveInstance( const std::function<void( SolARHololens2ResearchMode& )>& function )
+    {
+      std::lock_guard<ProfiledMutex> guard( s_instancesMutex );
+      if ( s_instances.empty() )
+      {
+        return false;
+      }
+      function( *s_instances.back() );
+      return true;
+    }
 
     void SolARHololens2ResearchMode::SetSpatialCoordinateSystem( Windows::Perception::Spatial::SpatialCoordinateSystem unitySpatialCoodinateSystem)
     {
@@ -80,6 +110,20 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
             m_sensorScenario = std::make_unique<SensorScenario>(kEnabledRMStreamTypes);
             m_sensorScenario->InitializeSensors();
             m_sensorScenario->InitializeCameraReaders();
+            m_sensorScenario->InitializeImuReaders();
+        }
+
+        for ( const auto& streamRate : m_streamRateSettings )
+        {
+            ApplyStreamSettings( streamRate.first );
+        }
+        for ( const auto& keyframeSettings : m_keyframeSettings )
+        {
+            ApplyStreamSettings( keyframeSettings.first );
+        }
+        for ( const auto& sharpnessThreshold : m_sharpnessThresholds )
+        {
+            ApplyStreamSettings( sharpnessThreshold.first );
         }
 
         for (int i = 0; i < kEnabledStreamTypes.size(); ++i)
@@ -90,7 +134,9 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
             }
             else if (kEnabledStreamTypes[i] == StreamTypes::EYE)
             {
-                // m_mixedReality.EnableEyeTracking();
+                // Access is requested by the next MixedReality::Update()
+                m_mixedReality.EnableEyeTracking();
+                m_eyeGazeStream = std::make_unique<EyeGazeStream>();
             }
         }        
     }
@@ -125,6 +171,25 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
       }
     }
 
+    void SolARHololens2ResearchMode::EnableImu( ImuSensor sensor )
+    {
+      auto imuType = toHololensRMSensorType( sensor );
+      if ( std::find( kEnabledRMStreamTypes.begin(), kEnabledRMStreamTypes.end(), imuType ) ==
+           kEnabledRMStreamTypes.end() )
+      {
+        kEnabledRMStreamTypes.push_back( imuType );
+      }
+    }
+
+    void SolARHololens2ResearchMode::EnableEyeGaze()
+    {
+      if ( std::find( kEnabledStreamTypes.begin(), kEnabledStreamTypes.end(), StreamTypes::EYE ) ==
+           kEnabledStreamTypes.end() )
+      {
+        kEnabledStreamTypes.push_back( StreamTypes::EYE );
+      }
+    }
+
     bool SolARHololens2ResearchMode::EnableRecording()
     {
       // Code is mostly present but not tested and likely not working
@@ -156,6 +221,9 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
       if ( m_mixedReality.IsEnabled() )
       {
         m_mixedReality.Update();
+        UpdateWorldToFrameTransform();
+        RecordEyeGaze();
+        PublishHeadPose();
       }
             
 
@@ -186,16 +254,23 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
         if (m_videoFrameProcessor)
         {
             m_videoFrameProcessor->StopRecording();
-            if ( m_archiveFolder )
-            {
-                m_videoFrameProcessor->DumpDataToDisk( m_archiveFolder, m_datetime );
-            }
-           
         }
         if (m_sensorScenario)
         {
             m_sensorScenario->StopRecording();
         }
+        if ( m_eyeGazeStream )
+        {
+          m_eyeGazeStream->StopRecording();
+        }
+        // Readers are stopped, write the last records before the folder is renamed
+        StopContainerRecording();
+        if ( m_stagingArena )
+        {
+          m_stagingArena->Flush();
+          m_lastStagingStats = m_stagingArena->GetStats();
+          m_stagingArena.reset();
+        }
 
         m_recording = false;
 
@@ -246,6 +321,7 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
         {
             throw winrt::hresult(E_POINTER);
         }
+        ApplyStreamSettings( SensorStream::PV );
         co_await m_videoFrameProcessor->InitializeAsync();
     }
 
@@ -268,16 +344,54 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
 
         auto worldCoordinate = m_UnitySpatialCoordinateSystem; // m_mixedReality.GetWorldCoordinateSystem();
 
+        // Per-sensor files, unless every stream goes to the container
+        StorageFolder sensorFolder = m_archiveFolder;
+        if ( m_archiveFolder && m_recordingFormat == RecordingFormat::Container &&
+             StartContainerRecording( std::wstring( m_archiveFolder.Path() ) + L"\\" + m_datetime + L".slrec" ) )
+        {
+          sensorFolder = nullptr;
+        }
+
+        m_stagingArena = nullptr;
+        if ( sensorFolder && m_burstSettings.Enabled )
+        {
+          StagingArenaSettings arenaSettings;
+          if ( m_burstSettings.MemoryBudgetMBytes > 0 )
+          {
+            arenaSettings.budgetBytes = static_cast<size_t>( m_burstSettings.MemoryBudgetMBytes ) << 20;
+          }
+          arenaSettings.flushMode = m_burstSettings.FlushMode == BurstFlushMode::AfterStop ? StagingFlushMode::AfterStop
+                                                                                           : StagingFlushMode::Background;
+          switch ( m_burstSettings.OverflowPolicy )
+          {
+          case BurstOverflowPolicy::DropNewest:
+            arenaSettings.overflowPolicy = StagingOverflowPolicy::DropNewest;
+            break;
+          case BurstOverflowPolicy::DropOldest:
+            arenaSettings.overflowPolicy = StagingOverflowPolicy::DropOldest;
+            break;
+          default:
+            arenaSettings.overflowPolicy = StagingOverflowPolicy::WriteThrough;
+            break;
+          }
+          m_stagingArena = std::make_shared<StagingArena>( arenaSettings );
+        }
+
         if (m_sensorScenario)
         {
             // TODO(jmhenaff): remove reference to mixedReality
-            m_sensorScenario->StartRecording(m_archiveFolder, worldCoordinate );
+            m_sensorScenario->StartRecording(sensorFolder, worldCoordinate, m_stagingArena );
         }
         if (m_videoFrameProcessor)
         {
-            m_videoFrameProcessor->Clear();
            // TODO(jmhenaff): remove reference to mixedReality
-            m_videoFrameProcessor->StartRecording(m_archiveFolder, worldCoordinate );
+            m_videoFrameProcessor->StartRecording(sensorFolder, worldCoordinate, m_datetime, m_stagingArena );
+        }
+        if ( m_eyeGazeStream && sensorFolder )
+        {
+          std::wstring eyeGazePath( sensorFolder.Path().data() );
+          eyeGazePath += L"\\" + m_datetime + L"_eye.txt";
+          m_eyeGazeStream->StartRecording( eyeGazePath );
         }
     }
 
@@ -310,7 +424,11 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
     }
 
     // Get RGB synchronized texture buffer and metadatas
-    com_array<uint8_t> SolARHololens2ResearchMode::GetPvData(uint64_t& timestamp,
+    com_array<uint8_t> SolARHololens2ResearchMode::GetPvData(uint64_t lastSeenSequence,
+                                                                    FrameStatus& status,
+                                                                    uint64_t& sequence,
+                                                                    uint64_t& timestamp,
+                                                                    float& sharpness,
                                                                     com_array<double>& PVtoWorldtransform, 
                                                                     float& fx,
                                                                     float& fy,
@@ -319,88 +437,41 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
                                                                     uint32_t& height,
                                                                     bool flip)
     {
-      m_RGBTextureUpdated = m_videoFrameProcessor->GetRGBByteArrayNewAvailable();
-
-      // return null
-      if ( !m_RGBTextureUpdated )
+      if ( !m_videoFrameProcessor )
       {
+        status = FrameStatus::NoFrame;
+        sequence = 0;
         return com_array<UINT8>();
       }
 
-      // re allocation if data size changes
-      auto rgbByteArraySize = m_videoFrameProcessor->GetRGBByteArraySize();
-      if ( m_RGBFrame.pixelBufferSize != rgbByteArraySize )
-      {
-        if ( m_RGBFrame.pixelBufferData != nullptr )
-        {
-          delete[] m_RGBFrame.pixelBufferData;
-          m_RGBFrame.pixelBufferData = nullptr;
-          m_RGBFrame.pixelBufferSize = 0;
-        }
-        m_RGBFrame.pixelBufferSize = rgbByteArraySize;
-        m_RGBFrame.pixelBufferData = new UINT8[m_RGBFrame.pixelBufferSize];
-      }
+      // all datas are copied simultaneously - metadatas (as timestamp) and RGB pixels buffer
+      // m_RGBFrame buffer is reallocated by the processor if data size changes
+      status = toFrameStatus( m_videoFrameProcessor->CopyLastFrame( m_RGBFrame, lastSeenSequence ) );
+      m_RGBTextureUpdated = ( status == FrameStatus::NewFrame );
 
-      if ( m_RGBFrame.pixelBufferData != nullptr && m_RGBFrame.pixelBufferSize > 0 )
+      // return null
+      if ( !m_RGBTextureUpdated )
       {
-        // all datas are copied simultaneously - metadatas (as timestamp) and RGB pixels buffer
-        m_videoFrameProcessor->CopyLastFrame( m_RGBFrame );
+        sequence = ( status == FrameStatus::NotModified ) ? lastSeenSequence : 0;
+        return com_array<UINT8>();
       }
+      sequence = m_RGBFrame.sequence;
 
-      com_array<UINT8> tempBuffer;
-      if ( !flip )
+      com_array<UINT8> tempBuffer = CopyPvPixels( flip );
+
+      PVtoWorldtransform = com_array<double>( PoseConversion::kTransformSize );
+      if ( m_RGBFrame.poseValid )
       {
-        tempBuffer = com_array<UINT8>(
-            std::move_iterator( m_RGBFrame.pixelBufferData ),
-            std::move_iterator( m_RGBFrame.pixelBufferData + m_RGBFrame.pixelBufferSize ) );
+        PoseConversion::ToSolARPose( &m_RGBFrame.PVtoWorldtransform.m11, PVtoWorldtransform.data() );
       }
       else
       {
-        tempBuffer = com_array<UINT8>( rgbByteArraySize );
-        for ( int x = 0; x < m_RGBFrame.width; x++ )
-        {
-          for ( int y = 0; y < m_RGBFrame.height; y++ )
-          {
-            // BGRA 32
-            int destIndex = ( x * 4 ) + y * ( m_RGBFrame.width * 4 );
-            int srcIndex = ( x * 4 ) + ( m_RGBFrame.height - 1 - y ) * ( m_RGBFrame.width * 4 );
-
-            tempBuffer[destIndex] = m_RGBFrame.pixelBufferData[srcIndex];
-            tempBuffer[destIndex + 1] = m_RGBFrame.pixelBufferData[srcIndex + 1];
-            tempBuffer[destIndex + 2] = m_RGBFrame.pixelBufferData[srcIndex + 2];
-            tempBuffer[destIndex + 3] = m_RGBFrame.pixelBufferData[srcIndex + 3];
-          }
-        }
+        // Frame not located: identity, in any axes
+        PoseConversion::Convert<PoseConversion::Layout::RowMajor, PoseConversion::CameraAxes::HoloLens>( &m_RGBFrame.PVtoWorldtransform.m11, PVtoWorldtransform.data() );
       }
 
-      //
-      std::array<double, 16> PVtoWorldtransform_values;
-      PVtoWorldtransform_values[0] = m_RGBFrame.PVtoWorldtransform.m11;
-      PVtoWorldtransform_values[1] = m_RGBFrame.PVtoWorldtransform.m12;
-      PVtoWorldtransform_values[2] = m_RGBFrame.PVtoWorldtransform.m13;
-      PVtoWorldtransform_values[3] = m_RGBFrame.PVtoWorldtransform.m14;
-      PVtoWorldtransform_values[4] = m_RGBFrame.PVtoWorldtransform.m21;
-      PVtoWorldtransform_values[5] = m_RGBFrame.PVtoWorldtransform.m22;
-      PVtoWorldtransform_values[6] = m_RGBFrame.PVtoWorldtransform.m23;
-      PVtoWorldtransform_values[7] = m_RGBFrame.PVtoWorldtransform.m24;
-      PVtoWorldtransform_values[8] = m_RGBFrame.PVtoWorldtransform.m31;
-      PVtoWorldtransform_values[9] = m_RGBFrame.PVtoWorldtransform.m32;
-      PVtoWorldtransform_values[10] = m_RGBFrame.PVtoWorldtransform.m33;
-      PVtoWorldtransform_values[11] = m_RGBFrame.PVtoWorldtransform.m34;
-      PVtoWorldtransform_values[12] = m_RGBFrame.PVtoWorldtransform.m41;
-      PVtoWorldtransform_values[13] = m_RGBFrame.PVtoWorldtransform.m42;
-      PVtoWorldtransform_values[14] = m_RGBFrame.PVtoWorldtransform.m43;
-      PVtoWorldtransform_values[15] = m_RGBFrame.PVtoWorldtransform.m44;
-
-      std::array<double, 16> PVtoWorldtransformSolar_values;
-      PVtoWorldtransformSolar_values.fill( 0 );
-      Utils::convertToSolARPose( PVtoWorldtransform_values, PVtoWorldtransformSolar_values );
-
-      // PVtoWorldtransform = com_array<double>(std::move_iterator(PVtoWorldtransform_values),
-      // std::move_iterator(PVtoWorldtransform_values + 16*sizeof(double)));
-      PVtoWorldtransform = com_array<double>( PVtoWorldtransformSolar_values.begin(),
-                                              PVtoWorldtransformSolar_values.end() );
       timestamp = m_RGBFrame.timestamp;
+      sharpness = m_RGBFrame.sharpness;
       fx = m_RGBFrame.fx;
       fy = m_RGBFrame.fy;
       pixelBufferSize = m_RGBFrame.pixelBufferSize;
@@ -411,10 +482,45 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
       return tempBuffer;
     }
 
+    com_array<uint8_t> SolARHololens2ResearchMode::CopyPvPixels( bool flip ) const
+    {
+      if ( !flip )
+      {
+        return com_array<UINT8>( m_RGBFrame.pixelBufferData, m_RGBFrame.pixelBufferData + m_RGBFrame.pixelBufferSize );
+      }
+
+      com_array<UINT8> tempBuffer( m_RGBFrame.pixelBufferSize );
+      for ( int x = 0; x < m_RGBFrame.width; x++ )
+      {
+        for ( int y = 0; y < m_RGBFrame.height; y++ )
+        {
+          // BGRA 32
+          int destIndex = ( x * 4 ) + y * ( m_RGBFrame.width * 4 );
+          int srcIndex = ( x * 4 ) + ( m_RGBFrame.height - 1 - y ) * ( m_RGBFrame.width * 4 );
+
+          tempBuffer[destIndex] = m_RGBFrame.pixelBufferData[srcIndex];
+          tempBuffer[destIndex + 1] = m_RGBFrame.pixelBufferData[srcIndex + 1];
+          tempBuffer[destIndex + 2] = m_RGBFrame.pixelBufferData[srcIndex + 2];
+          tempBuffer[destIndex + 3] = m_RGBFrame.pixelBufferData[srcIndex + 3];
+        }
+      }
+      return tempBuffer;
+    }
+
+    FrameCounters SolARHololens2ResearchMode::GetPvFrameCounters()
+    {
+      if ( !m_videoFrameProcessor )
+      {
+        return FrameCounters{};
+      }
+      return toFrameCounters( m_videoFrameProcessor->GetFrameCounters() );
+    }
+
     void SolARHololens2ResearchMode::InitializeRMSensors()
     {
         m_sensorScenario->InitializeSensors();
         m_sensorScenario->InitializeCameraReaders();
+        m_sensorScenario->InitializeImuReaders();
     }
 
     bool SolARHololens2ResearchMode::StartRMSensor(RMSensorType sensor)
@@ -464,7 +570,11 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
 
     com_array<uint8_t> SolARHololens2ResearchMode::GetVlcData(
         const RMSensorType sensor,
+        uint64_t lastSeenSequence,
+        FrameStatus& status,
+        uint64_t& sequence,
         uint64_t& timestamp,
+        float& sharpness,
         com_array<double>& PVtoWorldtransform,
         float& fx,
         float& fy,
@@ -475,14 +585,45 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
     {
         // TODO(jmhenaff): make m_sensorScenario->m_cameraReaders private, and make this check
         // in a m_sensorScenario method (e.g. getVlcSensorData(sensor, params....)
-      if ( m_sensorScenario->m_cameraReaders.find( toHololensRMSensorType( sensor ) ) ==
-           m_sensorScenario->m_cameraReaders.end() )
+      status = FrameStatus::NoFrame;
+      sequence = 0;
+      if ( !m_sensorScenario )
+      {
+        return com_array<uint8_t>();
+      }
+      auto vlcCameraReader = m_sensorScenario->m_vlcCameraReaders.find( toHololensRMSensorType( sensor ) );
+      if ( vlcCameraReader == m_sensorScenario->m_vlcCameraReaders.end() )
       {
         return com_array<uint8_t>();
       }
 
-      return m_sensorScenario->m_cameraReaders[toHololensRMSensorType( sensor )]->getVlcSensorData(
-          timestamp, PVtoWorldtransform, pixelBufferSize, width, height, flip );
+      FrameRequestStatus readerStatus;
+      winrt::Windows::Foundation::Numerics::float4x4 rigToWorld;
+      bool poseValid = false;
+      auto result = vlcCameraReader->second->getVlcSensorData(
+          lastSeenSequence, readerStatus, sequence, timestamp, sharpness, rigToWorld, poseValid, pixelBufferSize, width, height, flip );
+      status = toFrameStatus( readerStatus );
+      if ( status == FrameStatus::NewFrame )
+      {
+        // Matrix needs to be transposed for SolAR
+        PVtoWorldtransform = com_array<double>( PoseConversion::kTransformSize );
+        PoseConversion::Convert<PoseConversion::Layout::RowMajor, PoseConversion::CameraAxes::HoloLens>( &rigToWorld.m11, PVtoWorldtransform.data() );
+      }
+      return result;
+    }
+
+    FrameCounters SolARHololens2ResearchMode::GetVlcFrameCounters( RMSensorType sensor )
+    {
+      if ( !m_sensorScenario )
+      {
+        return FrameCounters{};
+      }
+      auto vlcCameraReader = m_sensorScenario->m_vlcCameraReaders.find( toHololensRMSensorType( sensor ) );
+      if ( vlcCameraReader == m_sensorScenario->m_vlcCameraReaders.end() )
+      {
+        return FrameCounters{};
+      }
+      return toFrameCounters( vlcCameraReader->second->getFrameCounters() );
     }
 
     uint32_t SolARHololens2ResearchMode::GetDepthWidth()
@@ -503,7 +644,19 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
       return m_sensorScenario->m_depthCameraReader->getHeight();
     }
 
+    FrameCounters SolARHololens2ResearchMode::GetDepthFrameCounters()
+    {
+      if ( !m_sensorScenario || !m_sensorScenario->m_depthCameraReader )
+      {
+        return FrameCounters{};
+      }
+      return toFrameCounters( m_sensorScenario->m_depthCameraReader->getFrameCounters() );
+    }
+
     com_array<uint16_t> SolARHololens2ResearchMode::GetDepthData(
+        uint64_t lastSeenSequence,
+        FrameStatus& status,
+        uint64_t& sequence,
         uint64_t& timestamp,
         com_array<double>& PVtoWorldtransform,
         float& fx,
@@ -512,32 +665,1203 @@ namespace winrt::SolARHololens2UnityPlugin::implementation
         uint32_t& width,
         uint32_t& height )
     {
-      if ( !m_sensorScenario->m_depthCameraReader )
+      status = FrameStatus::NoFrame;
+      sequence = 0;
+      if ( !m_sensorScenario || !m_sensorScenario->m_depthCameraReader )
       {
         return com_array<uint16_t>();
       }
-      return m_sensorScenario->m_depthCameraReader->getDepthSensorData(
-          timestamp, PVtoWorldtransform, pixelBufferSize, width, height );
+
+      FrameRequestStatus readerStatus;
+      winrt::Windows::Foundation::Numerics::float4x4 rigToWorld;
+      bool poseValid = false;
+      auto result = m_sensorScenario->m_depthCameraReader->getDepthSensorData(
+          lastSeenSequence, readerStatus, sequence, timestamp, rigToWorld, poseValid, pixelBufferSize, width, height );
+      status = toFrameStatus( readerStatus );
+      if ( status == FrameStatus::NewFrame )
+      {
+        // Unlike the VLC getter, the depth transform has always been returned untransposed
+        PVtoWorldtransform = com_array<double>( PoseConversion::kTransformSize );
+        PoseConversion::Convert<PoseConversion::Layout::ColumnMajor, PoseConversion::CameraAxes::HoloLens>( &rigToWorld.m11, PVtoWorldtransform.data() );
+      }
+      return result;
     }
 
-    ResearchModeSensorType SolARHololens2ResearchMode::toHololensRMSensorType( RMSensorType sType )
+    com_array<uint8_t> SolARHololens2ResearchMode::GetPvFrame( uint64_t lastSeenSequence,
+                                                               FrameStatus& status,
+                                                               FrameMetadata& metadata,
+                                                               bool flip )
     {
-        switch ( sType )
+      metadata = FrameMetadata{};
+      if ( !m_videoFrameProcessor )
+      {
+        status = FrameStatus::NoFrame;
+        return com_array<UINT8>();
+      }
+
+      status = toFrameStatus( m_videoFrameProcessor->CopyLastFrame( m_RGBFrame, lastSeenSequence ) );
+      m_RGBTextureUpdated = ( status == FrameStatus::NewFrame );
+      if ( !m_RGBTextureUpdated )
+      {
+        metadata.Sequence = ( status == FrameStatus::NotModified ) ? lastSeenSequence : 0;
+        return com_array<UINT8>();
+      }
+
+      metadata.Sequence = m_RGBFrame.sequence;
+      metadata.Timestamp = m_RGBFrame.timestamp;
+      metadata.Sharpness = m_RGBFrame.sharpness;
+      metadata.Fx = m_RGBFrame.fx;
+      metadata.Fy = m_RGBFrame.fy;
+      metadata.PixelBufferSize = m_RGBFrame.pixelBufferSize;
+      metadata.Width = m_RGBFrame.width;
+      metadata.Height = m_RGBFrame.height;
+      metadata.PoseValid = m_RGBFrame.poseValid;
+      metadata.Pose = GetFramePose( SensorStream::PV, m_RGBFrame.PVtoWorldtransform, m_RGBFrame.poseValid );
+
+      return CopyPvPixels( flip );
+    }
+
+    com_array<uint8_t> SolARHololens2ResearchMode::GetVlcFrame( RMSensorType sensor,
+                                                                uint64_t lastSeenSequence,
+                                                                FrameStatus& status,
+                                                                FrameMetadata& metadata,
+                                                                bool flip )
+    {
+      status = FrameStatus::NoFrame;
+      metadata = FrameMetadata{};
+      if ( !m_sensorScenario )
+      {
+        return com_array<uint8_t>();
+      }
+      auto vlcCameraReader = m_sensorScenario->m_vlcCameraReaders.find( toHololensRMSensorType( sensor ) );
+      if ( vlcCameraReader == m_sensorScenario->m_vlcCameraReaders.end() )
+      {
+        return com_array<uint8_t>();
+      }
+
+      FrameRequestStatus readerStatus;
+      winrt::Windows::Foundation::Numerics::float4x4 rigToWorld;
+      // Timestamp stays in host ticks, the clock of the VLC streams (FrameClock.h)
+      auto result = vlcCameraReader->second->getVlcSensorData( lastSeenSequence,
+                                                               readerStatus,
+                                                               metadata.Sequence,
+                                                               metadata.Timestamp,
+                                                               metadata.Sharpness,
+                                                               rigToWorld,
+                                                               metadata.PoseValid,
+                                                               metadata.PixelBufferSize,
+                                                               metadata.Width,
+                                                               metadata.Height,
+                                                               flip );
+      status = toFrameStatus( readerStatus );
+      if ( status == FrameStatus::NewFrame )
+      {
+        metadata.Pose = GetFramePose( toSensorStream( sensor ), rigToWorld, metadata.PoseValid );
+      }
+      return result;
+    }
+
+    com_array<uint16_t> SolARHololens2ResearchMode::GetDepthFrame( uint64_t lastSeenSequence,
+                                                                   FrameStatus& status,
+                                                                   FrameMetadata& metadata )
+    {
+      status = FrameStatus::NoFrame;
+      metadata = FrameMetadata{};
+      if ( !m_sensorScenario || !m_sensorScenario->m_depthCameraReader )
+      {
+        return com_array<uint16_t>();
+      }
+
+      FrameRequestStatus readerStatus;
+      winrt::Windows::Foundation::Numerics::float4x4 rigToWorld;
+      auto result = m_sensorScenario->m_depthCameraReader->getDepthSensorData( lastSeenSequence,
+                                                                               readerStatus,
+                                                                               metadata.Sequence,
+                                                                               metadata.Timestamp,
+                                                                               rigToWorld,
+                                                                               metadata.PoseValid,
+                                                                               metadata.PixelBufferSize,
+                                                                               metadata.Width,
+                                                                               metadata.Height );
+      status = toFrameStatus( readerStatus );
+      if ( status == FrameStatus::NewFrame )
+      {
+        // Depth frames are not scored
+        metadata.Sharpness = -1.f;
+        metadata.Pose = GetFramePose( SensorStream::DEPTH, rigToWorld, metadata.PoseValid );
+      }
+      return result;
+    }
+
+    void SolARHololens2ResearchMode::SetPoseFormat( SensorStream stream, PoseFormat format )
+    {
+      m_poseFormats[stream] = format;
+    }
+
+    com_array<double> SolARHololens2ResearchMode::GetPoseTransform( FramePose const& pose )
+    {
+      com_array<double> transform( PoseConversion::kTransformSize );
+      if ( pose.Format == PoseFormat::Matrix3x4 )
+      {
+        const float matrix3x4[PoseConversion::kMatrix3x4Size] = {
+            pose.R00, pose.R01, pose.R02, pose.Tx,
+            pose.R10, pose.R11, pose.R12, pose.Ty,
+            pose.R20, pose.R21, pose.R22, pose.Tz };
+        PoseConversion::FromMatrix3x4( matrix3x4, transform.data() );
+      }
+      else
+      {
+        const float rotation[4] = { pose.Qx, pose.Qy, pose.Qz, pose.Qw };
+        const float translation[3] = { pose.Tx, pose.Ty, pose.Tz };
+        PoseConversion::FromQuaternionTranslation( rotation, translation, transform.data() );
+      }
+      return transform;
+    }
+
+    FramePose SolARHololens2ResearchMode::GetFramePose( SensorStream stream, const winrt::Windows::Foundation::Numerics::float4x4& sensorToWorld, bool poseValid )
+    {
+      auto poseFormat = m_poseFormats.find( stream );
+      FramePose pose{};
+      pose.Format = ( poseFormat != m_poseFormats.end() ) ? poseFormat->second : PoseFormat::QuaternionTranslation;
+
+      // PV poses are given in the SolAR camera axes, as by GetPvData(). Frames which could not be
+      // located get the identity, whatever the axes.
+      const winrt::Windows::Foundation::Numerics::float4x4 transform = poseValid ? sensorToWorld : winrt::Windows::Foundation::Numerics::float4x4::identity();
+      const bool isPv = poseValid && ( stream == SensorStream::PV );
+      if ( pose.Format == PoseFormat::Matrix3x4 )
+      {
+        float matrix3x4[PoseConversion::kMatrix3x4Size];
+        if ( isPv )
         {
-        case RMSensorType::LEFT_FRONT:
-            return ResearchModeSensorType::LEFT_FRONT;
-        case RMSensorType::LEFT_LEFT:
-            return ResearchModeSensorType::LEFT_LEFT;
-        case RMSensorType::RIGHT_FRONT:
-            return ResearchModeSensorType::RIGHT_FRONT;
-        case RMSensorType::RIGHT_RIGHT:
-            return ResearchModeSensorType::RIGHT_RIGHT;
-        //case RMSensorType::DEPTH_AHAT:
-        //    return ResearchModeSensorType::DEPTH_AHAT;
-        //case RMSensorType::DEPTH_LONG_THROW:
-            return ResearchModeSensorType::DEPTH_LONG_THROW;
-        default:
-            throw std::runtime_error( "Unknown SensorType" );
+          PoseConversion::ToMatrix3x4<PoseConversion::CameraAxes::OpenCV>( &transform.m11, matrix3x4 );
+        }
+        else
+        {
+          PoseConversion::ToMatrix3x4<PoseConversion::CameraAxes::HoloLens>( &transform.m11, matrix3x4 );
+        }
+        pose.R00 = matrix3x4[0];
+        pose.R01 = matrix3x4[1];
+        pose.R02 = matrix3x4[2];
+        pose.Tx = matrix3x4[3];
+        pose.R10 = matrix3x4[4];
+        pose.R11 = matrix3x4[5];
+        pose.R12 = matrix3x4[6];
+        pose.Ty = matrix3x4[7];
+        pose.R20 = matrix3x4[8];
+        pose.R21 = matrix3x4[9];
+        pose.R22 = matrix3x4[10];
+        pose.Tz = matrix3x4[11];
+      }
+      else
+      {
+        float rotation[4];
+        float translation[3];
+        if ( isPv )
+        {
+          PoseConversion::ToQuaternionTranslation<PoseConversion::CameraAxes::OpenCV>( &transform.m11, rotation, translation );
+        }
+        else
+        {
+          PoseConversion::ToQuaternionTranslation<PoseConversion::CameraAxes::HoloLens>( &transform.m11, rotation, translation );
+        }
+        pose.Qx = rotation[0];
+        pose.Qy = rotation[1];
+        pose.Qz = rotation[2];
+        pose.Qw = rotation[3];
+        pose.Tx = translation[0];
+        pose.Ty = translation[1];
+        pose.Tz = translation[2];
+      }
+      return pose;
+    }
+
+    com_array<ImuSample> SolARHololens2ResearchMode::GetImuSamples( ImuSensor sensor, uint64_t sinceIndex, uint64_t& lostSamples )
+    {
+      lostSamples = 0;
+      if ( !m_sensorScenario )
+      {
+        return com_array<ImuSample>();
+      }
+      auto imuReader = m_sensorScenario->m_imuReaders.find( toHololensRMSensorType( sensor ) );
+      if ( imuReader == m_sensorScenario->m_imuReaders.end() )
+      {
+        return com_array<ImuSample>();
+      }
+
+      std::vector<::ImuSample> samples;
+      lostSamples = imuReader->second->getSamples( sinceIndex, samples );
+
+      com_array<ImuSample> result( static_cast<uint32_t>( samples.size() ) );
+      for ( size_t i = 0; i < samples.size(); i++ )
+      {
+        const ::ImuSample& sample = samples[i];
+        result[static_cast<uint32_t>( i )] = ImuSample{ sample.index,
+                                                        sample.timestamp,
+                                                        sample.sensorTicks,
+                                                        sample.x,
+                                                        sample.y,
+                                                        sample.z,
+                                                        sample.temperature };
+      }
+      return result;
+    }
+
+    bool SolARHololens2ResearchMode::PreintegrateImu( SensorStream stream,
+                                                      uint64_t fromTimestamp,
+                                                      uint64_t toTimestamp,
+                                                      com_array<double>& deltaRotation,
+                                                      com_array<double>& deltaVelocity,
+                                                      com_array<double>& deltaPosition,
+                                                      com_array<double>& covariance,
+                                                      com_array<double>& biasJacobians,
+                                                      double& deltaTime )
+    {
+      deltaTime = 0.0;
+      if ( !m_sensorScenario )
+      {
+        return false;
+      }
+      auto gyroReader = m_sensorScenario->m_imuReaders.find( ResearchModeSensorType::IMU_GYRO );
+      auto accelReader = m_sensorScenario->m_imuReaders.find( ResearchModeSensorType::IMU_ACCEL );
+      if ( gyroReader == m_sensorScenario->m_imuReaders.end() || accelReader == m_sensorScenario->m_imuReaders.end() )
+      {
+        return false;
+      }
+
+      // Samples are read on the clock of the frame timestamps of the stream
+      const auto clock = GetImuSampleClock( GetFrameClock( static_cast<SharedStream>( stream ) ) );
+
+      std::vector<::ImuSample> gyroSamples;
+      std::vector<::ImuSample> accelSamples;
+      PreintegratedImu result;
+      if ( !gyroReader->second->getSamplesBetween( clock, fromTimestamp, toTimestamp, gyroSamples ) ||
+           !accelReader->second->getSamplesBetween( clock, fromTimestamp, toTimestamp, accelSamples ) ||
+           !ImuPreintegrator::IntegrateInterval( gyroSamples, accelSamples, clock, fromTimestamp, toTimestamp,
+                                                 m_imuPreintegrationParameters, result ) )
+      {
+        return false;
+      }
+
+      using RowMajor3d = Eigen::Matrix<double, 3, 3, Eigen::RowMajor>;
+      using RowMajor9d = Eigen::Matrix<double, 9, 9, Eigen::RowMajor>;
+
+      deltaRotation = com_array<double>( 9 );
+      Eigen::Map<RowMajor3d>( deltaRotation.data() ) = result.deltaRotation;
+      deltaVelocity = com_array<double>( result.deltaVelocity.data(), result.deltaVelocity.data() + 3 );
+      deltaPosition = com_array<double>( result.deltaPosition.data(), result.deltaPosition.data() + 3 );
+      covariance = com_array<double>( 81 );
+      Eigen::Map<RowMajor9d>( covariance.data() ) = result.covariance;
+
+      biasJacobians = com_array<double>( 5 * 9 );
+      const Eigen::Matrix3d* jacobians[] = { &result.dR_dbg, &result.dV_dbg, &result.dV_dba, &result.dP_dbg, &result.dP_dba };
+      for ( size_t i = 0; i < 5; i++ )
+      {
+        Eigen::Map<RowMajor3d>( biasJacobians.data() + 9 * i ) = *jacobians[i];
+      }
+
+      deltaTime = result.deltaTime;
+      return true;
+    }
+
+    void SolARHololens2ResearchMode::SetImuPreintegrationSettings( ImuPreintegrationSettings const& settings )
+    {
+      // Keep default noise densities for values left to 0
+      ImuPreintegrationParameters parameters;
+      if ( settings.GyroNoiseDensity > 0.0 )
+      {
+        parameters.gyroNoiseDensity = settings.GyroNoiseDensity;
+      }
+      if ( settings.AccelNoiseDensity > 0.0 )
+      {
+        parameters.accelNoiseDensity = settings.AccelNoiseDensity;
+      }
+      parameters.gyroBias = Eigen::Vector3d( settings.GyroBiasX, settings.GyroBiasY, settings.GyroBiasZ );
+      parameters.accelBias = Eigen::Vector3d( settings.AccelBiasX, settings.AccelBiasY, settings.AccelBiasZ );
+      m_imuPreintegrationParameters = parameters;
+    }
+
+    com_array<EyeGazeSample> SolARHololens2ResearchMode::GetEyeGazeSamples( uint64_t sinceTimestamp )
+    {
+      if ( !m_eyeGazeStream )
+      {
+        return com_array<EyeGazeSample>();
+      }
+
+      std::vector<EyeGazeStream::Entry> samples;
+      m_eyeGazeStream->GetSamples( sinceTimestamp, samples );
+
+      com_array<EyeGazeSample> result( static_cast<uint32_t>( samples.size() ) );
+      for ( size_t i = 0; i < samples.size(); i++ )
+      {
+        const EyeGaze& gaze = samples[i].value;
+        result[static_cast<uint32_t>( i )] = EyeGazeSample{ samples[i].timestamp,
+                                                            gaze.origin[0],
+                                                            gaze.origin[1],
+                                                            gaze.origin[2],
+                                                            gaze.direction[0],
+                                                            gaze.direction[1],
+                                                            gaze.direction[2] };
+      }
+      return result;
+    }
+
+    bool SolARHololens2ResearchMode::GetEyeGazeAtTimestamp( SensorStream stream, uint64_t timestamp, EyeGazeSample& sample )
+    {
+      sample = EyeGazeSample{};
+      EyeGaze gaze;
+      const uint64_t absoluteTimestamp = ToAbsoluteTimestamp( stream, timestamp );
+      if ( !m_eyeGazeStream || !m_eyeGazeStream->GetGazeAtTimestamp( absoluteTimestamp, gaze ) )
+      {
+        return false;
+      }
+
+      sample = EyeGazeSample{ absoluteTimestamp,
+                              gaze.origin[0],
+                              gaze.origin[1],
+                              gaze.origin[2],
+                              gaze.direction[0],
+                              gaze.direction[1],
+                              gaze.direction[2] };
+      return true;
+    }
+
+    void SolARHololens2ResearchMode::RecordEyeGaze()
+    {
+      if ( !m_eyeGazeStream || !m_mixedReality.IsEyeTrackingActive() )
+      {
+        return;
+      }
+
+      // MixedReality gives the gaze in its world coordinate system
+      XMMATRIX toFrameCoordinateSystem;
+      if ( !GetWorldToFrameTransform( toFrameCoordinateSystem ) )
+      {
+        return;
+      }
+
+      XMFLOAT3 origin;
+      XMFLOAT3 direction;
+      XMStoreFloat3( &origin, XMVector3Transform( m_mixedReality.GetEyeGazeOrigin(), toFrameCoordinateSystem ) );
+      XMStoreFloat3( &direction,
+                     XMVector3Normalize( XMVector3TransformNormal( m_mixedReality.GetEyeGazeDirection(), toFrameCoordinateSystem ) ) );
+
+      EyeGaze gaze;
+      gaze.origin[0] = origin.x;
+      gaze.origin[1] = origin.y;
+      gaze.origin[2] = origin.z;
+      gaze.direction[0] = direction.x;
+      gaze.direction[1] = direction.y;
+      gaze.direction[2] = direction.z;
+      const uint64_t timestamp = static_cast<uint64_t>( m_mixedReality.GetPredictedDisplayTime() );
+      m_eyeGazeStream->Record( timestamp, gaze );
+
+      std::lock_guard<ProfiledMutex> guard( m_recordingSessionMutex );
+      if ( m_recordingSession )
+      {
+        m_recordingSession->WriteGaze( timestamp,
+                                       { { gaze.origin[0], gaze.origin[1], gaze.origin[2] },
+                                         { gaze.direction[0], gaze.direction[1], gaze.direction[2] } } );
+      }
+    }
+
+    bool SolARHololens2ResearchMode::GetHeadPoseAtTimestamp( SensorStream stream, uint64_t timestamp, HeadPoseSample& pose )
+    {
+      pose = HeadPoseSample{};
+      const uint64_t absoluteTimestamp = ToAbsoluteTimestamp( stream, timestamp );
+      XMMATRIX toFrameCoordinateSystem;
+      XMVECTOR position;
+      XMVECTOR forward;
+      XMVECTOR up;
+      if ( !m_mixedReality.IsEnabled() || !GetWorldToFrameTransform( toFrameCoordinateSystem ) ||
+           !m_mixedReality.GetHeadPoseAtTimestamp( static_cast<long long>( absoluteTimestamp ), position, forward, up ) )
+      {
+        return false;
+      }
+
+      XMFLOAT3 framePosition;
+      XMFLOAT3 frameForward;
+      XMFLOAT3 frameUp;
+      XMStoreFloat3( &framePosition, XMVector3Transform( XMVectorSetW( position, 1.0f ), toFrameCoordinateSystem ) );
+      XMStoreFloat3( &frameForward, XMVector3Normalize( XMVector3TransformNormal( forward, toFrameCoordinateSystem ) ) );
+      XMStoreFloat3( &frameUp, XMVector3Normalize( XMVector3TransformNormal( up, toFrameCoordinateSystem ) ) );
+      pose = HeadPoseSample{ absoluteTimestamp,
+                             framePosition.x, framePosition.y, framePosition.z,
+                             frameForward.x, frameForward.y, frameForward.z,
+                             frameUp.x, frameUp.y, frameUp.z };
+      return true;
+    }
+
+    void SolARHololens2ResearchMode::UpdateWorldToFrameTransform()
+    {
+      XMFLOAT4X4 transform;
+      XMStoreFloat4x4( &transform, XMMatrixIdentity() );
+      bool isValid = true;
+      if ( m_UnitySpatialCoordinateSystem )
+      {
+        auto worldToUnity = m_mixedReality.GetWorldCoordinateSystem().TryGetTransformTo( m_UnitySpatialCoordinateSystem );
+        isValid = static_cast<bool>( worldToUnity );
+        if ( isValid )
+        {
+          XMStoreFloat4x4( &transform, XMLoadFloat4x4( &worldToUnity.Value() ) );
         }
+      }
+
+      std::lock_guard<ProfiledMutex> lock( m_worldToFrameMutex );
+      m_worldToFrameTransform = transform;
+      m_isWorldToFrameTransformValid = isValid;
+    }
+
+    bool SolARHololens2ResearchMode::GetWorldToFrameTransform( XMMATRIX& transform )
+    {
+      std::lock_guard<ProfiledMutex> lock( m_worldToFrameMutex );
+      transform = XMLoadFloat4x4( &m_worldToFrameTransform );
+      return m_isWorldToFrameTransformValid;
+    }
+
+    uint64_t SolARHololens2ResearchMode::ToAbsoluteTimestamp( SensorStream stream, uint64_t timestamp ) const
+    {
+      if ( GetFrameClock( static_cast<SharedStream>( stream ) ) == FrameClock::Absolute )
+      {
+        return timestamp;
+      }
+      return m_timeConverter.RelativeTicksToAbsoluteTicks( HundredsOfNanoseconds( checkAndConvertUnsigned( timestamp ) ) ).count();
+    }
+
+    void SolARHololens2ResearchMode::SetStreamRate( SensorStream stream, StreamRateSettings const& settings )
+    {
+      FrameRateSettings rateSettings;
+      rateSettings.targetFps = settings.TargetFps;
+      rateSettings.keepEveryNth = settings.KeepEveryNth;
+      rateSettings.minTranslation = settings.MinTranslation;
+      rateSettings.minRotationDeg = settings.MinRotationDegrees;
+      m_streamRateSettings[stream] = rateSettings;
+
+      ApplyStreamSettings( stream );
+    }
+
+    void SolARHololens2ResearchMode::SetKeyframeSelection( SensorStream stream, KeyframeSelection const& settings )
+    {
+      KeyframeSettings keyframeSettings;
+      keyframeSettings.enabled = settings.Enabled;
+      keyframeSettings.minTranslation = settings.MinTranslation;
+      keyframeSettings.minRotationDeg = settings.MinRotationDegrees;
+      keyframeSettings.maxIntervalSec = settings.MaxIntervalSeconds;
+      keyframeSettings.maxOverlap = settings.MaxOverlap;
+      // Keep defaults for overlap estimate parameters left to 0
+      if ( settings.HorizontalFovDegrees > 0.f )
+      {
+        keyframeSettings.horizontalFovDeg = settings.HorizontalFovDegrees;
+      }
+      if ( settings.VerticalFovDegrees > 0.f )
+      {
+        keyframeSettings.verticalFovDeg = settings.VerticalFovDegrees;
+      }
+      if ( settings.SceneDepth > 0.f )
+      {
+        keyframeSettings.sceneDepth = settings.SceneDepth;
+      }
+      m_keyframeSettings[stream] = keyframeSettings;
+
+      ApplyStreamSettings( stream );
+    }
+
+    KeyframeSelectionStats SolARHololens2ResearchMode::GetKeyframeSelectionStats( SensorStream stream )
+    {
+      KeyframeSelector* keyframeSelector = GetKeyframeSelector( stream );
+      if ( !keyframeSelector )
+      {
+        return KeyframeSelectionStats{};
+      }
+
+      const ::KeyframeStats stats = keyframeSelector->GetStats();
+      return KeyframeSelectionStats{ stats.evaluated,
+                                     stats.emitted,
+                                     stats.byTranslation,
+                                     stats.byRotation,
+                                     stats.byTime,
+                                     stats.rejectedByOverlap };
+    }
+
+    void SolARHololens2ResearchMode::SetSharpnessThreshold( SensorStream stream, float minSharpness )
+    {
+      m_sharpnessThresholds[stream] = minSharpness;
+
+      ApplyStreamSettings( stream );
+    }
+
+    PipelineStats SolARHololens2ResearchMode::GetPipelineStats( SensorStream stream )
+    {
+      PipelineTracer* tracer = GetPipelineTracer( stream );
+      if ( !tracer )
+      {
+        return PipelineStats{};
+      }
+
+      return PipelineStats{ toStageLatency( tracer->GetStats( PipelineStage::Acquired ) ),
+                            toStageLatency( tracer->GetStats( PipelineStage::Located ) ),
+                            toStageLatency( tracer->GetStats( PipelineStage::Converted ) ),
+                            toStageLatency( tracer->GetStats( PipelineStage::Copied ) ),
+                            toStageLatency( tracer->GetStats( PipelineStage::Published ) ),
+                            toStageLatency( tracer->GetStats( PipelineStage::PickedUp ) ) };
+    }
+
+    void SolARHololens2ResearchMode::ResetPipelineStats( SensorStream stream )
+    {
+      if ( PipelineTracer* tracer = GetPipelineTracer( stream ) )
+      {
+        tracer->Reset();
+      }
+    }
+
+    hstring SolARHololens2ResearchMode::ExportPipelineTrace()
+    {
+      const std::pair<SensorStream, const char*> streamNames[] = { { SensorStream::PV, "PV" },
+                                                                   { SensorStream::LEFT_FRONT, "LEFT_FRONT" },
+                                                                   { SensorStream::LEFT_LEFT, "LEFT_LEFT" },
+                                                                   { SensorStream::RIGHT_FRONT, "RIGHT_FRONT" },
+                                                                   { SensorStream::RIGHT_RIGHT, "RIGHT_RIGHT" },
+                                                                   { SensorStream::DEPTH, "DEPTH" } };
+
+      std::vector<std::pair<std::string, const PipelineTracer*>> streams;
+      for ( const auto& streamName : streamNames )
+      {
+        if ( const PipelineTracer* tracer = GetPipelineTracer( streamName.first ) )
+        {
+          streams.emplace_back( streamName.second, tracer );
+        }
+      }
+      return winrt::to_hstring( ToChromeTrace( streams ) );
+    }
+
+    hstring SolARHololens2ResearchMode::GetLockProfileReport()
+    {
+      return winrt::to_hstring( LockProfiler::Report() );
+    }
+
+    void SolARHololens2ResearchMode::ResetLockProfile()
+    {
+      LockProfiler::Reset();
+    }
+
+    com_array<ExecutorQueueStats> SolARHololens2ResearchMode::GetExecutorStats()
+    {
+      // Hundreds of nanoseconds to milliseconds
+      constexpr double kTicksPerMs = 10'000.0;
+
+      const auto classStats = TaskExecutor::GetShared().GetStats();
+      com_array<ExecutorQueueStats> result( static_cast<uint32_t>( classStats.size() ) );
+      for ( size_t i = 0; i < classStats.size(); i++ )
+      {
+        const TaskClassStats& stats = classStats[i];
+        ExecutorQueueStats& queueStats = result[static_cast<uint32_t>( i )];
+        // ExecutorPriority values follow TaskPriority
+        queueStats.Priority = static_cast<ExecutorPriority>( i );
+        queueStats.Submitted = stats.submitted;
+        queueStats.Completed = stats.completed;
+        queueStats.Queued = stats.queued;
+        queueStats.MaxQueued = stats.maxQueued;
+        queueStats.MeanWaitMs = stats.started > 0 ? stats.waitTotal / kTicksPerMs / stats.started : 0.0;
+        queueStats.MaxWaitMs = stats.waitMax / kTicksPerMs;
+        queueStats.MeanRunMs = stats.completed > 0 ? stats.runTotal / kTicksPerMs / stats.completed : 0.0;
+        queueStats.MaxRunMs = stats.runMax / kTicksPerMs;
+        queueStats.Utilization = stats.utilization;
+      }
+      return result;
+    }
+
+    void SolARHololens2ResearchMode::ResetExecutorStats()
+    {
+      TaskExecutor::GetShared().ResetStats();
+    }
+
+    bool SolARHololens2ResearchMode::EnableSharedMemoryTransport( uint32_t frameSlots )
+    {
+      m_sharedMemoryPublisher.reset();
+      auto publisher = std::make_unique<SharedMemoryPublisher>( frameSlots );
+
+      for ( SensorStream stream : { SensorStream::PV,
+                                    SensorStream::LEFT_FRONT,
+                                    SensorStream::LEFT_LEFT,
+                                    SensorStream::RIGHT_FRONT,
+                                    SensorStream::RIGHT_RIGHT,
+                                    SensorStream::DEPTH } )
+      {
+        if ( FramePublisher* framePublisher = GetFramePublisher( stream ) )
+        {
+          // SharedStream starts with the SensorStream values
+          publisher->AddFrameStream( static_cast<SharedStream>( stream ), *framePublisher );
+        }
+      }
+
+      if ( m_sensorScenario )
+      {
+        const std::pair<ResearchModeSensorType, SharedStream> imuStreams[] = {
+            { ResearchModeSensorType::IMU_ACCEL, SharedStream::IMU_ACCEL },
+            { ResearchModeSensorType::IMU_GYRO, SharedStream::IMU_GYRO },
+            { ResearchModeSensorType::IMU_MAG, SharedStream::IMU_MAG } };
+        for ( const auto& imuStream : imuStreams )
+        {
+          auto imuReader = m_sensorScenario->m_imuReaders.find( imuStream.first );
+          if ( imuReader != m_sensorScenario->m_imuReaders.end() &&
+               !publisher->AddImuStream( imuStream.second, *imuReader->second ) )
+          {
+            return false;
+          }
+        }
+      }
+
+      if ( !publisher->EnableHeadPoses() )
+      {
+        return false;
+      }
+
+      m_sharedMemoryPublisher = std::move( publisher );
+      return true;
+    }
+
+    void SolARHololens2ResearchMode::DisableSharedMemoryTransport()
+    {
+      m_sharedMemoryPublisher.reset();
+    }
+
+    bool SolARHololens2ResearchMode::StartNetworkStreaming( NetworkStreamingSettings const& settings )
+    {
+      m_networkStreamServer.reset();
+      auto server = std::make_unique<NetworkStreamServer>();
+
+      for ( SensorStream stream : { SensorStream::PV,
+                                    SensorStream::LEFT_FRONT,
+                                    SensorStream::LEFT_LEFT,
+                                    SensorStream::RIGHT_FRONT,
+                                    SensorStream::RIGHT_RIGHT,
+                                    SensorStream::DEPTH } )
+      {
+        if ( FramePublisher* framePublisher = GetFramePublisher( stream ) )
+        {
+          NetworkCodec codec = NetworkCodec::Raw;
+          if ( stream == SensorStream::DEPTH )
+          {
+            codec = settings.CompressDepth ? NetworkCodec::Depth16 : NetworkCodec::Raw;
+          }
+          else if ( stream != SensorStream::PV )
+          {
+            codec = settings.CompressVlc ? NetworkCodec::Gray8 : NetworkCodec::Raw;
+          }
+          server->AddFrameStream( static_cast<SharedStream>( stream ), *framePublisher, codec );
+        }
+      }
+
+      if ( m_sensorScenario )
+      {
+        const std::pair<ResearchModeSensorType, SharedStream> imuStreams[] = {
+            { ResearchModeSensorType::IMU_ACCEL, SharedStream::IMU_ACCEL },
+            { ResearchModeSensorType::IMU_GYRO, SharedStream::IMU_GYRO },
+            { ResearchModeSensorType::IMU_MAG, SharedStream::IMU_MAG } };
+        for ( const auto& imuStream : imuStreams )
+        {
+          auto imuReader = m_sensorScenario->m_imuReaders.find( imuStream.first );
+          if ( imuReader != m_sensorScenario->m_imuReaders.end() )
+          {
+            server->AddImuStream( imuStream.second, imuReader->second->getSampleRing() );
+          }
+        }
+      }
+      server->AddHeadPoseStream();
+
+      NetworkStreamSettings serverSettings;
+      if ( settings.TcpPort > 0 )
+      {
+        serverSettings.tcpPort = settings.TcpPort;
+      }
+      if ( settings.MaxQueuedKBytes > 0 )
+      {
+        serverSettings.maxQueuedBytes = static_cast<size_t>( settings.MaxQueuedKBytes ) * 1024;
+      }
+      if ( settings.MaxClients > 0 )
+      {
+        serverSettings.maxClients = settings.MaxClients;
+      }
+      serverSettings.udpPoseHost = winrt::to_string( settings.UdpPoseHost );
+      serverSettings.udpPosePort = settings.UdpPosePort;
+      if ( !server->Start( serverSettings ) )
+      {
+        return false;
+      }
+
+      m_networkStreamServer = std::move( server );
+      return true;
+    }
+
+    void SolARHololens2ResearchMode::StopNetworkStreaming()
+    {
+      m_networkStreamServer.reset();
+    }
+
+    NetworkStreamingStats SolARHololens2ResearchMode::GetNetworkStreamingStats()
+    {
+      NetworkStreamingStats stats{};
+      if ( m_networkStreamServer )
+      {
+        const NetworkStreamStats serverStats = m_networkStreamServer->GetStats();
+        stats.Clients = serverStats.clients;
+        stats.SentMessages = serverStats.sentMessages;
+        stats.SentBytes = serverStats.sentBytes;
+        stats.DroppedFrames = serverStats.droppedFrames;
+        stats.RawFrameBytes = serverStats.rawFrameBytes;
+        stats.EncodedFrameBytes = serverStats.encodedFrameBytes;
+      }
+      return stats;
+    }
+
+    bool SolARHololens2ResearchMode::SetRecordingFormat( RecordingFormat format, bool compress )
+    {
+      if ( m_is_running )
+      {
+        return false;
+      }
+      m_recordingFormat = format;
+      m_compressRecording = compress;
+      return true;
+    }
+
+    RecordingStats SolARHololens2ResearchMode::GetRecordingStats()
+    {
+      RecordingWriterStats writerStats;
+      RecordingStats stats{};
+      {
+        std::lock_guard<ProfiledMutex> guard( m_recordingSessionMutex );
+        writerStats = m_recordingSession ? m_recordingSession->GetStats() : m_lastRecordingStats;
+        stats.WriteBytesPerSecond = m_recordingSession ? m_recordingSession->GetWriteBytesPerSecond() : m_lastWriteBytesPerSecond;
+        stats.GovernorAdjustments = m_recordingSession ? m_recordingSession->GetGovernorAdjustmentCount() : m_lastGovernorAdjustments;
+      }
+      stats.Records = writerStats.records;
+      stats.Chunks = writerStats.chunks;
+      stats.Bytes = writerStats.bytes;
+      stats.DroppedRecords = writerStats.droppedRecords;
+      stats.LateRecords = writerStats.lateRecords;
+      stats.PendingBytes = writerStats.pendingBytes;
+      return stats;
+    }
+
+    bool SolARHololens2ResearchMode::SetThroughputGovernor( ThroughputGovernorSettings const& settings,
+                                                            array_view<SensorStream const> priority )
+    {
+      if ( m_is_running )
+      {
+        return false;
+      }
+      m_governorSettings = settings;
+      m_governorPriority.clear();
+      for ( SensorStream stream : priority )
+      {
+        // SharedStream starts with the SensorStream values
+        m_governorPriority.push_back( static_cast<SharedStream>( stream ) );
+      }
+      return true;
+    }
+
+    bool SolARHololens2ResearchMode::SetBurstRecording( BurstRecordingSettings const& settings )
+    {
+      if ( m_is_running )
+      {
+        return false;
+      }
+      m_burstSettings = settings;
+      return true;
+    }
+
+    BurstRecordingStats SolARHololens2ResearchMode::GetBurstRecordingStats()
+    {
+      const StagingArenaStats arenaStats = m_stagingArena ? m_stagingArena->GetStats() : m_lastStagingStats;
+      BurstRecordingStats stats{};
+      stats.BudgetBytes = arenaStats.budgetBytes;
+      stats.StagedBytes = arenaStats.stagedBytes;
+      stats.PeakStagedBytes = arenaStats.peakStagedBytes;
+      stats.StagedFiles = arenaStats.stagedRecords;
+      stats.FlushedFiles = arenaStats.flushedRecords;
+      stats.Overflows = arenaStats.overflows;
+      switch ( arenaStats.overflowPolicy )
+      {
+      case StagingOverflowPolicy::DropNewest:
+        stats.OverflowPolicy = BurstOverflowPolicy::DropNewest;
+        break;
+      case StagingOverflowPolicy::DropOldest:
+        stats.OverflowPolicy = BurstOverflowPolicy::DropOldest;
+        break;
+      default:
+        stats.OverflowPolicy = BurstOverflowPolicy::WriteThrough;
+        break;
+      }
+      stats.WrittenThroughFiles = arenaStats.writtenThroughRecords;
+      stats.DroppedFiles = arenaStats.droppedRecords;
+      return stats;
+    }
+
+    bool SolARHololens2ResearchMode::StartContainerRecording( const std::filesystem::path& path )
+    {
+      auto session = std::make_unique<RecordingSession>();
+      RecordingWriterSettings settings;
+      settings.compress = m_compressRecording;
+      if ( !session->Open( path, settings ) )
+      {
+        return false;
+      }
+
+      if ( m_governorSettings.Enabled )
+      {
+        RecordingGovernorSettings governorSettings;
+        governorSettings.budgetBytesPerSecond = static_cast<uint64_t>( m_governorSettings.BudgetKBytesPerSecond ) * 1024;
+        std::vector<SharedStream> priority = m_governorPriority;
+        if ( priority.empty() )
+        {
+          // Depth and front cameras carry the tracking, side cameras are degraded first
+          priority = { SharedStream::DEPTH,
+                       SharedStream::LEFT_FRONT,
+                       SharedStream::RIGHT_FRONT,
+                       SharedStream::PV,
+                       SharedStream::LEFT_LEFT,
+                       SharedStream::RIGHT_RIGHT };
+        }
+        session->EnableGovernor( governorSettings, priority );
+      }
+
+      for ( SensorStream stream : { SensorStream::PV,
+                                    SensorStream::LEFT_FRONT,
+                                    SensorStream::LEFT_LEFT,
+                                    SensorStream::RIGHT_FRONT,
+                                    SensorStream::RIGHT_RIGHT,
+                                    SensorStream::DEPTH } )
+      {
+        FramePublisher* framePublisher = GetFramePublisher( stream );
+        if ( !framePublisher )
+        {
+          continue;
+        }
+        RecordingCalibrationSource calibration;
+        if ( RMCameraReader* reader = GetRMCameraReader( stream ) )
+        {
+          calibration = [reader]( RecordingCalibration& calibration, std::vector<float>& rays )
+          {
+            if ( !reader->getCalibration( calibration.extrinsics, rays ) )
+            {
+              return false;
+            }
+            calibration.width = reader->getWidth();
+            calibration.height = reader->getHeight();
+            return true;
+          };
+        }
+        // SharedStream starts with the SensorStream values
+        session->AddFrameStream( static_cast<SharedStream>( stream ), *framePublisher, std::move( calibration ) );
+      }
+
+      if ( m_sensorScenario )
+      {
+        const std::pair<ResearchModeSensorType, SharedStream> imuStreams[] = {
+            { ResearchModeSensorType::IMU_ACCEL, SharedStream::IMU_ACCEL },
+            { ResearchModeSensorType::IMU_GYRO, SharedStream::IMU_GYRO },
+            { ResearchModeSensorType::IMU_MAG, SharedStream::IMU_MAG } };
+        for ( const auto& imuStream : imuStreams )
+        {
+          auto imuReader = m_sensorScenario->m_imuReaders.find( imuStream.first );
+          if ( imuReader != m_sensorScenario->m_imuReaders.end() )
+          {
+            session->AddImuStream( imuStream.second, *imuReader->second );
+          }
+        }
+      }
+
+      std::lock_guard<ProfiledMutex> guard( m_recordingSessionMutex );
+      m_recordingSession = std::move( session );
+      return true;
+    }
+
+    void SolARHololens2ResearchMode::StopContainerRecording()
+    {
+      std::unique_ptr<RecordingSession> session;
+      {
+        std::lock_guard<ProfiledMutex> guard( m_recordingSessionMutex );
+        session = std::move( m_recordingSession );
+      }
+      if ( session )
+      {
+        // Out of the lock: closing waits for the writer to flush
+        session->Close();
+        std::lock_guard<ProfiledMutex> guard( m_recordingSessionMutex );
+        m_lastRecordingStats = session->GetStats();
+        m_lastWriteBytesPerSecond = session->GetWriteBytesPerSecond();
+        m_lastGovernorAdjustments = session->GetGovernorAdjustmentCount();
+      }
+    }
+
+    void SolARHololens2ResearchMode::PublishHeadPose()
+    {
+      bool recording = false;
+      {
+        std::lock_guard<ProfiledMutex> guard( m_recordingSessionMutex );
+        recording = m_recordingSession != nullptr;
+      }
+      if ( !m_sharedMemoryPublisher && !m_networkStreamServer && !recording )
+      {
+        return;
+      }
+
+      HeadPoseSample pose;
+      const uint64_t timestamp = static_cast<uint64_t>( m_mixedReality.GetPredictedDisplayTime() );
+      if ( !GetHeadPoseAtTimestamp( SensorStream::PV, timestamp, pose ) )
+      {
+        return;
+      }
+
+      const SharedHeadPose sharedPose{ pose.Timestamp,
+                                       { pose.PositionX, pose.PositionY, pose.PositionZ },
+                                       { pose.ForwardX, pose.ForwardY, pose.ForwardZ },
+                                       { pose.UpX, pose.UpY, pose.UpZ },
+                                       0 };
+      if ( m_sharedMemoryPublisher )
+      {
+        m_sharedMemoryPublisher->PublishHeadPose( sharedPose );
+      }
+      if ( m_networkStreamServer )
+      {
+        m_networkStreamServer->PublishHeadPose( sharedPose );
+      }
+
+      std::lock_guard<ProfiledMutex> guard( m_recordingSessionMutex );
+      if ( m_recordingSession )
+      {
+        m_recordingSession->WritePose( sharedPose );
+      }
+    }
+
+    void SolARHololens2ResearchMode::ApplyStreamSettings( SensorStream stream )
+    {
+      auto streamRate = m_streamRateSettings.find( stream );
+      if ( streamRate != m_streamRateSettings.end() )
+      {
+        if ( stream == SensorStream::PV && m_videoFrameProcessor )
+        {
+          m_videoFrameProcessor->SetFrameRate( streamRate->second );
+        }
+        else if ( RMCameraReader* reader = GetRMCameraReader( stream ) )
+        {
+          reader->setFrameRate( streamRate->second );
+        }
+      }
+
+      auto keyframeSettings = m_keyframeSettings.find( stream );
+      if ( keyframeSettings != m_keyframeSettings.end() )
+      {
+        if ( KeyframeSelector* keyframeSelector = GetKeyframeSelector( stream ) )
+        {
+          keyframeSelector->Configure( keyframeSettings->second );
+        }
+      }
+
+      auto sharpnessThreshold = m_sharpnessThresholds.find( stream );
+      if ( sharpnessThreshold != m_sharpnessThresholds.end() )
+      {
+        if ( stream == SensorStream::PV && m_videoFrameProcessor )
+        {
+          m_videoFrameProcessor->SetSharpnessThreshold( sharpnessThreshold->second );
+        }
+        else if ( RMCameraReader* reader = GetRMCameraReader( stream ) )
+        {
+          reader->setSharpnessThreshold( sharpnessThreshold->second );
+        }
+      }
+    }
+
+    RMCameraReader* SolARHololens2ResearchMode::GetRMCameraReader( SensorStream stream )
+    {
+      if ( stream == SensorStream::PV || !m_sensorScenario )
+      {
+        return nullptr;
+      }
+
+      if ( stream == SensorStream::DEPTH )
+      {
+        return m_sensorScenario->m_depthCameraReader.get();
+      }
+
+      auto vlcCameraReader = m_sensorScenario->m_vlcCameraReaders.find( toHololensRMSensorType( stream ) );
+      if ( vlcCameraReader == m_sensorScenario->m_vlcCameraReaders.end() )
+      {
+        return nullptr;
+      }
+      return vlcCameraReader->second.get();
+    }
+
+    KeyframeSelector* SolARHololens2ResearchMode::GetKeyframeSelector( SensorStream stream )
+    {
+      if ( stream == SensorStream::PV )
+      {
+        return m_videoFrameProcessor ? &m_videoFrameProcessor->GetKeyframeSelector() : nullptr;
+      }
+      RMCameraReader* reader = GetRMCameraReader( stream );
+      return reader ? &reader->getKeyframeSelector() : nullptr;
+    }
+
+    PipelineTracer* SolARHololens2ResearchMode::GetPipelineTracer( SensorStream stream )
+    {
+      if ( stream == SensorStream::PV )
+      {
+        return m_videoFrameProcessor ? &m_videoFrameProcessor->GetPipelineTracer() : nullptr;
+      }
+      RMCameraReader* reader = GetRMCameraReader( stream );
+      return reader ? &reader->getPipelineTracer() : nullptr;
+    }
+
+    FrameStatus SolARHololens2ResearchMode::WaitForNextFrame(
+        SensorStream stream,
+        uint64_t lastSeenSequence,
+        uint32_t timeoutMs,
+        uint64_t& sequence )
+    {
+      sequence = 0;
+      if ( stream == SensorStream::PV )
+      {
+        if ( !m_videoFrameProcessor )
+        {
+          return FrameStatus::NoFrame;
+        }
+        return toFrameStatus( m_videoFrameProcessor->WaitForNextFrame( lastSeenSequence, timeoutMs, sequence ) );
+      }
+
+      RMCameraReader* reader = GetRMCameraReader( stream );
+      if ( !reader )
+      {
+        return FrameStatus::NoFrame;
+      }
+      return toFrameStatus( reader->waitForNextFrame( lastSeenSequence, timeoutMs, sequence ) );
+    }
+
+    winrt::Windows::Foundation::IAsyncOperation<FrameStatus> SolARHololens2ResearchMode::WaitForNextFrameAsync(
+        SensorStream stream,
+        uint64_t lastSeenSequence,
+        uint32_t timeoutMs )
+    {
+      // Keep the object alive while waiting on a thread pool thread
+      auto strongThis{ get_strong() };
+      co_await winrt::resume_background();
+
+      uint64_t sequence = 0;
+      co_return WaitForNextFrame( stream, lastSeenSequence, timeoutMs, sequence );
+    }
+
+    FramePublisher* SolARHololens2ResearchMode::GetFramePublisher( SensorStream stream )
+    {
+      if ( stream == SensorStream::PV )
+      {
+        return m_videoFrameProcessor ? &m_videoFrameProcessor->GetFramePublisher() : nullptr;
+      }
+      RMCameraReader* reader = GetRMCameraReader( stream );
+      return reader ? &reader->getFramePublisher() : nullptr;
+    }
+
+    ResearchModeSensorType SolARHololens2ResearchMode::toHololensRMSensorType( RMSensorType sType )
+    {
+        switch ( sType )
+        {
+        case RMSensorType::LEFT_FRONT:
+            return ResearchModeSensorType::LEFT_FRONT;
+        case RMSensorType::LEFT_LEFT:
+            return ResearchModeSensorType::LEFT_LEFT;
+        case RMSensorType::RIGHT_FRONT:
+            return ResearchModeSensorType::RIGHT_FRONT;
+        case RMSensorType::RIGHT_RIGHT:
+            return ResearchModeSensorType::RIGHT_RIGHT;
+        //case RMSensorType::DEPTH_AHAT:
+        //    return ResearchModeSensorType::DEPTH_AHAT;
+        //case RMSensorType::DEPTH_LONG_THROW:
+            return ResearchModeSensorType::DEPTH_LONG_THROW;
+        default:
+            throw std::runtime_error( "Unknown SensorType" );
+        }
+    }
+
+    ResearchModeSensorType SolARHololens2ResearchMode::toHololensRMSensorType( SensorStream stream )
+    {
+        switch ( stream )
+        {
+        case SensorStream::LEFT_FRONT:
+            return ResearchModeSensorType::LEFT_FRONT;
+        case SensorStream::LEFT_LEFT:
+            return ResearchModeSensorType::LEFT_LEFT;
+        case SensorStream::RIGHT_FRONT:
+            return ResearchModeSensorType::RIGHT_FRONT;
+        case SensorStream::RIGHT_RIGHT:
+            return ResearchModeSensorType::RIGHT_RIGHT;
+        default:
+            throw std::runtime_error( "Not a VLC SensorStream" );
+        }
+    }
+
+    SensorStream SolARHololens2ResearchMode::toSensorStream( RMSensorType sensor )
+    {
+        switch ( sensor )
+        {
+        case RMSensorType::LEFT_FRONT:
+            return SensorStream::LEFT_FRONT;
+        case RMSensorType::LEFT_LEFT:
+            return SensorStream::LEFT_LEFT;
+        case RMSensorType::RIGHT_FRONT:
+            return SensorStream::RIGHT_FRONT;
+        case RMSensorType::RIGHT_RIGHT:
+            return SensorStream::RIGHT_RIGHT;
+        default:
+            throw std::runtime_error( "Unknown SensorType" );
+        }
+    }
+
+    ResearchModeSensorType SolARHololens2ResearchMode::toHololensRMSensorType( ImuSensor sensor )
+    {
+        switch ( sensor )
+        {
+        case ImuSensor::Accelerometer:
+            return ResearchModeSensorType::IMU_ACCEL;
+        case ImuSensor::Gyroscope:
+            return ResearchModeSensorType::IMU_GYRO;
+        case ImuSensor::Magnetometer:
+            return ResearchModeSensorType::IMU_MAG;
+        default:
+            throw std::runtime_error( "Unknown ImuSensor" );
+        }
+    }
+
+    FrameStatus SolARHololens2ResearchMode::toFrameStatus( FrameRequestStatus status )
+    {
+        switch ( status )
+        {
+        case FrameRequestStatus::NotModified:
+            return FrameStatus::NotModified;
+        case FrameRequestStatus::NewFrame:
+            return FrameStatus::NewFrame;
+        default:
+            return FrameStatus::NoFrame;
+        }
+    }
+
+    FrameCounters SolARHololens2ResearchMode::toFrameCounters( const StreamFrameCounters& counters )
+    {
+        return FrameCounters{ counters.produced,
+                              counters.consumed,
+                              counters.skipped,
+                              counters.duplicates,
+                              counters.notModified,
+                              counters.decimated,
+                              counters.blurry };
+    }
+
+    StageLatency SolARHololens2ResearchMode::toStageLatency( const LatencyStats& stats )
+    {
+        // Hundreds of nanoseconds to milliseconds
+        constexpr double kTicksPerMs = 10'000.0;
+        return StageLatency{ stats.count,
+                             stats.mean / kTicksPerMs,
+                             stats.p50 / kTicksPerMs,
+                             stats.p90 / kTicksPerMs,
+                             stats.p99 / kTicksPerMs,
+                             stats.max / kTicksPerMs };
     }
     }
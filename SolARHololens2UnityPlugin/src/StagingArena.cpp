@@ -0,0 +1,261 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StagingArena.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+StagingArena::StagingArena(const StagingArenaSettings& settings)
+    : m_settings(settings)
+{
+    m_settings.pageSize = std::max<size_t>(m_settings.pageSize, 1);
+    const size_t pageSize = m_settings.pageSize;
+    const size_t pageCount = std::min<size_t>(m_settings.budgetBytes / pageSize, kNoPage - 1);
+
+    // Touch the pages now rather than on the first frames of the capture
+    m_memory.reset(new uint8_t[pageCount * pageSize]);
+    std::memset(m_memory.get(), 0, pageCount * pageSize);
+
+    m_nextPage.resize(pageCount);
+    for (size_t page = 0; page < pageCount; ++page)
+    {
+        m_nextPage[page] = page + 1 < pageCount ? static_cast<uint32_t>(page + 1) : kNoPage;
+    }
+    m_freeList = pageCount > 0 ? 0 : kNoPage;
+    m_freePageCount = pageCount;
+    m_stats.budgetBytes = pageCount * pageSize;
+    m_stats.overflowPolicy = m_settings.overflowPolicy;
+
+    m_pFlushThread = std::make_unique<std::thread>(FlushThread, this);
+}
+
+StagingArena::~StagingArena()
+{
+    {
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        m_flushRequested = true;
+        m_fExit = true;
+    }
+    m_condVar.notify_all();
+    m_pFlushThread->join();
+}
+
+bool StagingArena::Stage(const std::shared_ptr<StagingSink>& sink, const std::string& name, const uint8_t* pData, size_t dataSize)
+{
+    const size_t size = name.size() + dataSize;
+    const size_t pageCount = std::max<size_t>((size + m_settings.pageSize - 1) / m_settings.pageSize, 1);
+
+    uint32_t firstPage = kNoPage;
+    std::vector<std::shared_ptr<StagingSink>> evictedSinks;
+    {
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        firstPage = AllocatePages(pageCount);
+        if (firstPage == kNoPage)
+        {
+            m_stats.overflows++;
+            if (m_settings.overflowPolicy == StagingOverflowPolicy::DropOldest)
+            {
+                // The record being written cannot be evicted: pages may stay short
+                while (m_freePageCount < pageCount && !m_records.empty())
+                {
+                    Record& oldest = m_records.front();
+                    FreePages(oldest.firstPage);
+                    m_stats.stagedBytes -= oldest.nameSize + oldest.dataSize;
+                    m_stats.droppedRecords++;
+                    // Sinks may close their file when released, out of the lock
+                    evictedSinks.push_back(std::move(oldest.sink));
+                    m_records.pop_front();
+                }
+                firstPage = AllocatePages(pageCount);
+            }
+            if (firstPage == kNoPage && m_settings.overflowPolicy != StagingOverflowPolicy::WriteThrough)
+            {
+                m_stats.droppedRecords++;
+                return false;
+            }
+            if (firstPage == kNoPage)
+            {
+                m_stats.writtenThroughRecords++;
+            }
+        }
+    }
+
+    if (firstPage == kNoPage)
+    {
+        sink->WriteRecord(name, { { pData, dataSize } }, dataSize);
+        return true;
+    }
+
+    // Pages are owned by this call until the record is queued: copy out of the lock
+    uint32_t page = firstPage;
+    size_t pageOffset = 0;
+    const auto copy = [this, &page, &pageOffset](const uint8_t* pSource, size_t count)
+    {
+        while (count > 0)
+        {
+            if (pageOffset == m_settings.pageSize)
+            {
+                page = m_nextPage[page];
+                pageOffset = 0;
+            }
+            const size_t size = std::min(count, m_settings.pageSize - pageOffset);
+            std::memcpy(Page(page) + pageOffset, pSource, size);
+            pSource += size;
+            count -= size;
+            pageOffset += size;
+        }
+    };
+    copy(reinterpret_cast<const uint8_t*>(name.data()), name.size());
+    copy(pData, dataSize);
+
+    {
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        m_records.push_back({ sink, firstPage, name.size(), dataSize });
+        m_stats.stagedRecords++;
+        m_stats.stagedBytes += size;
+        m_stats.peakStagedBytes = std::max(m_stats.peakStagedBytes, m_stats.stagedBytes);
+    }
+    m_condVar.notify_one();
+    return true;
+}
+
+void StagingArena::Flush()
+{
+    std::unique_lock<ProfiledMutex> lock(m_mutex);
+    m_flushRequested = true;
+    m_condVar.notify_all();
+    m_flushedCondVar.wait(lock, [this] { return m_records.empty() && !m_writing; });
+    // Records staged from now on are deferred again
+    m_flushRequested = false;
+}
+
+StagingArenaStats StagingArena::GetStats()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    return m_stats;
+}
+
+void StagingArena::FlushThread(StagingArena* pArena)
+{
+    ScopedThreadProfile profile("StagingArena::FlushThread");
+#ifdef _WIN32
+    // Capture threads go first, the arena absorbs the difference
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+
+    std::string name;
+    std::vector<StagingPiece> pieces;
+    std::unique_lock<ProfiledMutex> lock(pArena->m_mutex);
+    while (true)
+    {
+        pArena->m_condVar.wait(lock, [pArena]
+        {
+            return pArena->m_fExit ||
+                   (!pArena->m_records.empty() &&
+                    (pArena->m_settings.flushMode == StagingFlushMode::Background || pArena->m_flushRequested));
+        });
+        if (pArena->m_records.empty())
+        {
+            // Exiting, everything is written
+            break;
+        }
+
+        Record record = std::move(pArena->m_records.front());
+        pArena->m_records.pop_front();
+        pArena->m_writing = true;
+        lock.unlock();
+
+        // The name is small, the data is written from the pages
+        pArena->GetPieces(record.firstPage, 0, record.nameSize, pieces);
+        name.clear();
+        for (const StagingPiece& piece : pieces)
+        {
+            name.append(reinterpret_cast<const char*>(piece.pData), piece.size);
+        }
+        pArena->GetPieces(record.firstPage, record.nameSize, record.dataSize, pieces);
+        record.sink->WriteRecord(name, pieces, record.dataSize);
+        record.sink.reset();
+
+        lock.lock();
+        pArena->FreePages(record.firstPage);
+        pArena->m_writing = false;
+        pArena->m_stats.stagedBytes -= record.nameSize + record.dataSize;
+        pArena->m_stats.flushedRecords++;
+        pArena->m_stats.flushedBytes += record.dataSize;
+        if (pArena->m_records.empty())
+        {
+            pArena->m_flushedCondVar.notify_all();
+        }
+    }
+    pArena->m_flushedCondVar.notify_all();
+}
+
+uint32_t StagingArena::AllocatePages(size_t count)
+{
+    if (count > m_freePageCount)
+    {
+        return kNoPage;
+    }
+    const uint32_t firstPage = m_freeList;
+    uint32_t lastPage = firstPage;
+    for (size_t i = 1; i < count; ++i)
+    {
+        lastPage = m_nextPage[lastPage];
+    }
+    m_freeList = m_nextPage[lastPage];
+    m_nextPage[lastPage] = kNoPage;
+    m_freePageCount -= count;
+    return firstPage;
+}
+
+void StagingArena::FreePages(uint32_t firstPage)
+{
+    uint32_t lastPage = firstPage;
+    size_t count = 1;
+    while (m_nextPage[lastPage] != kNoPage)
+    {
+        lastPage = m_nextPage[lastPage];
+        count++;
+    }
+    m_nextPage[lastPage] = m_freeList;
+    m_freeList = firstPage;
+    m_freePageCount += count;
+}
+
+void StagingArena::GetPieces(uint32_t firstPage, size_t offset, size_t count, std::vector<StagingPiece>& pieces) const
+{
+    // Page chains are only modified under the lock, and not for the pages of a record in use
+    pieces.clear();
+    const size_t pageSize = m_settings.pageSize;
+    uint32_t page = firstPage;
+    for (; offset >= pageSize; offset -= pageSize)
+    {
+        page = m_nextPage[page];
+    }
+    while (count > 0)
+    {
+        const size_t size = std::min(count, pageSize - offset);
+        pieces.push_back({ Page(page) + offset, size });
+        count -= size;
+        offset = 0;
+        page = m_nextPage[page];
+    }
+}
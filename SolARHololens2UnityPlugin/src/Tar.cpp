@@ -177,9 +177,28 @@ namespace Io
             const std::wstring& fileName,
             const uint8_t* fileData,
             const size_t fileSize)
+    {
+        AddFile(Utf16ToUtf8(fileName), { { fileData, fileSize } }, fileSize);
+    }
+
+    void Tarball::AddFile(
+            const std::string& fileName,
+            const std::vector<StagingPiece>& pieces,
+            const size_t fileSize)
     {
         assert(m_tarballFile.is_open());
 
+        WriteHeader(fileName, fileSize);
+        for (const StagingPiece& piece : pieces)
+        {
+            m_tarballFile.write(
+                reinterpret_cast<const char*>(piece.pData), piece.size);
+        }
+        WritePadding(fileSize);
+    }
+
+    void Tarball::WriteHeader(const std::string& fileName, const size_t fileSize)
+    {
         static_assert(
             sizeof(TarHeader) == 512,
             "Size of the TarHeader structure must be equal to 512 bytes.");
@@ -188,7 +207,7 @@ namespace Io
 
         TarHeader header;
 
-        CopyStringToTarHeader<100>(Utf16ToUtf8(fileName), header.FileName);
+        CopyStringToTarHeader<100>(fileName, header.FileName);
         CopyUInt64ToTarHeaderAsOctets<12>(fileSize, header.FileSize);
         CopyUInt64ToTarHeaderAsOctets<12>(
             std::chrono::duration_cast<std::chrono::seconds>(
@@ -203,24 +222,50 @@ namespace Io
 
         CopyUInt64ToTarHeaderAsOctets<7>(headerChecksum, header.Checksum);
 
-        // Write the header and the data to the tarball.
-
         m_tarballFile.write(
             reinterpret_cast<const char*>(&header), sizeof(header));
-        m_tarballFile.write(
-            reinterpret_cast<const char*>(fileData), fileSize);
+    }
 
+    void Tarball::WritePadding(const size_t fileSize)
+    {
         // Make sure the file is aligned to 512 byes, otherwise
         // pad the file with zeros.
 
+        static const char kZeros[512] = {};
         const size_t lastBlockSize = fileSize % 512;
         if (lastBlockSize != 0)
         {
             const size_t lastBlockPadding = 512 - lastBlockSize;
             assert(lastBlockPadding < 512);
 
-            m_tarballFile.write(
-                std::vector<char>(lastBlockPadding, 0).data(), lastBlockPadding);
+            m_tarballFile.write(kZeros, lastBlockPadding);
         }
     }
+
+    StagedTarball::StagedTarball(const std::wstring& tarballFileName, std::shared_ptr<StagingArena> arena)
+        : m_sink(std::make_shared<Sink>(tarballFileName))
+        , m_arena(std::move(arena))
+    {
+    }
+
+    void StagedTarball::AddFile(
+            const std::wstring& fileName,
+            const uint8_t* fileData,
+            const size_t fileSize)
+    {
+        if (m_arena)
+        {
+            m_arena->Stage(m_sink, Utf16ToUtf8(fileName), fileData, fileSize);
+        }
+        else
+        {
+            m_sink->WriteRecord(Utf16ToUtf8(fileName), { { fileData, fileSize } }, fileSize);
+        }
+    }
+
+    void StagedTarball::Sink::WriteRecord(const std::string& name, const std::vector<StagingPiece>& pieces, size_t dataSize)
+    {
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        m_tarball.AddFile(name, pieces, dataSize);
+    }
 }
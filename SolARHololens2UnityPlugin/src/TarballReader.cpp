@@ -0,0 +1,187 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TarballReader.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr size_t kBlockSize = 512;
+    // Fields of the header block (POSIX ustar, of which Io::Tarball writes the v7 subset)
+    constexpr size_t kNameOffset = 0;
+    constexpr size_t kNameSize = 100;
+    constexpr size_t kSizeOffset = 124;
+    constexpr size_t kSizeSize = 12;
+    constexpr size_t kChecksumOffset = 148;
+    constexpr size_t kChecksumSize = 8;
+    constexpr size_t kTypeOffset = 156;
+    constexpr size_t kMagicOffset = 257;
+    constexpr size_t kPrefixOffset = 345;
+    constexpr size_t kPrefixSize = 155;
+
+    // Octal number, terminated by a space or a null character
+    bool ParseOctal(const uint8_t* pField, size_t size, uint64_t& value)
+    {
+        value = 0;
+        size_t i = 0;
+        while (i < size && pField[i] == ' ')
+        {
+            ++i;
+        }
+        bool hasDigit = false;
+        for (; i < size && pField[i] >= '0' && pField[i] <= '7'; ++i)
+        {
+            value = (value << 3) | static_cast<uint64_t>(pField[i] - '0');
+            hasDigit = true;
+        }
+        return hasDigit && (i == size || pField[i] == ' ' || pField[i] == '\0');
+    }
+
+    std::string ParseString(const uint8_t* pField, size_t size)
+    {
+        const void* pEnd = std::memchr(pField, '\0', size);
+        return std::string(reinterpret_cast<const char*>(pField),
+                           pEnd ? static_cast<const uint8_t*>(pEnd) - pField : size);
+    }
+
+    // Sum of the header bytes, the checksum field counted as spaces
+    bool IsValidHeader(const uint8_t* pHeader)
+    {
+        uint64_t checksum = 0;
+        if (!ParseOctal(pHeader + kChecksumOffset, kChecksumSize, checksum))
+        {
+            return false;
+        }
+        uint64_t sum = 0;
+        for (size_t i = 0; i < kBlockSize; ++i)
+        {
+            sum += (i >= kChecksumOffset && i < kChecksumOffset + kChecksumSize) ? ' ' : pHeader[i];
+        }
+        return sum == checksum;
+    }
+}
+
+namespace Io
+{
+    bool TarballReader::Open(const std::filesystem::path& path)
+    {
+        Close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFile2(path.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        m_fileHandle = file;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(kBlockSize))
+        {
+            Close();
+            return false;
+        }
+        m_mappingHandle = CreateFileMappingFromApp(file, nullptr, PAGE_READONLY, 0, nullptr);
+        m_pData = m_mappingHandle ? static_cast<const uint8_t*>(MapViewOfFileFromApp(m_mappingHandle, FILE_MAP_READ, 0, 0)) : nullptr;
+        m_size = static_cast<size_t>(size.QuadPart);
+#else
+        const int file = open(path.c_str(), O_RDONLY);
+        if (file < 0)
+        {
+            return false;
+        }
+        struct stat status;
+        if (fstat(file, &status) != 0 || status.st_size < static_cast<off_t>(kBlockSize))
+        {
+            close(file);
+            return false;
+        }
+        void* pData = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        // The mapping keeps the file referenced
+        close(file);
+        m_pData = pData != MAP_FAILED ? static_cast<const uint8_t*>(pData) : nullptr;
+        m_size = static_cast<size_t>(status.st_size);
+#endif
+        if (!m_pData || !IsValidHeader(m_pData))
+        {
+            Close();
+            return false;
+        }
+
+        // Stop at the end of archive (zero block), at a corrupted header or at truncated data
+        size_t offset = 0;
+        while (offset + kBlockSize <= m_size && IsValidHeader(m_pData + offset))
+        {
+            const uint8_t* pHeader = m_pData + offset;
+            uint64_t size = 0;
+            if (!ParseOctal(pHeader + kSizeOffset, kSizeSize, size) || size > m_size - offset - kBlockSize)
+            {
+                break;
+            }
+
+            // Regular files only, '\0' for pre-POSIX archives
+            const uint8_t type = pHeader[kTypeOffset];
+            if (type == '0' || type == '\0')
+            {
+                std::string name = ParseString(pHeader + kNameOffset, kNameSize);
+                if (std::memcmp(pHeader + kMagicOffset, "ustar", 5) == 0 && pHeader[kPrefixOffset] != '\0')
+                {
+                    name = ParseString(pHeader + kPrefixOffset, kPrefixSize) + "/" + name;
+                }
+                m_entries.push_back({ std::move(name), pHeader + kBlockSize, static_cast<size_t>(size) });
+            }
+            offset += kBlockSize + ((static_cast<size_t>(size) + kBlockSize - 1) / kBlockSize) * kBlockSize;
+        }
+        return true;
+    }
+
+    void TarballReader::Close()
+    {
+#ifdef _WIN32
+        if (m_pData)
+        {
+            UnmapViewOfFile(m_pData);
+        }
+        if (m_mappingHandle)
+        {
+            CloseHandle(m_mappingHandle);
+        }
+        if (m_fileHandle)
+        {
+            CloseHandle(m_fileHandle);
+        }
+#else
+        if (m_pData)
+        {
+            munmap(const_cast<uint8_t*>(m_pData), m_size);
+        }
+#endif
+        m_pData = nullptr;
+        m_size = 0;
+        m_fileHandle = nullptr;
+        m_mappingHandle = nullptr;
+        m_entries.clear();
+    }
+}
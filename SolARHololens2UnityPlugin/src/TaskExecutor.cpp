@@ -0,0 +1,215 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TaskExecutor.h"
+
+#include <algorithm>
+#include <thread>
+#include <unsupported/Eigen/CXX11/ThreadPool>
+
+namespace
+{
+    // Workers declare themselves to the lock profiler
+    struct ProfiledThreadEnvironment : Eigen::StlThreadEnvironment
+    {
+        EnvThread* CreateThread(std::function<void()> f)
+        {
+            return new EnvThread([f = std::move(f)]()
+            {
+                ScopedThreadProfile profile("TaskExecutor::WorkerThread");
+                f();
+            });
+        }
+    };
+
+    uint64_t ToHundredsOfNanoseconds(std::chrono::steady_clock::duration duration)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::duration<int64_t, std::ratio<1, 10000000>>>(duration).count());
+    }
+}
+
+struct TaskExecutor::WorkerPool : Eigen::NonBlockingThreadPoolTempl<ProfiledThreadEnvironment>
+{
+    using NonBlockingThreadPoolTempl::NonBlockingThreadPoolTempl;
+};
+
+TaskExecutor::TaskExecutor(unsigned threadCount)
+    : m_threadCount(threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency())),
+      m_statsStart(Clock::now())
+{
+    m_pool = std::make_unique<WorkerPool>(static_cast<int>(m_threadCount));
+}
+
+TaskExecutor::~TaskExecutor()
+{
+    // Workers run the remaining tasks before exiting
+    m_pool.reset();
+}
+
+TaskExecutor& TaskExecutor::GetShared()
+{
+    static TaskExecutor* pExecutor = new TaskExecutor();
+    return *pExecutor;
+}
+
+void TaskExecutor::Schedule(TaskPriority priority, Task task)
+{
+    {
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        auto& queue = m_queues[static_cast<size_t>(priority)];
+        queue.push_back({ std::move(task), Clock::now() });
+
+        TaskClassStats& stats = m_stats[static_cast<size_t>(priority)];
+        stats.submitted++;
+        stats.maxQueued = std::max<uint64_t>(stats.maxQueued, queue.size());
+
+        // Enough tokens for every worker to run tasks. Bounded, so that the pool queues never
+        // overflow: the pool would run the token on the calling thread.
+        if (m_activeTokens == m_threadCount)
+        {
+            return;
+        }
+        m_activeTokens++;
+    }
+    m_pool->Schedule([this]() { RunTasks(); });
+}
+
+void TaskExecutor::RunTasks()
+{
+    for (;;)
+    {
+        QueuedTask next;
+        size_t priority = 0;
+        {
+            std::lock_guard<ProfiledMutex> guard(m_mutex);
+            while (priority < kTaskPriorityCount && m_queues[priority].empty())
+            {
+                priority++;
+            }
+            if (priority == kTaskPriorityCount)
+            {
+                m_activeTokens--;
+                return;
+            }
+            next = std::move(m_queues[priority].front());
+            m_queues[priority].pop_front();
+
+            const uint64_t wait = ToHundredsOfNanoseconds(Clock::now() - next.scheduledAt);
+            TaskClassStats& stats = m_stats[priority];
+            stats.started++;
+            stats.waitTotal += wait;
+            stats.waitMax = std::max(stats.waitMax, wait);
+        }
+
+        const Clock::time_point start = Clock::now();
+        next.task();
+        const uint64_t run = ToHundredsOfNanoseconds(Clock::now() - start);
+
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        TaskClassStats& stats = m_stats[priority];
+        stats.completed++;
+        stats.runTotal += run;
+        stats.runMax = std::max(stats.runMax, run);
+    }
+}
+
+std::array<TaskClassStats, kTaskPriorityCount> TaskExecutor::GetStats()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    const double workerTime = static_cast<double>(ToHundredsOfNanoseconds(Clock::now() - m_statsStart)) * m_threadCount;
+    std::array<TaskClassStats, kTaskPriorityCount> stats = m_stats;
+    for (size_t i = 0; i < kTaskPriorityCount; ++i)
+    {
+        stats[i].queued = m_queues[i].size();
+        stats[i].utilization = workerTime > 0. ? static_cast<double>(stats[i].runTotal) / workerTime : 0.;
+    }
+    return stats;
+}
+
+void TaskExecutor::ResetStats()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    for (size_t i = 0; i < kTaskPriorityCount; ++i)
+    {
+        m_stats[i] = TaskClassStats();
+        m_stats[i].maxQueued = m_queues[i].size();
+    }
+    m_statsStart = Clock::now();
+}
+
+SerialTaskQueue::SerialTaskQueue(TaskExecutor& executor, TaskPriority priority, size_t capacity)
+    : m_executor(executor), m_priority(priority), m_capacity(capacity)
+{
+}
+
+SerialTaskQueue::~SerialTaskQueue()
+{
+    Wait();
+}
+
+bool SerialTaskQueue::Schedule(TaskExecutor::Task task)
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    if (m_capacity > 0 && m_tasks.size() >= m_capacity)
+    {
+        m_rejected++;
+        return false;
+    }
+
+    m_tasks.push_back(std::move(task));
+    if (!m_isActive)
+    {
+        m_isActive = true;
+        m_executor.Schedule(m_priority, [this]() { RunNext(); });
+    }
+    return true;
+}
+
+void SerialTaskQueue::RunNext()
+{
+    TaskExecutor::Task task;
+    {
+        std::lock_guard<ProfiledMutex> guard(m_mutex);
+        task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+    }
+
+    task();
+
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    if (m_tasks.empty())
+    {
+        m_isActive = false;
+        m_condVar.notify_all();
+    }
+    else
+    {
+        // Back in the executor queue, so that tasks of higher classes can run in between
+        m_executor.Schedule(m_priority, [this]() { RunNext(); });
+    }
+}
+
+void SerialTaskQueue::Wait()
+{
+    std::unique_lock<ProfiledMutex> lock(m_mutex);
+    m_condVar.wait(lock, [this]() { return !m_isActive; });
+}
+
+uint64_t SerialTaskQueue::GetRejectedCount()
+{
+    std::lock_guard<ProfiledMutex> guard(m_mutex);
+    return m_rejected;
+}
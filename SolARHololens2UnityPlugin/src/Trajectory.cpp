@@ -0,0 +1,432 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Trajectory.h"
+#include "PoseLogWriter.h"
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using RowMajorMatrix4f = Eigen::Matrix<float, 4, 4, Eigen::RowMajor>;
+
+namespace
+{
+    constexpr size_t kTimestampSize = sizeof(int64_t);
+    constexpr size_t kFocalLengthCount = 2;
+    constexpr size_t kMatrixCount = 16;
+
+    void ToQuaternionTranslation(const float transform[16], float pose[7])
+    {
+        const Eigen::Map<const RowMajorMatrix4f> matrix(transform);
+        const Eigen::Quaternionf rotation(matrix.topLeftCorner<3, 3>());
+        pose[0] = matrix(0, 3);
+        pose[1] = matrix(1, 3);
+        pose[2] = matrix(2, 3);
+        pose[3] = rotation.x();
+        pose[4] = rotation.y();
+        pose[5] = rotation.z();
+        pose[6] = rotation.w();
+    }
+
+    void ToTransform(const float pose[7], float transform[16])
+    {
+        Eigen::Map<RowMajorMatrix4f> matrix(transform);
+        matrix.setIdentity();
+        matrix.topLeftCorner<3, 3>() = Eigen::Quaternionf(pose[6], pose[3], pose[4], pose[5]).normalized().toRotationMatrix();
+        matrix(0, 3) = pose[0];
+        matrix(1, 3) = pose[1];
+        matrix(2, 3) = pose[2];
+    }
+
+    // Parse up to count comma separated values of line, return the number parsed
+    size_t ParseFloats(const char*& p, const char* end, float* values, size_t count)
+    {
+        size_t parsed = 0;
+        while (parsed < count && p < end && *p != '\n' && *p != '\r')
+        {
+            if (*p == ',')
+            {
+                ++p;
+            }
+            char* next = nullptr;
+            values[parsed] = std::strtof(p, &next);
+            if (next == p)
+            {
+                break;
+            }
+            p = next;
+            ++parsed;
+        }
+        return parsed;
+    }
+
+    void SkipLine(const char*& p, const char* end)
+    {
+        while (p < end && *p != '\n')
+        {
+            ++p;
+        }
+        if (p < end)
+        {
+            ++p;
+        }
+    }
+}
+
+size_t GetTrajectoryPoseSize(TrajectoryPoseFormat format)
+{
+    return format == TrajectoryPoseFormat::QuaternionTranslation ? 7 : kMatrixCount;
+}
+
+size_t GetTrajectoryRecordSize(TrajectoryPoseFormat format, uint16_t flags)
+{
+    size_t size = kTimestampSize + GetTrajectoryPoseSize(format) * sizeof(float);
+    if (flags & kTrajectoryHasFocalLength)
+    {
+        size += kFocalLengthCount * sizeof(float);
+    }
+    // Keep timestamps 8-byte aligned in mapped files
+    return (size + 7) & ~size_t(7);
+}
+
+TrajectoryWriter::TrajectoryWriter(size_t chunkSize)
+    : m_chunk(std::max(chunkSize, GetTrajectoryRecordSize(TrajectoryPoseFormat::Matrix, kTrajectoryHasFocalLength)))
+{
+}
+
+bool TrajectoryWriter::Open(const std::filesystem::path& path, TrajectoryPoseFormat format, bool hasFocalLength)
+{
+    Close();
+
+    m_header = TrajectoryHeader();
+    m_header.headerSize = sizeof(TrajectoryHeader);
+    m_header.poseFormat = format;
+    m_header.flags = hasFocalLength ? kTrajectoryHasFocalLength : 0;
+    m_header.recordSize = static_cast<uint32_t>(GetTrajectoryRecordSize(format, m_header.flags));
+    m_isHeaderDirty = false;
+    m_recordCount = 0;
+
+    m_file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open())
+    {
+        return false;
+    }
+    m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    m_file.flush();
+    return true;
+}
+
+void TrajectoryWriter::Close()
+{
+    if (m_file.is_open())
+    {
+        WriteChunk();
+        m_file.close();
+    }
+    m_chunkUsed = 0;
+}
+
+void TrajectoryWriter::SetIntrinsics(float cx, float cy, uint32_t width, uint32_t height)
+{
+    m_header.principalPoint[0] = cx;
+    m_header.principalPoint[1] = cy;
+    m_header.imageWidth = width;
+    m_header.imageHeight = height;
+    m_header.flags |= kTrajectoryHasIntrinsics;
+    m_isHeaderDirty = true;
+}
+
+void TrajectoryWriter::Write(int64_t timestamp, const float transform[16], const float* focalLength)
+{
+    if (!m_file.is_open())
+    {
+        return;
+    }
+    if (m_chunkUsed + m_header.recordSize > m_chunk.size())
+    {
+        WriteChunk();
+    }
+
+    char* pRecord = m_chunk.data() + m_chunkUsed;
+    std::memset(pRecord, 0, m_header.recordSize);
+    std::memcpy(pRecord, &timestamp, kTimestampSize);
+    float* pPose = reinterpret_cast<float*>(pRecord + kTimestampSize);
+    if (m_header.poseFormat == TrajectoryPoseFormat::QuaternionTranslation)
+    {
+        ToQuaternionTranslation(transform, pPose);
+    }
+    else
+    {
+        std::memcpy(pPose, transform, kMatrixCount * sizeof(float));
+    }
+    if ((m_header.flags & kTrajectoryHasFocalLength) && focalLength)
+    {
+        std::memcpy(pPose + GetTrajectoryPoseSize(m_header.poseFormat), focalLength, kFocalLengthCount * sizeof(float));
+    }
+
+    m_chunkUsed += m_header.recordSize;
+    m_recordCount++;
+}
+
+void TrajectoryWriter::WriteChunk()
+{
+    if (m_isHeaderDirty)
+    {
+        m_file.seekp(0);
+        m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+        m_file.seekp(0, std::ios::end);
+        m_isHeaderDirty = false;
+    }
+    if (m_chunkUsed > 0)
+    {
+        m_file.write(m_chunk.data(), m_chunkUsed);
+        m_chunkUsed = 0;
+    }
+    m_file.flush();
+}
+
+bool TrajectoryReader::Open(const std::filesystem::path& path)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFile2(path.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    m_fileHandle = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(TrajectoryHeader)))
+    {
+        Close();
+        return false;
+    }
+    m_mappingHandle = CreateFileMappingFromApp(file, nullptr, PAGE_READONLY, 0, nullptr);
+    m_pData = m_mappingHandle ? static_cast<const uint8_t*>(MapViewOfFileFromApp(m_mappingHandle, FILE_MAP_READ, 0, 0)) : nullptr;
+    m_size = static_cast<size_t>(size.QuadPart);
+#else
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(TrajectoryHeader)))
+    {
+        close(file);
+        return false;
+    }
+    void* pData = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    // The mapping keeps the file referenced
+    close(file);
+    m_pData = pData != MAP_FAILED ? static_cast<const uint8_t*>(pData) : nullptr;
+    m_size = static_cast<size_t>(status.st_size);
+#endif
+    if (!m_pData)
+    {
+        Close();
+        return false;
+    }
+
+    std::memcpy(&m_header, m_pData, sizeof(m_header));
+    if (std::memcmp(m_header.magic, TrajectoryHeader().magic, sizeof(m_header.magic)) != 0 ||
+        m_header.version != TrajectoryHeader::kVersion ||
+        m_header.headerSize < sizeof(TrajectoryHeader) || m_header.headerSize > m_size ||
+        m_header.recordSize != GetTrajectoryRecordSize(m_header.poseFormat, m_header.flags))
+    {
+        Close();
+        return false;
+    }
+    m_pRecords = m_pData + m_header.headerSize;
+    m_recordCount = (m_size - m_header.headerSize) / m_header.recordSize;
+    return true;
+}
+
+void TrajectoryReader::Close()
+{
+#ifdef _WIN32
+    if (m_pData)
+    {
+        UnmapViewOfFile(m_pData);
+    }
+    if (m_mappingHandle)
+    {
+        CloseHandle(m_mappingHandle);
+    }
+    if (m_fileHandle)
+    {
+        CloseHandle(m_fileHandle);
+    }
+#else
+    if (m_pData)
+    {
+        munmap(const_cast<uint8_t*>(m_pData), m_size);
+    }
+#endif
+    m_pData = nullptr;
+    m_size = 0;
+    m_fileHandle = nullptr;
+    m_mappingHandle = nullptr;
+    m_header = TrajectoryHeader();
+    m_pRecords = nullptr;
+    m_recordCount = 0;
+}
+
+int64_t TrajectoryReader::GetTimestamp(size_t index) const
+{
+    int64_t timestamp;
+    std::memcpy(&timestamp, Record(index), kTimestampSize);
+    return timestamp;
+}
+
+const float* TrajectoryReader::GetPose(size_t index) const
+{
+    return reinterpret_cast<const float*>(Record(index) + kTimestampSize);
+}
+
+const float* TrajectoryReader::GetFocalLength(size_t index) const
+{
+    if (!(m_header.flags & kTrajectoryHasFocalLength))
+    {
+        return nullptr;
+    }
+    return GetPose(index) + GetTrajectoryPoseSize(m_header.poseFormat);
+}
+
+void TrajectoryReader::GetTransform(size_t index, float transform[16]) const
+{
+    if (m_header.poseFormat == TrajectoryPoseFormat::QuaternionTranslation)
+    {
+        ToTransform(GetPose(index), transform);
+    }
+    else
+    {
+        std::memcpy(transform, GetPose(index), kMatrixCount * sizeof(float));
+    }
+}
+
+size_t TrajectoryReader::LowerBound(int64_t timestamp) const
+{
+    size_t first = 0;
+    size_t count = m_recordCount;
+    while (count > 0)
+    {
+        const size_t step = count / 2;
+        if (GetTimestamp(first + step) < timestamp)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+    return first;
+}
+
+bool ConvertTrajectoryToCsv(const std::filesystem::path& trajectoryPath, const std::filesystem::path& csvPath)
+{
+    TrajectoryReader reader;
+    PoseLogWriter writer;
+    if (!reader.Open(trajectoryPath) || !writer.Open(csvPath))
+    {
+        return false;
+    }
+
+    const TrajectoryHeader& header = reader.GetHeader();
+    const bool hasFocalLength = (header.flags & kTrajectoryHasFocalLength) != 0;
+    if (hasFocalLength)
+    {
+        std::ostringstream intrinsics;
+        intrinsics << header.principalPoint[0] << "," << header.principalPoint[1] << ","
+                   << header.imageWidth << "," << header.imageHeight;
+        writer.WriteLine(intrinsics.str());
+    }
+
+    float values[kFocalLengthCount + kMatrixCount];
+    for (size_t i = 0; i < reader.GetRecordCount(); ++i)
+    {
+        float* pTransform = values;
+        if (hasFocalLength)
+        {
+            std::memcpy(values, reader.GetFocalLength(i), kFocalLengthCount * sizeof(float));
+            pTransform += kFocalLengthCount;
+        }
+        reader.GetTransform(i, pTransform);
+        writer.WriteRecord(reader.GetTimestamp(i), values, (pTransform - values) + kMatrixCount);
+    }
+    writer.Close();
+    return true;
+}
+
+bool ConvertCsvToTrajectory(const std::filesystem::path& csvPath, const std::filesystem::path& trajectoryPath,
+    bool hasFocalLength, TrajectoryPoseFormat format)
+{
+    std::ifstream file(csvPath, std::ios::in | std::ios::binary);
+    TrajectoryWriter writer;
+    if (!file || !writer.Open(trajectoryPath, format, hasFocalLength))
+    {
+        return false;
+    }
+    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const char* p = content.data();
+    const char* end = p + content.size();
+
+    if (hasFocalLength)
+    {
+        float intrinsics[4];
+        if (ParseFloats(p, end, intrinsics, 4) == 4)
+        {
+            writer.SetIntrinsics(intrinsics[0], intrinsics[1], static_cast<uint32_t>(intrinsics[2]), static_cast<uint32_t>(intrinsics[3]));
+        }
+        SkipLine(p, end);
+    }
+
+    const size_t valueCount = (hasFocalLength ? kFocalLengthCount : 0) + kMatrixCount;
+    float values[kFocalLengthCount + kMatrixCount];
+    while (p < end)
+    {
+        char* next = nullptr;
+        const long long timestamp = std::strtoll(p, &next, 10);
+        if (next != p)
+        {
+            p = next;
+            if (ParseFloats(p, end, values, valueCount) == valueCount)
+            {
+                writer.Write(timestamp, hasFocalLength ? values + kFocalLengthCount : values, hasFocalLength ? values : nullptr);
+            }
+        }
+        SkipLine(p, end);
+    }
+    writer.Close();
+    return true;
+}
@@ -16,8 +16,8 @@
 
 #include "pch.h"
 #include "VideoFrameProcessor.h"
+#include "PoseConversion.h"
 #include <winrt/Windows.Foundation.Collections.h>
-#include <fstream>
 
 using namespace winrt::Windows::Foundation::Collections;
 using namespace winrt::Windows::Media::Capture;
@@ -26,6 +26,37 @@ using namespace winrt::Windows::Perception::Spatial;
 using namespace winrt::Windows::Graphics::Imaging;
 using namespace winrt::Windows::Storage;
 
+namespace
+{
+    // Sharpness of the luminance of a bitmap, FrameQuality::kNoScore for unsupported formats.
+    // NV12 frames are scored on their luminance plane, before any conversion.
+    float ComputeSharpness(const SoftwareBitmap& bitmap)
+    {
+        const BitmapPixelFormat format = bitmap.BitmapPixelFormat();
+        const bool isBgra = (format == BitmapPixelFormat::Bgra8);
+        if (!isBgra && format != BitmapPixelFormat::Nv12 && format != BitmapPixelFormat::Gray8)
+        {
+            return FrameQuality::kNoScore;
+        }
+
+        BitmapBuffer bitmapBuffer = bitmap.LockBuffer(BitmapBufferAccessMode::Read);
+        // Plane 0 is the luminance plane of NV12 bitmaps
+        const BitmapPlaneDescription plane = bitmapBuffer.GetPlaneDescription(0);
+
+        uint32_t pixelBufferDataLength = 0;
+        uint8_t* pixelBufferData = nullptr;
+        auto spMemoryBufferByteAccess{ bitmapBuffer.CreateReference().as<::Windows::Foundation::IMemoryBufferByteAccess>() };
+        winrt::check_hresult(spMemoryBufferByteAccess->GetBuffer(&pixelBufferData, &pixelBufferDataLength));
+
+        const uint8_t* pPlane = pixelBufferData + plane.StartIndex;
+        const uint32_t width = static_cast<uint32_t>(plane.Width);
+        const uint32_t height = static_cast<uint32_t>(plane.Height);
+        const uint32_t stride = static_cast<uint32_t>(plane.Stride);
+        return isBgra ? FrameQuality::SharpnessBgra8(pPlane, width, height, stride)
+                      : FrameQuality::SharpnessGray8(pPlane, width, height, stride);
+    }
+}
+
 const int VideoFrameProcessor::kImageWidth = 760;
 const wchar_t VideoFrameProcessor::kSensorName[3] = L"PV";
 
@@ -109,8 +140,6 @@ winrt::Windows::Foundation::IAsyncAction VideoFrameProcessor::InitializeAsync()
 
     winrt::check_bool(status == MediaFrameReaderStartStatus::Success);
 
-    // reserve for 10 seconds at 30fps
-    m_PVFrameLog.reserve(10 * 30);
     // m_pGrabThread = new std::thread(CameraGrabThread, this);
 
     m_OnFrameArrivedRegistration = m_mediaFrameReader.FrameArrived({ this, &VideoFrameProcessor::OnFrameArrived });
@@ -121,9 +150,15 @@ void VideoFrameProcessor::OnFrameArrived(const MediaFrameReader& sender, const M
 {
     if (MediaFrameReference frame = sender.TryAcquireLatestFrame())
     {   //
-        std::lock_guard<std::shared_mutex> lock(m_frameMutex);
+        std::lock_guard<ProfiledSharedMutex> lock(m_frameMutex);
         m_latestFrame = frame;
+        m_latestFrameArrival = PipelineClockNow();
         m_NbFrameArrived++; 
+        if (m_isConverting)
+        {
+            // Not scheduled if a conversion is already pending: it will convert this frame
+            m_conversionQueue.Schedule([this]() { ConvertLatestFrame(); });
+        }
     }
 }
 
@@ -134,29 +169,46 @@ uint32_t VideoFrameProcessor::GetNbFrameCopyToClient() { return m_NbFrameCopyToC
 
 uint32_t VideoFrameProcessor::GetRGBByteArraySize()
 {
-    std::lock_guard<std::shared_mutex> lock( m_frameMutex );
+    std::lock_guard<ProfiledSharedMutex> lock( m_frameMutex );
     return m_RGBFrame.pixelBufferSize;
 }
 
 uint32_t VideoFrameProcessor::GetRGBByteArrayWidth()
 {
-    std::lock_guard<std::shared_mutex> lock( m_frameMutex );
+    std::lock_guard<ProfiledSharedMutex> lock( m_frameMutex );
     return m_RGBFrame.width;
 }
 
 uint32_t VideoFrameProcessor::GetRGBByteArrayHeight()
 {
-    std::lock_guard<std::shared_mutex> lock( m_frameMutex );
+    std::lock_guard<ProfiledSharedMutex> lock( m_frameMutex );
     return m_RGBFrame.height;
 }
 
-void VideoFrameProcessor::CopyLastFrame(PVFrame& to_RGBFrame) // 
+FrameRequestStatus VideoFrameProcessor::CopyLastFrame(PVFrame& to_RGBFrame, uint64_t lastSeenSequence)
 {
-    std::lock_guard<std::shared_mutex> lock( m_frameMutex );
+    std::lock_guard<ProfiledSharedMutex> lock( m_frameMutex );
+
+    const bool pickedUp = !m_frameSequence.IsLatestServed();
+    FrameRequestStatus status = m_frameSequence.Request(lastSeenSequence);
+    if (status != FrameRequestStatus::NewFrame)
+    {
+        return status;
+    }
+    if (pickedUp)
+    {
+        m_tracer.PickedUp(m_frameTrace);
+    }
+
+    // re allocation if data size changes
+    if (to_RGBFrame.pixelBufferSize != m_RGBFrame.pixelBufferSize)
+    {
+        delete[] to_RGBFrame.pixelBufferData;
+        to_RGBFrame.pixelBufferData = new uint8_t[m_RGBFrame.pixelBufferSize];
+        to_RGBFrame.pixelBufferSize = m_RGBFrame.pixelBufferSize;
+    }
 
-    // if to_RGBFrame buffer has been allocated and shares the same size as m_RGBFrame
-    // recopy m_RGBFrame datas
-    if (to_RGBFrame.pixelBufferData != nullptr  && to_RGBFrame.pixelBufferSize == m_RGBFrame.pixelBufferSize)
+    if (to_RGBFrame.pixelBufferData != nullptr)
     {
         // buffer copy
         std::memcpy(&(to_RGBFrame.pixelBufferData[0]), m_RGBFrame.pixelBufferData, m_RGBFrame.pixelBufferSize);
@@ -166,139 +218,226 @@ void VideoFrameProcessor::CopyLastFrame(PVFrame& to_RGBFrame) //
         to_RGBFrame.fx                 = m_RGBFrame.fx;
         to_RGBFrame.fy                 = m_RGBFrame.fy;
         to_RGBFrame.timestamp          = (uint64_t) m_RGBFrame.timestamp;
+        to_RGBFrame.sequence           = m_RGBFrame.sequence;
+        to_RGBFrame.sharpness          = m_RGBFrame.sharpness;
         to_RGBFrame.PVtoWorldtransform = m_RGBFrame.PVtoWorldtransform;
+        to_RGBFrame.poseValid          = m_RGBFrame.poseValid;
 
         m_NbFrameCopyToClient = m_NbFrameCopyToClient + 1;
-        m_RGBByteArrayNewAvailable = false;
     }
+    return status;
 }
 
-bool VideoFrameProcessor::GetRGBByteArrayNewAvailable()
+StreamFrameCounters VideoFrameProcessor::GetFrameCounters()
 {
-    return m_RGBByteArrayNewAvailable;
+    std::lock_guard<ProfiledSharedMutex> lock( m_frameMutex );
+    StreamFrameCounters counters = m_frameSequence.Counters();
+    counters.decimated = m_rateController.GetDecimatedCount();
+    counters.blurry = m_sharpnessFilter.GetRejectedCount();
+    return counters;
 }
 
-//void VideoFrameProcessor::AddLogFrame()
-//{
-//    // Lock on m_frameMutex from caller
-//    PVFrame frame;
-//
-//    frame.timestamp = m_latestTimestamp;
-//    frame.fx = m_latestFrame.VideoMediaFrame().CameraIntrinsics().FocalLength().x;
-//    frame.fy = m_latestFrame.VideoMediaFrame().CameraIntrinsics().FocalLength().y;
-//
-//    auto PVtoWorld = m_latestFrame.CoordinateSystem().TryGetTransformTo(m_worldCoordSystem);
-//    if (PVtoWorld)
-//    {
-//        frame.PVtoWorldtransform = PVtoWorld.Value();
-//    }
-//    m_PVFrameLog.push_back(std::move(frame));
-//}
+FrameRequestStatus VideoFrameProcessor::WaitForNextFrame(uint64_t lastSeenSequence, uint32_t timeoutMs, uint64_t& sequence)
+{
+    std::unique_lock<ProfiledSharedMutex> lock( m_frameMutex );
+    return m_frameSequence.Wait(lock, m_frameCondVar, lastSeenSequence, timeoutMs, [this]() { return m_fExit; }, sequence);
+}
+
+void VideoFrameProcessor::AddLogFrame(const winrt::Windows::Media::Devices::Core::CameraIntrinsics& intrinsics, const PVFrame& metadata)
+{
+    // As for the Research Mode cameras, frames which could not be located are not in the pose log
+    if (!metadata.poseValid)
+    {
+        return;
+    }
+    if (m_poseLog.GetRecordCount() == 0)
+    {
+        m_poseLog.SetIntrinsics(intrinsics.PrincipalPoint().x, intrinsics.PrincipalPoint().y, intrinsics.ImageWidth(), intrinsics.ImageHeight());
+    }
 
-// This thread converts last grabbed frame and updates m_RGBFrame
-void VideoFrameProcessor::CameraGrabThread(VideoFrameProcessor* pProcessor)
+    float PVtoWorld[PoseConversion::kTransformSize];
+    PoseConversion::Convert<PoseConversion::Layout::RowMajor, PoseConversion::CameraAxes::HoloLens>(&metadata.PVtoWorldtransform.m11, PVtoWorld);
+    const float focalLength[] = { metadata.fx, metadata.fy };
+    m_poseLog.Write(metadata.timestamp, PVtoWorld, focalLength);
+}
+
+// Converts the latest arrived frame and updates m_RGBFrame
+void VideoFrameProcessor::ConvertLatestFrame()
 {
-    while (!pProcessor->m_fExit)
+    std::lock_guard<ProfiledSharedMutex> lock(m_frameMutex);
+    if (m_latestFrame == nullptr)
+    {
+        return;
+    }
+
+    auto frame = m_latestFrame;
+    long long timestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds(frame.SystemRelativeTime().Value().count())).count();
+    if (timestamp == m_latestTimestamp)
+    {
+        // Already processed
+        return;
+    }
+
+    // Decimation happens before pose lookup and conversion
+    FrameRateController& rateController = m_rateController;
+    if (!rateController.AcceptTimestamp(static_cast<uint64_t>(timestamp)))
+    {
+        // Mark the frame as processed so that it is not evaluated again
+        m_latestTimestamp = timestamp;
+        return;
+    }
+
+    FrameTrace trace;
+    // SystemRelativeTime is on the QPC clock, like PipelineClockNow()
+    trace.Set(PipelineStage::Exposure, static_cast<uint64_t>(frame.SystemRelativeTime().Value().count()));
+    trace.Set(PipelineStage::Acquired, m_latestFrameArrival);
+
+    assert( m_worldCoordSystem );
+
+    auto PVtoWorld = frame.CoordinateSystem().TryGetTransformTo(m_worldCoordSystem);
+    trace.Mark(PipelineStage::Located);
+    const KeyframePose keyframePose = PVtoWorld ? ToKeyframePose(PVtoWorld.Value()) : KeyframePose{};
+    if (PVtoWorld && rateController.RequiresPose() && !rateController.AcceptPose(keyframePose))
+    {
+        m_latestTimestamp = timestamp;
+        return;
+    }
+
+    const float sharpness = ComputeSharpness(frame.VideoMediaFrame().SoftwareBitmap());
+    if (!m_sharpnessFilter.Accept(sharpness))
+    {
+        m_latestTimestamp = timestamp;
+        return;
+    }
+
+    if (!m_keyframeSelector.Evaluate(static_cast<uint64_t>(timestamp), PVtoWorld ? &keyframePose : nullptr))
+    {
+        m_latestTimestamp = timestamp;
+        return;
+    }
+
+    if (PVtoWorld)
+    {
+        rateController.Commit(static_cast<uint64_t>(timestamp), keyframePose);
+    }
+    else
+    {
+        rateController.Commit(static_cast<uint64_t>(timestamp));
+    }
+
+    SoftwareBitmap softwareBitmap = SoftwareBitmap::Convert(frame.VideoMediaFrame().SoftwareBitmap(), BitmapPixelFormat::Bgra8);
+    trace.Mark(PipelineStage::Converted);
+
+    if (softwareBitmap != nullptr)
     {
-        std::lock_guard<std::shared_mutex> lock(pProcessor->m_frameMutex);
-        if (pProcessor->m_latestFrame != nullptr)
+        // Fill RGB Frame infos
+        m_latestTimestamp = timestamp;
+
+        m_RGBFrame.timestamp = timestamp;
+        m_RGBFrame.fx = frame.VideoMediaFrame().CameraIntrinsics().FocalLength().x;
+        m_RGBFrame.fy = frame.VideoMediaFrame().CameraIntrinsics().FocalLength().y;
+        m_RGBFrame.width = softwareBitmap.PixelWidth();
+        m_RGBFrame.height = softwareBitmap.PixelHeight();
+        m_RGBFrame.sharpness = sharpness;
+
+        //// use first pose as world reference coordinate system
+        //if ( !m_isWorldCoordSystemSet )
+        //{
+        //    if ( frame.CoordinateSystem() )
+        //    {
+        //    m_worldCoordSystem = frame.CoordinateSystem();
+        //    m_isWorldCoordSystemSet = true;
+        //    }
+        //}
+
+        // A frame which cannot be located does not keep the pose of the previous one
+        m_RGBFrame.PVtoWorldtransform = PVtoWorld ? PVtoWorld.Value() : winrt::Windows::Foundation::Numerics::float4x4::identity();
+        m_RGBFrame.poseValid = static_cast<bool>(PVtoWorld);
+        m_NbFrameConverted = m_NbFrameConverted + 1;
+
+        // Get image buffer data
         {
-            auto frame = pProcessor->m_latestFrame;
-            long long timestamp = pProcessor->m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds(frame.SystemRelativeTime().Value().count())).count();
-            if (timestamp != pProcessor->m_latestTimestamp)
+            // Get bitmap buffer object of the frame
+            BitmapBuffer bitmapBuffer = softwareBitmap.LockBuffer(BitmapBufferAccessMode::Read);
+
+            // Get raw pointer to the buffer object
+            uint32_t pixelBufferDataLength = 0;
+            uint8_t* pixelBufferData;
+
+            auto spMemoryBufferByteAccess{ bitmapBuffer.CreateReference().as<::Windows::Foundation::IMemoryBufferByteAccess>() };
+            winrt::check_hresult(spMemoryBufferByteAccess->GetBuffer(&pixelBufferData, &pixelBufferDataLength));
+
+            // check if buffer must be reallocated
+            if (m_RGBFrame.pixelBufferSize != pixelBufferDataLength)
             {
-                SoftwareBitmap softwareBitmap = SoftwareBitmap::Convert(frame.VideoMediaFrame().SoftwareBitmap(), BitmapPixelFormat::Bgra8);
-                    
-                if (softwareBitmap != nullptr)
+                if (m_RGBFrame.pixelBufferData != nullptr)
                 {
-                    // Fill RGB Frame infos
-                    pProcessor->m_latestTimestamp = timestamp;
-
-                    pProcessor->m_RGBFrame.timestamp = timestamp;
-                    pProcessor->m_RGBFrame.fx = frame.VideoMediaFrame().CameraIntrinsics().FocalLength().x;
-                    pProcessor->m_RGBFrame.fy = frame.VideoMediaFrame().CameraIntrinsics().FocalLength().y;
-                    pProcessor->m_RGBFrame.width = softwareBitmap.PixelWidth();
-                    pProcessor->m_RGBFrame.height = softwareBitmap.PixelHeight();
-
-                    //// use first pose as world reference coordinate system
-                    //if ( !pProcessor->m_isWorldCoordSystemSet )
-                    //{
-                    //    if ( frame.CoordinateSystem() )
-                    //    {
-                    //    pProcessor->m_worldCoordSystem = frame.CoordinateSystem();
-                    //    pProcessor->m_isWorldCoordSystemSet = true;
-                    //    }
-                    //}
-
-                    assert( pProcessor->m_worldCoordSystem );
-
-                    auto PVtoWorld = pProcessor->m_latestFrame.CoordinateSystem().TryGetTransformTo(pProcessor->m_worldCoordSystem);
-                    if (PVtoWorld)
-                    {
-                        pProcessor->m_RGBFrame.PVtoWorldtransform = PVtoWorld.Value();
-                    }
-                    pProcessor->m_NbFrameConverted = pProcessor->m_NbFrameConverted + 1;
+                    delete[] m_RGBFrame.pixelBufferData;
+                    m_RGBFrame.pixelBufferData = nullptr;
+                    m_RGBFrame.pixelBufferSize = 0;
+                }
+                m_RGBFrame.pixelBufferData = new uint8_t[pixelBufferDataLength];
+                m_RGBFrame.pixelBufferSize = pixelBufferDataLength;
+            }
 
-                    // Get image buffer data
-                    {
-                        // Get bitmap buffer object of the frame
-                        BitmapBuffer bitmapBuffer = softwareBitmap.LockBuffer(BitmapBufferAccessMode::Read);
-
-                        // Get raw pointer to the buffer object
-                        uint32_t pixelBufferDataLength = 0;
-                        uint8_t* pixelBufferData;
-
-                        auto spMemoryBufferByteAccess{ bitmapBuffer.CreateReference().as<::Windows::Foundation::IMemoryBufferByteAccess>() };
-                        winrt::check_hresult(spMemoryBufferByteAccess->GetBuffer(&pixelBufferData, &pixelBufferDataLength));
-
-                        // check if buffer must be reallocated
-                        if (pProcessor->m_RGBFrame.pixelBufferSize != pixelBufferDataLength)
-                        {
-                            if (pProcessor->m_RGBFrame.pixelBufferData != nullptr)
-                            {
-                                delete[] pProcessor->m_RGBFrame.pixelBufferData;
-                                pProcessor->m_RGBFrame.pixelBufferData = nullptr;
-                                pProcessor->m_RGBFrame.pixelBufferSize = 0;
-                            }
-                            pProcessor->m_RGBFrame.pixelBufferData = new uint8_t[pixelBufferDataLength];
-                            pProcessor->m_RGBFrame.pixelBufferSize = pixelBufferDataLength;
-                        }
-
-                        // 
-                        std::memcpy(pProcessor->m_RGBFrame.pixelBufferData, &pixelBufferData[0], pixelBufferDataLength);
-
-                        pProcessor->m_NbFrameCopyInContext = pProcessor->m_NbFrameCopyInContext + 1;
-                        pProcessor->m_RGBByteArrayNewAvailable = true;
-                    }
+            // 
+            std::memcpy(m_RGBFrame.pixelBufferData, &pixelBufferData[0], pixelBufferDataLength);
+
+            m_NbFrameCopyInContext = m_NbFrameCopyInContext + 1;
+            m_RGBFrame.sequence = m_frameSequence.Produce();
+            trace.sequence = m_RGBFrame.sequence;
+            trace.Mark(PipelineStage::Copied);
+            m_frameTrace = trace;
+            m_frameCondVar.notify_all();
+
+            if (m_framePublisher.HasSubscribers())
+            {
+                auto sharedFrame = m_framePublisher.AllocateFrame();
+                sharedFrame->sequence = m_RGBFrame.sequence;
+                sharedFrame->timestamp = m_RGBFrame.timestamp;
+                sharedFrame->toWorldTransform = ToKeyframePose(m_RGBFrame.PVtoWorldtransform);
+                sharedFrame->poseValid = m_RGBFrame.poseValid;
+                sharedFrame->width = m_RGBFrame.width;
+                sharedFrame->height = m_RGBFrame.height;
+                sharedFrame->bytesPerPixel = 4;
+                sharedFrame->sharpness = sharpness;
+                sharedFrame->data.assign(pixelBufferData, pixelBufferData + pixelBufferDataLength);
+                m_framePublisher.Publish(sharedFrame);
+            }
+            trace.Mark(PipelineStage::Published);
+            m_tracer.Complete(trace);
+        }
 
+        {
+            std::lock_guard<ProfiledMutex> guard( m_storageMutex );
+            // Recording ?
+            if ( m_storageFolder != nullptr )
+            {
+                PVFrame metadata;
+                metadata.timestamp = m_RGBFrame.timestamp;
+                metadata.sequence = m_RGBFrame.sequence;
+                metadata.PVtoWorldtransform = m_RGBFrame.PVtoWorldtransform;
+                metadata.poseValid = m_RGBFrame.poseValid;
+                metadata.fx = m_RGBFrame.fx;
+                metadata.fy = m_RGBFrame.fy;
+                // The converted bitmap is queued, not the frame: reader buffers are not held meanwhile
+                auto intrinsics = frame.VideoMediaFrame().CameraIntrinsics();
+                m_recordingQueue.Schedule([this, intrinsics, metadata, softwareBitmap]()
+                {
+                    std::lock_guard<ProfiledMutex> guard( m_storageMutex );
+                    if ( m_storageFolder != nullptr )
                     {
-                        std::lock_guard<std::mutex> guard( pProcessor->m_storageMutex );
-                        // Recording ?
-                        if ( pProcessor->m_storageFolder != nullptr )
-                        {
-                        // TODO(jmhenaff): Warning this version of PVFrame added image buffer
-                        // (compared to the sample version). So only original info must be used
-                        // (timestamp, fx/fy, PVToWorld matrix) Add another structure only
-                        // containing these info and add it to PVFrame to replace them ?
-                        pProcessor->m_PVFrameLog.push_back( pProcessor->m_RGBFrame );
-
-                        // Convert and write the bitmap
-                        pProcessor->DumpFrame( softwareBitmap, pProcessor->m_latestTimestamp );
-                        }
+                        AddLogFrame( intrinsics, metadata );
+
+                        // Write the bitmap
+                        DumpFrame( softwareBitmap, metadata.timestamp );
                     }
-                }
+                });
             }
         }
-        
     }
 }
 
-void VideoFrameProcessor::Clear()
-{
-    std::lock_guard<std::shared_mutex> lock(m_frameMutex);
-    m_PVFrameLog.clear();
-}
-
 void VideoFrameProcessor::DumpFrame(const SoftwareBitmap& softwareBitmap, long long timestamp)
 {
     // Compose the output file name
@@ -318,45 +457,8 @@ void VideoFrameProcessor::DumpFrame(const SoftwareBitmap& softwareBitmap, long l
     m_tarball->AddFile(bitmapPath, &pixelBufferData[0], pixelBufferDataLength);
 }
 
-bool VideoFrameProcessor::DumpDataToDisk( const StorageFolder& folder,
-                                          const std::wstring& datetime_path )
-{
-  auto path = folder.Path().data();
-  std::wstring fullName( path );
-  fullName += L"\\" + datetime_path + L"_pv.txt";
-  std::ofstream file( fullName );
-  if ( !file )
-  {
-    return false;
-  }
-
-  std::lock_guard<std::shared_mutex> lock( m_frameMutex );
-  // assuming this is called at the end of the capture session, and m_latestFrame is not nullptr
-  assert( m_latestFrame != nullptr );
-  file << m_latestFrame.VideoMediaFrame().CameraIntrinsics().PrincipalPoint().x << ","
-       << m_latestFrame.VideoMediaFrame().CameraIntrinsics().PrincipalPoint().y << ","
-       << m_latestFrame.VideoMediaFrame().CameraIntrinsics().ImageWidth() << ","
-       << m_latestFrame.VideoMediaFrame().CameraIntrinsics().ImageHeight() << "\n";
-
-  for ( const PVFrame& frame : m_PVFrameLog )
-  {
-    file << frame.timestamp << ",";
-    file << frame.fx << "," << frame.fy << ",";
-    file << frame.PVtoWorldtransform.m11 << "," << frame.PVtoWorldtransform.m21 << ","
-         << frame.PVtoWorldtransform.m31 << "," << frame.PVtoWorldtransform.m41 << ","
-         << frame.PVtoWorldtransform.m12 << "," << frame.PVtoWorldtransform.m22 << ","
-         << frame.PVtoWorldtransform.m32 << "," << frame.PVtoWorldtransform.m42 << ","
-         << frame.PVtoWorldtransform.m13 << "," << frame.PVtoWorldtransform.m23 << ","
-         << frame.PVtoWorldtransform.m33 << "," << frame.PVtoWorldtransform.m43 << ","
-         << frame.PVtoWorldtransform.m14 << "," << frame.PVtoWorldtransform.m24 << ","
-         << frame.PVtoWorldtransform.m34 << "," << frame.PVtoWorldtransform.m44;
-    file << "\n";
-  }
-  file.close();
-  return true;
-}
-
-void VideoFrameProcessor::StartRecording(const StorageFolder& storageFolder, const SpatialCoordinateSystem& worldCoordSystem)
+void VideoFrameProcessor::StartRecording(const StorageFolder& storageFolder, const SpatialCoordinateSystem& worldCoordSystem, const std::wstring& datetime_path,
+                                         const std::shared_ptr<StagingArena>& stagingArena)
 {
     m_worldCoordSystem = worldCoordSystem;
     m_isWorldCoordSystemSet = true;
@@ -364,17 +466,20 @@ void VideoFrameProcessor::StartRecording(const StorageFolder& storageFolder, con
     // Recording
     if (storageFolder)
     {
-        std::lock_guard<std::mutex> guard(m_storageMutex);
+        std::lock_guard<ProfiledMutex> guard(m_storageMutex);
         m_storageFolder = storageFolder;
 
         // Create the tarball for the image files
         wchar_t fileName[MAX_PATH] = {};
         swprintf_s(fileName, L"%s\\%s.tar", m_storageFolder.Path().data(), kSensorName);
-        m_tarball.reset(new Io::Tarball(fileName));
+        m_tarball.reset(new Io::StagedTarball(fileName, stagingArena));
+
+        m_poseLog.Open(std::wstring(m_storageFolder.Path().data()) + L"\\" + datetime_path + L"_pv.traj", TrajectoryPoseFormat::Matrix, true);
     }
 
-    // Grab thread control
-    if (m_pGrabThread)
+    // Conversion control, frames arriving from now on are converted
+    std::lock_guard<ProfiledSharedMutex> lock(m_frameMutex);
+    if (m_isConverting)
     {
         // Already running
         return;
@@ -382,23 +487,26 @@ void VideoFrameProcessor::StartRecording(const StorageFolder& storageFolder, con
     //auto status = co_await m_mediaFrameReader.StartAsync();
     //winrt::check_bool(status == MediaFrameReaderStartStatus::Success);
     m_fExit = false;
-    m_pGrabThread = new std::thread(CameraGrabThread, this);
-
+    m_isConverting = true;
 }
 
 void VideoFrameProcessor::StopRecording()
 {
-    m_fExit = true;
-
-    if (m_pGrabThread && m_pGrabThread->joinable())
     {
-        m_pGrabThread->join();
+        std::lock_guard<ProfiledSharedMutex> lock( m_frameMutex );
+        m_fExit = true;
+        m_isConverting = false;
     }
-    m_pGrabThread = nullptr;
+    m_frameCondVar.notify_all();
+
+    // No conversion is scheduled after that, and recordings are only scheduled by conversions
+    m_conversionQueue.Wait();
+    m_recordingQueue.Wait();
 
     if (m_storageFolder)
     {
-        std::lock_guard<std::mutex> guard(m_storageMutex);
+        std::lock_guard<ProfiledMutex> guard(m_storageMutex);
+        m_poseLog.Close();
         m_tarball.reset();
         m_storageFolder = nullptr;
     }
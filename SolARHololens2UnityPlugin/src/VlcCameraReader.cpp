@@ -0,0 +1,124 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "VlcCameraReader.h"
+
+using winrt::com_array;
+
+winrt::com_array<uint8_t> VlcCameraReader::getVlcSensorData(uint64_t lastSeenSequence, FrameRequestStatus& status, uint64_t& sequence, uint64_t& timestamp, float& sharpness, winrt::Windows::Foundation::Numerics::float4x4& rigToWorldtransform, bool& poseValid, uint32_t& pixelBufferSize, uint32_t& width, uint32_t& height, bool flip)
+{
+    std::lock_guard<ProfiledMutex> reader_guard(m_sensorFrameMutex);
+    status = RequestFrame( lastSeenSequence );
+    sequence = m_frameSequence.Latest();
+    if ( status == FrameRequestStatus::NewFrame )
+    {
+        timestamp = static_cast<uint64_t>(m_frameTimestamp);
+        sharpness = m_frameSharpness;
+
+        //// TODO(jmhenaff): do something with this?
+        //UINT32 gain = 0;
+        //UINT64 exposure = 0;
+        //m_pTypedFrame->GetGain(&gain);
+        //m_pTypedFrame->GetExposure(&exposure);
+
+        // Get data buffer (8 bits grayscale)
+        const BYTE* pImage = nullptr;
+        size_t outBufferCount = 0;
+        winrt::check_hresult(m_pTypedFrame->GetBuffer(&pImage, &outBufferCount));
+
+        assert(outBufferCount == m_resolution.Width * m_resolution.Height);
+
+        width = m_resolution.Width;
+        height = m_resolution.Height;
+        pixelBufferSize = m_resolution.Width * m_resolution.Height;
+
+        // Copy grayscale image as single channel 8 bit format, let caller convert it to RGB texture
+        com_array<UINT8> tempBuffer(outBufferCount);
+        if ( !flip )
+        {
+          std::memcpy( tempBuffer.data(), pImage, outBufferCount );
+        }
+        else
+        {
+          for ( uint32_t y = 0; y < height; y++ )
+          {
+            std::memcpy( tempBuffer.data() + y * width, pImage + ( height - y - 1 ) * width, width );
+          }
+        }
+
+        rigToWorldtransform = m_frameLocation.rigToWorldtransform;
+        poseValid = m_frameLocated;
+
+        return tempBuffer;
+    }
+
+    return winrt::com_array<uint8_t>();
+}
+
+void VlcCameraReader::FillSharedFrameData(IResearchModeSensorVLCFrame* pVLCFrame, SharedFrame& frame)
+{
+    const BYTE* pImage = nullptr;
+    size_t outBufferCount = 0;
+    winrt::check_hresult(pVLCFrame->GetBuffer(&pImage, &outBufferCount));
+
+    frame.bytesPerPixel = 1;
+    frame.data.assign(pImage, pImage + outBufferCount);
+}
+
+float VlcCameraReader::ComputeSharpness(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorVLCFrame* pVLCFrame)
+{
+    // m_resolution is only written by the update thread, resolution is not cached yet for the first frame
+    ResearchModeSensorResolution resolution = m_resolution;
+    if (!m_hasResolution && FAILED(pSensorFrame->GetResolution(&resolution)))
+    {
+        return FrameQuality::kNoScore;
+    }
+
+    const BYTE* pImage = nullptr;
+    size_t outBufferCount = 0;
+    if (FAILED(pVLCFrame->GetBuffer(&pImage, &outBufferCount)) ||
+        outBufferCount < static_cast<size_t>(resolution.Stride) * resolution.Height)
+    {
+        return FrameQuality::kNoScore;
+    }
+
+    return FrameQuality::SharpnessGray8(pImage, resolution.Width, resolution.Height, resolution.Stride);
+}
+
+void VlcCameraReader::SaveFrame(IResearchModeSensorFrame* pSensorFrame, IResearchModeSensorVLCFrame* pVLCFrame)
+{
+    wchar_t outputPath[MAX_PATH];
+
+    // Get PGM header
+    int maxBitmapValue = 255;
+    const std::string headerString = CreateHeader(m_resolution, maxBitmapValue);
+
+    // Compose the output file name using absolute ticks
+    swprintf_s(outputPath, L"%llu.pgm", m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds(checkAndConvertUnsigned(m_frameTimestamp))).count());
+
+    // Convert the software bitmap to raw bytes
+    std::vector<BYTE> pgmData;
+    size_t outBufferCount = 0;
+    const BYTE* pImage = nullptr;
+
+    winrt::check_hresult(pVLCFrame->GetBuffer(&pImage, &outBufferCount));
+
+    pgmData.reserve(headerString.size() + outBufferCount);
+    pgmData.insert(pgmData.end(), headerString.c_str(), headerString.c_str() + headerString.size());
+    pgmData.insert(pgmData.end(), pImage, pImage + outBufferCount);
+
+    m_tarball->AddFile(outputPath, &pgmData[0], pgmData.size());
+}
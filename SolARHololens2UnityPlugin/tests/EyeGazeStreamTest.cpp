@@ -0,0 +1,161 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Eye gaze sampled at 60 Hz as the render loop does, queried at camera frame timestamps
+
+#include "EyeGazeStream.h"
+#include "TestCheck.h"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    constexpr uint64_t kFirstTimestamp = 1'000'000'000;
+    constexpr uint64_t kPeriod = 166'667;    // 60 Hz, hundreds of nanoseconds
+
+    EyeGaze GetGaze(float x, float dx, float dy, float dz)
+    {
+        EyeGaze gaze;
+        gaze.origin[0] = x;
+        gaze.origin[1] = 1.5f;
+        gaze.direction[0] = dx;
+        gaze.direction[1] = dy;
+        gaze.direction[2] = dz;
+        return gaze;
+    }
+
+    float Norm(const float (&v)[3])
+    {
+        return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    }
+}
+
+TEST_CASE(Interpolate)
+{
+    const EyeGazeStream::Entry before{ 1000, GetGaze(0.f, 1.f, 0.f, 0.f) };
+    const EyeGazeStream::Entry after{ 2000, GetGaze(2.f, 0.f, 1.f, 0.f) };
+
+    EyeGaze gaze = EyeGazeStream::Interpolate(before, after, 1500);
+    CHECK_NEAR(gaze.origin[0], 1.f, 1e-6f);
+    CHECK_NEAR(gaze.origin[1], 1.5f, 1e-6f);
+    // Renormalized direction
+    CHECK_NEAR(gaze.direction[0], 0.70710678f, 1e-6f);
+    CHECK_NEAR(gaze.direction[1], 0.70710678f, 1e-6f);
+    CHECK_NEAR(gaze.direction[2], 0.f, 1e-6f);
+
+    gaze = EyeGazeStream::Interpolate(before, after, 1250);
+    CHECK_NEAR(gaze.origin[0], 0.5f, 1e-6f);
+    CHECK_NEAR(Norm(gaze.direction), 1.f, 1e-6f);
+    CHECK(gaze.direction[0] > gaze.direction[1]);
+
+    // Both ends, and a single sample
+    gaze = EyeGazeStream::Interpolate(before, after, 2000);
+    CHECK_NEAR(gaze.direction[1], 1.f, 1e-6f);
+    gaze = EyeGazeStream::Interpolate(before, before, 1000);
+    CHECK_EQUAL(gaze.direction[0], 1.f);
+}
+
+TEST_CASE(GazeAtTimestamp)
+{
+    EyeGazeStream stream(16);
+    EyeGaze gaze;
+    CHECK(!stream.GetGazeAtTimestamp(kFirstTimestamp, gaze));
+
+    // Looking along -z, origin moving along x by 0.1 per render frame
+    for (uint64_t frame = 0; frame < 10; ++frame)
+    {
+        CHECK(stream.Record(kFirstTimestamp + frame * kPeriod, GetGaze(0.1f * frame, 0.f, 0.f, -1.f)));
+    }
+    // Not newer than the last sample
+    CHECK(!stream.Record(kFirstTimestamp + 9 * kPeriod, GetGaze(0.f, 0.f, 0.f, -1.f)));
+
+    // A camera frame a third of the way between frames 4 and 5
+    CHECK(stream.GetGazeAtTimestamp(kFirstTimestamp + 4 * kPeriod + kPeriod / 3, gaze));
+    CHECK_NEAR(gaze.origin[0], 0.4f + 0.1f / 3.f, 1e-4f);
+    CHECK_NEAR(gaze.direction[2], -1.f, 1e-6f);
+    CHECK(stream.GetGazeAtTimestamp(kFirstTimestamp, gaze));
+    CHECK_NEAR(gaze.origin[0], 0.f, 1e-6f);
+
+    // Outside the buffered window
+    CHECK(!stream.GetGazeAtTimestamp(kFirstTimestamp - 1, gaze));
+    CHECK(!stream.GetGazeAtTimestamp(kFirstTimestamp + 9 * kPeriod + 1, gaze));
+
+    std::vector<EyeGazeStream::Entry> samples;
+    stream.GetSamples(kFirstTimestamp + 7 * kPeriod, samples);
+    CHECK_EQUAL(samples.size(), 2u);
+    CHECK_EQUAL(samples.front().timestamp, kFirstTimestamp + 8 * kPeriod);
+
+    // Older samples are overwritten
+    for (uint64_t frame = 10; frame < 30; ++frame)
+    {
+        stream.Record(kFirstTimestamp + frame * kPeriod, GetGaze(0.1f * frame, 0.f, 0.f, -1.f));
+    }
+    CHECK(!stream.GetGazeAtTimestamp(kFirstTimestamp + 5 * kPeriod, gaze));
+    CHECK(stream.GetGazeAtTimestamp(kFirstTimestamp + 20 * kPeriod, gaze));
+}
+
+TEST_CASE(TrackingGap)
+{
+    // Same gap as the head poses, both sampled per render frame
+    CHECK_EQUAL(EyeGazeStream::kMaxInterpolationGap, HeadPoseHistory::kMaxInterpolationGap);
+
+    EyeGazeStream stream;
+    EyeGaze gaze;
+    CHECK(stream.Record(kFirstTimestamp, GetGaze(0.f, 0.f, 0.f, -1.f)));
+    CHECK(stream.Record(kFirstTimestamp + EyeGazeStream::kMaxInterpolationGap, GetGaze(1.f, 0.f, 0.f, -1.f)));
+    CHECK(stream.Record(kFirstTimestamp + 2 * EyeGazeStream::kMaxInterpolationGap + 1, GetGaze(2.f, 0.f, 0.f, -1.f)));
+
+    // At most kMaxInterpolationGap apart: interpolated
+    CHECK(stream.GetGazeAtTimestamp(kFirstTimestamp + EyeGazeStream::kMaxInterpolationGap / 2, gaze));
+    CHECK_NEAR(gaze.origin[0], 0.5f, 1e-6f);
+    // Further apart: tracking was lost in between
+    CHECK(!stream.GetGazeAtTimestamp(kFirstTimestamp + EyeGazeStream::kMaxInterpolationGap * 3 / 2, gaze));
+    // Exact samples on both sides of the gap are still found
+    CHECK(stream.GetGazeAtTimestamp(kFirstTimestamp + 2 * EyeGazeStream::kMaxInterpolationGap + 1, gaze));
+    CHECK_EQUAL(gaze.origin[0], 2.f);
+}
+
+TEST_CASE(Recording)
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "EyeGazeStreamTest_eye.txt";
+    EyeGazeStream stream;
+
+    // Samples are logged between StartRecording() and StopRecording() only
+    CHECK(stream.Record(kFirstTimestamp, GetGaze(0.f, 0.f, 0.f, -1.f)));
+    CHECK(stream.StartRecording(path.wstring()));
+    CHECK(stream.Record(kFirstTimestamp + kPeriod, GetGaze(0.5f, 0.f, 1.f, 0.f)));
+    CHECK(!stream.Record(kFirstTimestamp + kPeriod, GetGaze(9.f, 0.f, 0.f, -1.f)));
+    CHECK(stream.Record(kFirstTimestamp + 2 * kPeriod, GetGaze(-0.25f, 1.f, 0.f, 0.f)));
+    stream.StopRecording();
+    CHECK(stream.Record(kFirstTimestamp + 3 * kPeriod, GetGaze(0.f, 0.f, 0.f, -1.f)));
+
+    std::ifstream file(path);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(file, line);)
+    {
+        lines.push_back(line);
+    }
+    CHECK(lines == std::vector<std::string>({ "1000166667,0.5,1.5,0,0,1,0", "1000333334,-0.25,1.5,0,1,0,0" }));
+    file.close();
+    std::filesystem::remove(path);
+
+    // Not a folder in which the file can be created
+    CHECK(!stream.StartRecording((path / "missing" / "eye.txt").wstring()));
+}
+
+TEST_MAIN()
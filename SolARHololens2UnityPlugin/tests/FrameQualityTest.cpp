@@ -0,0 +1,186 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Sharpness scores against a naive variance of the Laplacian. On ARM64 the kernels run with NEON,
+// the widths cover rows without NEON block, with a block and a scalar tail, and exact blocks.
+
+#include "FrameQuality.h"
+#include "TestCheck.h"
+
+#include <random>
+#include <vector>
+
+namespace
+{
+    const uint32_t kWidths[] = { 3, 8, 9, 10, 11, 16, 17, 23, 31, 64, 641, 760 };
+
+    // Image of width x height pixels in rows of stride bytes, the padding is filled with values
+    // which change the score if read
+    struct TestImage
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t stride;
+        std::vector<uint8_t> bytes;
+    };
+
+    TestImage GetImage(uint32_t width, uint32_t height, uint32_t bytesPerPixel, uint32_t padding, std::mt19937& generator)
+    {
+        std::uniform_int_distribution<int> value(0, 255);
+        TestImage image{ width, height, width * bytesPerPixel + padding, {} };
+        image.bytes.resize(static_cast<size_t>(image.stride) * height);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t i = 0; i < image.stride; ++i)
+            {
+                // Gradient with noise, full range values at the borders of the rows
+                const bool isPadding = i >= width * bytesPerPixel;
+                image.bytes[static_cast<size_t>(y) * image.stride + i] = isPadding ? static_cast<uint8_t>(value(generator) | 0x80) :
+                    static_cast<uint8_t>(i / bytesPerPixel % 3 == 0 ? value(generator) : (i / bytesPerPixel + y + value(generator) / 16) & 0xFF);
+            }
+        }
+        return image;
+    }
+
+    // Variance of the 4-neighbour Laplacian of the channel, on rows 1, 1 + rowStep, ...
+    double ReferenceSharpness(const TestImage& image, uint32_t bytesPerPixel, uint32_t channel, uint32_t rowStep)
+    {
+        const auto pixel = [&](uint32_t x, uint32_t y) { return static_cast<double>(image.bytes[static_cast<size_t>(y) * image.stride + x * bytesPerPixel + channel]); };
+        double sum = 0.;
+        double sumOfSquares = 0.;
+        double count = 0.;
+        for (uint32_t y = 1; y + 1 < image.height; y += rowStep)
+        {
+            for (uint32_t x = 1; x + 1 < image.width; ++x)
+            {
+                const double lap = 4. * pixel(x, y) - pixel(x, y - 1) - pixel(x, y + 1) - pixel(x - 1, y) - pixel(x + 1, y);
+                sum += lap;
+                sumOfSquares += lap * lap;
+                count++;
+            }
+        }
+        const double mean = sum / count;
+        return sumOfSquares / count - mean * mean;
+    }
+
+    bool IsNear(float score, double reference)
+    {
+        return std::abs(score - reference) <= 1e-5 * reference + 1e-3;
+    }
+}
+
+TEST_CASE(Gray8MatchesReference)
+{
+    std::mt19937 generator(11);
+    size_t mismatches = 0;
+    for (uint32_t width : kWidths)
+    {
+        for (uint32_t padding : { 0u, 13u })
+        {
+            for (uint32_t rowStep : { 1u, 2u, 4u, 7u })
+            {
+                const TestImage image = GetImage(width, 19, 1, padding, generator);
+                const float score = FrameQuality::SharpnessGray8(image.bytes.data(), image.width, image.height, image.stride, rowStep);
+                if (!IsNear(score, ReferenceSharpness(image, 1, 0, rowStep)))
+                {
+                    std::cerr << "Gray8 " << width << " stride " << image.stride << " rowStep " << rowStep << ": " << score << "\n";
+                    mismatches++;
+                }
+            }
+        }
+    }
+    CHECK_EQUAL(mismatches, 0u);
+}
+
+TEST_CASE(Bgra8MatchesReference)
+{
+    std::mt19937 generator(12);
+    size_t mismatches = 0;
+    for (uint32_t width : kWidths)
+    {
+        for (uint32_t padding : { 0u, 12u, 7u })
+        {
+            for (uint32_t rowStep : { 1u, 3u, 4u })
+            {
+                const TestImage image = GetImage(width, 17, 4, padding, generator);
+                const float score = FrameQuality::SharpnessBgra8(image.bytes.data(), image.width, image.height, image.stride, rowStep);
+                // The green channel only
+                if (!IsNear(score, ReferenceSharpness(image, 4, 1, rowStep)))
+                {
+                    std::cerr << "Bgra8 " << width << " stride " << image.stride << " rowStep " << rowStep << ": " << score << "\n";
+                    mismatches++;
+                }
+            }
+        }
+    }
+    CHECK_EQUAL(mismatches, 0u);
+}
+
+TEST_CASE(FullRangeLaplacian)
+{
+    // Checkerboard of 0 and 255: |Laplacian| = 1020, the largest value of the 16-bit NEON lanes
+    TestImage image{ 643, 9, 643, std::vector<uint8_t>(643 * 9) };
+    for (uint32_t y = 0; y < image.height; ++y)
+    {
+        for (uint32_t x = 0; x < image.width; ++x)
+        {
+            image.bytes[y * image.stride + x] = (x + y) % 2 ? 255 : 0;
+        }
+    }
+    const float score = FrameQuality::SharpnessGray8(image.bytes.data(), image.width, image.height, image.stride, 1);
+    CHECK(IsNear(score, ReferenceSharpness(image, 1, 0, 1)));
+    CHECK(score > 1e6f);
+}
+
+TEST_CASE(EdgeCases)
+{
+    std::vector<uint8_t> flat(32 * 32, 128);
+    CHECK_EQUAL(FrameQuality::SharpnessGray8(flat.data(), 32, 32, 32), 0.f);
+    // rowStep 0 is taken as 1
+    CHECK_EQUAL(FrameQuality::SharpnessGray8(flat.data(), 32, 32, 32, 0), 0.f);
+    CHECK_EQUAL(FrameQuality::SharpnessGray8(nullptr, 32, 32, 32), FrameQuality::kNoScore);
+    CHECK_EQUAL(FrameQuality::SharpnessGray8(flat.data(), 2, 32, 32), FrameQuality::kNoScore);
+    CHECK_EQUAL(FrameQuality::SharpnessBgra8(flat.data(), 8, 2, 32), FrameQuality::kNoScore);
+
+    // A blurred copy scores lower
+    std::mt19937 generator(13);
+    const TestImage sharp = GetImage(64, 64, 1, 0, generator);
+    TestImage blurred = sharp;
+    for (uint32_t y = 0; y < sharp.height; ++y)
+    {
+        for (uint32_t x = 1; x + 1 < sharp.width; ++x)
+        {
+            const size_t i = static_cast<size_t>(y) * sharp.stride + x;
+            blurred.bytes[i] = static_cast<uint8_t>((sharp.bytes[i - 1] + 2 * sharp.bytes[i] + sharp.bytes[i + 1]) / 4);
+        }
+    }
+    CHECK(FrameQuality::SharpnessGray8(blurred.bytes.data(), 64, 64, 64) < FrameQuality::SharpnessGray8(sharp.bytes.data(), 64, 64, 64));
+}
+
+TEST_CASE(Filter)
+{
+    SharpnessFilter filter;
+    CHECK(!filter.IsEnabled());
+    CHECK(filter.Accept(0.f));
+    filter.SetThreshold(100.f);
+    CHECK(filter.Accept(100.f));
+    CHECK(!filter.Accept(99.f));
+    // Frames without score are never dropped
+    CHECK(filter.Accept(FrameQuality::kNoScore));
+    CHECK_EQUAL(filter.GetRejectedCount(), 1u);
+}
+
+TEST_MAIN()
@@ -0,0 +1,214 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Source decimation of a synthetic 30 fps feed, driven as the capture threads do
+
+#include "FrameRateController.h"
+#include "TestCheck.h"
+
+#include <cmath>
+
+namespace
+{
+    constexpr uint64_t kFirstTimestamp = 1'000'000'000;
+    constexpr uint64_t kPeriod = 333'333;    // 30 fps, hundreds of nanoseconds
+
+    // Sensor intervals jitter by up to 3 ms
+    uint64_t GetTimestamp(uint64_t frame)
+    {
+        const int64_t jitter[] = { 0, 25'000, -30'000, 10'000, -5'000 };
+        return kFirstTimestamp + frame * kPeriod + jitter[frame % 5];
+    }
+
+    // Position x, rotated by angleDeg about y
+    KeyframePose GetPose(float x, float angleDeg)
+    {
+        const float angle = angleDeg * 3.14159265f / 180.f;
+        const float c = std::cos(angle);
+        const float s = std::sin(angle);
+        return { c, 0.f, -s, 0.f, 0.f, 1.f, 0.f, 0.f, s, 0.f, c, 0.f, x, 1.5f, 0.f, 1.f };
+    }
+
+    // Kept frame numbers out of count frames, each kept frame being committed
+    std::vector<uint64_t> RunTimestamps(FrameRateController& controller, uint64_t count)
+    {
+        std::vector<uint64_t> kept;
+        for (uint64_t frame = 0; frame < count; ++frame)
+        {
+            if (controller.AcceptTimestamp(GetTimestamp(frame)))
+            {
+                controller.Commit(GetTimestamp(frame));
+                kept.push_back(frame);
+            }
+        }
+        return kept;
+    }
+
+    // Pose stage of a frame, as the capture threads do after AcceptTimestamp()
+    bool Process(FrameRateController& controller, uint64_t frame, const KeyframePose& pose)
+    {
+        if (!controller.AcceptTimestamp(GetTimestamp(frame)) || (controller.RequiresPose() && !controller.AcceptPose(pose)))
+        {
+            return false;
+        }
+        controller.Commit(GetTimestamp(frame), pose);
+        return true;
+    }
+}
+
+TEST_CASE(DefaultKeepsEveryFrame)
+{
+    FrameRateController controller;
+    CHECK(!controller.RequiresPose());
+    CHECK_EQUAL(RunTimestamps(controller, 30).size(), 30u);
+    CHECK_EQUAL(controller.GetDecimatedCount(), 0u);
+}
+
+TEST_CASE(KeepEveryNth)
+{
+    FrameRateController controller;
+    FrameRateSettings settings;
+    settings.keepEveryNth = 3;
+    controller.Configure(settings);
+    CHECK(RunTimestamps(controller, 10) == std::vector<uint64_t>({ 0, 3, 6, 9 }));
+    CHECK_EQUAL(controller.GetDecimatedCount(), 6u);
+
+    // 0 keeps every frame, as 1
+    settings.keepEveryNth = 0;
+    controller.Configure(settings);
+    CHECK_EQUAL(RunTimestamps(controller, 10).size(), 10u);
+}
+
+TEST_CASE(TargetFpsTolerance)
+{
+    // 15 fps on a 30 fps feed: every other frame, despite the jitter of the intervals
+    FrameRateController controller;
+    FrameRateSettings settings;
+    settings.targetFps = 15.f;
+    controller.Configure(settings);
+    const std::vector<uint64_t> kept = RunTimestamps(controller, 30);
+    CHECK_EQUAL(kept.size(), 15u);
+    for (size_t i = 0; i < kept.size(); ++i)
+    {
+        CHECK_EQUAL(kept[i], 2 * i);
+    }
+    CHECK_EQUAL(controller.GetDecimatedCount(), 15u);
+
+    // 10 fps: every third frame
+    FrameRateController tenFps;
+    settings.targetFps = 10.f;
+    tenFps.Configure(settings);
+    CHECK(RunTimestamps(tenFps, 10) == std::vector<uint64_t>({ 0, 3, 6, 9 }));
+
+    // At the sensor rate, a frame 10% early is still kept
+    FrameRateController sensorRate;
+    settings.targetFps = 30.f;
+    sensorRate.Configure(settings);
+    CHECK(sensorRate.AcceptTimestamp(kFirstTimestamp));
+    sensorRate.Commit(kFirstTimestamp);
+    CHECK(sensorRate.AcceptTimestamp(kFirstTimestamp + kPeriod * 91 / 100));
+    CHECK(!sensorRate.AcceptTimestamp(kFirstTimestamp + kPeriod * 89 / 100));
+}
+
+TEST_CASE(PeriodFromLastCommittedFrame)
+{
+    FrameRateController controller;
+    FrameRateSettings settings;
+    settings.targetFps = 15.f;
+    controller.Configure(settings);
+    CHECK(controller.AcceptTimestamp(GetTimestamp(0)));
+    controller.Commit(GetTimestamp(0));
+    // Frame 2 passes the rate check but is dropped later (e.g. blurry): not committed
+    CHECK(!controller.AcceptTimestamp(GetTimestamp(1)));
+    CHECK(controller.AcceptTimestamp(GetTimestamp(2)));
+    // Frame 3 is measured from frame 0
+    CHECK(controller.AcceptTimestamp(GetTimestamp(3)));
+}
+
+TEST_CASE(TranslationFromLastCommittedPose)
+{
+    FrameRateController controller;
+    FrameRateSettings settings;
+    settings.minTranslation = 0.1f;
+    controller.Configure(settings);
+    CHECK(controller.RequiresPose());
+
+    // First located frame is kept whatever its pose
+    CHECK(Process(controller, 0, GetPose(5.f, 0.f)));
+    CHECK(!Process(controller, 1, GetPose(5.05f, 0.f)));
+    CHECK(!Process(controller, 2, GetPose(4.92f, 0.f)));
+    // Measured from the frame 0, not from the rejected frames
+    CHECK(Process(controller, 3, GetPose(5.11f, 0.f)));
+    CHECK(!Process(controller, 4, GetPose(5.2f, 0.f)));
+    CHECK(Process(controller, 5, GetPose(5.22f, 0.f)));
+    CHECK_EQUAL(controller.GetDecimatedCount(), 3u);
+
+    // Frames kept without pose keep the last located pose as reference
+    CHECK(controller.AcceptTimestamp(GetTimestamp(6)));
+    controller.Commit(GetTimestamp(6));
+    CHECK(!Process(controller, 7, GetPose(5.3f, 0.f)));
+    CHECK(Process(controller, 8, GetPose(5.33f, 0.f)));
+}
+
+TEST_CASE(RotationFromLastCommittedPose)
+{
+    FrameRateController controller;
+    FrameRateSettings settings;
+    settings.minRotationDeg = 5.f;
+    controller.Configure(settings);
+
+    CHECK(Process(controller, 0, GetPose(0.f, 10.f)));
+    CHECK(!Process(controller, 1, GetPose(0.f, 13.f)));
+    CHECK(!Process(controller, 2, GetPose(0.f, 6.f)));
+    CHECK(Process(controller, 3, GetPose(0.f, 16.f)));
+    // Either criterion keeps a frame
+    settings.minTranslation = 0.1f;
+    controller.Configure(settings);
+    CHECK(!Process(controller, 4, GetPose(0.05f, 18.f)));
+    CHECK(Process(controller, 5, GetPose(0.15f, 17.f)));
+    CHECK(Process(controller, 6, GetPose(0.15f, 23.f)));
+}
+
+TEST_CASE(TimestampChecksComeFirst)
+{
+    // Frames dropped by the rate are not evaluated against the pose
+    FrameRateController controller;
+    FrameRateSettings settings;
+    settings.keepEveryNth = 2;
+    settings.minTranslation = 1.f;
+    controller.Configure(settings);
+    CHECK(Process(controller, 0, GetPose(0.f, 0.f)));
+    CHECK(!Process(controller, 1, GetPose(2.f, 0.f)));
+    CHECK(Process(controller, 2, GetPose(2.f, 0.f)));
+    CHECK(!Process(controller, 4, GetPose(2.5f, 0.f)));
+    CHECK_EQUAL(controller.GetDecimatedCount(), 2u);
+}
+
+TEST_CASE(KeyframePoseConversion)
+{
+    // Any 16 floats in the layout of a winrt float4x4
+    struct Float4x4
+    {
+        float m11, m12, m13, m14, m21, m22, m23, m24, m31, m32, m33, m34, m41, m42, m43, m44;
+    };
+    const Float4x4 transform{ 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 1.f, 1.5f, 4.f, 1.f };
+    const KeyframePose pose = ToKeyframePose(transform);
+    CHECK(pose[12] == 1.f && pose[13] == 1.5f && pose[14] == 4.f && pose[15] == 1.f);
+    CHECK_NEAR(KeyframeSelector::TranslationDistance(pose, GetPose(4.f, 0.f)), 5.f, 1e-6f);
+    CHECK_NEAR(KeyframeSelector::RotationAngleDeg(GetPose(0.f, 0.f), GetPose(0.f, 30.f)), 30.f, 1e-3f);
+}
+
+TEST_MAIN()
@@ -0,0 +1,97 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FrameSequence.h"
+#include "TestCheck.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+TEST_CASE(RequestStatusAndCounters)
+{
+    FrameSequence sequence;
+    CHECK(sequence.Request(0) == FrameRequestStatus::NoFrame);
+
+    CHECK_EQUAL(sequence.Produce(), 1u);
+    CHECK(sequence.Request(0) == FrameRequestStatus::NewFrame);
+    CHECK(sequence.Request(1) == FrameRequestStatus::NotModified);
+    CHECK(sequence.Request(0) == FrameRequestStatus::NewFrame);
+
+    sequence.Produce();
+    sequence.Produce();
+    CHECK(sequence.Request(1) == FrameRequestStatus::NewFrame);
+
+    const StreamFrameCounters& counters = sequence.Counters();
+    CHECK_EQUAL(counters.produced, 3u);
+    CHECK_EQUAL(counters.consumed, 2u);
+    CHECK_EQUAL(counters.skipped, 1u);
+    CHECK_EQUAL(counters.duplicates, 1u);
+    CHECK_EQUAL(counters.notModified, 1u);
+}
+
+TEST_CASE(WaitTimesOut)
+{
+    std::mutex mutex;
+    std::condition_variable condVar;
+    FrameSequence sequence;
+    uint64_t latest = 42;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    CHECK(sequence.Wait(lock, condVar, 0, 10, []() { return false; }, latest) == FrameRequestStatus::NoFrame);
+    CHECK_EQUAL(latest, 0u);
+
+    sequence.Produce();
+    CHECK(sequence.Wait(lock, condVar, 1, 10, []() { return false; }, latest) == FrameRequestStatus::NotModified);
+    CHECK_EQUAL(latest, 1u);
+    // Not served by Wait()
+    CHECK_EQUAL(sequence.Counters().notModified, 0u);
+}
+
+TEST_CASE(WaitWakesOnProduceAndStop)
+{
+    std::mutex mutex;
+    std::condition_variable condVar;
+    FrameSequence sequence;
+    bool isStopped = false;
+
+    std::thread producer([&]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            sequence.Produce();
+        }
+        condVar.notify_all();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            isStopped = true;
+        }
+        condVar.notify_all();
+    });
+
+    uint64_t latest = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    CHECK(sequence.Wait(lock, condVar, 0, 10000, [&]() { return isStopped; }, latest) == FrameRequestStatus::NewFrame);
+    CHECK_EQUAL(latest, 1u);
+    CHECK(sequence.Wait(lock, condVar, 1, 10000, [&]() { return isStopped; }, latest) == FrameRequestStatus::NotModified);
+    CHECK(isStopped);
+    lock.unlock();
+    producer.join();
+}
+
+TEST_MAIN()
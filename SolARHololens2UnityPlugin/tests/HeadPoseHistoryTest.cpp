@@ -0,0 +1,204 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HeadPoseHistory.h"
+#include "TestCheck.h"
+
+#include <cmath>
+
+namespace
+{
+    constexpr uint64_t kRenderPeriod = 166'667;    // 60 Hz, hundreds of nanoseconds
+    constexpr float kTolerance = 1e-5f;
+
+    // Head at position, turned by yaw radians about the vertical axis
+    HeadPose GetPose(float x, float y, float z, float yaw)
+    {
+        HeadPose pose;
+        pose.position[0] = x;
+        pose.position[1] = y;
+        pose.position[2] = z;
+        pose.forward[0] = -std::sin(yaw);
+        pose.forward[1] = 0.f;
+        pose.forward[2] = -std::cos(yaw);
+        return pose;
+    }
+
+    bool IsNear(const float a[3], const float b[3])
+    {
+        return std::abs(a[0] - b[0]) <= kTolerance && std::abs(a[1] - b[1]) <= kTolerance && std::abs(a[2] - b[2]) <= kTolerance;
+    }
+
+    bool IsNear(const HeadPose& a, const HeadPose& b)
+    {
+        return IsNear(a.position, b.position) && IsNear(a.forward, b.forward) && IsNear(a.up, b.up);
+    }
+}
+
+TEST_CASE(RingRejectsNonIncreasingTimestamps)
+{
+    TimestampedRing<int> ring(4, "ring");
+    CHECK(ring.Push(10, 1));
+    CHECK(!ring.Push(10, 2));
+    CHECK(!ring.Push(5, 3));
+    CHECK(ring.Push(11, 4));
+
+    std::vector<TimestampedRing<int>::Entry> entries;
+    ring.Read(0, entries);
+    CHECK_EQUAL(entries.size(), 2u);
+    CHECK_EQUAL(entries[0].value, 1);
+    CHECK_EQUAL(entries[1].value, 4);
+}
+
+TEST_CASE(RingWrapsAround)
+{
+    CHECK_EQUAL(TimestampedRing<int>(0, "ring").Capacity(), 2u);
+
+    TimestampedRing<int> ring(4, "ring");
+    uint64_t oldest = 0;
+    uint64_t newest = 0;
+    CHECK(!ring.GetWindow(oldest, newest));
+
+    // 10 entries in 4 slots: 70, 80, 90 and 100 remain, the oldest one in the middle of the storage
+    for (int i = 1; i <= 10; ++i)
+    {
+        CHECK(ring.Push(10 * i, i));
+    }
+    CHECK(ring.GetWindow(oldest, newest));
+    CHECK_EQUAL(oldest, 70u);
+    CHECK_EQUAL(newest, 100u);
+
+    std::vector<TimestampedRing<int>::Entry> entries;
+    ring.Read(0, entries);
+    CHECK_EQUAL(entries.size(), 4u);
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        CHECK_EQUAL(entries[i].timestamp, 70u + 10 * i);
+        CHECK_EQUAL(entries[i].value, static_cast<int>(7 + i));
+    }
+    entries.clear();
+    ring.Read(85, entries);
+    CHECK_EQUAL(entries.size(), 2u);
+    CHECK_EQUAL(entries[0].timestamp, 90u);
+    entries.clear();
+    ring.Read(100, entries);
+    CHECK(entries.empty());
+
+    TimestampedRing<int>::Entry before;
+    TimestampedRing<int>::Entry after;
+    CHECK(ring.FindBracket(75, before, after));
+    CHECK_EQUAL(before.timestamp, 70u);
+    CHECK_EQUAL(after.timestamp, 80u);
+    // Exact matches, including both ends of the window
+    CHECK(ring.FindBracket(80, before, after));
+    CHECK_EQUAL(before.timestamp, 80u);
+    CHECK_EQUAL(after.timestamp, 80u);
+    CHECK(ring.FindBracket(70, before, after));
+    CHECK_EQUAL(after.timestamp, 70u);
+    CHECK(ring.FindBracket(100, before, after));
+    CHECK_EQUAL(before.timestamp, 100u);
+    // Overwritten, and not yet pushed
+    CHECK(!ring.FindBracket(60, before, after));
+    CHECK(!ring.FindBracket(101, before, after));
+
+    ring.Clear();
+    CHECK(!ring.GetWindow(oldest, newest));
+    CHECK(ring.Push(1, 0));
+}
+
+TEST_CASE(InterpolatesPositionAndOrientation)
+{
+    const float quarterTurn = 1.5707963f;
+    HeadPoseHistory history;
+    CHECK(history.Record(1'000'000, GetPose(0.f, 0.f, 0.f, 0.f)));
+    CHECK(history.Record(1'000'000 + 4 * kRenderPeriod, GetPose(1.f, 2.f, 3.f, quarterTurn)));
+
+    HeadPose pose;
+    CHECK(history.Lookup(1'000'000 + 2 * kRenderPeriod, pose) == HeadPoseLookup::Interpolated);
+    CHECK(IsNear(pose, GetPose(0.5f, 1.f, 1.5f, 0.5f * quarterTurn)));
+
+    CHECK(history.Lookup(1'000'000 + kRenderPeriod, pose) == HeadPoseLookup::Interpolated);
+    CHECK(IsNear(pose, GetPose(0.25f, 0.5f, 0.75f, 0.25f * quarterTurn)));
+
+    // Buffered poses are returned as recorded
+    CHECK(history.Lookup(1'000'000, pose) == HeadPoseLookup::Interpolated);
+    CHECK(IsNear(pose, GetPose(0.f, 0.f, 0.f, 0.f)));
+    CHECK(history.Lookup(1'000'000 + 4 * kRenderPeriod, pose) == HeadPoseLookup::Interpolated);
+    CHECK(IsNear(pose, GetPose(1.f, 2.f, 3.f, quarterTurn)));
+}
+
+TEST_CASE(InterpolationReorthogonalizesUp)
+{
+    // Up tilted towards forward, as rounding in the system poses may leave it
+    HeadPoseHistory::Entry before{ 0, GetPose(0.f, 0.f, 0.f, 0.f) };
+    before.value.up[2] = -0.05f;
+    HeadPoseHistory::Entry after{ 100, GetPose(0.f, 0.f, 0.f, 0.2f) };
+
+    const HeadPose pose = HeadPoseHistory::Interpolate(before, after, 30);
+    const float dot = pose.forward[0] * pose.up[0] + pose.forward[1] * pose.up[1] + pose.forward[2] * pose.up[2];
+    CHECK_NEAR(dot, 0.f, kTolerance);
+    CHECK_NEAR(std::sqrt(pose.up[0] * pose.up[0] + pose.up[1] * pose.up[1] + pose.up[2] * pose.up[2]), 1.f, kTolerance);
+    CHECK_NEAR(std::sqrt(pose.forward[0] * pose.forward[0] + pose.forward[1] * pose.forward[1] + pose.forward[2] * pose.forward[2]), 1.f, kTolerance);
+}
+
+TEST_CASE(OutsideWindowAndTrackingGap)
+{
+    HeadPose pose = GetPose(9.f, 9.f, 9.f, 0.f);
+    HeadPoseHistory history;
+    CHECK(history.Lookup(1'000'000, pose) == HeadPoseLookup::OutsideWindow);
+
+    CHECK(history.Record(1'000'000, GetPose(0.f, 0.f, 0.f, 0.f)));
+    CHECK(history.Record(1'000'000 + HeadPoseHistory::kMaxInterpolationGap, GetPose(1.f, 0.f, 0.f, 0.f)));
+    CHECK(history.Record(2'000'001 + HeadPoseHistory::kMaxInterpolationGap, GetPose(2.f, 0.f, 0.f, 0.f)));
+
+    CHECK(history.Lookup(999'999, pose) == HeadPoseLookup::OutsideWindow);
+    CHECK(history.Lookup(2'000'002 + HeadPoseHistory::kMaxInterpolationGap, pose) == HeadPoseLookup::OutsideWindow);
+    // Not changed when not interpolated
+    CHECK(IsNear(pose, GetPose(9.f, 9.f, 9.f, 0.f)));
+
+    // Poses exactly the maximum gap apart are interpolated, one tick further apart are not
+    CHECK(history.Lookup(1'500'000, pose) == HeadPoseLookup::Interpolated);
+    CHECK(IsNear(pose, GetPose(0.5f, 0.f, 0.f, 0.f)));
+    CHECK(history.Lookup(1'500'000 + HeadPoseHistory::kMaxInterpolationGap, pose) == HeadPoseLookup::TrackingGap);
+    // The pose before the gap is still found exactly
+    CHECK(history.Lookup(1'000'000 + HeadPoseHistory::kMaxInterpolationGap, pose) == HeadPoseLookup::Interpolated);
+    CHECK(IsNear(pose, GetPose(1.f, 0.f, 0.f, 0.f)));
+
+    history.Clear();
+    CHECK(history.Lookup(1'500'000, pose) == HeadPoseLookup::OutsideWindow);
+}
+
+TEST_CASE(HistoryWrapsAround)
+{
+    HeadPoseHistory history(8);
+    const uint64_t start = 1'000'000;
+    for (uint64_t i = 0; i < 20; ++i)
+    {
+        CHECK(history.Record(start + i * kRenderPeriod, GetPose(static_cast<float>(i), 0.f, 0.f, 0.f)));
+    }
+
+    // Poses 12 to 19 remain
+    HeadPose pose;
+    CHECK(history.Lookup(start + 11 * kRenderPeriod, pose) == HeadPoseLookup::OutsideWindow);
+    CHECK(history.Lookup(start + 11 * kRenderPeriod + kRenderPeriod / 2, pose) == HeadPoseLookup::OutsideWindow);
+    CHECK(history.Lookup(start + 12 * kRenderPeriod, pose) == HeadPoseLookup::Interpolated);
+    CHECK(IsNear(pose, GetPose(12.f, 0.f, 0.f, 0.f)));
+    CHECK(history.Lookup(start + 18 * kRenderPeriod + kRenderPeriod / 4, pose) == HeadPoseLookup::Interpolated);
+    CHECK_NEAR(pose.position[0], 18.25f, 1e-4f);
+    CHECK(history.Lookup(start + 20 * kRenderPeriod, pose) == HeadPoseLookup::OutsideWindow);
+}
+
+TEST_MAIN()
@@ -0,0 +1,186 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Preintegration against the closed form deltas of a constant angular rate and specific force,
+// directly and from the synthetic IMU rings on the clock of each frame stream.
+
+#include "FrameClock.h"
+#include "ImuPreintegration.h"
+#include "SyntheticImu.h"
+#include "TestCheck.h"
+
+using Eigen::Matrix3d;
+using Eigen::Vector3d;
+
+namespace
+{
+    constexpr double kRateHz = 1000.;
+    constexpr uint64_t kFirstHostTicks = 50'000'000;
+
+    struct ExpectedDeltas
+    {
+        Matrix3d rotation;
+        Vector3d velocity;
+        Vector3d position;
+    };
+
+    // Rotation of the closed form frame, where the angular rate is along z, to the IMU frame
+    Matrix3d GetAxes()
+    {
+        return Eigen::AngleAxisd(0.7, Vector3d(1., 2., -0.5).normalized()).toRotationMatrix();
+    }
+
+    // Angular rate w about z, specific force (ax, 0, az) in the closed form frame
+    constexpr double kRate = 1.3;
+    constexpr double kForceX = 2.;
+    constexpr double kForceZ = 9.81;
+
+    Vector3d GetAngularRate() { return GetAxes() * Vector3d(0., 0., kRate); }
+    Vector3d GetSpecificForce() { return GetAxes() * Vector3d(kForceX, 0., kForceZ); }
+
+    // R(t) = Rz(w t), V(t) = integral of R(s) a ds, P(t) = integral of V(s) ds
+    ExpectedDeltas GetExpectedDeltas(double t)
+    {
+        const double w = kRate;
+        const double c = std::cos(w * t);
+        const double s = std::sin(w * t);
+        const Matrix3d axes = GetAxes();
+
+        ExpectedDeltas deltas;
+        deltas.rotation = axes * Eigen::AngleAxisd(w * t, Vector3d::UnitZ()).toRotationMatrix() * axes.transpose();
+        deltas.velocity = axes * Vector3d(kForceX * s / w, kForceX * (1. - c) / w, kForceZ * t);
+        deltas.position = axes * Vector3d(kForceX * (1. - c) / (w * w), kForceX * (t / w - s / (w * w)), 0.5 * kForceZ * t * t);
+        return deltas;
+    }
+
+    double RotationError(const Matrix3d& a, const Matrix3d& b)
+    {
+        return Eigen::AngleAxisd(a.transpose() * b).angle();
+    }
+
+    SyntheticMotion GetConstantMotion()
+    {
+        return { [](double) { return GetAngularRate(); }, [](double) { return GetSpecificForce(); } };
+    }
+
+    bool Preintegrate(const SyntheticImu& imu, SharedStream stream, uint64_t from, uint64_t to, PreintegratedImu& result)
+    {
+        const auto clock = GetImuSampleClock(GetFrameClock(stream));
+        std::vector<ImuSample> gyroSamples;
+        std::vector<ImuSample> accelSamples;
+        return imu.Gyro().ReadBetween(clock, from, to, gyroSamples) &&
+               imu.Accel().ReadBetween(clock, from, to, accelSamples) &&
+               ImuPreintegrator::IntegrateInterval(gyroSamples, accelSamples, clock, from, to, ImuPreintegrationParameters(), result);
+    }
+}
+
+TEST_CASE(ConstantRatesMatchClosedForm)
+{
+    const double duration = 0.5;
+    double previousVelocityError = 0.;
+    for (int steps : { 100, 1000 })
+    {
+        ImuPreintegrator integrator;
+        integrator.Reset(0);
+        for (int i = 0; i < steps; ++i)
+        {
+            integrator.Integrate(GetAngularRate(), GetSpecificForce(), duration / steps);
+        }
+        const PreintegratedImu& result = integrator.Result();
+        const ExpectedDeltas expected = GetExpectedDeltas(duration);
+        const double dt = duration / steps;
+
+        CHECK_NEAR(result.deltaTime, duration, 1e-12);
+        // Exact for a constant rate, up to the rounding of the composed steps
+        CHECK(RotationError(result.deltaRotation, expected.rotation) < 1e-9);
+        // The specific force is rotated with the orientation at the start of each step: first order in dt
+        const double velocityError = (result.deltaVelocity - expected.velocity).norm();
+        CHECK(velocityError < kRate * kForceX * duration * dt);
+        CHECK((result.deltaPosition - expected.position).norm() < kRate * kForceX * duration * duration * dt);
+        if (previousVelocityError > 0.)
+        {
+            CHECK_NEAR(previousVelocityError / velocityError, 10., 0.5);
+        }
+        previousVelocityError = velocityError;
+
+        // Covariance stays symmetric positive definite
+        CHECK((result.covariance - result.covariance.transpose()).norm() < 1e-18);
+        CHECK(result.covariance.llt().info() == Eigen::Success);
+    }
+}
+
+TEST_CASE(GyroBiasJacobianMatchesFiniteDifference)
+{
+    const Vector3d biasUpdate(2e-4, -1e-4, 3e-4);
+    ImuPreintegrationParameters biased;
+    biased.gyroBias = biasUpdate;
+
+    ImuPreintegrator integrator;
+    ImuPreintegrator biasedIntegrator(biased);
+    integrator.Reset(0);
+    biasedIntegrator.Reset(0);
+    for (int i = 0; i < 200; ++i)
+    {
+        integrator.Integrate(GetAngularRate(), GetSpecificForce(), 1e-3);
+        biasedIntegrator.Integrate(GetAngularRate(), GetSpecificForce(), 1e-3);
+    }
+    const PreintegratedImu& result = integrator.Result();
+    const PreintegratedImu& reference = biasedIntegrator.Result();
+
+    const Vector3d phi = result.dR_dbg * biasUpdate;
+    const Matrix3d corrected = result.deltaRotation * Eigen::AngleAxisd(phi.norm(), phi.normalized()).toRotationMatrix();
+    CHECK(RotationError(corrected, reference.deltaRotation) < 1e-7);
+    CHECK((result.deltaVelocity + result.dV_dbg * biasUpdate - reference.deltaVelocity).norm() < 1e-6);
+    CHECK((result.deltaPosition + result.dP_dbg * biasUpdate - reference.deltaPosition).norm() < 1e-7);
+}
+
+TEST_CASE(IntervalOnEachStreamClock)
+{
+    SyntheticImu imu(GetConstantMotion(), kRateHz, kRateHz, kFirstHostTicks);
+    imu.GenerateUntil(kFirstHostTicks + 10'000'000);
+
+    // Frame timestamps between IMU samples, 1/30 s apart
+    const uint64_t fromHostTicks = kFirstHostTicks + 2'503'000;
+    const uint64_t toHostTicks = fromHostTicks + 333'333;
+    const ExpectedDeltas expected = GetExpectedDeltas(333'333 * 1e-7);
+
+    // VLC getters return host ticks
+    PreintegratedImu vlc;
+    CHECK(Preintegrate(imu, SharedStream::LEFT_FRONT, fromHostTicks, toHostTicks, vlc));
+    CHECK_NEAR(vlc.deltaTime, 333'333 * 1e-7, 1e-12);
+    CHECK_EQUAL(vlc.sampleCount, 34u);
+    CHECK(RotationError(vlc.deltaRotation, expected.rotation) < 1e-9);
+    CHECK((vlc.deltaVelocity - expected.velocity).norm() < 1e-4);
+    CHECK((vlc.deltaPosition - expected.position).norm() < 1e-5);
+
+    // PV and depth getters return absolute timestamps: same interval, same deltas
+    for (SharedStream stream : { SharedStream::DEPTH, SharedStream::PV })
+    {
+        PreintegratedImu absolute;
+        CHECK(Preintegrate(imu, stream, fromHostTicks + SyntheticImu::kAbsoluteOffset, toHostTicks + SyntheticImu::kAbsoluteOffset, absolute));
+        CHECK_EQUAL(absolute.sampleCount, vlc.sampleCount);
+        CHECK(absolute.deltaRotation.isApprox(vlc.deltaRotation, 1e-12));
+        CHECK(absolute.deltaVelocity.isApprox(vlc.deltaVelocity, 1e-12));
+        CHECK(absolute.deltaPosition.isApprox(vlc.deltaPosition, 1e-12));
+    }
+
+    // A depth timestamp read on the host tick clock is not covered by the samples
+    PreintegratedImu mismatched;
+    CHECK(!Preintegrate(imu, SharedStream::LEFT_FRONT, fromHostTicks + SyntheticImu::kAbsoluteOffset,
+                        toHostTicks + SyntheticImu::kAbsoluteOffset, mismatched));
+}
+
+TEST_MAIN()
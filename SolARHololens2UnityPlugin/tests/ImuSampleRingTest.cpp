@@ -0,0 +1,183 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ImuSampleRing.h"
+#include "SyntheticImu.h"
+#include "TestCheck.h"
+
+#include <chrono>
+
+namespace
+{
+    constexpr uint64_t kFirstHostTicks = 1'000'000;
+    constexpr double kRateHz = 1000.;    // one sample every 10000 ticks
+
+    SyntheticMotion GetMotion()
+    {
+        return { [](double t) { return Eigen::Vector3d(t, -t, 0.5); },
+                 [](double) { return Eigen::Vector3d(0., 0., 9.81); } };
+    }
+
+    // Indices follow each other from sinceIndex + lost + 1, and each sample holds what the stand-in
+    // pushed at its index: a sample torn by the producer would not
+    bool IsConsistent(const SyntheticImu& imu, uint64_t sinceIndex, uint64_t lost, const std::vector<ImuSample>& samples)
+    {
+        const SyntheticMotion motion = GetMotion();
+        uint64_t index = sinceIndex + lost;
+        for (const ImuSample& sample : samples)
+        {
+            const uint64_t hostTicks = imu.HostTicksAt(++index, kRateHz);
+            const double t = static_cast<double>(hostTicks - kFirstHostTicks) * 1e-7;
+            if (sample.index != index || sample.hostTicks != hostTicks ||
+                sample.timestamp != hostTicks + SyntheticImu::kAbsoluteOffset ||
+                sample.x != static_cast<float>(motion.angularRate(t).x()))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+TEST_CASE(CapacityIsRoundedUpToPowerOfTwo)
+{
+    CHECK_EQUAL(ImuSampleRing(0).Capacity(), 2u);
+    CHECK_EQUAL(ImuSampleRing(3).Capacity(), 4u);
+    CHECK_EQUAL(ImuSampleRing(16).Capacity(), 16u);
+    CHECK_EQUAL(ImuSampleRing().Capacity(), ImuSampleRing::kDefaultCapacity);
+}
+
+TEST_CASE(ReadSinceIndex)
+{
+    SyntheticImu imu(GetMotion(), kRateHz, kRateHz, kFirstHostTicks);
+    std::vector<ImuSample> samples;
+    CHECK_EQUAL(imu.Gyro().Read(0, samples), 0u);
+    CHECK(samples.empty());
+
+    // 100 ms
+    imu.GenerateUntil(kFirstHostTicks + 1'000'000);
+    CHECK_EQUAL(imu.Gyro().LastIndex(), 101u);
+    CHECK_EQUAL(imu.Accel().LastIndex(), 101u);
+
+    CHECK_EQUAL(imu.Gyro().Read(0, samples), 0u);
+    CHECK_EQUAL(samples.size(), 101u);
+    CHECK(IsConsistent(imu, 0, 0, samples));
+
+    // Appended to the samples already there
+    CHECK_EQUAL(imu.Gyro().Read(50, samples), 0u);
+    CHECK_EQUAL(samples.size(), 152u);
+    CHECK_EQUAL(samples[101].index, 51u);
+
+    samples.clear();
+    CHECK_EQUAL(imu.Gyro().Read(101, samples), 0u);
+    CHECK(samples.empty());
+}
+
+TEST_CASE(OverwrittenSamplesAreReportedLost)
+{
+    SyntheticImu imu(GetMotion(), kRateHz, kRateHz, kFirstHostTicks, 16);
+    imu.GenerateUntil(imu.HostTicksAt(100, kRateHz));
+    CHECK_EQUAL(imu.Gyro().LastIndex(), 100u);
+
+    // The slot after the last sample may be under write, 15 samples are readable
+    std::vector<ImuSample> samples;
+    CHECK_EQUAL(imu.Gyro().Read(0, samples), 85u);
+    CHECK_EQUAL(samples.size(), 15u);
+    CHECK(IsConsistent(imu, 0, 85, samples));
+
+    samples.clear();
+    CHECK_EQUAL(imu.Gyro().Read(84, samples), 1u);
+    CHECK_EQUAL(samples.size(), 15u);
+
+    samples.clear();
+    CHECK_EQUAL(imu.Gyro().Read(90, samples), 0u);
+    CHECK_EQUAL(samples.size(), 10u);
+    CHECK(IsConsistent(imu, 90, 0, samples));
+}
+
+TEST_CASE(ReadBetweenOnEachClock)
+{
+    SyntheticImu imu(GetMotion(), kRateHz, kRateHz, kFirstHostTicks, 64);
+    imu.GenerateUntil(kFirstHostTicks + 1'000'000);
+
+    // Sample 53 (520000) is the last one at or before from, sample 57 (560000) the first one after to
+    std::vector<ImuSample> samples;
+    CHECK(imu.Gyro().ReadBetween(&ImuSample::hostTicks, kFirstHostTicks + 525'000, kFirstHostTicks + 552'000, samples));
+    CHECK_EQUAL(samples.size(), 5u);
+    CHECK(IsConsistent(imu, 52, 0, samples));
+
+    const uint64_t absoluteFirst = kFirstHostTicks + SyntheticImu::kAbsoluteOffset;
+    CHECK(imu.Gyro().ReadBetween(&ImuSample::timestamp, absoluteFirst + 525'000, absoluteFirst + 552'000, samples));
+    CHECK_EQUAL(samples.size(), 5u);
+    CHECK_EQUAL(samples.front().index, 53u);
+
+    const uint64_t sensorFirst = kFirstHostTicks * 100 + SyntheticImu::kSensorOffset;
+    CHECK(imu.Gyro().ReadBetween(&ImuSample::sensorTicks, sensorFirst + 52'500'000, sensorFirst + 55'200'000, samples));
+    CHECK_EQUAL(samples.size(), 5u);
+    CHECK_EQUAL(samples.front().index, 53u);
+
+    // Exact sample times bound the interval
+    CHECK(imu.Gyro().ReadBetween(&ImuSample::hostTicks, kFirstHostTicks + 990'000, kFirstHostTicks + 1'000'000, samples));
+    CHECK_EQUAL(samples.size(), 2u);
+
+    // Not covered: after the last sample, before the oldest readable one, or a clock mix-up
+    CHECK(!imu.Gyro().ReadBetween(&ImuSample::hostTicks, kFirstHostTicks + 900'000, kFirstHostTicks + 1'000'001, samples));
+    CHECK(!imu.Gyro().ReadBetween(&ImuSample::hostTicks, kFirstHostTicks + 100'000, kFirstHostTicks + 500'000, samples));
+    CHECK(!imu.Gyro().ReadBetween(&ImuSample::timestamp, kFirstHostTicks + 900'000, kFirstHostTicks + 950'000, samples));
+}
+
+// Run on x86 (TSO): the stores of the producer are never seen out of order, so this does not
+// check the fence of ImuSampleRing::Push(), which only matters on weakly ordered CPUs (ARM64)
+TEST_CASE(ConcurrentReaderSeesNoTornSample)
+{
+    SyntheticImu imu(GetMotion(), kRateHz, kRateHz, kFirstHostTicks, 64);
+    imu.Start(8);
+
+    uint64_t sinceIndex = 0;
+    uint64_t received = 0;
+    uint64_t lost = 0;
+    bool isConsistent = true;
+    std::vector<ImuSample> samples;
+    const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    for (int read = 0; std::chrono::steady_clock::now() < end; ++read)
+    {
+        samples.clear();
+        const uint64_t readLost = imu.Gyro().Read(sinceIndex, samples);
+        isConsistent = isConsistent && IsConsistent(imu, sinceIndex, readLost, samples);
+        lost += readLost;
+        received += samples.size();
+        sinceIndex += readLost + samples.size();
+        // Slow reader from time to time, the producer laps the ring
+        if (read % 64 == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    imu.Stop();
+
+    samples.clear();
+    const uint64_t readLost = imu.Gyro().Read(sinceIndex, samples);
+    CHECK(IsConsistent(imu, sinceIndex, readLost, samples));
+    lost += readLost;
+    received += samples.size();
+
+    CHECK(isConsistent);
+    CHECK(lost > 0);
+    CHECK_EQUAL(received + lost, imu.Gyro().LastIndex());
+    CHECK_EQUAL(imu.Accel().LastIndex(), imu.Gyro().LastIndex());
+}
+
+TEST_MAIN()
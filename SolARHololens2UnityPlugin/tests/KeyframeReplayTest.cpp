@@ -0,0 +1,281 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Keyframe selection replayed from a recorded sequence: a synthetic capture (walk, stop, turn) of
+// two VLC cameras is written to a Container recording, read back through RecordingReader as the
+// dataset exporter does, checked for sequence and timestamp continuity, and fed to KeyframeSelector.
+
+#include "KeyframeSelector.h"
+#include "RecordingContainer.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <map>
+
+namespace
+{
+    constexpr uint64_t kFirstTimestamp = 132'900'000'000'000'000;
+    constexpr uint64_t kFramePeriod = 333'333;		// 30 fps, hundreds of nanoseconds
+    constexpr size_t kFrameCount = 300;
+    constexpr size_t kWalkEnd = 100;				// 2.5 m along x at 0.025 m per frame
+    constexpr size_t kTurnStart = 200;				// then 1 degree of yaw per frame
+    constexpr float kStep = 0.025f;
+    constexpr float kDegToRad = 3.14159265358979f / 180.f;
+    // Frames of the walk the rig could not be located at
+    constexpr size_t kUnlocatedFrames[] = { 50, 51 };
+
+    bool IsUnlocated(size_t frame)
+    {
+        return std::find(std::begin(kUnlocatedFrames), std::end(kUnlocatedFrames), frame) != std::end(kUnlocatedFrames);
+    }
+
+    // Rig to world of a frame, row-major with column vectors as recorded (SolARHL2FrameMetadata)
+    void GetRecordedTransform(size_t frame, float transform[16])
+    {
+        const float x = kStep * static_cast<float>(std::min(frame, kWalkEnd - 1));
+        const float yaw = frame >= kTurnStart ? static_cast<float>(frame - kTurnStart + 1) * kDegToRad : 0.f;
+        const float values[16] = {
+            std::cos(yaw), 0.f, std::sin(yaw), x,
+            0.f, 1.f, 0.f, 0.f,
+            -std::sin(yaw), 0.f, std::cos(yaw), 0.f,
+            0.f, 0.f, 0.f, 1.f };
+        std::copy(std::begin(values), std::end(values), transform);
+    }
+
+    // RecordingContainer layout to the winrt float4x4 layout of the capture threads
+    KeyframePose FromRecordedTransform(const float transform[16])
+    {
+        KeyframePose pose;
+        for (int row = 0; row < 4; ++row)
+        {
+            for (int column = 0; column < 4; ++column)
+            {
+                pose[row * 4 + column] = transform[column * 4 + row];
+            }
+        }
+        return pose;
+    }
+
+    void WriteRecording(const std::filesystem::path& path)
+    {
+        RecordingWriter writer;
+        CHECK(writer.Open(path));
+        uint64_t rightSequence = 0;
+        for (size_t frame = 0; frame < kFrameCount; ++frame)
+        {
+            SolARHL2FrameMetadata metadata{};
+            metadata.sequence = frame + 1;
+            metadata.timestamp = kFirstTimestamp + frame * kFramePeriod;
+            metadata.width = 4;
+            metadata.height = 2;
+            metadata.bytesPerPixel = 1;
+            metadata.planeCount = 1;
+            metadata.dataSize = 8;
+            metadata.sharpness = -1.f;
+            metadata.poseValid = IsUnlocated(frame) ? 0 : 1;
+            if (metadata.poseValid)
+            {
+                GetRecordedTransform(frame, metadata.toWorldTransform);
+            }
+            else
+            {
+                const float identity[16] = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f };
+                std::copy(std::begin(identity), std::end(identity), metadata.toWorldTransform);
+            }
+            uint8_t pixels[8];
+            std::fill(std::begin(pixels), std::end(pixels), static_cast<uint8_t>(frame));
+            CHECK(writer.WriteFrame(SharedStream::LEFT_FRONT, metadata, pixels));
+
+            // Second camera decimated to 15 fps, its own sequence numbers
+            if (frame % 2 == 0)
+            {
+                metadata.sequence = ++rightSequence;
+                CHECK(writer.WriteFrame(SharedStream::RIGHT_FRONT, metadata, pixels));
+            }
+        }
+        writer.Close();
+        CHECK_EQUAL(writer.GetStats().droppedRecords, 0u);
+    }
+
+    struct ReplayedFrame
+    {
+        uint64_t timestamp;
+        bool hasPose;
+        KeyframePose pose;
+    };
+
+    KeyframeSettings GetSettings()
+    {
+        KeyframeSettings settings;
+        settings.enabled = true;
+        settings.minTranslation = 0.09f;
+        settings.minRotationDeg = 9.5f;
+        settings.maxIntervalSec = 0.95f;
+        return settings;
+    }
+
+    std::vector<KeyframeDecision> Replay(const std::vector<ReplayedFrame>& frames, KeyframeStats& stats)
+    {
+        KeyframeSelector selector(kFrameCount);
+        selector.Configure(GetSettings());
+        for (const ReplayedFrame& frame : frames)
+        {
+            selector.Evaluate(frame.timestamp, frame.hasPose ? &frame.pose : nullptr);
+        }
+        stats = selector.GetStats();
+        return selector.GetDecisions(0);
+    }
+
+    std::filesystem::path GetRecordingPath()
+    {
+        return std::filesystem::temp_directory_path() / "KeyframeReplayTest.slrec";
+    }
+}
+
+TEST_CASE(RecordedSequenceIsContinuous)
+{
+    const std::filesystem::path path = GetRecordingPath();
+    WriteRecording(path);
+
+    RecordingReader reader;
+    CHECK(reader.Open(path));
+    std::map<SharedStream, std::vector<SolARHL2FrameMetadata>> streams;
+    std::vector<uint8_t> pixels;
+    reader.ForEachRecord(~0u, GetStreamBit(SharedStream::LEFT_FRONT) | GetStreamBit(SharedStream::RIGHT_FRONT), [&](const RecordingRecord& record)
+    {
+        SolARHL2FrameMetadata metadata;
+        CHECK(RecordingReader::DecodeFrame(record, metadata, pixels));
+        CHECK_EQUAL(record.timestamp, metadata.timestamp);
+        CHECK_EQUAL(pixels.size(), 8u);
+        CHECK_EQUAL(pixels[0], static_cast<uint8_t>((metadata.timestamp - kFirstTimestamp) / kFramePeriod));
+        streams[static_cast<SharedStream>(record.stream)].push_back(metadata);
+        return true;
+    });
+    reader.Close();
+    std::filesystem::remove(path);
+
+    CHECK_EQUAL(streams.size(), 2u);
+    const std::vector<SolARHL2FrameMetadata>& left = streams[SharedStream::LEFT_FRONT];
+    const std::vector<SolARHL2FrameMetadata>& right = streams[SharedStream::RIGHT_FRONT];
+    CHECK_EQUAL(left.size(), kFrameCount);
+    CHECK_EQUAL(right.size(), kFrameCount / 2);
+    for (size_t i = 1; i < left.size(); ++i)
+    {
+        CHECK_EQUAL(left[i].sequence, left[i - 1].sequence + 1);
+        CHECK_EQUAL(left[i].timestamp - left[i - 1].timestamp, kFramePeriod);
+    }
+    for (size_t i = 1; i < right.size(); ++i)
+    {
+        CHECK_EQUAL(right[i].sequence, right[i - 1].sequence + 1);
+        CHECK_EQUAL(right[i].timestamp - right[i - 1].timestamp, 2 * kFramePeriod);
+    }
+    for (size_t i = 0; i < left.size(); ++i)
+    {
+        CHECK_EQUAL(left[i].poseValid, IsUnlocated(i) ? 0u : 1u);
+    }
+}
+
+TEST_CASE(KeyframeSelectionReplay)
+{
+    const std::filesystem::path path = GetRecordingPath();
+    WriteRecording(path);
+
+    std::vector<ReplayedFrame> frames;
+    {
+        RecordingReader reader;
+        CHECK(reader.Open(path));
+        std::vector<uint8_t> pixels;
+        reader.ForEachRecord(~0u, GetStreamBit(SharedStream::LEFT_FRONT), [&](const RecordingRecord& record)
+        {
+            SolARHL2FrameMetadata metadata;
+            CHECK(RecordingReader::DecodeFrame(record, metadata, pixels));
+            frames.push_back({ metadata.timestamp, metadata.poseValid != 0, FromRecordedTransform(metadata.toWorldTransform) });
+            return true;
+        });
+    }
+    std::filesystem::remove(path);
+    CHECK_EQUAL(frames.size(), kFrameCount);
+
+    KeyframeStats stats;
+    const std::vector<KeyframeDecision> decisions = Replay(frames, stats);
+    CHECK_EQUAL(decisions.size(), kFrameCount);
+
+    // Walk: every 4 frames (0.1 m), the unlocated frames do not break the pattern. Stop: every 29
+    // frames (0.95 s) from the last walk keyframe. Turn: every 10 frames (10 degrees).
+    std::vector<size_t> expected;
+    for (size_t frame = 0; frame < kWalkEnd; frame += 4)
+    {
+        expected.push_back(frame);
+    }
+    expected.insert(expected.end(), { 125, 154, 183 });
+    for (size_t frame = 209; frame < kFrameCount; frame += 10)
+    {
+        expected.push_back(frame);
+    }
+
+    std::vector<size_t> keyframes;
+    for (size_t i = 0; i < decisions.size(); ++i)
+    {
+        const KeyframeDecision& decision = decisions[i];
+        CHECK_EQUAL(decision.index, i + 1);
+        CHECK_EQUAL(decision.timestamp, frames[i].timestamp);
+        CHECK_EQUAL((decision.reasons & KeyframeReasonNoPose) != 0, IsUnlocated(i));
+        if (!decision.isKeyframe)
+        {
+            continue;
+        }
+        keyframes.push_back(i);
+        if (i == 0)
+        {
+            CHECK(decision.reasons & KeyframeReasonFirst);
+        }
+        else if (i < kWalkEnd)
+        {
+            CHECK_EQUAL(decision.reasons, static_cast<uint32_t>(KeyframeReasonTranslation));
+        }
+        else if (i < kTurnStart)
+        {
+            CHECK_EQUAL(decision.reasons, static_cast<uint32_t>(KeyframeReasonTime));
+        }
+        else
+        {
+            CHECK_EQUAL(decision.reasons, static_cast<uint32_t>(KeyframeReasonRotation));
+        }
+    }
+    CHECK(keyframes == expected);
+
+    CHECK_EQUAL(stats.evaluated, kFrameCount);
+    CHECK_EQUAL(stats.emitted, expected.size());
+    CHECK_EQUAL(stats.byTranslation, 24u);
+    CHECK_EQUAL(stats.byTime, 3u);
+    CHECK_EQUAL(stats.byRotation, 10u);
+
+    // Deterministic: the same recording gives the same decisions
+    KeyframeStats replayedStats;
+    const std::vector<KeyframeDecision> replayed = Replay(frames, replayedStats);
+    CHECK_EQUAL(replayed.size(), decisions.size());
+    for (size_t i = 0; i < std::min(replayed.size(), decisions.size()); ++i)
+    {
+        CHECK_EQUAL(replayed[i].isKeyframe, decisions[i].isKeyframe);
+        CHECK_EQUAL(replayed[i].reasons, decisions[i].reasons);
+        CHECK_EQUAL(replayed[i].translation, decisions[i].translation);
+        CHECK_EQUAL(replayed[i].rotationDeg, decisions[i].rotationDeg);
+    }
+}
+
+TEST_MAIN()
@@ -0,0 +1,246 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Log-linear buckets of the latency histograms, their percentiles against the exact ones, and the
+// merge of the producer and consumer halves of the recent traces.
+
+#include "LatencyTrace.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+
+namespace
+{
+    constexpr uint64_t kMaxValue = std::numeric_limits<uint64_t>::max();
+
+    // Exact percentile: the value of rank ceil(count * percent / 100)
+    uint64_t Percentile(const std::vector<uint64_t>& sorted, uint64_t percent)
+    {
+        return sorted[static_cast<size_t>((sorted.size() * percent + 99) / 100) - 1];
+    }
+
+    // Midpoint of the bucket of the exact value, as GetStats() reports it
+    uint64_t Expected(uint64_t exact, uint64_t min, uint64_t max)
+    {
+        return std::clamp(LatencyHistogram::BucketMidpoint(LatencyHistogram::BucketIndex(exact)), min, max);
+    }
+
+    // Within half a bucket, 1/64 of the value
+    bool IsNear(uint64_t value, uint64_t exact)
+    {
+        const uint64_t error = value > exact ? value - exact : exact - value;
+        return error <= exact / (2 * LatencyHistogram::kSubBucketCount);
+    }
+
+    FrameTrace GetProducerTrace(uint64_t sequence, uint64_t exposure)
+    {
+        FrameTrace trace;
+        trace.sequence = sequence;
+        for (size_t stage = 0; stage <= static_cast<size_t>(PipelineStage::Published); ++stage)
+        {
+            trace.stamps[stage] = exposure + stage * 1000;
+        }
+        return trace;
+    }
+
+    // Trace stored along the frame: published after the copy
+    FrameTrace GetStoredTrace(const FrameTrace& producerTrace)
+    {
+        FrameTrace trace = producerTrace;
+        trace.Set(PipelineStage::Published, 0);
+        return trace;
+    }
+}
+
+TEST_CASE(ExactBuckets)
+{
+    for (uint64_t value = 0; value < 2 * LatencyHistogram::kSubBucketCount; ++value)
+    {
+        CHECK_EQUAL(LatencyHistogram::BucketIndex(value), static_cast<size_t>(value));
+        CHECK_EQUAL(LatencyHistogram::BucketMidpoint(static_cast<size_t>(value)), value);
+    }
+}
+
+TEST_CASE(PowerOfTwoBoundaries)
+{
+    size_t mismatches = 0;
+    for (uint32_t bit = LatencyHistogram::kSubBucketBits + 1; bit < 64; ++bit)
+    {
+        // 2^bit starts the first bucket of its range, 2^bit - 1 ends the last one of the previous
+        const uint64_t power = uint64_t(1) << bit;
+        const size_t index = LatencyHistogram::BucketIndex(power);
+        if (index != (bit - LatencyHistogram::kSubBucketBits + 1) * LatencyHistogram::kSubBucketCount ||
+            LatencyHistogram::BucketIndex(power - 1) != index - 1 || LatencyHistogram::BucketIndex(power + 1) != index)
+        {
+            std::cerr << "2^" << bit << ": bucket " << index << "\n";
+            mismatches++;
+        }
+    }
+    CHECK_EQUAL(mismatches, 0u);
+
+    // Top bucket
+    CHECK_EQUAL(LatencyHistogram::BucketIndex(kMaxValue), LatencyHistogram::kBucketCount - 1);
+    CHECK_EQUAL(LatencyHistogram::BucketIndex(kMaxValue - (uint64_t(1) << 58) + 1), LatencyHistogram::kBucketCount - 1);
+    CHECK_EQUAL(LatencyHistogram::BucketIndex(kMaxValue - (uint64_t(1) << 58)), LatencyHistogram::kBucketCount - 2);
+    CHECK_EQUAL(LatencyHistogram::BucketMidpoint(LatencyHistogram::kBucketCount - 1), kMaxValue - (uint64_t(1) << 57) + 1);
+}
+
+TEST_CASE(BucketRoundTrips)
+{
+    // The midpoint of every bucket falls in the bucket, within half a bucket of its bounds
+    size_t mismatches = 0;
+    for (size_t index = 0; index < LatencyHistogram::kBucketCount; ++index)
+    {
+        const uint64_t midpoint = LatencyHistogram::BucketMidpoint(index);
+        if (LatencyHistogram::BucketIndex(midpoint) != index)
+        {
+            std::cerr << "bucket " << index << ": midpoint " << midpoint << "\n";
+            mismatches++;
+        }
+    }
+    CHECK_EQUAL(mismatches, 0u);
+
+    std::mt19937_64 generator(3);
+    for (int i = 0; i < 100000; ++i)
+    {
+        // Spread over every power of two
+        const uint64_t value = generator() >> (generator() % 64);
+        const uint64_t midpoint = LatencyHistogram::BucketMidpoint(LatencyHistogram::BucketIndex(value));
+        if (!IsNear(midpoint, value))
+        {
+            std::cerr << value << ": midpoint " << midpoint << "\n";
+            mismatches++;
+        }
+    }
+    CHECK_EQUAL(mismatches, 0u);
+}
+
+TEST_CASE(Percentiles)
+{
+    // Latencies of 1 ms to 100 ms, log-normal, in hundreds of nanoseconds
+    std::mt19937 generator(7);
+    std::lognormal_distribution<double> latency(std::log(50'000.), 0.8);
+    for (size_t count : { 1u, 2u, 7u, 100u, 1001u, 50000u })
+    {
+        LatencyHistogram histogram;
+        std::vector<uint64_t> values;
+        uint64_t sum = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint64_t value = static_cast<uint64_t>(latency(generator));
+            values.push_back(value);
+            sum += value;
+            histogram.Record(value);
+        }
+        std::sort(values.begin(), values.end());
+
+        const LatencyStats stats = histogram.GetStats();
+        CHECK_EQUAL(stats.count, count);
+        CHECK_EQUAL(stats.min, values.front());
+        CHECK_EQUAL(stats.max, values.back());
+        CHECK_NEAR(stats.mean, static_cast<double>(sum) / static_cast<double>(count), 1e-6 * stats.mean);
+
+        const uint64_t p50 = Percentile(values, 50);
+        const uint64_t p90 = Percentile(values, 90);
+        const uint64_t p99 = Percentile(values, 99);
+        CHECK_EQUAL(stats.p50, Expected(p50, stats.min, stats.max));
+        CHECK_EQUAL(stats.p90, Expected(p90, stats.min, stats.max));
+        CHECK_EQUAL(stats.p99, Expected(p99, stats.min, stats.max));
+        CHECK(IsNear(stats.p50, p50) && IsNear(stats.p90, p90) && IsNear(stats.p99, p99));
+    }
+}
+
+TEST_CASE(PercentilesOfExtremes)
+{
+    LatencyHistogram histogram;
+    CHECK_EQUAL(histogram.GetStats().count, 0u);
+
+    // Clamped to the recorded range: a single value is exact
+    histogram.Record(kMaxValue);
+    LatencyStats stats = histogram.GetStats();
+    CHECK(stats.min == kMaxValue && stats.p50 == kMaxValue && stats.p99 == kMaxValue);
+
+    // 98 small values, two at the top: p99 is in the top bucket
+    histogram.Reset();
+    for (int i = 0; i < 98; ++i)
+    {
+        histogram.Record(10);
+    }
+    histogram.Record(kMaxValue - 1);
+    histogram.Record(kMaxValue);
+    stats = histogram.GetStats();
+    CHECK_EQUAL(stats.p50, 10u);
+    CHECK_EQUAL(stats.p90, 10u);
+    CHECK_EQUAL(stats.p99, LatencyHistogram::BucketMidpoint(LatencyHistogram::kBucketCount - 1));
+    CHECK_EQUAL(stats.max, kMaxValue);
+}
+
+TEST_CASE(StoreMergesProducerAndConsumer)
+{
+    const uint64_t exposure = PipelineClockNow() - 500'000;
+
+    // Producer first, as usual
+    PipelineTracer tracer;
+    const FrameTrace first = GetProducerTrace(7, exposure);
+    tracer.Complete(first);
+    tracer.PickedUp(GetStoredTrace(first));
+
+    // Consumer first: the frame was returned before Complete() stored it
+    const FrameTrace second = GetProducerTrace(8, exposure + 330'000);
+    tracer.PickedUp(GetStoredTrace(second));
+    tracer.Complete(second);
+
+    const std::vector<FrameTrace> traces = tracer.GetRecentTraces();
+    CHECK_EQUAL(traces.size(), 2u);
+    for (size_t i = 0; i < traces.size(); ++i)
+    {
+        const FrameTrace& expected = i == 0 ? first : second;
+        CHECK_EQUAL(traces[i].sequence, expected.sequence);
+        bool isMerged = traces[i].Get(PipelineStage::PickedUp) >= expected.Get(PipelineStage::Published);
+        for (size_t stage = 0; stage <= static_cast<size_t>(PipelineStage::Published); ++stage)
+        {
+            isMerged &= traces[i].stamps[stage] == expected.stamps[stage];
+        }
+        CHECK(isMerged);
+    }
+
+    // Each frame counted once per stage
+    CHECK_EQUAL(tracer.GetStats(PipelineStage::Acquired).count, 2u);
+    CHECK_EQUAL(tracer.GetStats(PipelineStage::Published).count, 2u);
+    CHECK_EQUAL(tracer.GetStats(PipelineStage::PickedUp).count, 2u);
+    CHECK_EQUAL(tracer.GetStats(PipelineStage::Published).min, 5000u);
+
+    // A frame kRecentTraceCount later replaces the one of its slot, without merging
+    FrameTrace later = GetProducerTrace(7 + PipelineTracer::kRecentTraceCount, exposure + 1'000'000);
+    later.Set(PipelineStage::Located, 0);
+    tracer.Complete(later);
+    const std::vector<FrameTrace> replaced = tracer.GetRecentTraces();
+    CHECK_EQUAL(replaced.size(), 2u);
+    CHECK(replaced.back().sequence == later.sequence && replaced.back().Get(PipelineStage::Located) == 0 &&
+          replaced.back().Get(PipelineStage::PickedUp) == 0);
+
+    const std::string json = ToChromeTrace({ { "PV", &tracer } });
+    CHECK(json.find("\"name\":\"PickedUp\"") != std::string::npos);
+    CHECK(json.find("\"sequence\":263") != std::string::npos);
+
+    tracer.Reset();
+    CHECK(tracer.GetRecentTraces().empty());
+    CHECK_EQUAL(tracer.GetStats(PipelineStage::Acquired).count, 0u);
+}
+
+TEST_MAIN()
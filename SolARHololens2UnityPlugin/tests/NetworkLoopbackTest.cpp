@@ -0,0 +1,317 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// NetworkStreamServer and the receivers over 127.0.0.1: frames of every codec, IMU samples and
+// head poses published as the capture threads do, compared byte for byte on the receiver side
+
+#include "NetworkStreamReceiver.h"
+#include "NetworkStreamServer.h"
+#include "TestCheck.h"
+
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <random>
+#include <thread>
+
+namespace
+{
+    constexpr uint64_t kFrameCount = 10;
+    constexpr uint64_t kImuSampleCount = 500;
+    constexpr uint64_t kHeadPoseCount = 3;
+    constexpr uint32_t kTimeoutMs = 5000;
+
+    struct TestStream
+    {
+        SharedStream stream;
+        NetworkCodec codec;
+        uint32_t width;
+        uint32_t height;
+        uint32_t bytesPerPixel;
+        uint32_t planeCount;
+        FramePublisher publisher;
+    };
+
+    // Smooth gradient with noise, and an invalid (zero) area as in depth maps
+    std::vector<uint8_t> GetPixels(const TestStream& stream, uint64_t sequence, std::mt19937& generator)
+    {
+        std::uniform_int_distribution<int> noise(0, 3);
+        std::vector<uint8_t> pixels(static_cast<size_t>(stream.width) * stream.height * stream.bytesPerPixel * stream.planeCount);
+        for (size_t i = 0; i < pixels.size(); ++i)
+        {
+            const size_t x = (i / stream.bytesPerPixel) % stream.width;
+            pixels[i] = x < stream.width / 4 ? 0 : static_cast<uint8_t>(x + sequence + noise(generator));
+        }
+        return pixels;
+    }
+
+    SharedFramePtr Publish(TestStream& stream, uint64_t sequence, std::mt19937& generator)
+    {
+        auto frame = stream.publisher.AllocateFrame();
+        frame->sequence = sequence;
+        frame->timestamp = 132'900'000'000'000'000 + sequence * 333'333;
+        frame->poseValid = sequence % 4 != 0;
+        if (frame->poseValid)
+        {
+            frame->toWorldTransform[12] = static_cast<float>(sequence);
+            frame->toWorldTransform[13] = 1.5f;
+        }
+        frame->width = stream.width;
+        frame->height = stream.height;
+        frame->bytesPerPixel = stream.bytesPerPixel;
+        frame->planeCount = stream.planeCount;
+        frame->sharpness = 0.5f * static_cast<float>(sequence);
+        frame->data = GetPixels(stream, sequence, generator);
+        stream.publisher.Publish(frame);
+        return frame;
+    }
+
+    SharedHeadPose GetHeadPose(uint64_t index)
+    {
+        SharedHeadPose pose{};
+        pose.timestamp = 132'900'000'000'000'000 + index * 166'667;
+        pose.position[0] = static_cast<float>(index);
+        pose.forward[2] = -1.f;
+        pose.up[1] = 1.f;
+        return pose;
+    }
+
+    bool WaitForClients(NetworkStreamServer& server, uint32_t count)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kTimeoutMs);
+        while (server.GetStats().clients < count)
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+            {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return true;
+    }
+
+    // Received frames of a stream against the published ones, byte for byte
+    size_t CountFrameMismatches(const std::vector<NetworkMessage>& received, const TestStream& stream, const std::vector<SharedFramePtr>& published)
+    {
+        size_t mismatches = 0;
+        size_t index = 0;
+        for (const NetworkMessage& message : received)
+        {
+            if (message.header.type != static_cast<uint16_t>(NetworkMessageType::Frame) || message.header.stream != static_cast<uint32_t>(stream.stream))
+            {
+                continue;
+            }
+            SolARHL2FrameMetadata expected{};
+            if (index < published.size())
+            {
+                FillFrameMetadata(*published[index], stream.stream == SharedStream::PV, expected);
+            }
+            if (index >= published.size() || message.header.codec != static_cast<uint16_t>(stream.codec) ||
+                message.header.timestamp != expected.timestamp || std::memcmp(&message.frame, &expected, sizeof(expected)) != 0 ||
+                message.pixels != published[index]->data)
+            {
+                mismatches++;
+            }
+            index++;
+        }
+        return mismatches + (published.size() - std::min(index, published.size()));
+    }
+}
+
+TEST_CASE(LoopbackStreaming)
+{
+    TestStream streams[] = {
+        { SharedStream::PV, NetworkCodec::Raw, 64, 32, 4, 1, {} },
+        { SharedStream::LEFT_FRONT, NetworkCodec::Gray8, 64, 48, 1, 1, {} },
+        { SharedStream::DEPTH, NetworkCodec::Depth16, 32, 32, 2, 2, {} } };
+    ImuSampleRing gyro(1024);
+
+    NetworkPoseReceiver poseReceiver;
+    CHECK(poseReceiver.Open(0));
+
+    NetworkStreamServer server;
+    for (TestStream& stream : streams)
+    {
+        server.AddFrameStream(stream.stream, stream.publisher, stream.codec);
+    }
+    server.AddImuStream(SharedStream::IMU_GYRO, gyro);
+    server.AddHeadPoseStream();
+    NetworkStreamSettings settings;
+    settings.tcpPort = 0;
+    settings.udpPoseHost = "127.0.0.1";
+    settings.udpPosePort = poseReceiver.GetPort();
+    CHECK(server.Start(settings));
+
+    NetworkStreamReceiver receiver;
+    CHECK(receiver.Connect("127.0.0.1", server.GetPort()));
+    const uint32_t available = GetStreamBit(SharedStream::PV) | GetStreamBit(SharedStream::LEFT_FRONT) | GetStreamBit(SharedStream::DEPTH) |
+                               GetStreamBit(SharedStream::IMU_GYRO) | GetStreamBit(SharedStream::HEAD_POSE);
+    CHECK_EQUAL(receiver.GetAvailableStreams(), available);
+    NetworkStreamReceiver depthReceiver;
+    CHECK(depthReceiver.Connect("127.0.0.1", server.GetPort(), GetStreamBit(SharedStream::DEPTH)));
+    CHECK(WaitForClients(server, 2));
+
+    // Frames are published at the pace of their delivery, as the sensors would: the subscriptions
+    // of the server drop the oldest frames of a burst. The pose datagram of a frame is sent by its
+    // delivery task, one pose datagram per frame whatever the TCP clients want.
+    std::mt19937 generator(3);
+    std::map<SharedStream, std::vector<SharedFramePtr>> published;
+    std::map<SharedStream, uint64_t> framePoses;
+    size_t poseMismatches = 0;
+    NetworkMessage message;
+    for (uint64_t sequence = 1; sequence <= kFrameCount; ++sequence)
+    {
+        for (TestStream& stream : streams)
+        {
+            published[stream.stream].push_back(Publish(stream, sequence, generator));
+        }
+        for (size_t i = 0; i < std::size(streams) && poseReceiver.Receive(message, kTimeoutMs); ++i)
+        {
+            const auto stream = static_cast<SharedStream>(message.header.stream);
+            const std::vector<SharedFramePtr>& frames = published[stream];
+            const uint64_t index = framePoses[stream]++;
+            SolARHL2FrameMetadata expected{};
+            if (index < frames.size())
+            {
+                FillFrameMetadata(*frames[index], stream == SharedStream::PV, expected);
+            }
+            if (message.header.type != static_cast<uint16_t>(NetworkMessageType::FramePose) || index >= frames.size() ||
+                message.header.timestamp != expected.timestamp || message.framePose.sequence != expected.sequence ||
+                message.framePose.poseValid != expected.poseValid ||
+                std::memcmp(message.framePose.toWorldTransform, expected.toWorldTransform, sizeof(expected.toWorldTransform)) != 0)
+            {
+                poseMismatches++;
+            }
+        }
+    }
+    CHECK_EQUAL(poseMismatches, 0u);
+    for (const TestStream& stream : streams)
+    {
+        CHECK_EQUAL(framePoses[stream.stream], kFrameCount);
+    }
+
+    for (uint64_t index = 1; index <= kImuSampleCount; ++index)
+    {
+        ImuSample sample;
+        sample.index = index;
+        sample.timestamp = 1'000 + index * 10'000;
+        sample.hostTicks = index * 10'000;
+        sample.sensorTicks = 5'000 + index * 1'000'000;
+        sample.x = static_cast<float>(index);
+        sample.y = -sample.x;
+        sample.z = 0.5f * sample.x;
+        sample.temperature = 30.f;
+        gyro.Push(sample);
+    }
+    for (uint64_t index = 1; index <= kHeadPoseCount; ++index)
+    {
+        server.PublishHeadPose(GetHeadPose(index));
+    }
+
+    // Every published message, in order for each stream
+    std::vector<NetworkMessage> messages;
+    std::vector<SharedImuSample> imuSamples;
+    uint64_t frameCount = 0;
+    uint64_t headPoseCount = 0;
+    while ((frameCount < 3 * kFrameCount || imuSamples.size() < kImuSampleCount || headPoseCount < kHeadPoseCount) &&
+           receiver.Receive(message, kTimeoutMs))
+    {
+        switch (static_cast<NetworkMessageType>(message.header.type))
+        {
+        case NetworkMessageType::Frame:
+            frameCount++;
+            messages.push_back(message);
+            break;
+        case NetworkMessageType::ImuSamples:
+            CHECK_EQUAL(message.header.stream, static_cast<uint32_t>(SharedStream::IMU_GYRO));
+            CHECK(!message.imuSamples.empty() && message.header.timestamp == message.imuSamples.back().timestamp);
+            imuSamples.insert(imuSamples.end(), message.imuSamples.begin(), message.imuSamples.end());
+            break;
+        case NetworkMessageType::HeadPose:
+        {
+            const SharedHeadPose expected = GetHeadPose(++headPoseCount);
+            CHECK(std::memcmp(&message.headPose, &expected, sizeof(expected)) == 0);
+        }
+            break;
+        default:
+            CHECK(false);
+            break;
+        }
+    }
+    CHECK_EQUAL(frameCount, 3 * kFrameCount);
+    CHECK_EQUAL(headPoseCount, kHeadPoseCount);
+    for (const TestStream& stream : streams)
+    {
+        CHECK_EQUAL(CountFrameMismatches(messages, stream, published[stream.stream]), 0u);
+    }
+    CHECK_EQUAL(imuSamples.size(), kImuSampleCount);
+    for (size_t i = 0; i < imuSamples.size(); ++i)
+    {
+        const SharedImuSample& sample = imuSamples[i];
+        CHECK(sample.index == i + 1 && sample.timestamp == 1'000 + sample.index * 10'000 &&
+              sample.sensorTicks == 5'000 + sample.index * 1'000'000 && sample.x == static_cast<float>(sample.index) &&
+              sample.y == -sample.x && sample.z == 0.5f * sample.x && sample.temperature == 30.f);
+    }
+
+    // The depth only client gets the depth frames alone
+    std::vector<NetworkMessage> depthMessages;
+    while (depthMessages.size() < kFrameCount && depthReceiver.Receive(message, kTimeoutMs))
+    {
+        depthMessages.push_back(message);
+    }
+    CHECK_EQUAL(depthMessages.size(), kFrameCount);
+    CHECK_EQUAL(CountFrameMismatches(depthMessages, streams[2], published[SharedStream::DEPTH]), 0u);
+
+    uint64_t headPoseDatagrams = 0;
+    while (headPoseDatagrams < kHeadPoseCount && poseReceiver.Receive(message, kTimeoutMs))
+    {
+        const SharedHeadPose expected = GetHeadPose(++headPoseDatagrams);
+        CHECK(message.header.type == static_cast<uint16_t>(NetworkMessageType::HeadPose) &&
+              std::memcmp(&message.headPose, &expected, sizeof(expected)) == 0);
+    }
+    CHECK_EQUAL(headPoseDatagrams, kHeadPoseCount);
+
+    const NetworkStreamStats stats = server.GetStats();
+    CHECK_EQUAL(stats.droppedFrames, 0u);
+    CHECK(stats.encodedFrameBytes < stats.rawFrameBytes);
+
+    // Clients see the end of the stream
+    server.Stop();
+    CHECK(!receiver.Receive(message, kTimeoutMs));
+    CHECK(!receiver.IsConnected());
+}
+
+TEST_CASE(ConnectionRefusedWhenFull)
+{
+    FramePublisher publisher;
+    NetworkStreamServer server;
+    server.AddFrameStream(SharedStream::PV, publisher);
+    NetworkStreamSettings settings;
+    settings.tcpPort = 0;
+    settings.maxClients = 1;
+    CHECK(server.Start(settings));
+
+    NetworkStreamReceiver first;
+    CHECK(first.Connect("127.0.0.1", server.GetPort()));
+    CHECK(WaitForClients(server, 1));
+    NetworkStreamReceiver second;
+    CHECK(!second.Connect("127.0.0.1", server.GetPort()));
+    CHECK(!second.IsConnected());
+    CHECK_EQUAL(server.GetStats().clients, 1u);
+}
+
+TEST_MAIN()
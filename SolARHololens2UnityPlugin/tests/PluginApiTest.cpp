@@ -0,0 +1,213 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Flat C API stream handles over a publisher fed by the test, as the capture threads do
+
+#include "PluginApiStream.h"
+#include "TestCheck.h"
+
+#include <thread>
+
+namespace
+{
+    // Rig rotated a quarter turn about z, at (1, 2, 3), as a winrt float4x4 (row vector convention)
+    const std::array<float, 16> kToWorld = { 0.f, 1.f, 0.f, 0.f, -1.f, 0.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 1.f, 2.f, 3.f, 1.f };
+    // Same transform, row-major in the column vector convention, in the rig and SolAR camera axes
+    const float kRigToWorld[16] = { 0.f, -1.f, 0.f, 1.f, 1.f, 0.f, 0.f, 2.f, 0.f, 0.f, 1.f, 3.f, 0.f, 0.f, 0.f, 1.f };
+    const float kSolARToWorld[16] = { 0.f, 1.f, 0.f, 1.f, 1.f, 0.f, 0.f, 2.f, 0.f, 0.f, -1.f, 3.f, 0.f, 0.f, 0.f, 1.f };
+    const float kIdentity[16] = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f };
+
+    void Publish(FramePublisher& publisher, uint64_t sequence, bool poseValid)
+    {
+        auto frame = publisher.AllocateFrame();
+        frame->sequence = sequence;
+        frame->timestamp = 1'000'000 + sequence;
+        // Producers leave the identity when the sensor could not be located
+        if (poseValid)
+        {
+            frame->toWorldTransform = kToWorld;
+        }
+        frame->poseValid = poseValid;
+        frame->width = 4;
+        frame->height = 2;
+        frame->bytesPerPixel = 1;
+        frame->sharpness = 12.5f;
+        frame->data.assign(8, static_cast<uint8_t>(sequence));
+        publisher.Publish(frame);
+    }
+
+    bool IsSame(const float a[16], const float b[16])
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            if (a[i] != b[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // As SolARHL2_OpenStream()
+    SolARHL2Stream* Open(FramePublisher& publisher, SolARHL2StreamId streamId, uint32_t queueCapacity, uint32_t maxAcquiredFrames)
+    {
+        SolARHL2Stream* stream = nullptr;
+        auto subscriber = publisher.Subscribe(queueCapacity > 0 ? queueCapacity : FramePublisher::kDefaultQueueCapacity);
+        CHECK(CreatePluginApiStream(streamId, std::move(subscriber), maxAcquiredFrames, &stream) == SOLARHL2_OK);
+        return stream;
+    }
+}
+
+TEST_CASE(InvalidArguments)
+{
+    FramePublisher publisher;
+    SolARHL2Stream* stream = nullptr;
+    CHECK(CreatePluginApiStream(SOLARHL2_STREAM_PV, nullptr, 0, &stream) == SOLARHL2_INVALID_ARGUMENT);
+    CHECK(CreatePluginApiStream(SOLARHL2_STREAM_PV, publisher.Subscribe(), 0, nullptr) == SOLARHL2_INVALID_ARGUMENT);
+
+    SolARHL2Frame frame;
+    SolARHL2StreamStats stats;
+    CHECK(SolARHL2_AcquireFrame(nullptr, 0, &frame) == SOLARHL2_INVALID_ARGUMENT);
+    CHECK(SolARHL2_GetStreamStats(nullptr, &stats) == SOLARHL2_INVALID_ARGUMENT);
+    stream = Open(publisher, SOLARHL2_STREAM_PV, 0, 0);
+    CHECK(SolARHL2_AcquireFrame(stream, 0, nullptr) == SOLARHL2_INVALID_ARGUMENT);
+    CHECK(SolARHL2_GetStreamStats(stream, nullptr) == SOLARHL2_INVALID_ARGUMENT);
+    // No-ops
+    SolARHL2_ReleaseFrame(stream, nullptr);
+    SolARHL2_CloseStream(nullptr);
+    SolARHL2_CloseStream(stream);
+    CHECK_EQUAL(SolARHL2_GetApiVersion(), static_cast<uint32_t>(SOLARHL2_API_VERSION));
+}
+
+TEST_CASE(MetadataPacking)
+{
+    FramePublisher publisher;
+    SolARHL2Stream* pvStream = Open(publisher, SOLARHL2_STREAM_PV, 0, 0);
+    SolARHL2Stream* vlcStream = Open(publisher, SOLARHL2_STREAM_LEFT_FRONT, 0, 0);
+    Publish(publisher, 7, true);
+    Publish(publisher, 8, false);
+
+    SolARHL2Frame frame;
+    CHECK(SolARHL2_AcquireFrame(pvStream, 0, &frame) == SOLARHL2_OK);
+    CHECK_EQUAL(frame.metadata.sequence, 7u);
+    CHECK_EQUAL(frame.metadata.timestamp, 1'000'007u);
+    CHECK(IsSame(frame.metadata.toWorldTransform, kSolARToWorld));
+    CHECK_EQUAL(frame.metadata.width, 4u);
+    CHECK_EQUAL(frame.metadata.height, 2u);
+    CHECK_EQUAL(frame.metadata.bytesPerPixel, 1u);
+    CHECK_EQUAL(frame.metadata.planeCount, 1u);
+    CHECK_EQUAL(frame.metadata.dataSize, 8u);
+    CHECK_EQUAL(frame.metadata.sharpness, 12.5f);
+    CHECK_EQUAL(frame.metadata.poseValid, 1u);
+    CHECK(frame.data != nullptr && frame.data[0] == 7 && frame.data[7] == 7);
+    SolARHL2_ReleaseFrame(pvStream, &frame);
+    CHECK(frame.data == nullptr);
+
+    // The identity of frames which could not be located is not turned to the SolAR axes
+    CHECK(SolARHL2_AcquireFrame(pvStream, 0, &frame) == SOLARHL2_OK);
+    CHECK_EQUAL(frame.metadata.poseValid, 0u);
+    CHECK(IsSame(frame.metadata.toWorldTransform, kIdentity));
+    SolARHL2_ReleaseFrame(pvStream, &frame);
+
+    // Other streams keep the rig axes
+    CHECK(SolARHL2_AcquireFrame(vlcStream, 0, &frame) == SOLARHL2_OK);
+    CHECK(IsSame(frame.metadata.toWorldTransform, kRigToWorld));
+    SolARHL2_ReleaseFrame(vlcStream, &frame);
+
+    SolARHL2_CloseStream(pvStream);
+    SolARHL2_CloseStream(vlcStream);
+}
+
+TEST_CASE(AcquiredFrameSlots)
+{
+    FramePublisher publisher;
+    SolARHL2Stream* stream = Open(publisher, SOLARHL2_STREAM_DEPTH, 4, 2);
+    for (uint64_t i = 1; i <= 3; ++i)
+    {
+        Publish(publisher, i, true);
+    }
+
+    SolARHL2Frame first;
+    SolARHL2Frame second;
+    SolARHL2Frame third;
+    CHECK(SolARHL2_AcquireFrame(stream, 0, &first) == SOLARHL2_OK);
+    CHECK(SolARHL2_AcquireFrame(stream, 0, &second) == SOLARHL2_OK);
+    CHECK(first.slot != second.slot);
+    // Both slots held: the queued frame is not lost
+    CHECK(SolARHL2_AcquireFrame(stream, 0, &third) == SOLARHL2_TOO_MANY_FRAMES);
+
+    SolARHL2StreamStats stats;
+    CHECK(SolARHL2_GetStreamStats(stream, &stats) == SOLARHL2_OK);
+    CHECK_EQUAL(stats.received, 3u);
+    CHECK_EQUAL(stats.dropped, 0u);
+    CHECK_EQUAL(stats.acquired, 2u);
+
+    // Held frames stay valid while the later ones are read
+    SolARHL2_ReleaseFrame(stream, &first);
+    CHECK(SolARHL2_AcquireFrame(stream, 0, &third) == SOLARHL2_OK);
+    CHECK_EQUAL(third.metadata.sequence, 3u);
+    CHECK_EQUAL(third.slot, first.slot);
+    CHECK(second.data[0] == 2);
+    CHECK(SolARHL2_AcquireFrame(stream, 0, &first) == SOLARHL2_TOO_MANY_FRAMES);
+    SolARHL2_ReleaseFrame(stream, &second);
+    CHECK(SolARHL2_AcquireFrame(stream, 0, &second) == SOLARHL2_NO_FRAME);
+    SolARHL2_ReleaseFrame(stream, &third);
+    CHECK(SolARHL2_GetStreamStats(stream, &stats) == SOLARHL2_OK);
+    CHECK_EQUAL(stats.acquired, 0u);
+    SolARHL2_CloseStream(stream);
+}
+
+TEST_CASE(QueueOverflowAndClose)
+{
+    FramePublisher publisher;
+    SolARHL2Stream* stream = Open(publisher, SOLARHL2_STREAM_PV, 2, 0);
+    for (uint64_t i = 1; i <= 5; ++i)
+    {
+        Publish(publisher, i, true);
+    }
+
+    SolARHL2StreamStats stats;
+    CHECK(SolARHL2_GetStreamStats(stream, &stats) == SOLARHL2_OK);
+    CHECK_EQUAL(stats.received, 5u);
+    CHECK_EQUAL(stats.dropped, 3u);
+
+    // The latest frames are kept
+    SolARHL2Frame frame;
+    CHECK(SolARHL2_AcquireFrame(stream, 0, &frame) == SOLARHL2_OK);
+    CHECK_EQUAL(frame.metadata.sequence, 4u);
+    SolARHL2_ReleaseFrame(stream, &frame);
+
+    // A waiting caller gets the frame published meanwhile, then the stream end
+    CHECK(SolARHL2_AcquireFrame(stream, 0, &frame) == SOLARHL2_OK);
+    SolARHL2_ReleaseFrame(stream, &frame);
+    std::thread producer([&publisher]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        Publish(publisher, 6, true);
+    });
+    CHECK(SolARHL2_AcquireFrame(stream, 5000, &frame) == SOLARHL2_OK);
+    CHECK_EQUAL(frame.metadata.sequence, 6u);
+    SolARHL2_ReleaseFrame(stream, &frame);
+    producer.join();
+
+    CHECK(SolARHL2_AcquireFrame(stream, 10, &frame) == SOLARHL2_NO_FRAME);
+    publisher.CloseAll();
+    CHECK(SolARHL2_AcquireFrame(stream, 10, &frame) == SOLARHL2_STREAM_CLOSED);
+    CHECK(SolARHL2_AcquireFrame(stream, 0, &frame) == SOLARHL2_STREAM_CLOSED);
+    SolARHL2_CloseStream(stream);
+}
+
+TEST_MAIN()
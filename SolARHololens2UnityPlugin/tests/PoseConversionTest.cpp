@@ -0,0 +1,237 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// PoseConversion kernels against the Eigen code they replace (transpose of the winrt float4x4,
+// then product with the HoloLens to OpenCV axis change), for every layout, camera axes and
+// precision, on random poses and on the rotations where the quaternion extraction switches branch.
+
+#include "PoseConversion.h"
+#include "TestCheck.h"
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace PoseConversion;
+
+namespace
+{
+    constexpr size_t kRandomPoseCount = 100'000;
+
+    // winrt float4x4 of a sensor to world transform: rotation rows, translation in m41..m43
+    std::vector<float> ToHoloLens(const Eigen::Matrix3d& rotation, const Eigen::Vector3d& translation)
+    {
+        Eigen::Matrix4d columnVector = Eigen::Matrix4d::Identity();
+        columnVector.topLeftCorner<3, 3>() = rotation;
+        columnVector.topRightCorner<3, 1>() = translation;
+        // The row vector matrix is the transpose, stored row by row
+        const Eigen::Matrix<double, 4, 4, Eigen::RowMajor> rowVector = columnVector.transpose();
+        std::vector<float> transform(kTransformSize);
+        for (size_t i = 0; i < kTransformSize; ++i)
+        {
+            transform[i] = static_cast<float>(rowVector.data()[i]);
+        }
+        return transform;
+    }
+
+    // Sensor rotations are not exactly orthonormal: random poses, some slightly skewed, and the
+    // identity, the half turns and the 24 axis aligned rotations
+    std::vector<std::vector<float>> GetPoses()
+    {
+        std::vector<std::vector<float>> poses;
+        std::mt19937 generator(7);
+        std::normal_distribution<double> normal;
+        std::uniform_real_distribution<double> position(-50., 50.);
+        for (size_t i = 0; i < kRandomPoseCount; ++i)
+        {
+            Eigen::Quaterniond q(normal(generator), normal(generator), normal(generator), normal(generator));
+            Eigen::Matrix3d rotation = q.normalized().toRotationMatrix();
+            if (i % 4 == 0)
+            {
+                rotation += 1e-4 * Eigen::Matrix3d::Random();
+            }
+            poses.push_back(ToHoloLens(rotation, Eigen::Vector3d(position(generator), position(generator), position(generator))));
+        }
+
+        const Eigen::Vector3d axes[] = { Eigen::Vector3d::UnitX(), Eigen::Vector3d::UnitY(), Eigen::Vector3d::UnitZ(),
+                                         Eigen::Vector3d(1., 1., 0.).normalized(), Eigen::Vector3d(1., -2., 3.).normalized() };
+        for (const Eigen::Vector3d& axis : axes)
+        {
+            const double pi = EIGEN_PI;
+            for (double angle : { 0., 0.5 * pi, pi - 1e-3, pi, -0.5 * pi, 2.5 })
+            {
+                poses.push_back(ToHoloLens(Eigen::AngleAxisd(angle, axis).toRotationMatrix(), Eigen::Vector3d(1., 2., 3.)));
+            }
+        }
+        for (int x = 0; x < 4; ++x)
+        {
+            for (int y = 0; y < 4; ++y)
+            {
+                for (int z = 0; z < 4; ++z)
+                {
+                    const Eigen::Matrix3d rotation = (Eigen::AngleAxisd(0.5 * EIGEN_PI * z, Eigen::Vector3d::UnitZ()) *
+                                                      Eigen::AngleAxisd(0.5 * EIGEN_PI * y, Eigen::Vector3d::UnitY()) *
+                                                      Eigen::AngleAxisd(0.5 * EIGEN_PI * x, Eigen::Vector3d::UnitX())).toRotationMatrix();
+                    poses.push_back(ToHoloLens(rotation.array().round().matrix(), Eigen::Vector3d(-1., 0., 4.)));
+                }
+            }
+        }
+        return poses;
+    }
+
+    // Former Utils::convertToSolARPose: transpose, then axis change on the right
+    Eigen::Matrix4d Reference(const std::vector<float>& hololensToWorld, CameraAxes axes)
+    {
+        Eigen::Matrix4d rowVector;
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                rowVector(i, j) = hololensToWorld[i * 4 + j];
+            }
+        }
+        const Eigen::Matrix4d flip = Eigen::Vector4d(1., -1., -1., 1.).asDiagonal();
+        return axes == CameraAxes::OpenCV ? Eigen::Matrix4d(rowVector.transpose() * flip) : Eigen::Matrix4d(rowVector.transpose());
+    }
+
+    // Exact comparison: the conversion only moves values and flips signs
+    template <Layout layout, CameraAxes axes, typename T>
+    size_t CountMismatches(const std::vector<std::vector<float>>& poses)
+    {
+        using Matrix = Eigen::Matrix<T, 4, 4, layout == Layout::RowMajor ? Eigen::RowMajor : Eigen::ColMajor>;
+        size_t mismatches = 0;
+        for (const std::vector<float>& pose : poses)
+        {
+            const Matrix expected = Reference(pose, axes).template cast<T>();
+            T converted[kTransformSize];
+            Convert<layout, axes, T>(pose.data(), converted);
+            for (size_t i = 0; i < kTransformSize; ++i)
+            {
+                if (converted[i] != expected.data()[i])
+                {
+                    mismatches++;
+                    break;
+                }
+            }
+        }
+        return mismatches;
+    }
+
+    template <CameraAxes axes>
+    void CheckCompactForms(const std::vector<std::vector<float>>& poses)
+    {
+        size_t matrixMismatches = 0;
+        size_t quaternionMismatches = 0;
+        size_t negativeW = 0;
+        for (const std::vector<float>& pose : poses)
+        {
+            const Eigen::Matrix4d expected = Reference(pose, axes);
+
+            float matrix3x4[kMatrix3x4Size];
+            ToMatrix3x4<axes, float>(pose.data(), matrix3x4);
+            double fromMatrix[kTransformSize];
+            FromMatrix3x4(matrix3x4, fromMatrix);
+            if (Eigen::Map<const Eigen::Matrix<double, 4, 4, Eigen::RowMajor>>(fromMatrix) != Eigen::Matrix<double, 4, 4, Eigen::RowMajor>(expected))
+            {
+                matrixMismatches++;
+            }
+
+            // Compared with Eigen on the closest rotation to the matrix, up to the sign of the
+            // quaternion: the skewed poses are off by the order of their skew
+            float rotation[4];
+            float translation[3];
+            ToQuaternionTranslation<axes>(pose.data(), rotation, translation);
+            const Eigen::JacobiSVD<Eigen::Matrix3d> svd(expected.topLeftCorner<3, 3>(), Eigen::ComputeFullU | Eigen::ComputeFullV);
+            const Eigen::Quaterniond reference(Eigen::Matrix3d(svd.matrixU() * svd.matrixV().transpose()));
+            const Eigen::Vector4d q(rotation[0], rotation[1], rotation[2], rotation[3]);
+            const double distance = std::min((q - reference.coeffs()).norm(), (q + reference.coeffs()).norm());
+            if (distance > 5e-4 || std::abs(q.norm() - 1.) > 1e-6 ||
+                Eigen::Vector3d(translation[0], translation[1], translation[2]) != expected.topRightCorner<3, 1>())
+            {
+                quaternionMismatches++;
+            }
+            if (rotation[3] < 0.f)
+            {
+                negativeW++;
+            }
+
+            float fromQuaternion[kTransformSize];
+            FromQuaternionTranslation(rotation, translation, fromQuaternion);
+            const Eigen::Map<const Eigen::Matrix<float, 4, 4, Eigen::RowMajor>> rebuilt(fromQuaternion);
+            if (!rebuilt.isApprox(expected.cast<float>(), 1e-3f))
+            {
+                quaternionMismatches++;
+            }
+        }
+        CHECK_EQUAL(matrixMismatches, 0u);
+        CHECK_EQUAL(quaternionMismatches, 0u);
+        CHECK_EQUAL(negativeW, 0u);
+    }
+}
+
+TEST_CASE(ConvertMatchesEigenForEveryVariant)
+{
+    const std::vector<std::vector<float>> poses = GetPoses();
+    CHECK_EQUAL((CountMismatches<Layout::RowMajor, CameraAxes::HoloLens, float>(poses)), 0u);
+    CHECK_EQUAL((CountMismatches<Layout::RowMajor, CameraAxes::HoloLens, double>(poses)), 0u);
+    CHECK_EQUAL((CountMismatches<Layout::RowMajor, CameraAxes::OpenCV, float>(poses)), 0u);
+    CHECK_EQUAL((CountMismatches<Layout::RowMajor, CameraAxes::OpenCV, double>(poses)), 0u);
+    CHECK_EQUAL((CountMismatches<Layout::ColumnMajor, CameraAxes::HoloLens, float>(poses)), 0u);
+    CHECK_EQUAL((CountMismatches<Layout::ColumnMajor, CameraAxes::HoloLens, double>(poses)), 0u);
+    CHECK_EQUAL((CountMismatches<Layout::ColumnMajor, CameraAxes::OpenCV, float>(poses)), 0u);
+    CHECK_EQUAL((CountMismatches<Layout::ColumnMajor, CameraAxes::OpenCV, double>(poses)), 0u);
+}
+
+TEST_CASE(SolARPoseAndBatch)
+{
+    const std::vector<std::vector<float>> poses = GetPoses();
+    std::vector<float> packed;
+    for (const std::vector<float>& pose : poses)
+    {
+        packed.insert(packed.end(), pose.begin(), pose.end());
+    }
+    std::vector<double> batch(packed.size());
+    ConvertBatch<Layout::RowMajor, CameraAxes::OpenCV, double>(packed.data(), poses.size(), batch.data());
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < poses.size(); ++i)
+    {
+        double solar[kTransformSize];
+        ToSolARPose(poses[i].data(), solar);
+        const Eigen::Matrix<double, 4, 4, Eigen::RowMajor> expected = Reference(poses[i], CameraAxes::OpenCV);
+        for (size_t j = 0; j < kTransformSize; ++j)
+        {
+            if (solar[j] != expected.data()[j] || batch[i * kTransformSize + j] != solar[j])
+            {
+                mismatches++;
+                break;
+            }
+        }
+    }
+    CHECK_EQUAL(mismatches, 0u);
+}
+
+TEST_CASE(CompactFormsMatchEigen)
+{
+    const std::vector<std::vector<float>> poses = GetPoses();
+    CheckCompactForms<CameraAxes::HoloLens>(poses);
+    CheckCompactForms<CameraAxes::OpenCV>(poses);
+}
+
+TEST_MAIN()
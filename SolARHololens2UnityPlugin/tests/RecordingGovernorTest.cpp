@@ -0,0 +1,307 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Governor decisions on synthetic periods of one second: bytes submitted per stream, bytes
+// written by the storage and writer queue depth, as RecordingSession reports them.
+
+#include "RecordingGovernor.h"
+#include "TestCheck.h"
+
+#include <utility>
+
+namespace
+{
+    constexpr size_t kPendingCapacity = 1000;
+
+    // PV and depth have a codec, highest priority first
+    const std::vector<SharedStream> kPriority = { SharedStream::PV, SharedStream::LEFT_FRONT, SharedStream::DEPTH };
+    const std::vector<SharedStream> kCanCompress = { SharedStream::PV, SharedStream::DEPTH };
+
+    using StreamInput = std::vector<std::pair<SharedStream, size_t>>;
+
+    class Driver
+    {
+    public:
+        explicit Driver(const RecordingGovernorSettings& settings = RecordingGovernorSettings())
+            : m_governor(settings)
+        {
+            m_governor.SetPriority(kPriority, kCanCompress);
+        }
+
+        RecordingGovernor& Governor() { return m_governor; }
+
+        // One second: each stream submits its bytes, the storage writes writeBytes and pending bytes
+        // wait in the writer queue. Return the events of the period.
+        std::vector<RecordingGovernorEvent> Step(const StreamInput& input, uint64_t writeBytes, size_t pendingBytes)
+        {
+            for (const auto& [stream, bytes] : input)
+            {
+                m_governor.AddInput(stream, bytes);
+            }
+            m_writtenBytes += writeBytes;
+            std::vector<RecordingGovernorEvent> events;
+            m_governor.Update(1., m_writtenBytes, pendingBytes, kPendingCapacity, events);
+            return events;
+        }
+
+        // Steps until an event, at most maxSteps. Number of steps, 0 if none.
+        size_t StepUntilEvent(const StreamInput& input, uint64_t writeBytes, size_t pendingBytes, size_t maxSteps,
+                              RecordingGovernorEvent& event)
+        {
+            for (size_t step = 1; step <= maxSteps; ++step)
+            {
+                const std::vector<RecordingGovernorEvent> events = Step(input, writeBytes, pendingBytes);
+                if (!events.empty())
+                {
+                    event = events.front();
+                    return step;
+                }
+            }
+            return 0;
+        }
+
+    private:
+        RecordingGovernor m_governor;
+        uint64_t m_writtenBytes = 0;
+    };
+
+    const StreamInput kInput = { { SharedStream::PV, 400 }, { SharedStream::LEFT_FRONT, 200 }, { SharedStream::DEPTH, 100 } };
+
+    bool Matches(const RecordingGovernorEvent& event, SharedStream stream, RecordingGovernorReason reason, uint32_t level)
+    {
+        const bool canCompress = stream == SharedStream::PV || stream == SharedStream::DEPTH;
+        const RecordingStreamQuality quality = RecordingGovernor::GetLevelQuality(level, canCompress);
+        return event.stream == static_cast<uint16_t>(stream) && event.reason == reason && event.level == level &&
+               event.compress == (quality.compress ? 1u : 0u) && event.keepEveryNth == quality.keepEveryNth &&
+               event.resolutionDivisor == quality.resolutionDivisor;
+    }
+
+    bool IsQuality(const RecordingStreamQuality& quality, uint32_t level, bool compress, uint32_t keepEveryNth, uint32_t resolutionDivisor)
+    {
+        return quality.level == level && quality.compress == compress && quality.keepEveryNth == keepEveryNth &&
+               quality.resolutionDivisor == resolutionDivisor;
+    }
+}
+
+TEST_CASE(LevelQuality)
+{
+    // With a codec, level 1 is lossless compression, the frame rate and resolution levels follow
+    CHECK(IsQuality(RecordingGovernor::GetLevelQuality(0, true), 0, false, 1, 1));
+    CHECK(IsQuality(RecordingGovernor::GetLevelQuality(1, true), 1, true, 1, 1));
+    CHECK(IsQuality(RecordingGovernor::GetLevelQuality(2, true), 2, true, 2, 1));
+    CHECK(IsQuality(RecordingGovernor::GetLevelQuality(3, true), 3, true, 2, 2));
+    CHECK(IsQuality(RecordingGovernor::GetLevelQuality(4, true), 4, true, 4, 2));
+    CHECK(IsQuality(RecordingGovernor::GetLevelQuality(5, true), 5, true, 8, 2));
+
+    // Without, the same steps one level earlier
+    CHECK(IsQuality(RecordingGovernor::GetLevelQuality(0, false), 0, false, 1, 1));
+    CHECK(IsQuality(RecordingGovernor::GetLevelQuality(1, false), 1, false, 2, 1));
+    CHECK(IsQuality(RecordingGovernor::GetLevelQuality(2, false), 2, false, 2, 2));
+    CHECK(IsQuality(RecordingGovernor::GetLevelQuality(3, false), 3, false, 4, 2));
+    CHECK(IsQuality(RecordingGovernor::GetLevelQuality(4, false), 4, false, 8, 2));
+
+    // One more level with a codec, both ending on the same frame rate and resolution
+    CHECK_EQUAL(RecordingGovernor::GetMaxLevel(true), 5u);
+    CHECK_EQUAL(RecordingGovernor::GetMaxLevel(false), 4u);
+    for (uint32_t level = 0; level < RecordingGovernor::GetMaxLevel(false); ++level)
+    {
+        const RecordingStreamQuality withCodec = RecordingGovernor::GetLevelQuality(level + 1, true);
+        const RecordingStreamQuality withoutCodec = RecordingGovernor::GetLevelQuality(level, false);
+        CHECK(withCodec.keepEveryNth == withoutCodec.keepEveryNth && withCodec.resolutionDivisor == withoutCodec.resolutionDivisor);
+    }
+
+    // Past the last level, clamped
+    CHECK(IsQuality(RecordingGovernor::GetLevelQuality(9, true), 9, true, 8, 2));
+    CHECK(IsQuality(RecordingGovernor::GetLevelQuality(9, false), 9, false, 8, 2));
+}
+
+TEST_CASE(DegradeLowestPriorityFirst)
+{
+    Driver driver;
+    // The writer keeps up, but its queue is over highWatermark: one level per period
+    std::vector<std::pair<SharedStream, uint32_t>> expected;
+    for (uint32_t level = 1; level <= 5; ++level)
+    {
+        expected.push_back({ SharedStream::DEPTH, level });
+    }
+    for (uint32_t level = 1; level <= 4; ++level)
+    {
+        expected.push_back({ SharedStream::LEFT_FRONT, level });
+    }
+    for (uint32_t level = 1; level <= 5; ++level)
+    {
+        expected.push_back({ SharedStream::PV, level });
+    }
+
+    bool isOrdered = true;
+    for (const auto& [stream, level] : expected)
+    {
+        const std::vector<RecordingGovernorEvent> events = driver.Step(kInput, 700, 600);
+        isOrdered &= events.size() == 1 && Matches(events.front(), stream, RecordingGovernorReason::QueueFull, level);
+    }
+    CHECK(isOrdered);
+    CHECK_EQUAL(driver.Governor().GetAdjustmentCount(), 14u);
+    CHECK(IsQuality(driver.Governor().GetQuality(SharedStream::DEPTH), 5, true, 8, 2));
+    CHECK(IsQuality(driver.Governor().GetQuality(SharedStream::LEFT_FRONT), 4, false, 8, 2));
+
+    // Every stream at its last level
+    CHECK(driver.Step(kInput, 700, 600).empty());
+    CHECK_EQUAL(driver.Governor().GetAdjustmentCount(), 14u);
+}
+
+TEST_CASE(EventContents)
+{
+    Driver driver;
+    const std::vector<RecordingGovernorEvent> events = driver.Step(kInput, 650, 700);
+    CHECK_EQUAL(events.size(), 1u);
+    const RecordingGovernorEvent& event = events.front();
+    CHECK(Matches(event, SharedStream::DEPTH, RecordingGovernorReason::QueueFull, 1));
+    CHECK_EQUAL(event.writeBytesPerSecond, 650u);
+    CHECK_EQUAL(event.inputBytesPerSecond, 700u);
+    // Bandwidth of depth before it was degraded
+    CHECK_EQUAL(event.streamBytesPerSecond, 100u);
+    CHECK_EQUAL(event.pendingBytes, 700u);
+    CHECK_EQUAL(driver.Governor().GetWriteBytesPerSecond(), 650u);
+}
+
+TEST_CASE(IdleStreamsAreSkipped)
+{
+    // Depth submits nothing: degrading it would not help
+    Driver driver;
+    const StreamInput input = { { SharedStream::PV, 400 }, { SharedStream::LEFT_FRONT, 200 } };
+    const std::vector<RecordingGovernorEvent> events = driver.Step(input, 600, 600);
+    CHECK(events.size() == 1 && Matches(events.front(), SharedStream::LEFT_FRONT, RecordingGovernorReason::QueueFull, 1));
+    CHECK_EQUAL(driver.Governor().GetQuality(SharedStream::DEPTH).level, 0u);
+    // Not governed streams stay at full quality
+    driver.Governor().AddInput(SharedStream::IMU_GYRO, 1000);
+    CHECK_EQUAL(driver.Governor().GetQuality(SharedStream::IMU_GYRO).level, 0u);
+}
+
+TEST_CASE(Backlog)
+{
+    Driver driver;
+    // Streams produce 700 B/s, the storage writes 500 B/s: the queue grows
+    CHECK(driver.Step(kInput, 500, 200).empty());
+    const std::vector<RecordingGovernorEvent> events = driver.Step(kInput, 500, 400);
+    CHECK(events.size() == 1 && Matches(events.front(), SharedStream::DEPTH, RecordingGovernorReason::Backlog, 1));
+
+    // Within measurement noise of the write bandwidth: not a backlog
+    Driver noise;
+    CHECK(noise.Step(kInput, 680, 200).empty());
+    CHECK(noise.Step(kInput, 680, 300).empty());
+
+    // Queue below lowWatermark: not a backlog yet
+    Driver low;
+    CHECK(low.Step(kInput, 500, 50).empty());
+    CHECK(low.Step(kInput, 500, 100).empty());
+}
+
+TEST_CASE(RestoreHighestPriorityFirst)
+{
+    RecordingGovernorSettings settings;
+    settings.restorePeriods = 3;
+    Driver driver(settings);
+    // PV to level 1, the others to their last level
+    for (int i = 0; i < 10; ++i)
+    {
+        driver.Step(kInput, 700, 600);
+    }
+    CHECK_EQUAL(driver.Governor().GetQuality(SharedStream::PV).level, 1u);
+
+    // The writer keeps up with an empty queue: one level every restorePeriods periods
+    std::vector<std::pair<SharedStream, uint32_t>> expected = { { SharedStream::PV, 0 } };
+    for (uint32_t level = 4; level-- > 0;)
+    {
+        expected.push_back({ SharedStream::LEFT_FRONT, level });
+    }
+    for (uint32_t level = 5; level-- > 0;)
+    {
+        expected.push_back({ SharedStream::DEPTH, level });
+    }
+    bool isOrdered = true;
+    for (const auto& [stream, level] : expected)
+    {
+        RecordingGovernorEvent event{};
+        isOrdered &= driver.StepUntilEvent(kInput, 700, 0, 10, event) == settings.restorePeriods &&
+                     Matches(event, stream, RecordingGovernorReason::Recovered, level);
+    }
+    CHECK(isOrdered);
+
+    // All restored
+    RecordingGovernorEvent event{};
+    CHECK_EQUAL(driver.StepUntilEvent(kInput, 700, 0, 10, event), 0u);
+}
+
+TEST_CASE(RestoreNeedsConsecutiveCalmPeriods)
+{
+    RecordingGovernorSettings settings;
+    settings.restorePeriods = 3;
+    Driver driver(settings);
+    driver.Step(kInput, 700, 600);
+
+    // A queue at lowWatermark or growing starts the count again
+    CHECK(driver.Step(kInput, 700, 0).empty());
+    CHECK(driver.Step(kInput, 700, 0).empty());
+    CHECK(driver.Step(kInput, 700, 150).empty());
+    CHECK(driver.Step(kInput, 700, 0).empty());
+    CHECK(driver.Step(kInput, 700, 0).empty());
+    CHECK(driver.Step(kInput, 700, 10).empty());
+    CHECK(driver.Step(kInput, 700, 0).empty());
+    CHECK(driver.Step(kInput, 700, 0).empty());
+    const std::vector<RecordingGovernorEvent> events = driver.Step(kInput, 700, 0);
+    CHECK(events.size() == 1 && Matches(events.front(), SharedStream::DEPTH, RecordingGovernorReason::Recovered, 0));
+}
+
+TEST_CASE(Budget)
+{
+    RecordingGovernorSettings settings;
+    settings.budgetBytesPerSecond = 1000;
+    settings.restorePeriods = 3;
+
+    // At the budget is not over it
+    Driver atBudget(settings);
+    CHECK(atBudget.Step({ { SharedStream::PV, 1000 } }, 2000, 0).empty());
+
+    Driver driver(settings);
+    const StreamInput over = { { SharedStream::PV, 800 }, { SharedStream::DEPTH, 400 } };
+    std::vector<RecordingGovernorEvent> events = driver.Step(over, 2000, 0);
+    CHECK(events.size() == 1 && Matches(events.front(), SharedStream::DEPTH, RecordingGovernorReason::Budget, 1));
+    CHECK_EQUAL(events.front().inputBytesPerSecond, 1200u);
+}
+
+TEST_CASE(BudgetRestoreHysteresis)
+{
+    RecordingGovernorSettings settings;
+    settings.budgetBytesPerSecond = 1000;
+    settings.restorePeriods = 3;
+    Driver driver(settings);
+
+    // Degraded for a full queue, while streams produce 800 B/s, within the budget
+    const StreamInput within = { { SharedStream::PV, 600 }, { SharedStream::DEPTH, 200 } };
+    CHECK_EQUAL(driver.Step(within, 2000, 600).size(), 1u);
+
+    // 800 B/s is over 70% of the budget: restoring a level could exceed it, never restored
+    RecordingGovernorEvent event{};
+    CHECK_EQUAL(driver.StepUntilEvent(within, 2000, 0, 20, event), 0u);
+
+    // At 600 B/s, the smoothed bandwidth goes 740, 698, 668.6...: under 70% from the second period,
+    // restored after restorePeriods such periods
+    const StreamInput below = { { SharedStream::PV, 450 }, { SharedStream::DEPTH, 150 } };
+    CHECK_EQUAL(driver.StepUntilEvent(below, 2000, 0, 20, event), 4u);
+    CHECK(Matches(event, SharedStream::DEPTH, RecordingGovernorReason::Recovered, 0));
+}
+
+TEST_MAIN()
@@ -0,0 +1,264 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Round trips of the sequence lock ring through POSIX shared memory, with the producer in a
+// child process as the plugin is for its consumers
+
+#include "SharedMemoryRing.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr uint32_t kSlotCount = 8;
+    constexpr uint32_t kSlotCapacity = 256;
+    constexpr uint32_t kRecordType = 42;
+
+    // Unique per test run, tests may run in parallel
+    std::string GetRingName(const char* test)
+    {
+        return std::string("SolARHL2Test_") + test + "_" + std::to_string(getpid());
+    }
+
+    // Payload of record: its size varies with the record, every byte is derived from the record
+    uint32_t GetPayload(uint64_t record, std::vector<uint8_t>& payload)
+    {
+        payload.resize(16 + record % (kSlotCapacity - 16));
+        for (size_t i = 0; i < payload.size(); ++i)
+        {
+            payload[i] = static_cast<uint8_t>(record * 31 + i);
+        }
+        return static_cast<uint32_t>(payload.size());
+    }
+
+    bool IsPayload(uint64_t record, const uint8_t* data, uint32_t size)
+    {
+        std::vector<uint8_t> expected;
+        return GetPayload(record, expected) == size && std::memcmp(expected.data(), data, size) == 0;
+    }
+
+    bool OpenWhenCreated(SharedMemoryRingReader& reader, const std::string& name)
+    {
+        for (int i = 0; i < 500; ++i)
+        {
+            if (reader.Open(name))
+            {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+    }
+
+    struct Producer
+    {
+        pid_t process = -1;
+        int stopPipe = -1;
+    };
+
+    // Child process writing records 1 to count as fast as it can, then keeping the ring until
+    // Stop(), since the name is removed with its producer. With exitWithRing, it exits right away
+    // without closing the ring, as a crashed producer.
+    Producer StartProducer(const std::string& name, uint64_t count, bool exitWithRing)
+    {
+        int pipes[2] = { -1, -1 };
+        if (pipe(pipes) != 0)
+        {
+            return Producer();
+        }
+        const pid_t child = fork();
+        if (child != 0)
+        {
+            close(pipes[0]);
+            return Producer{ child, pipes[1] };
+        }
+
+        close(pipes[1]);
+        SharedMemoryRingWriter writer;
+        if (!writer.Create(name, kSlotCount, kSlotCapacity, kRecordType))
+        {
+            _exit(1);
+        }
+        std::vector<uint8_t> payload;
+        for (uint64_t record = 1; record <= count; ++record)
+        {
+            const uint32_t size = GetPayload(record, payload);
+            if (!writer.Write(1000 + record, payload.data(), size))
+            {
+                _exit(2);
+            }
+        }
+        if (!exitWithRing)
+        {
+            char unused;
+            while (read(pipes[0], &unused, 1) > 0)
+            {
+            }
+            writer.Close();
+        }
+        _exit(0);
+    }
+
+    // Whether the producer exited normally
+    bool Stop(Producer& producer)
+    {
+        close(producer.stopPipe);
+        int status = 0;
+        return waitpid(producer.process, &status, 0) == producer.process && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+}
+
+TEST_CASE(RoundTripAcrossProcesses)
+{
+    const std::string name = GetRingName("RoundTrip");
+    Producer producer = StartProducer(name, 20, false);
+
+    SharedMemoryRingReader reader;
+    CHECK(OpenWhenCreated(reader, name));
+    CHECK_EQUAL(reader.GetRecordType(), kRecordType);
+    CHECK_EQUAL(reader.GetSlotCount(), kSlotCount);
+    while (reader.GetLatestRecord() < 20)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // The slot after the latest one is not trusted: records 14 to 20 remain
+    CHECK_EQUAL(reader.GetOldestRecord(), 14u);
+    SharedRecordView view;
+    std::vector<uint8_t> data;
+    for (uint64_t record = 14; record <= 20; ++record)
+    {
+        CHECK(reader.Read(record, view, data));
+        CHECK_EQUAL(view.record, record);
+        CHECK_EQUAL(view.timestamp, 1000 + record);
+        CHECK(IsPayload(record, view.data, view.size));
+        // In place read of the same record
+        CHECK(reader.Peek(record, view));
+        CHECK(IsPayload(record, view.data, view.size) && reader.IsValid(view));
+    }
+    // Overwritten, and not written yet
+    CHECK(!reader.Read(12, view, data));
+    CHECK(!reader.Peek(21, view));
+    CHECK(!reader.Peek(0, view));
+
+    // Another producer cannot take a live ring over
+    SharedMemoryRingWriter writer;
+    CHECK(!writer.Create(name, kSlotCount, kSlotCapacity, kRecordType));
+
+    CHECK(Stop(producer));
+    // The name is removed with its producer, the mapping stays readable
+    SharedMemoryRingReader closedReader;
+    CHECK(!closedReader.Open(name));
+    CHECK(reader.Read(20, view, data));
+}
+
+TEST_CASE(StaleRingIsReplaced)
+{
+    const std::string name = GetRingName("Stale");
+    Producer producer = StartProducer(name, 3, true);
+    CHECK(Stop(producer));
+
+    // Producer exited without removing the name
+    SharedMemoryRingReader staleReader;
+    CHECK(staleReader.Open(name));
+    CHECK_EQUAL(staleReader.GetLatestRecord(), 3u);
+
+    SharedMemoryRingWriter writer;
+    CHECK(writer.Create(name, kSlotCount, kSlotCapacity, kRecordType));
+    SharedMemoryRingReader reader;
+    CHECK(reader.Open(name));
+    CHECK_EQUAL(reader.GetLatestRecord(), 0u);
+    // Readers of the stale region keep it until they reopen the name
+    CHECK_EQUAL(staleReader.GetLatestRecord(), 3u);
+    writer.Close();
+}
+
+TEST_CASE(SlotBeingWrittenIsRejected)
+{
+    const std::string name = GetRingName("Pending");
+    SharedMemoryRingWriter writer;
+    CHECK(writer.Create(name, kSlotCount, kSlotCapacity, kRecordType));
+    CHECK(writer.BeginWrite(kSlotCapacity + 1) == nullptr);
+    SharedMemoryRingReader reader;
+    CHECK(reader.Open(name));
+
+    std::vector<uint8_t> payload;
+    for (uint64_t record = 1; record <= kSlotCount; ++record)
+    {
+        const uint32_t size = GetPayload(record, payload);
+        CHECK(writer.Write(record, payload.data(), size));
+    }
+
+    // Record 1 read in place while its slot is reused for record 9
+    SharedRecordView view;
+    CHECK(reader.Peek(1, view));
+    const uint32_t size = GetPayload(kSlotCount + 1, payload);
+    uint8_t* pPayload = writer.BeginWrite(size);
+    CHECK(pPayload != nullptr);
+    CHECK(!reader.IsValid(view));
+    CHECK(!reader.Peek(1, view));
+    CHECK(!reader.Peek(kSlotCount + 1, view));
+    CHECK_EQUAL(reader.GetLatestRecord(), static_cast<uint64_t>(kSlotCount));
+
+    std::memcpy(pPayload, payload.data(), size);
+    writer.Commit(kSlotCount + 1);
+    CHECK(reader.Peek(kSlotCount + 1, view));
+    CHECK(IsPayload(kSlotCount + 1, view.data, view.size));
+    writer.Close();
+}
+
+TEST_CASE(ConcurrentReadsAreNeverTorn)
+{
+    const std::string name = GetRingName("Concurrent");
+    constexpr uint64_t kRecordCount = 200'000;
+    Producer producer = StartProducer(name, kRecordCount, false);
+
+    SharedMemoryRingReader reader;
+    CHECK(OpenWhenCreated(reader, name));
+    SharedRecordView view;
+    std::vector<uint8_t> data;
+    uint64_t readCount = 0;
+    uint64_t tornCount = 0;
+    uint64_t last = 0;
+    while (last < kRecordCount)
+    {
+        const uint64_t latest = reader.GetLatestRecord();
+        for (uint64_t record = std::max(last + 1, reader.GetOldestRecord()); record <= latest; ++record)
+        {
+            if (reader.Read(record, view, data))
+            {
+                readCount++;
+                if (view.timestamp != 1000 + record || !IsPayload(record, view.data, view.size))
+                {
+                    tornCount++;
+                }
+            }
+        }
+        last = std::max(last, latest);
+    }
+    CHECK(readCount > 0);
+    CHECK_EQUAL(tornCount, 0u);
+    CHECK(Stop(producer));
+}
+
+TEST_MAIN()
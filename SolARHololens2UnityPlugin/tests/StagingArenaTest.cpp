@@ -0,0 +1,280 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Staging arena of 16-byte pages, so that records span several pages, written to a sink in memory
+
+#include "StagingArena.h"
+#include "TestCheck.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    constexpr size_t kPageSize = 16;
+
+    class MemorySink : public StagingSink
+    {
+    public:
+        struct WrittenRecord
+        {
+            std::string name;
+            std::vector<uint8_t> data;
+            size_t pieceCount;
+        };
+
+        void WriteRecord(const std::string& name, const std::vector<StagingPiece>& pieces, size_t dataSize) override
+        {
+            std::vector<uint8_t> data;
+            for (const StagingPiece& piece : pieces)
+            {
+                data.insert(data.end(), piece.pData, piece.pData + piece.size);
+            }
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_records.push_back({ name, data, pieces.size() });
+            m_isSizeConsistent &= data.size() == dataSize;
+        }
+
+        std::vector<WrittenRecord> GetRecords()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_records;
+        }
+
+        std::vector<std::string> GetNames()
+        {
+            std::vector<std::string> names;
+            for (const WrittenRecord& record : GetRecords())
+            {
+                names.push_back(record.name);
+            }
+            return names;
+        }
+
+        bool IsSizeConsistent()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_isSizeConsistent;
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::vector<WrittenRecord> m_records;
+        bool m_isSizeConsistent = true;
+    };
+
+    StagingArenaSettings GetSettings(size_t pageCount, StagingFlushMode flushMode, StagingOverflowPolicy overflowPolicy)
+    {
+        StagingArenaSettings settings;
+        settings.budgetBytes = pageCount * kPageSize;
+        settings.pageSize = kPageSize;
+        settings.flushMode = flushMode;
+        settings.overflowPolicy = overflowPolicy;
+        return settings;
+    }
+
+    std::vector<uint8_t> GetData(size_t size, uint8_t seed)
+    {
+        std::vector<uint8_t> data(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            data[i] = static_cast<uint8_t>(seed + i * 7);
+        }
+        return data;
+    }
+
+    bool Stage(StagingArena& arena, const std::shared_ptr<StagingSink>& sink, const std::string& name, size_t dataSize)
+    {
+        const std::vector<uint8_t> data = GetData(dataSize, static_cast<uint8_t>(name[0]));
+        return arena.Stage(sink, name, data.data(), data.size());
+    }
+
+    bool IsWritten(const MemorySink::WrittenRecord& record, const std::string& name, size_t dataSize)
+    {
+        return record.name == name && record.data == GetData(dataSize, static_cast<uint8_t>(name[0]));
+    }
+}
+
+TEST_CASE(PageChains)
+{
+    StagingArena arena(GetSettings(10, StagingFlushMode::AfterStop, StagingOverflowPolicy::DropNewest));
+    auto sink = std::make_shared<MemorySink>();
+
+    // Name and data of a record share its pages: "A" and 40 bytes take 3 pages
+    CHECK(Stage(arena, sink, "A", 40));
+    CHECK(Stage(arena, sink, "B", 15));      // exactly one page
+    CHECK(Stage(arena, sink, "Cname", 0));
+    CHECK(Stage(arena, sink, "D", 79));      // exactly 5 pages, the arena is full
+    CHECK(!Stage(arena, sink, "E", 0));
+    StagingArenaStats stats = arena.GetStats();
+    CHECK_EQUAL(stats.stagedRecords, 4u);
+    CHECK_EQUAL(stats.stagedBytes, 41u + 16u + 5u + 80u);
+    CHECK_EQUAL(stats.peakStagedBytes, stats.stagedBytes);
+
+    arena.Flush();
+    const std::vector<MemorySink::WrittenRecord> records = sink->GetRecords();
+    CHECK_EQUAL(records.size(), 4u);
+    CHECK(IsWritten(records[0], "A", 40) && records[0].pieceCount == 3);
+    CHECK(IsWritten(records[1], "B", 15) && records[1].pieceCount == 1);
+    CHECK(IsWritten(records[2], "Cname", 0) && records[2].pieceCount == 0);
+    CHECK(IsWritten(records[3], "D", 79) && records[3].pieceCount == 5);
+    CHECK(sink->IsSizeConsistent());
+
+    stats = arena.GetStats();
+    CHECK_EQUAL(stats.stagedBytes, 0u);
+    CHECK_EQUAL(stats.flushedRecords, 4u);
+    CHECK_EQUAL(stats.flushedBytes, 40u + 15u + 0u + 79u);
+
+    // Every page is free again: a record of the whole budget fits
+    CHECK(Stage(arena, sink, "F", 10 * kPageSize - 1));
+    CHECK(!Stage(arena, sink, "G", 0));
+    arena.Flush();
+    CHECK(IsWritten(sink->GetRecords().back(), "F", 10 * kPageSize - 1));
+}
+
+TEST_CASE(DropOldest)
+{
+    StagingArena arena(GetSettings(10, StagingFlushMode::AfterStop, StagingOverflowPolicy::DropOldest));
+    auto sink = std::make_shared<MemorySink>();
+    CHECK(Stage(arena, sink, "A", 40));      // pages 0 to 2
+    CHECK(Stage(arena, sink, "B", 40));      // 3 to 5
+    CHECK(Stage(arena, sink, "C", 40));      // 6 to 8
+    // 4 pages: A is evicted, D takes its pages and the last one, not contiguous
+    CHECK(Stage(arena, sink, "D", 60));
+    // 2 pages: B is evicted, one of its pages stays free
+    CHECK(Stage(arena, sink, "E", 20));
+
+    StagingArenaStats stats = arena.GetStats();
+    CHECK_EQUAL(stats.overflows, 2u);
+    CHECK_EQUAL(stats.droppedRecords, 2u);
+    CHECK_EQUAL(stats.stagedRecords, 5u);
+    CHECK_EQUAL(stats.stagedBytes, 41u + 61u + 21u);
+
+    arena.Flush();
+    const std::vector<MemorySink::WrittenRecord> records = sink->GetRecords();
+    CHECK(sink->GetNames() == std::vector<std::string>({ "C", "D", "E" }));
+    CHECK(IsWritten(records[0], "C", 40));
+    CHECK(IsWritten(records[1], "D", 60));
+    CHECK(IsWritten(records[2], "E", 20));
+    CHECK(sink->IsSizeConsistent());
+
+    // Larger than the budget: dropped, even with every page free
+    CHECK(!Stage(arena, sink, "F", 10 * kPageSize));
+    stats = arena.GetStats();
+    CHECK_EQUAL(stats.overflows, 3u);
+    CHECK_EQUAL(stats.droppedRecords, 3u);
+}
+
+TEST_CASE(StrictBudget)
+{
+    // The budget is rounded down to whole pages
+    StagingArenaSettings settings = GetSettings(4, StagingFlushMode::AfterStop, StagingOverflowPolicy::DropNewest);
+    settings.budgetBytes += kPageSize - 1;
+    StagingArena arena(settings);
+    auto sink = std::make_shared<MemorySink>();
+    CHECK_EQUAL(arena.GetStats().budgetBytes, 4 * kPageSize);
+
+    // The first records are kept, the next ones dropped until there is room
+    CHECK(Stage(arena, sink, "A", 31));
+    CHECK(!Stage(arena, sink, "B", 40));
+    CHECK(Stage(arena, sink, "C", 20));
+    CHECK(!Stage(arena, sink, "D", 0));
+    StagingArenaStats stats = arena.GetStats();
+    CHECK_EQUAL(stats.overflows, 2u);
+    CHECK_EQUAL(stats.droppedRecords, 2u);
+    CHECK(stats.peakStagedBytes <= stats.budgetBytes);
+    arena.Flush();
+    CHECK(sink->GetNames() == std::vector<std::string>({ "A", "C" }));
+}
+
+TEST_CASE(WriteThrough)
+{
+    StagingArena arena(GetSettings(4, StagingFlushMode::AfterStop, StagingOverflowPolicy::WriteThrough));
+    auto sink = std::make_shared<MemorySink>();
+    CHECK(Stage(arena, sink, "A", 40));
+    // Does not fit: written by the calling thread, before the staged record
+    CHECK(Stage(arena, sink, "B", 40));
+    CHECK(sink->GetNames() == std::vector<std::string>({ "B" }));
+    CHECK(IsWritten(sink->GetRecords()[0], "B", 40));
+
+    StagingArenaStats stats = arena.GetStats();
+    CHECK_EQUAL(stats.overflows, 1u);
+    CHECK_EQUAL(stats.writtenThroughRecords, 1u);
+    CHECK_EQUAL(stats.droppedRecords, 0u);
+    CHECK_EQUAL(stats.stagedRecords, 1u);
+    arena.Flush();
+    CHECK(sink->GetNames() == std::vector<std::string>({ "B", "A" }));
+}
+
+TEST_CASE(FlushAfterStop)
+{
+    auto sink = std::make_shared<MemorySink>();
+    {
+        StagingArena arena(GetSettings(64, StagingFlushMode::AfterStop, StagingOverflowPolicy::DropNewest));
+        for (char name = 'A'; name <= 'H'; ++name)
+        {
+            CHECK(Stage(arena, sink, std::string(1, name), 50));
+        }
+        // Nothing is written during the capture
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(sink->GetRecords().empty());
+
+        // Flush() returns once every record is written
+        arena.Flush();
+        CHECK(sink->GetNames() == std::vector<std::string>({ "A", "B", "C", "D", "E", "F", "G", "H" }));
+        CHECK_EQUAL(arena.GetStats().flushedRecords, 8u);
+
+        // Records staged after Flush() are deferred again, then written by the destructor
+        CHECK(Stage(arena, sink, "I", 50));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK_EQUAL(sink->GetRecords().size(), 8u);
+    }
+    CHECK_EQUAL(sink->GetRecords().size(), 9u);
+    CHECK(IsWritten(sink->GetRecords().back(), "I", 50));
+    CHECK(sink->IsSizeConsistent());
+}
+
+TEST_CASE(Background)
+{
+    StagingArena arena(GetSettings(8, StagingFlushMode::Background, StagingOverflowPolicy::WriteThrough));
+    auto first = std::make_shared<MemorySink>();
+    auto second = std::make_shared<MemorySink>();
+    // Many more records than pages: written as they come, pages reused
+    for (int i = 0; i < 200; ++i)
+    {
+        CHECK(Stage(arena, i % 2 ? second : first, std::string(1, static_cast<char>('a' + i % 26)), 3 * kPageSize));
+    }
+    arena.Flush();
+    CHECK_EQUAL(first->GetRecords().size() + second->GetRecords().size(), 200u);
+    const StagingArenaStats stats = arena.GetStats();
+    CHECK_EQUAL(stats.flushedRecords + stats.writtenThroughRecords, 200u);
+    CHECK_EQUAL(stats.stagedBytes, 0u);
+    CHECK(stats.peakStagedBytes <= stats.budgetBytes);
+    CHECK(first->IsSizeConsistent() && second->IsSizeConsistent());
+
+    bool isIntact = true;
+    for (const auto& sink : { first, second })
+    {
+        for (const MemorySink::WrittenRecord& record : sink->GetRecords())
+        {
+            isIntact &= IsWritten(record, record.name, 3 * kPageSize);
+        }
+    }
+    CHECK(isIntact);
+}
+
+TEST_MAIN()
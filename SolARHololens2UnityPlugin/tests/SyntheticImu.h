@@ -0,0 +1,132 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Stand-in for a pair of ImuReader (IMU_GYRO and IMU_ACCEL) on Linux: samples of a synthetic
+// motion are pushed in batches into ImuSampleRing, with the clocks ImuReader::PushSamples()
+// gives them, either on demand or from a producer thread as the Research Mode update thread does.
+
+#include "ImuSampleRing.h"
+
+#include <Eigen/Dense>
+
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+// Angular rate (rad/s) and specific force (m/s^2) in the IMU frame, at a time in seconds from
+// the first sample
+struct SyntheticMotion
+{
+	std::function<Eigen::Vector3d(double)> angularRate;
+	std::function<Eigen::Vector3d(double)> specificForce;
+};
+
+class SyntheticImu
+{
+public:
+	// Host ticks (relative QPC) to absolute timestamp, in hundreds of nanoseconds
+	static constexpr uint64_t kAbsoluteOffset = 132'900'000'000'000'000;
+	// IMU clock (VinylHupTicks, nanoseconds) at host tick 0
+	static constexpr uint64_t kSensorOffset = 5'000'000'000;
+
+	SyntheticImu(SyntheticMotion motion, double gyroRateHz, double accelRateHz, uint64_t firstHostTicks,
+				 size_t ringCapacity = ImuSampleRing::kDefaultCapacity)
+		: m_motion(std::move(motion)),
+		  m_gyro(ringCapacity),
+		  m_accel(ringCapacity),
+		  m_gyroRateHz(gyroRateHz),
+		  m_accelRateHz(accelRateHz),
+		  m_firstHostTicks(firstHostTicks)
+	{
+	}
+
+	~SyntheticImu() { Stop(); }
+
+	// Host ticks of the sample at index (starting at 1) of a sensor sampled at rateHz
+	uint64_t HostTicksAt(uint64_t index, double rateHz) const
+	{
+		return m_firstHostTicks + static_cast<uint64_t>(std::llround(static_cast<double>(index - 1) * 1e7 / rateHz));
+	}
+
+	// Push the samples of both sensors up to hostTicks included
+	void GenerateUntil(uint64_t hostTicks)
+	{
+		while (HostTicksAt(m_gyro.LastIndex() + 1, m_gyroRateHz) <= hostTicks)
+		{
+			Push(m_gyro, m_gyroRateHz, m_motion.angularRate);
+		}
+		while (HostTicksAt(m_accel.LastIndex() + 1, m_accelRateHz) <= hostTicks)
+		{
+			Push(m_accel, m_accelRateHz, m_motion.specificForce);
+		}
+	}
+
+	// Producer thread pushing batches of batchSize gyroscope samples, and the accelerometer
+	// samples of the same period, as fast as the rings accept them
+	void Start(size_t batchSize)
+	{
+		Stop();
+		m_fExit = false;
+		m_producer = std::thread([this, batchSize]()
+		{
+			while (!m_fExit)
+			{
+				GenerateUntil(HostTicksAt(m_gyro.LastIndex() + batchSize, m_gyroRateHz));
+				std::this_thread::yield();
+			}
+		});
+	}
+
+	void Stop()
+	{
+		if (m_producer.joinable())
+		{
+			m_fExit = true;
+			m_producer.join();
+		}
+	}
+
+	const ImuSampleRing& Gyro() const { return m_gyro; }
+	const ImuSampleRing& Accel() const { return m_accel; }
+
+private:
+	void Push(ImuSampleRing& ring, double rateHz, const std::function<Eigen::Vector3d(double)>& value)
+	{
+		ImuSample sample;
+		sample.hostTicks = HostTicksAt(ring.LastIndex() + 1, rateHz);
+		sample.timestamp = sample.hostTicks + kAbsoluteOffset;
+		sample.sensorTicks = sample.hostTicks * 100 + kSensorOffset;
+		const Eigen::Vector3d values = value(static_cast<double>(sample.hostTicks - m_firstHostTicks) * 1e-7);
+		sample.x = static_cast<float>(values.x());
+		sample.y = static_cast<float>(values.y());
+		sample.z = static_cast<float>(values.z());
+		sample.temperature = 35.f;
+		ring.Push(sample);
+	}
+
+	SyntheticMotion m_motion;
+	ImuSampleRing m_gyro;
+	ImuSampleRing m_accel;
+	double m_gyroRateHz;
+	double m_accelRateHz;
+	uint64_t m_firstHostTicks;
+
+	std::atomic<bool> m_fExit = false;
+	std::thread m_producer;
+};
@@ -0,0 +1,344 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Priority classes and serial queues on an executor of one worker, so that the order of the tasks
+// is deterministic: a gate task holds the worker while the tested tasks are queued.
+
+#include "TaskExecutor.h"
+#include "TestCheck.h"
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr uint64_t kTicksPerMillisecond = 10'000;
+
+    // Task holding its worker until Open()
+    class Gate
+    {
+    public:
+        TaskExecutor::Task GetTask()
+        {
+            return [this]()
+            {
+                m_started.set_value();
+                m_opened.get_future().wait();
+            };
+        }
+
+        // Until the task runs
+        void WaitStarted() { m_started.get_future().wait(); }
+        void Open() { m_opened.set_value(); }
+
+    private:
+        std::promise<void> m_started;
+        std::promise<void> m_opened;
+    };
+
+    // Order in which the tasks ran
+    class RunLog
+    {
+    public:
+        TaskExecutor::Task GetTask(int id)
+        {
+            return [this, id]()
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_ids.push_back(id);
+            };
+        }
+
+        std::vector<int> GetIds()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_ids;
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::vector<int> m_ids;
+    };
+
+    void WaitIdle(TaskExecutor& executor, TaskPriority priority = TaskPriority::Background)
+    {
+        std::promise<void> done;
+        executor.Schedule(priority, [&done]() { done.set_value(); });
+        done.get_future().wait();
+    }
+}
+
+TEST_CASE(PriorityOrder)
+{
+    TaskExecutor executor(1);
+    CHECK_EQUAL(executor.GetThreadCount(), 1u);
+    Gate gate;
+    executor.Schedule(TaskPriority::Background, gate.GetTask());
+    gate.WaitStarted();
+
+    // Queued lowest class first, two tasks per class: id = 10 * class + rank
+    RunLog log;
+    for (int rank = 0; rank < 2; ++rank)
+    {
+        for (int priority = static_cast<int>(kTaskPriorityCount) - 1; priority >= 0; --priority)
+        {
+            executor.Schedule(static_cast<TaskPriority>(priority), log.GetTask(10 * priority + rank));
+        }
+    }
+    CHECK_EQUAL(executor.GetStats()[static_cast<size_t>(TaskPriority::Capture)].queued, 2u);
+    gate.Open();
+    WaitIdle(executor);
+
+    // Highest class first, submission order within a class
+    CHECK(log.GetIds() == std::vector<int>({ 0, 1, 10, 11, 20, 21, 30, 31 }));
+}
+
+TEST_CASE(RunningTaskNotPreempted)
+{
+    TaskExecutor executor(1);
+    Gate gate;
+    RunLog log;
+    executor.Schedule(TaskPriority::Background, gate.GetTask());
+    gate.WaitStarted();
+    executor.Schedule(TaskPriority::Background, log.GetTask(30));
+    executor.Schedule(TaskPriority::Capture, log.GetTask(0));
+    gate.Open();
+    WaitIdle(executor);
+    // The capture task overtakes the queued background task only
+    CHECK(log.GetIds() == std::vector<int>({ 0, 30 }));
+}
+
+TEST_CASE(SerialQueueOrder)
+{
+    // Several workers: the tasks of the queue still run in order, one at a time
+    TaskExecutor executor(4);
+    SerialTaskQueue queue(executor, TaskPriority::Recording);
+    RunLog log;
+    std::atomic<int> running{ 0 };
+    std::atomic<int> maxRunning{ 0 };
+    for (int id = 0; id < 200; ++id)
+    {
+        CHECK(queue.Schedule([&, id]()
+        {
+            const int count = ++running;
+            int max = maxRunning.load();
+            while (count > max && !maxRunning.compare_exchange_weak(max, count))
+            {
+            }
+            log.GetTask(id)();
+            std::this_thread::yield();
+            running--;
+        }));
+    }
+    queue.Wait();
+
+    const std::vector<int> ids = log.GetIds();
+    CHECK_EQUAL(ids.size(), 200u);
+    bool isOrdered = true;
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        isOrdered &= ids[i] == static_cast<int>(i);
+    }
+    CHECK(isOrdered);
+    CHECK_EQUAL(maxRunning.load(), 1);
+    CHECK_EQUAL(queue.GetRejectedCount(), 0u);
+}
+
+TEST_CASE(SerialQueueYieldsToHigherClasses)
+{
+    // Each task of the queue goes back to the executor queue: capture work runs in between
+    TaskExecutor executor(1);
+    Gate gate;
+    RunLog log;
+    executor.Schedule(TaskPriority::Background, gate.GetTask());
+    gate.WaitStarted();
+    SerialTaskQueue queue(executor, TaskPriority::Recording);
+    queue.Schedule(log.GetTask(20));
+    queue.Schedule([&]()
+    {
+        log.GetTask(21)();
+        executor.Schedule(TaskPriority::Capture, log.GetTask(0));
+    });
+    queue.Schedule(log.GetTask(22));
+    gate.Open();
+    queue.Wait();
+    CHECK(log.GetIds() == std::vector<int>({ 20, 21, 0, 22 }));
+}
+
+TEST_CASE(Coalescing)
+{
+    TaskExecutor executor(1);
+    SerialTaskQueue queue(executor, TaskPriority::Conversion, 1);
+    Gate gate;
+    RunLog log;
+
+    // Running task not counted: one more waits, the next ones are dropped
+    CHECK(queue.Schedule(gate.GetTask()));
+    gate.WaitStarted();
+    CHECK(queue.Schedule(log.GetTask(1)));
+    CHECK(!queue.Schedule(log.GetTask(2)));
+    CHECK(!queue.Schedule(log.GetTask(3)));
+    CHECK_EQUAL(queue.GetRejectedCount(), 2u);
+    gate.Open();
+    queue.Wait();
+    CHECK(log.GetIds() == std::vector<int>({ 1 }));
+
+    // Room again once the waiting task started
+    CHECK(queue.Schedule(log.GetTask(4)));
+    queue.Wait();
+    CHECK(log.GetIds() == std::vector<int>({ 1, 4 }));
+    CHECK_EQUAL(queue.GetRejectedCount(), 2u);
+}
+
+TEST_CASE(Wait)
+{
+    TaskExecutor executor(1);
+    std::atomic<int> done{ 0 };
+    {
+        SerialTaskQueue queue(executor, TaskPriority::Background);
+        // Nothing scheduled: returns at once
+        queue.Wait();
+
+        for (int i = 0; i < 5; ++i)
+        {
+            queue.Schedule([&done]()
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                done++;
+            });
+        }
+        queue.Wait();
+        CHECK_EQUAL(done.load(), 5);
+
+        // Also waits for the running task, and from the destructor
+        Gate gate;
+        queue.Schedule(gate.GetTask());
+        queue.Schedule([&done]() { done++; });
+        gate.WaitStarted();
+        std::thread opener([&gate]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            gate.Open();
+        });
+        queue.Wait();
+        CHECK_EQUAL(done.load(), 6);
+        opener.join();
+        queue.Schedule([&done]() { done++; });
+    }
+    CHECK_EQUAL(done.load(), 7);
+
+    // The destructor of the executor runs the queued tasks
+    {
+        TaskExecutor last(1);
+        for (int i = 0; i < 10; ++i)
+        {
+            last.Schedule(TaskPriority::Background, [&done]() { done++; });
+        }
+    }
+    CHECK_EQUAL(done.load(), 17);
+}
+
+TEST_CASE(Stats)
+{
+    TaskExecutor executor(1);
+    Gate gate;
+    executor.Schedule(TaskPriority::Background, gate.GetTask());
+    gate.WaitStarted();
+    executor.ResetStats();
+
+    // Three tasks of 20 ms and a last one signalling the end, queued behind the gate
+    for (int i = 0; i < 3; ++i)
+    {
+        executor.Schedule(TaskPriority::Recording, []() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+    }
+    std::promise<void> done;
+    executor.Schedule(TaskPriority::Recording, [&done]() { done.set_value(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    gate.Open();
+    done.get_future().wait();
+
+    const std::array<TaskClassStats, kTaskPriorityCount> stats = executor.GetStats();
+    const TaskClassStats& recording = stats[static_cast<size_t>(TaskPriority::Recording)];
+    CHECK_EQUAL(recording.submitted, 4u);
+    CHECK_EQUAL(recording.started, 4u);
+    CHECK_EQUAL(recording.queued, 0u);
+    CHECK_EQUAL(recording.maxQueued, 4u);
+    CHECK(recording.runTotal >= 60 * kTicksPerMillisecond);
+    CHECK(recording.runMax >= 20 * kTicksPerMillisecond && recording.runMax <= recording.runTotal);
+    // Behind the gate for 10 ms at least, the last task behind the 20 ms ones for 60 ms more
+    CHECK(recording.waitMax >= 70 * kTicksPerMillisecond && recording.waitTotal >= recording.waitMax);
+
+    // The gate was started before the reset: its completion only is counted
+    const TaskClassStats& background = stats[static_cast<size_t>(TaskPriority::Background)];
+    CHECK_EQUAL(background.started, 0u);
+    CHECK_EQUAL(background.completed, 1u);
+    CHECK(background.runTotal >= 10 * kTicksPerMillisecond);
+
+    // About 60 ms of work out of 70 ms and more since the reset
+    CHECK(recording.utilization > 0.4 && recording.utilization <= 1.);
+    CHECK_EQUAL(stats[static_cast<size_t>(TaskPriority::Capture)].submitted, 0u);
+    CHECK_EQUAL(stats[static_cast<size_t>(TaskPriority::Capture)].utilization, 0.);
+
+    executor.ResetStats();
+    const TaskClassStats reset = executor.GetStats()[static_cast<size_t>(TaskPriority::Recording)];
+    CHECK_EQUAL(reset.submitted, 0u);
+    CHECK_EQUAL(reset.runTotal, 0u);
+    CHECK_EQUAL(reset.utilization, 0.);
+}
+
+TEST_CASE(UtilizationOfAllWorkers)
+{
+    // Two workers, one task of 40 ms each, out of 80 ms and more
+    using Clock = std::chrono::steady_clock;
+    TaskExecutor executor(2);
+    const Clock::time_point beforeReset = Clock::now();
+    executor.ResetStats();
+    const Clock::time_point afterReset = Clock::now();
+    std::atomic<int> done{ 0 };
+    for (int i = 0; i < 2; ++i)
+    {
+        executor.Schedule(TaskPriority::Conversion, [&done]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(40));
+            done++;
+        });
+    }
+    std::this_thread::sleep_until(afterReset + std::chrono::milliseconds(80));
+    while (executor.GetStats()[static_cast<size_t>(TaskPriority::Conversion)].completed < 2)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const Clock::time_point beforeStats = Clock::now();
+    const TaskClassStats stats = executor.GetStats()[static_cast<size_t>(TaskPriority::Conversion)];
+    const Clock::time_point afterStats = Clock::now();
+    CHECK_EQUAL(done.load(), 2);
+    CHECK(stats.runTotal >= 80 * kTicksPerMillisecond);
+
+    // runTotal / (elapsed since the reset x 2 workers)
+    const auto workerTime = [&stats](Clock::duration elapsed)
+    {
+        return static_cast<double>(stats.runTotal) / (2. * std::chrono::duration<double>(elapsed).count() * 1e7);
+    };
+    CHECK(stats.utilization >= workerTime(afterStats - beforeReset) * 0.999);
+    CHECK(stats.utilization <= workerTime(beforeStats - afterReset) * 1.001);
+    CHECK(stats.utilization > 0. && stats.utilization <= 0.5 * static_cast<double>(stats.runTotal) / (80 * kTicksPerMillisecond));
+}
+
+TEST_MAIN()
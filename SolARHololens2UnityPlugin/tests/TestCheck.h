@@ -0,0 +1,90 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Minimal checks of the tests: each test is an executable run by ctest, failing checks are
+// reported with their location and make the test return a non zero status.
+
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace test
+{
+	inline int& FailureCount()
+	{
+		static int count = 0;
+		return count;
+	}
+
+	inline bool Check(bool condition, const char* expression, const char* file, int line)
+	{
+		if (!condition)
+		{
+			std::cerr << file << ":" << line << ": check failed: " << expression << "\n";
+			FailureCount()++;
+		}
+		return condition;
+	}
+
+	struct TestCase
+	{
+		const char* name;
+		std::function<void()> body;
+	};
+
+	inline std::vector<TestCase>& TestCases()
+	{
+		static std::vector<TestCase> testCases;
+		return testCases;
+	}
+
+	struct Registration
+	{
+		Registration(const char* name, std::function<void()> body) { TestCases().push_back({ name, std::move(body) }); }
+	};
+
+	// Run the registered test cases, return the exit status of the test
+	inline int RunAll()
+	{
+		for (const TestCase& testCase : TestCases())
+		{
+			const int failures = FailureCount();
+			testCase.body();
+			std::cout << (FailureCount() == failures ? "[ OK ] " : "[FAIL] ") << testCase.name << "\n";
+		}
+		return FailureCount() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+}
+
+#define TEST_CONCAT_IMPL(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT_IMPL(a, b)
+
+// TEST_CASE(Name) { body }
+#define TEST_CASE(name) \
+	static void name(); \
+	static test::Registration TEST_CONCAT(s_registration, name)(#name, name); \
+	static void name()
+
+#define CHECK(condition) test::Check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(a, b) test::Check((a) == (b), #a " == " #b, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, tolerance) test::Check(std::abs((a) - (b)) <= (tolerance), #a " ~= " #b, __FILE__, __LINE__)
+
+#define TEST_MAIN() int main() { return test::RunAll(); }
@@ -0,0 +1,222 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Capture to pickup latency of a consumer polling the latest frame once per render frame (Unity
+// Update()) and of a consumer blocked in WaitForNextFrame, on a synthetic sensor.
+// The sensor stores frames as the Research Mode readers do: FrameSequence under a ProfiledMutex,
+// condition variable notified after the frame is stored, and the consumers use the same
+// FrameSequence::Request()/Wait() calls as Get*Data()/WaitForNextFrame.
+// Built by CMakeLists.txt (target FrameLatencyBench), e.g.
+//   FrameLatencyBench --seconds 10 --fps 30 --render-fps 60 --render-jitter 2
+
+#include "FrameSequence.h"
+#include "LatencyTrace.h"
+#include "LockProfiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Settings
+    {
+        double seconds = 5.;
+        double sensorFps = 30.;
+        double renderFps = 60.;
+        // Frame time variation of the render loop, which drifts its phase relative to the sensor
+        double renderJitterMs = 2.;
+    };
+
+    // Latest frame of a stream, as stored by the capture thread of a reader
+    struct SyntheticStream
+    {
+        ProfiledMutex mutex{ "SyntheticStream::mutex" };
+        std::condition_variable_any condVar;
+        FrameSequence sequence;
+        FrameTrace trace;
+        std::atomic<bool> isStopped = false;
+        PipelineTracer tracer;
+    };
+
+    void RunSensor(SyntheticStream& stream, const Settings& settings)
+    {
+        const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1. / settings.sensorFps));
+        const auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(settings.seconds));
+        auto next = Clock::now() + period;
+        while (Clock::now() < end)
+        {
+            std::this_thread::sleep_until(next);
+            next += period;
+
+            FrameTrace trace;
+            trace.Mark(PipelineStage::Exposure);
+            trace.Set(PipelineStage::Acquired, trace.Get(PipelineStage::Exposure));
+            {
+                std::lock_guard<ProfiledMutex> guard(stream.mutex);
+                trace.sequence = stream.sequence.Produce();
+                trace.Mark(PipelineStage::Copied);
+                stream.trace = trace;
+            }
+            stream.condVar.notify_all();
+            trace.Mark(PipelineStage::Published);
+            stream.tracer.Complete(trace);
+        }
+
+        {
+            std::lock_guard<ProfiledMutex> guard(stream.mutex);
+            stream.isStopped = true;
+        }
+        stream.condVar.notify_all();
+    }
+
+    // Get*Data() equivalent: trace of the latest frame if not seen yet
+    bool RequestFrame(SyntheticStream& stream, uint64_t& lastSeenSequence, FrameTrace& trace)
+    {
+        std::lock_guard<ProfiledMutex> guard(stream.mutex);
+        if (stream.sequence.Request(lastSeenSequence) != FrameRequestStatus::NewFrame)
+        {
+            return false;
+        }
+        lastSeenSequence = stream.sequence.Latest();
+        trace = stream.trace;
+        return true;
+    }
+
+    // Unity polling the latest frame in each Update()
+    void RunPollingConsumer(SyntheticStream& stream, const Settings& settings)
+    {
+        std::mt19937 generator(42);
+        std::uniform_real_distribution<double> frameTime(1. / settings.renderFps - settings.renderJitterMs * 1e-3,
+                                                         1. / settings.renderFps + settings.renderJitterMs * 1e-3);
+        auto next = Clock::now();
+        uint64_t lastSeenSequence = 0;
+        while (!stream.isStopped)
+        {
+            FrameTrace trace;
+            if (RequestFrame(stream, lastSeenSequence, trace))
+            {
+                stream.tracer.PickedUp(trace);
+            }
+            next += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(frameTime(generator)));
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    // Consumer thread blocked in WaitForNextFrame
+    void RunWaitingConsumer(SyntheticStream& stream)
+    {
+        uint64_t lastSeenSequence = 0;
+        while (!stream.isStopped)
+        {
+            uint64_t sequence = 0;
+            {
+                std::unique_lock<ProfiledMutex> lock(stream.mutex);
+                stream.sequence.Wait(lock, stream.condVar, lastSeenSequence, 1000, [&]() { return stream.isStopped.load(); }, sequence);
+            }
+            FrameTrace trace;
+            if (RequestFrame(stream, lastSeenSequence, trace))
+            {
+                stream.tracer.PickedUp(trace);
+            }
+        }
+    }
+
+    void PrintStats(const char* name, SyntheticStream& stream)
+    {
+        const LatencyStats stats = stream.tracer.GetStats(PipelineStage::PickedUp);
+        std::lock_guard<ProfiledMutex> guard(stream.mutex);
+        const StreamFrameCounters& counters = stream.sequence.Counters();
+        std::cout << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(2)
+                  << " frames " << std::setw(5) << counters.produced
+                  << "  picked up " << std::setw(5) << counters.consumed
+                  << "  skipped " << std::setw(4) << counters.skipped
+                  << "  empty requests " << std::setw(5) << counters.notModified
+                  << "  latency ms: mean " << std::setw(6) << stats.mean / 1e4
+                  << "  p50 " << std::setw(6) << stats.p50 / 1e4
+                  << "  p99 " << std::setw(6) << stats.p99 / 1e4
+                  << "  max " << std::setw(6) << stats.max / 1e4 << "\n";
+    }
+
+    bool ParsePositive(const char* text, double& value)
+    {
+        char* pEnd = nullptr;
+        value = std::strtod(text, &pEnd);
+        return pEnd != text && *pEnd == '\0' && value > 0.;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool isValid = false;
+        if (argument == "--seconds" && hasValue)
+        {
+            isValid = ParsePositive(argv[++i], settings.seconds);
+        }
+        else if (argument == "--fps" && hasValue)
+        {
+            isValid = ParsePositive(argv[++i], settings.sensorFps);
+        }
+        else if (argument == "--render-fps" && hasValue)
+        {
+            isValid = ParsePositive(argv[++i], settings.renderFps);
+        }
+        else if (argument == "--render-jitter" && hasValue)
+        {
+            isValid = ParsePositive(argv[++i], settings.renderJitterMs) && settings.renderJitterMs * 1e-3 < 1. / settings.renderFps;
+        }
+
+        if (!isValid)
+        {
+            std::cerr << "Usage: FrameLatencyBench [--seconds <s>] [--fps <sensor fps>] [--render-fps <Update() rate>]\n"
+                         "                         [--render-jitter <Update() period variation, ms>]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::cout << "Sensor " << settings.sensorFps << " fps, render " << settings.renderFps << " fps, "
+              << settings.seconds << " s per consumer\n";
+
+    SyntheticStream polled;
+    {
+        std::thread consumer(RunPollingConsumer, std::ref(polled), std::cref(settings));
+        RunSensor(polled, settings);
+        consumer.join();
+    }
+    PrintStats("polling", polled);
+
+    SyntheticStream waited;
+    {
+        std::thread consumer(RunWaitingConsumer, std::ref(waited));
+        RunSensor(waited, settings);
+        consumer.join();
+    }
+    PrintStats("waiting", waited);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Per frame time of the sharpness scores, at the sizes of the streams: 640x480 VLC frames
+// (SharpnessGray8) and 760x428 PV frames (SharpnessBgra8, and the luminance plane of NV12 frames),
+// with the default row step and every row. The NEON kernels are used on ARM64 builds.
+// Built by CMakeLists.txt (target FrameQualityBench), e.g.
+//   FrameQualityBench --frames 2000 --repeat 5
+
+#include "FrameQuality.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Settings
+    {
+        size_t frames = 1000;
+        int repeat = 3;
+    };
+
+    using SharpnessFunction = float (*)(const uint8_t*, uint32_t, uint32_t, uint32_t, uint32_t);
+
+    struct Case
+    {
+        const char* name;
+        SharpnessFunction function;
+        uint32_t width;
+        uint32_t height;
+        uint32_t bytesPerPixel;
+    };
+
+    // Textured scene: gradient with noise
+    std::vector<uint8_t> GetImage(const Case& benchCase)
+    {
+        std::mt19937 generator(5);
+        std::uniform_int_distribution<int> noise(0, 15);
+        std::vector<uint8_t> image(static_cast<size_t>(benchCase.width) * benchCase.height * benchCase.bytesPerPixel);
+        for (size_t i = 0; i < image.size(); ++i)
+        {
+            image[i] = static_cast<uint8_t>(i / benchCase.bytesPerPixel % benchCase.width / 4 + noise(generator));
+        }
+        return image;
+    }
+
+    // Best of repeat runs of frames scores, in microseconds per frame
+    double BestUsPerFrame(const Settings& settings, const Case& benchCase, uint32_t rowStep, float& score)
+    {
+        const std::vector<uint8_t> image = GetImage(benchCase);
+        const uint32_t stride = benchCase.width * benchCase.bytesPerPixel;
+        double best = 0.;
+        for (int i = 0; i < settings.repeat; ++i)
+        {
+            volatile float result = 0.f;
+            const auto start = Clock::now();
+            for (size_t frame = 0; frame < settings.frames; ++frame)
+            {
+                result = benchCase.function(image.data(), benchCase.width, benchCase.height, stride, rowStep);
+            }
+            const double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / static_cast<double>(settings.frames);
+            best = (i == 0) ? us : std::min(best, us);
+            score = result;
+        }
+        return best;
+    }
+
+    bool ParseCount(const char* text, size_t& value)
+    {
+        char* pEnd = nullptr;
+        const unsigned long long parsed = std::strtoull(text, &pEnd, 10);
+        value = static_cast<size_t>(parsed);
+        return pEnd != text && *pEnd == '\0' && parsed > 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool isValid = false;
+        if (argument == "--frames" && hasValue)
+        {
+            isValid = ParseCount(argv[++i], settings.frames);
+        }
+        else if (argument == "--repeat" && hasValue)
+        {
+            size_t repeat = 0;
+            isValid = ParseCount(argv[++i], repeat);
+            settings.repeat = static_cast<int>(repeat);
+        }
+
+        if (!isValid)
+        {
+            std::cerr << "Usage: FrameQualityBench [--frames <frames per run>] [--repeat <runs, best is kept>]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+#if defined(_M_ARM64) || defined(__aarch64__)
+    std::cout << "NEON kernels";
+#else
+    std::cout << "Scalar kernels";
+#endif
+    std::cout << ", " << settings.frames << " frames, best of " << settings.repeat << " runs\n";
+
+    const Case cases[] = {
+        { "Gray8 640x480 (VLC)", FrameQuality::SharpnessGray8, 640, 480, 1 },
+        { "Gray8 760x428 (PV luminance)", FrameQuality::SharpnessGray8, 760, 428, 1 },
+        { "Bgra8 640x480", FrameQuality::SharpnessBgra8, 640, 480, 4 },
+        { "Bgra8 760x428 (PV)", FrameQuality::SharpnessBgra8, 760, 428, 4 } };
+    bool isValid = true;
+    for (const Case& benchCase : cases)
+    {
+        for (uint32_t rowStep : { FrameQuality::kDefaultRowStep, 1u })
+        {
+            float score = 0.f;
+            const double us = BestUsPerFrame(settings, benchCase, rowStep, score);
+            isValid &= score > 0.f;
+            std::cout << std::left << std::setw(30) << benchCase.name << " rowStep " << rowStep << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(10) << us << " us/frame" << std::setw(12) << score << " score\n";
+        }
+    }
+    return isValid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
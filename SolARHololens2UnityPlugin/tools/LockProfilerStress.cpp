@@ -0,0 +1,272 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Stress of the instrumented locks (always built with SOLAR_PROFILE_LOCKS): worker threads hammer
+// a ProfiledMutex, a ProfiledSharedMutex, and the profiled locks of KeyframeSelector and
+// HeadPoseHistory (TimestampedRing) as capture and Unity threads do. The counters of the
+// LockProfiler report are checked against the operations performed, and the report is printed.
+// Built by CMakeLists.txt (target LockProfilerStress, run by ctest), e.g.
+//   LockProfilerStress --threads 8 --iterations 100000
+
+#include "HeadPoseHistory.h"
+#include "KeyframeSelector.h"
+#include "LockProfiler.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef SOLAR_PROFILE_LOCKS
+#error LockProfilerStress must be built with SOLAR_PROFILE_LOCKS
+#endif
+
+namespace
+{
+    struct Settings
+    {
+        unsigned threads = 4;
+        unsigned iterations = 20000;
+    };
+
+    // Columns of a lock site line of LockProfiler::Report()
+    struct SiteReport
+    {
+        uint64_t acquisitions = 0;
+        uint64_t contended = 0;
+        double waitTotal = 0.;
+        double waitMax = 0.;
+        double holdTotal = 0.;
+        double holdMax = 0.;
+        uint64_t shared = 0;
+        std::string owner;
+    };
+
+    bool FindSite(const std::string& report, const std::string& site, SiteReport& result)
+    {
+        std::istringstream lines(report);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            if (line.compare(0, site.size() + 3, site + " | ") != 0)
+            {
+                continue;
+            }
+            std::istringstream fields(line.substr(site.size() + 3));
+            char separator;
+            fields >> result.acquisitions >> separator >> result.contended >> separator >> result.waitTotal >> separator
+                   >> result.waitMax >> separator >> result.holdTotal >> separator >> result.holdMax >> separator
+                   >> result.shared >> separator >> result.owner;
+            return static_cast<bool>(fields);
+        }
+        return false;
+    }
+
+    int s_failures = 0;
+
+    void Expect(bool condition, const std::string& what)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED: " << what << "\n";
+            s_failures++;
+        }
+    }
+
+    // Consistency of the counters of a site every thread is done with
+    void ExpectReleased(const std::string& report, const std::string& site, SiteReport& result)
+    {
+        Expect(FindSite(report, site, result), site + " is reported");
+        Expect(result.contended <= result.acquisitions + result.shared, site + ": contended <= acquisitions");
+        Expect(result.waitMax <= result.waitTotal, site + ": wait max <= wait total");
+        Expect(result.holdMax <= result.holdTotal, site + ": hold max <= hold total");
+        Expect(result.owner == "-", site + ": no owner once released");
+    }
+
+    template <class Function>
+    void RunThreads(const char* name, unsigned count, Function function)
+    {
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            threads.emplace_back([name, i, &function]()
+            {
+                const std::string threadName = std::string(name) + " " + std::to_string(i);
+                ScopedThreadProfile profile(threadName.c_str());
+                function(i);
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    void StressExclusive(const Settings& settings)
+    {
+        ProfiledMutex mutex("Stress::exclusive");
+        uint64_t counter = 0;
+        RunThreads("exclusive", settings.threads, [&](unsigned)
+        {
+            for (unsigned i = 0; i < settings.iterations; ++i)
+            {
+                std::lock_guard<ProfiledMutex> guard(mutex);
+                counter++;
+            }
+        });
+
+        const uint64_t expected = static_cast<uint64_t>(settings.threads) * settings.iterations;
+        SiteReport site;
+        ExpectReleased(LockProfiler::Report(), "Stress::exclusive", site);
+        Expect(counter == expected, "exclusive: no lost increment");
+        Expect(site.acquisitions == expected, "exclusive: one acquisition per lock");
+        Expect(site.shared == 0, "exclusive: no shared acquisition");
+    }
+
+    void StressShared(const Settings& settings)
+    {
+        ProfiledSharedMutex mutex("Stress::shared");
+        // Written together under the exclusive lock, a reader must never see them differ
+        uint64_t first = 0;
+        uint64_t second = 0;
+        std::atomic<uint64_t> reads = 0;
+        std::atomic<bool> isTorn = false;
+        RunThreads("shared", settings.threads, [&](unsigned thread)
+        {
+            for (unsigned i = 0; i < settings.iterations; ++i)
+            {
+                if (thread == 0)
+                {
+                    std::lock_guard<ProfiledSharedMutex> guard(mutex);
+                    first++;
+                    second++;
+                }
+                else
+                {
+                    std::shared_lock<ProfiledSharedMutex> lock(mutex);
+                    if (first != second)
+                    {
+                        isTorn = true;
+                    }
+                    reads++;
+                }
+            }
+        });
+
+        SiteReport site;
+        ExpectReleased(LockProfiler::Report(), "Stress::shared", site);
+        Expect(!isTorn, "shared: readers never see a write in progress");
+        Expect(first == settings.iterations, "shared: no lost write");
+        Expect(site.acquisitions == settings.iterations, "shared: one exclusive acquisition per write");
+        Expect(site.shared == reads, "shared: one shared acquisition per read");
+    }
+
+    // Capture thread evaluating frames while Unity threads poll decisions and look poses up
+    void StressPluginSites(const Settings& settings)
+    {
+        KeyframeSelector selector;
+        KeyframeSettings keyframeSettings;
+        keyframeSettings.enabled = true;
+        keyframeSettings.minTranslation = 0.1f;
+        selector.Configure(keyframeSettings);
+        HeadPoseHistory history(256);
+
+        std::atomic<uint64_t> lookups = 0;
+        RunThreads("plugin", settings.threads, [&](unsigned thread)
+        {
+            for (unsigned i = 0; i < settings.iterations; ++i)
+            {
+                const uint64_t timestamp = 1'000'000 + static_cast<uint64_t>(i) * 166'667;
+                if (thread == 0)
+                {
+                    KeyframePose pose = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f };
+                    pose[12] = 0.01f * static_cast<float>(i);
+                    selector.Evaluate(timestamp, &pose);
+                    HeadPose headPose;
+                    headPose.position[0] = pose[12];
+                    history.Record(timestamp, headPose);
+                }
+                else
+                {
+                    HeadPose headPose;
+                    history.Lookup(timestamp, headPose);
+                    selector.GetStats();
+                    lookups++;
+                }
+            }
+        });
+
+        const std::string report = LockProfiler::Report();
+        SiteReport keyframeSite;
+        ExpectReleased(report, "KeyframeSelector::m_mutex", keyframeSite);
+        SiteReport historySite;
+        ExpectReleased(report, "HeadPoseHistory::m_poses", historySite);
+        Expect(selector.GetStats().evaluated == settings.iterations, "plugin: every frame evaluated");
+        Expect(keyframeSite.acquisitions >= settings.iterations + lookups, "plugin: selector locked by every call");
+        Expect(historySite.acquisitions == settings.iterations + lookups, "plugin: history locked once per call");
+    }
+
+    bool ParseUnsigned(const char* text, unsigned& value)
+    {
+        char* pEnd = nullptr;
+        const unsigned long parsed = std::strtoul(text, &pEnd, 10);
+        value = static_cast<unsigned>(parsed);
+        return pEnd != text && *pEnd == '\0' && parsed > 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool isValid = false;
+        if (argument == "--threads" && hasValue)
+        {
+            isValid = ParseUnsigned(argv[++i], settings.threads) && settings.threads >= 2;
+        }
+        else if (argument == "--iterations" && hasValue)
+        {
+            isValid = ParseUnsigned(argv[++i], settings.iterations);
+        }
+
+        if (!isValid)
+        {
+            std::cerr << "Usage: LockProfilerStress [--threads <at least 2>] [--iterations <per thread>]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    StressExclusive(settings);
+    StressShared(settings);
+    StressPluginSites(settings);
+
+    const std::string report = LockProfiler::Report();
+    Expect(report.find("exclusive 0 | exited") != std::string::npos, "profiled threads are reported");
+    std::cout << report;
+
+    LockProfiler::Reset();
+    SiteReport site;
+    Expect(!FindSite(LockProfiler::Report(), "Stress::exclusive", site), "reset forgets destroyed locks");
+
+    std::cout << (s_failures == 0 ? "All lock counters consistent\n" : "Lock counters inconsistent\n");
+    return s_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,192 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Service side client of the network streaming server (StartNetworkStreaming()): connects with
+// NetworkStreamReceiver, prints one line per received message and a per stream summary.
+// Built by CMakeLists.txt (target NetworkStreamDump) from the receiver sources only, as a SolAR
+// service would, e.g.
+//   NetworkStreamDump --host 192.168.1.20 --streams LEFT_FRONT,IMU_GYRO --count 1000
+
+#include "NetworkStreamReceiver.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace
+{
+    constexpr SharedStream kLastStream = SharedStream::HEAD_POSE;
+
+    struct Settings
+    {
+        std::string host = "127.0.0.1";
+        uint16_t port = 5400;
+        uint32_t streamMask = 0;
+        uint64_t count = 0;         // 0 until disconnection
+        bool isQuiet = false;
+    };
+
+    struct StreamSummary
+    {
+        uint64_t messages = 0;
+        uint64_t bytes = 0;
+        uint64_t first = 0;
+        uint64_t last = 0;
+    };
+
+    // "PV,LEFT_FRONT,...": names of GetSharedStreamName() without prefix
+    bool ParseStreams(const std::string& list, uint32_t& mask)
+    {
+        std::istringstream names(list);
+        std::string name;
+        mask = 0;
+        while (std::getline(names, name, ','))
+        {
+            bool isFound = false;
+            for (uint32_t i = 0; i <= static_cast<uint32_t>(kLastStream); ++i)
+            {
+                if (GetSharedStreamName(static_cast<SharedStream>(i)) == "SolARHL2_" + name)
+                {
+                    mask |= GetStreamBit(static_cast<SharedStream>(i));
+                    isFound = true;
+                }
+            }
+            if (!isFound)
+            {
+                return false;
+            }
+        }
+        return mask != 0;
+    }
+
+    void Print(const NetworkMessage& message)
+    {
+        const auto stream = static_cast<SharedStream>(message.header.stream);
+        std::cout << std::left << std::setw(20) << GetSharedStreamName(stream) << std::right << message.header.timestamp;
+        switch (static_cast<NetworkMessageType>(message.header.type))
+        {
+        case NetworkMessageType::Frame:
+            std::cout << " frame " << message.frame.sequence << " " << message.frame.width << "x" << message.frame.height
+                      << " " << message.pixels.size() << " B" << (message.frame.poseValid ? "" : " not located");
+            break;
+        case NetworkMessageType::ImuSamples:
+            std::cout << " " << message.imuSamples.size() << " IMU samples";
+            break;
+        case NetworkMessageType::HeadPose:
+            std::cout << " head at " << message.headPose.position[0] << " " << message.headPose.position[1] << " " << message.headPose.position[2];
+            break;
+        default:
+            std::cout << " message " << message.header.type;
+            break;
+        }
+        std::cout << "\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool isValid = false;
+        if (argument == "--host" && hasValue)
+        {
+            settings.host = argv[++i];
+            isValid = true;
+        }
+        else if (argument == "--port" && hasValue)
+        {
+            const unsigned long port = std::strtoul(argv[++i], nullptr, 10);
+            settings.port = static_cast<uint16_t>(port);
+            isValid = port > 0 && port <= 65535;
+        }
+        else if (argument == "--streams" && hasValue)
+        {
+            isValid = ParseStreams(argv[++i], settings.streamMask);
+        }
+        else if (argument == "--count" && hasValue)
+        {
+            settings.count = std::strtoull(argv[++i], nullptr, 10);
+            isValid = settings.count > 0;
+        }
+        else if (argument == "--quiet")
+        {
+            settings.isQuiet = true;
+            isValid = true;
+        }
+
+        if (!isValid)
+        {
+            std::cerr << "Usage: NetworkStreamDump [--host <address>] [--port <tcp port>] [--streams PV,LEFT_FRONT,...,HEAD_POSE]"
+                         " [--count <messages>] [--quiet (summary only)]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    NetworkStreamReceiver receiver;
+    if (!receiver.Connect(settings.host, settings.port, settings.streamMask))
+    {
+        std::cerr << "Cannot connect to " << settings.host << ":" << settings.port << "\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "Connected, server streams:";
+    for (uint32_t i = 0; i <= static_cast<uint32_t>(kLastStream); ++i)
+    {
+        if (receiver.GetAvailableStreams() & GetStreamBit(static_cast<SharedStream>(i)))
+        {
+            std::cout << " " << GetSharedStreamName(static_cast<SharedStream>(i));
+        }
+    }
+    std::cout << "\n";
+
+    std::map<uint32_t, StreamSummary> summaries;
+    NetworkMessage message;
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t received = 0;
+    while ((settings.count == 0 || received < settings.count) && receiver.Receive(message))
+    {
+        received++;
+        StreamSummary& summary = summaries[message.header.stream];
+        summary.messages++;
+        summary.bytes += sizeof(NetworkMessageHeader) + message.header.payloadSize;
+        summary.first = summary.messages == 1 ? message.header.timestamp : summary.first;
+        summary.last = message.header.timestamp;
+        if (!settings.isQuiet)
+        {
+            Print(message);
+        }
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "\n" << received << " messages in " << std::fixed << std::setprecision(1) << seconds << " s"
+              << (receiver.IsConnected() ? "\n" : ", disconnected\n");
+    for (const auto& summary : summaries)
+    {
+        // Sensor time covered by the messages of the stream, in hundreds of nanoseconds
+        const double span = static_cast<double>(summary.second.last - summary.second.first) * 1e-7;
+        std::cout << std::left << std::setw(20) << GetSharedStreamName(static_cast<SharedStream>(summary.first)) << std::right
+                  << std::setw(8) << summary.second.messages << " messages" << std::setw(10) << std::setprecision(2)
+                  << static_cast<double>(summary.second.bytes) / (1 << 20) << " MB"
+                  << std::setw(10) << (span > 0. ? static_cast<double>(summary.second.messages - 1) / span : 0.) << " /s\n";
+    }
+    return EXIT_SUCCESS;
+}
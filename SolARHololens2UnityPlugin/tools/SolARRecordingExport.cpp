@@ -0,0 +1,135 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Command line exporter of the plugin recordings to EuRoC, TUM or SolAR datasets (DatasetExporter.h).
+// Not part of the plugin DLL: built by CMakeLists.txt (target SolARRecordingExport), e.g.
+//   SolARRecordingExport --layout tum recording.slrec dataset
+
+#include "DatasetExporter.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::cerr <<
+            "Usage: SolARRecordingExport [options] <recording> <output folder>\n"
+            "  <recording>          .slrec file, or folder of a recording in separate files\n"
+            "  --layout <layout>    euroc (default), tum or solar\n"
+            "  --streams <streams>  comma separated: PV, LEFT_FRONT, LEFT_LEFT, RIGHT_FRONT, RIGHT_RIGHT,\n"
+            "                       DEPTH, IMU_ACCEL, IMU_GYRO, IMU_MAG, HEAD_POSE (default all)\n"
+            "  --start <seconds>    from the beginning of the recording (default 0)\n"
+            "  --end <seconds>      from the beginning of the recording (default the end)\n"
+            "  --threads <count>    conversion threads (default one per hardware thread)\n";
+    }
+
+    bool ParseSeconds(const char* text, uint64_t& timestamp)
+    {
+        char* pEnd = nullptr;
+        const double seconds = std::strtod(text, &pEnd);
+        if (pEnd == text || *pEnd != '\0' || seconds < 0.)
+        {
+            return false;
+        }
+        // Hundreds of nanoseconds
+        timestamp = static_cast<uint64_t>(seconds * 1e7);
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    DatasetExportSettings settings;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool isValid = true;
+        if (argument == "--layout" && hasValue)
+        {
+            isValid = ParseDatasetLayout(argv[++i], settings.layout);
+        }
+        else if (argument == "--streams" && hasValue)
+        {
+            settings.streamMask = 0;
+            std::istringstream streams(argv[++i]);
+            std::string name;
+            while (isValid && std::getline(streams, name, ','))
+            {
+                SharedStream stream;
+                isValid = ParseStreamName(name, stream);
+                settings.streamMask |= isValid ? GetStreamBit(stream) : 0;
+            }
+        }
+        else if (argument == "--start" && hasValue)
+        {
+            isValid = ParseSeconds(argv[++i], settings.startOffset);
+        }
+        else if (argument == "--end" && hasValue)
+        {
+            isValid = ParseSeconds(argv[++i], settings.endOffset);
+        }
+        else if (argument == "--threads" && hasValue)
+        {
+            settings.threadCount = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (argument.compare(0, 2, "--") == 0)
+        {
+            isValid = false;
+        }
+        else
+        {
+            paths.push_back(argument);
+        }
+
+        if (!isValid)
+        {
+            std::cerr << "Invalid option " << argument << "\n";
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (paths.size() != 2)
+    {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    DatasetExportStats stats;
+    std::string error;
+    if (!ExportDataset(paths[0], paths[1], settings, stats, error))
+    {
+        std::cerr << "Export failed: " << error << "\n";
+        return EXIT_FAILURE;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << stats.frames << " frames (" << stats.imageBytes / (1024 * 1024) << " MB), " << stats.imuSamples
+              << " IMU samples, " << stats.poses << " poses exported in " << seconds << " s\n";
+    if (stats.failedFrames > 0)
+    {
+        std::cout << stats.failedFrames << " frames could not be exported\n";
+    }
+    return stats.failedFrames > 0 ? 2 : EXIT_SUCCESS;
+}
@@ -0,0 +1,300 @@
+/**
+ * @copyright Copyright (c) 2021-2022 B-com http://www.b-com.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Binary trajectory files against the legacy CSV pose logs, on a synthetic 30 Hz trajectory:
+// write time, load time (istream parsing of the CSV as the existing tools do, mapped reads of the
+// .traj in both pose formats), timestamp lookups and file sizes. The CSV conversion round trip
+// and the mapped poses are checked against the written ones.
+// Built by CMakeLists.txt (target TrajectoryBench), e.g.
+//   TrajectoryBench --poses 108000 --repeat 5 --pv
+
+#include "Trajectory.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr int64_t kFirstTimestamp = 132'900'000'000'000'000;
+    constexpr int64_t kPeriod = 333'333;    // 30 Hz, hundreds of nanoseconds
+
+    struct Settings
+    {
+        size_t poses = 108'000;     // one hour at 30 Hz
+        int repeat = 3;
+        bool hasFocalLength = false;
+    };
+
+    struct Pose
+    {
+        int64_t timestamp;
+        float transform[16];
+        float focalLength[2];
+    };
+
+    // Walk along a circle, looking ahead, with some head bobbing
+    std::vector<Pose> GenerateTrajectory(size_t count)
+    {
+        std::vector<Pose> poses(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const double t = static_cast<double>(i) / 30.;
+            const double yaw = 0.05 * t;
+            const double pitch = 0.1 * std::sin(2. * t);
+            const float cy = static_cast<float>(std::cos(yaw));
+            const float sy = static_cast<float>(std::sin(yaw));
+            const float cp = static_cast<float>(std::cos(pitch));
+            const float sp = static_cast<float>(std::sin(pitch));
+            const float transform[16] = {
+                cy, sy * sp, sy * cp, static_cast<float>(20. * std::sin(yaw)),
+                0.f, cp, -sp, static_cast<float>(1.6 + 0.02 * std::sin(12. * t)),
+                -sy, cy * sp, cy * cp, static_cast<float>(20. * std::cos(yaw)),
+                0.f, 0.f, 0.f, 1.f };
+            Pose& pose = poses[i];
+            pose.timestamp = kFirstTimestamp + static_cast<int64_t>(i) * kPeriod;
+            std::copy(std::begin(transform), std::end(transform), pose.transform);
+            pose.focalLength[0] = 1480.f + 0.01f * static_cast<float>(i % 100);
+            pose.focalLength[1] = 1481.f;
+        }
+        return poses;
+    }
+
+    template <class Function>
+    double BestMs(int repeat, Function function)
+    {
+        double best = 0.;
+        for (int i = 0; i < repeat; ++i)
+        {
+            const auto start = Clock::now();
+            function();
+            const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            best = (i == 0) ? ms : std::min(best, ms);
+        }
+        return best;
+    }
+
+    bool WriteTrajectory(const std::filesystem::path& path, const std::vector<Pose>& poses, TrajectoryPoseFormat format, bool hasFocalLength)
+    {
+        TrajectoryWriter writer;
+        if (!writer.Open(path, format, hasFocalLength))
+        {
+            return false;
+        }
+        if (hasFocalLength)
+        {
+            writer.SetIntrinsics(960.f, 540.f, 1920, 1080);
+        }
+        for (const Pose& pose : poses)
+        {
+            writer.Write(pose.timestamp, pose.transform, pose.focalLength);
+        }
+        writer.Close();
+        return true;
+    }
+
+    // Line by line istream parsing of a legacy pose log, as the existing tools read them
+    double ParseCsv(const std::filesystem::path& path, bool hasFocalLength, size_t& count)
+    {
+        std::ifstream file(path);
+        std::string line;
+        if (hasFocalLength)
+        {
+            std::getline(file, line);
+        }
+        double checksum = 0.;
+        count = 0;
+        while (std::getline(file, line))
+        {
+            std::replace(line.begin(), line.end(), ',', ' ');
+            std::istringstream values(line);
+            long long timestamp = 0;
+            values >> timestamp;
+            float value = 0.f;
+            while (values >> value)
+            {
+                checksum += value;
+            }
+            count++;
+        }
+        return checksum;
+    }
+
+    double ReadMapped(const std::filesystem::path& path, size_t& count)
+    {
+        TrajectoryReader reader;
+        double checksum = 0.;
+        count = 0;
+        if (!reader.Open(path))
+        {
+            return checksum;
+        }
+        float transform[16];
+        for (size_t i = 0; i < reader.GetRecordCount(); ++i)
+        {
+            reader.GetTransform(i, transform);
+            checksum += transform[3] + transform[7] + transform[11];
+        }
+        count = reader.GetRecordCount();
+        return checksum;
+    }
+
+    bool IsSameFile(const std::filesystem::path& a, const std::filesystem::path& b)
+    {
+        std::ifstream fileA(a, std::ios::binary);
+        std::ifstream fileB(b, std::ios::binary);
+        return std::equal(std::istreambuf_iterator<char>(fileA), std::istreambuf_iterator<char>(),
+                          std::istreambuf_iterator<char>(fileB), std::istreambuf_iterator<char>());
+    }
+
+    // Mapped transforms against the written ones, exact for matrices
+    bool CheckMapped(const std::filesystem::path& path, const std::vector<Pose>& poses, float tolerance)
+    {
+        TrajectoryReader reader;
+        if (!reader.Open(path) || reader.GetRecordCount() != poses.size())
+        {
+            return false;
+        }
+        float transform[16];
+        for (size_t i = 0; i < poses.size(); ++i)
+        {
+            reader.GetTransform(i, transform);
+            if (reader.GetTimestamp(i) != poses[i].timestamp)
+            {
+                return false;
+            }
+            for (int j = 0; j < 16; ++j)
+            {
+                if (std::abs(transform[j] - poses[i].transform[j]) > tolerance)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void PrintRow(const char* name, double ms, size_t poses)
+    {
+        std::cout << std::left << std::setw(34) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << ms << " ms" << std::setw(10) << (ms * 1e6 / static_cast<double>(poses)) << " ns/pose\n";
+    }
+
+    bool ParseCount(const char* text, size_t& value)
+    {
+        char* pEnd = nullptr;
+        const unsigned long long parsed = std::strtoull(text, &pEnd, 10);
+        value = static_cast<size_t>(parsed);
+        return pEnd != text && *pEnd == '\0' && parsed > 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool isValid = false;
+        if (argument == "--poses" && hasValue)
+        {
+            isValid = ParseCount(argv[++i], settings.poses);
+        }
+        else if (argument == "--repeat" && hasValue)
+        {
+            size_t repeat = 0;
+            isValid = ParseCount(argv[++i], repeat);
+            settings.repeat = static_cast<int>(repeat);
+        }
+        else if (argument == "--pv")
+        {
+            settings.hasFocalLength = true;
+            isValid = true;
+        }
+
+        if (!isValid)
+        {
+            std::cerr << "Usage: TrajectoryBench [--poses <count>] [--repeat <runs, best is kept>] [--pv (with focal length)]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    const std::filesystem::path folder = std::filesystem::temp_directory_path() / "TrajectoryBench";
+    std::filesystem::create_directories(folder);
+    const std::filesystem::path matrixPath = folder / "matrix.traj";
+    const std::filesystem::path quaternionPath = folder / "quaternion.traj";
+    const std::filesystem::path csvPath = folder / "poses.txt";
+    const std::filesystem::path convertedPath = folder / "converted.traj";
+    const std::filesystem::path roundTripPath = folder / "roundtrip.txt";
+
+    const std::vector<Pose> poses = GenerateTrajectory(settings.poses);
+    const size_t count = poses.size();
+    std::cout << count << " poses" << (settings.hasFocalLength ? " with focal length (PV)" : " (rig2world)")
+              << ", best of " << settings.repeat << " runs\n";
+
+    bool isValid = true;
+    PrintRow("write .traj (matrix)", BestMs(settings.repeat, [&]() { isValid &= WriteTrajectory(matrixPath, poses, TrajectoryPoseFormat::Matrix, settings.hasFocalLength); }), count);
+    PrintRow("write .traj (quaternion)", BestMs(settings.repeat, [&]() { isValid &= WriteTrajectory(quaternionPath, poses, TrajectoryPoseFormat::QuaternionTranslation, settings.hasFocalLength); }), count);
+    PrintRow("write CSV (ConvertTrajectoryToCsv)", BestMs(settings.repeat, [&]() { isValid &= ConvertTrajectoryToCsv(matrixPath, csvPath); }), count);
+
+    size_t readCount = 0;
+    volatile double checksum = 0.;
+    PrintRow("parse CSV (istream)", BestMs(settings.repeat, [&]() { checksum = ParseCsv(csvPath, settings.hasFocalLength, readCount); }), count);
+    isValid &= readCount == count;
+    PrintRow("convert CSV to .traj", BestMs(settings.repeat, [&]() { isValid &= ConvertCsvToTrajectory(csvPath, convertedPath, settings.hasFocalLength); }), count);
+    PrintRow("mapped read (matrix)", BestMs(settings.repeat, [&]() { checksum = ReadMapped(matrixPath, readCount); }), count);
+    isValid &= readCount == count;
+    PrintRow("mapped read (quaternion)", BestMs(settings.repeat, [&]() { checksum = ReadMapped(quaternionPath, readCount); }), count);
+    isValid &= readCount == count;
+
+    // Frame timestamp lookups, e.g. pose of each frame of another stream
+    {
+        TrajectoryReader reader;
+        isValid &= reader.Open(matrixPath);
+        std::mt19937_64 generator(42);
+        std::uniform_int_distribution<int64_t> timestamps(kFirstTimestamp, kFirstTimestamp + static_cast<int64_t>(count) * kPeriod);
+        std::vector<int64_t> queries(count);
+        std::generate(queries.begin(), queries.end(), [&]() { return timestamps(generator); });
+        size_t sum = 0;
+        PrintRow("LowerBound (one per pose)", BestMs(settings.repeat, [&]() { for (int64_t query : queries) { sum += reader.LowerBound(query); } }), count);
+        checksum = static_cast<double>(sum);
+    }
+
+    std::cout << "\nFile sizes: CSV " << std::filesystem::file_size(csvPath)
+              << " B, .traj matrix " << std::filesystem::file_size(matrixPath)
+              << " B, .traj quaternion " << std::filesystem::file_size(quaternionPath) << " B\n";
+
+    isValid &= CheckMapped(matrixPath, poses, 0.f);
+    isValid &= CheckMapped(quaternionPath, poses, 1e-5f);
+    // CSV -> .traj -> CSV gives back the same file
+    isValid &= ConvertTrajectoryToCsv(convertedPath, roundTripPath) && IsSameFile(csvPath, roundTripPath);
+
+    std::filesystem::remove_all(folder);
+    std::cout << (isValid ? "Round trips consistent\n" : "Round trip mismatch\n");
+    return isValid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -269,13 +269,26 @@ void MixedReality::Update()
 
 	UpdateAnchors();
 
-	winrt::Windows::UI::Input::Spatial::SpatialPointerPose pointerPose = winrt::Windows::UI::Input::Spatial::SpatialPointerPose::TryGetAtTimestamp(GetWorldCoordinateSystem(), prediction.Timestamp());
+	auto worldCoordinateSystem = GetWorldCoordinateSystem();
+	if (worldCoordinateSystem != m_headPoseHistoryCoordinateSystem)
+	{
+		m_headPoseHistory.Clear();
+		m_headPoseHistoryCoordinateSystem = worldCoordinateSystem;
+	}
+
+	winrt::Windows::UI::Input::Spatial::SpatialPointerPose pointerPose = winrt::Windows::UI::Input::Spatial::SpatialPointerPose::TryGetAtTimestamp(worldCoordinateSystem, prediction.Timestamp());
 	if (pointerPose)
 	{
 		m_headPosition = XMVectorSetW(XMLoadFloat3(&pointerPose.Head().Position()), 1.0f);
 		m_headForwardDirection = XMLoadFloat3(&pointerPose.Head().ForwardDirection());
 		m_headUpDirection = XMLoadFloat3(&pointerPose.Head().UpDirection());
 
+		HeadPose headPose;
+		XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(headPose.position), m_headPosition);
+		XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(headPose.forward), m_headForwardDirection);
+		XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(headPose.up), m_headUpDirection);
+		m_headPoseHistory.Record(prediction.Timestamp().TargetTime().time_since_epoch().count(), headPose);
+
 		if (m_isEyeTrackingEnabled)
 		{
 			if (pointerPose.Eyes() && pointerPose.Eyes().IsCalibrationValid())
@@ -300,17 +313,14 @@ void MixedReality::Update()
 	{
 		m_isEyeTrackingRequested = false;
 
-		thread requestAccessThread([this]()
+		// Completed on a system thread, no thread waits for the user answer
+		winrt::Windows::Perception::People::EyesPose::RequestAccessAsync().Completed([this](auto const& operation, winrt::Windows::Foundation::AsyncStatus status)
 			{
-				auto status = winrt::Windows::Perception::People::EyesPose::RequestAccessAsync().get();
-
-				if (status == winrt::Windows::UI::Input::GazeInputAccessStatus::Allowed)
+				if (status == winrt::Windows::Foundation::AsyncStatus::Completed && operation.GetResults() == winrt::Windows::UI::Input::GazeInputAccessStatus::Allowed)
 					m_isEyeTrackingEnabled = true;
 				else
 					m_isEyeTrackingEnabled = false;
 			});
-
-		requestAccessThread.detach();
 	}
 
 	auto sourceStates = m_spatialInteractionManager.GetDetectedSourcesAtTimestamp(prediction.Timestamp());
@@ -880,6 +890,16 @@ void MixedReality::OnLocatabilityChanged(winrt::Windows::Perception::Spatial::Sp
 
 bool MixedReality::GetHeadPoseAtTimestamp(long long fileTimeTimestamp, DirectX::XMVECTOR& position, DirectX::XMVECTOR& direction, DirectX::XMVECTOR& up)
 {
+	HeadPose headPose;
+	if (fileTimeTimestamp > 0 && m_headPoseHistory.Lookup(static_cast<uint64_t>(fileTimeTimestamp), headPose) == HeadPoseLookup::Interpolated)
+	{
+		position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(headPose.position));
+		direction = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(headPose.forward));
+		up = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(headPose.up));
+		return true;
+	}
+
+	// Outside the recorded window (or in a tracking gap): ask the system
 	if (m_referenceFrame)
 	{
 		auto dateTime = winrt::clock::from_file_time(winrt::file_time(fileTimeTimestamp));
@@ -902,21 +922,47 @@ SurfaceMapping::SurfaceMapping(winrt::Windows::Perception::Spatial::SpatialStati
 	m_isActive(false),
 	m_surfaceDrawMode(SurfaceDrawMode::None),
 	m_headPosition(XMVectorZero()),
-	m_numberOfSurfacesInProcessingQueue(0),
-	m_surfaceObservationThread(new std::thread(&SurfaceMapping::SurfaceObservationThreadFunction, this))
+	m_numberOfSurfacesInProcessingQueue(0)
 {
 }
 
+SurfaceMapping::~SurfaceMapping()
+{
+	// Update() does not schedule passes anymore. Wait for the current one: its task, then the
+	// computation it started, then the conversion task scheduled by its completion.
+	m_meshingQueue.Wait();
+	{
+		unique_lock<ProfiledMutex> lock(m_pendingMeshingsMutex);
+		m_pendingMeshingsCondVar.wait(lock, [this]() { return m_pendingMeshings == 0; });
+	}
+	m_meshingQueue.Wait();
+
+	// The user may never answer, the completion of the request only updates m_accessRequest
+	if (m_accessOperation && m_accessOperation.Status() == winrt::Windows::Foundation::AsyncStatus::Started)
+		m_accessOperation.Cancel();
+}
+
+// The access request completes asynchronously, the observer is created by the first pass after it
+// is allowed. A denied request is made again by the next pass.
 void SurfaceMapping::CreaterObserverIfNeeded()
 {
 	if (m_surfaceObserver)
 		return;
 
-	auto status = winrt::Windows::Perception::Spatial::Surfaces::SpatialSurfaceObserver::RequestAccessAsync().get();
-	if (status == winrt::Windows::Perception::Spatial::SpatialPerceptionAccessStatus::Allowed)
+	if (m_accessRequest->isAllowed)
 	{
 		m_surfaceObserver = winrt::Windows::Perception::Spatial::Surfaces::SpatialSurfaceObserver();
 	}
+	else if (!m_accessRequest->isRequested.exchange(true))
+	{
+		m_accessOperation = winrt::Windows::Perception::Spatial::Surfaces::SpatialSurfaceObserver::RequestAccessAsync();
+		m_accessOperation.Completed([accessRequest = m_accessRequest](auto const& operation, winrt::Windows::Foundation::AsyncStatus status)
+			{
+				accessRequest->isAllowed = status == winrt::Windows::Foundation::AsyncStatus::Completed && operation.GetResults() == winrt::Windows::Perception::Spatial::SpatialPerceptionAccessStatus::Allowed;
+				if (!accessRequest->isAllowed)
+					accessRequest->isRequested = false;
+			});
+	}
 }
 
 // Returns the list of observed surfaces that are new or in need of an update.
@@ -959,77 +1005,95 @@ void SurfaceMapping::GetLatestSurfacesToProcess(std::vector<TimestampSurfacePair
 		});
 }
 
-void SurfaceMapping::SurfaceObservationThreadFunction()
+void SurfaceMapping::StartMeshingPass()
 {
-	vector<TimestampSurfacePair> surfacesToProcess;
+	CreaterObserverIfNeeded();
+	if (!m_surfaceObserver || !m_referenceFrame)
+	{
+		m_isMeshingPassPending = false;
+		return;
+	}
+
+	m_headPositionMutex.lock();
+	winrt::Windows::Perception::Spatial::SpatialBoundingBox box = { { XMVectorGetX(m_headPosition), XMVectorGetY(m_headPosition), XMVectorGetZ(m_headPosition) }, { 10.f, 10.f, 5.f } };
+	winrt::Windows::Perception::Spatial::SpatialBoundingVolume bounds = winrt::Windows::Perception::Spatial::SpatialBoundingVolume::FromBox(m_referenceFrame.CoordinateSystem(), box);
+	m_surfaceObserver.SetBoundingVolume(bounds);
+	m_headPositionMutex.unlock();
+
+	if (m_surfacesToProcess.empty())
+		GetLatestSurfacesToProcess(m_surfacesToProcess);
 
-	for (;;)
+	if (m_surfacesToProcess.empty())
 	{
-		CreaterObserverIfNeeded();
-		if (!m_surfaceObserver || !m_referenceFrame)
-		{
-			Sleep(50);
-			continue;
-		}
+		m_isMeshingPassPending = false;
+		return;
+	}
 
-		m_headPositionMutex.lock();
-		winrt::Windows::Perception::Spatial::SpatialBoundingBox box = { { XMVectorGetX(m_headPosition), XMVectorGetY(m_headPosition), XMVectorGetZ(m_headPosition) }, { 10.f, 10.f, 5.f } };
-		winrt::Windows::Perception::Spatial::SpatialBoundingVolume bounds = winrt::Windows::Perception::Spatial::SpatialBoundingVolume::FromBox(m_referenceFrame.CoordinateSystem(), box);
-		m_surfaceObserver.SetBoundingVolume(bounds);
-		m_headPositionMutex.unlock();
+	auto surfaceInfo = m_surfacesToProcess.back().second;
+	m_surfacesToProcess.pop_back();
 
-		if (surfacesToProcess.empty())
-		{
-			Sleep(50);
-			GetLatestSurfacesToProcess(surfacesToProcess);
-		}
+	m_numberOfSurfacesInProcessingQueueMutex.lock();
+	m_numberOfSurfacesInProcessingQueue = (unsigned)m_surfacesToProcess.size();
+	m_numberOfSurfacesInProcessingQueueMutex.unlock();
+
+	auto options = winrt::Windows::Perception::Spatial::Surfaces::SpatialSurfaceMeshOptions();
+	options.IncludeVertexNormals(true);
 
-		while (!surfacesToProcess.empty())
+	// The computation completes on a system thread, the conversion runs on the executor
+	{
+		lock_guard<ProfiledMutex> lock(m_pendingMeshingsMutex);
+		m_pendingMeshings++;
+	}
+	surfaceInfo.TryComputeLatestMeshAsync(1000.0, options).Completed([this](auto const& operation, winrt::Windows::Foundation::AsyncStatus status)
 		{
-			Sleep(50);
+			winrt::Windows::Perception::Spatial::Surfaces::SpatialSurfaceMesh sourceMesh{ nullptr };
+			if (status == winrt::Windows::Foundation::AsyncStatus::Completed)
+				sourceMesh = operation.GetResults();
 
-			auto surfaceInfo = surfacesToProcess.back().second;
-			surfacesToProcess.pop_back();
+			m_meshingQueue.Schedule([this, sourceMesh]()
+				{
+					if (sourceMesh)
+						AddMeshRecord(sourceMesh);
 
-			m_numberOfSurfacesInProcessingQueueMutex.lock();
-			m_numberOfSurfacesInProcessingQueue = (unsigned)surfacesToProcess.size();
-			m_numberOfSurfacesInProcessingQueueMutex.unlock();
+					m_isMeshingPassPending = false;
+					{
+						lock_guard<ProfiledMutex> lock(m_pendingMeshingsMutex);
+						m_pendingMeshings--;
+					}
+					m_pendingMeshingsCondVar.notify_all();
+				});
+		});
+}
 
-			auto options = winrt::Windows::Perception::Spatial::Surfaces::SpatialSurfaceMeshOptions();
-			options.IncludeVertexNormals(true);
-			auto sourceMesh = surfaceInfo.TryComputeLatestMeshAsync(1000.0, options).get();
-			if (sourceMesh)
-			{
-				MeshRecord newMeshRecord;
-				newMeshRecord.id = sourceMesh.SurfaceInfo().Id();
-				newMeshRecord.sourceMesh = sourceMesh;
-				newMeshRecord.lastMeshUpdateTime = Timer::GetSystemRelativeTime();
-				newMeshRecord.lastSurfaceUpdateTime = sourceMesh.SurfaceInfo().UpdateTime().time_since_epoch().count();
-				newMeshRecord.color = XMVectorSet(0.5f, 0.5f, 0.5f, 1.0f);
-
-				auto tryTransform = sourceMesh.CoordinateSystem().TryGetTransformTo(m_referenceFrame.CoordinateSystem());
-				if (tryTransform)
-					newMeshRecord.worldTransform = tryTransform.Value();
-
-				newMeshRecord.mesh = make_shared<Mesh>(nullptr, 0);
-				ConvertMesh(newMeshRecord.sourceMesh, newMeshRecord.mesh);
-				newMeshRecord.sourceMesh = nullptr;
-				newMeshRecord.mesh->UpdateBoundingBox();
-
-				if (m_surfaceDrawMode != SurfaceDrawMode::None)
-					newMeshRecord.InitDrawCall();
-
-				m_newMeshRecordsMutex.lock();
-				m_newMeshRecords.push_back(newMeshRecord);
-				m_newMeshRecordsMutex.unlock();
-			}
-		}
-	}
+void SurfaceMapping::AddMeshRecord(winrt::Windows::Perception::Spatial::Surfaces::SpatialSurfaceMesh sourceMesh)
+{
+	MeshRecord newMeshRecord;
+	newMeshRecord.id = sourceMesh.SurfaceInfo().Id();
+	newMeshRecord.sourceMesh = sourceMesh;
+	newMeshRecord.lastMeshUpdateTime = Timer::GetSystemRelativeTime();
+	newMeshRecord.lastSurfaceUpdateTime = sourceMesh.SurfaceInfo().UpdateTime().time_since_epoch().count();
+	newMeshRecord.color = XMVectorSet(0.5f, 0.5f, 0.5f, 1.0f);
+
+	auto tryTransform = sourceMesh.CoordinateSystem().TryGetTransformTo(m_referenceFrame.CoordinateSystem());
+	if (tryTransform)
+		newMeshRecord.worldTransform = tryTransform.Value();
+
+	newMeshRecord.mesh = make_shared<Mesh>(nullptr, 0);
+	ConvertMesh(newMeshRecord.sourceMesh, newMeshRecord.mesh);
+	newMeshRecord.sourceMesh = nullptr;
+	newMeshRecord.mesh->UpdateBoundingBox();
+
+	if (m_surfaceDrawMode != SurfaceDrawMode::None)
+		newMeshRecord.InitDrawCall();
+
+	m_newMeshRecordsMutex.lock();
+	m_newMeshRecords.push_back(newMeshRecord);
+	m_newMeshRecordsMutex.unlock();
 }
 
 unsigned SurfaceMapping::GetNumberOfSurfacesInProcessingQueue()
 {
-	lock_guard<mutex> lock(m_numberOfSurfacesInProcessingQueueMutex);
+	lock_guard<ProfiledMutex> lock(m_numberOfSurfacesInProcessingQueueMutex);
 	return m_numberOfSurfacesInProcessingQueue;
 }
 
@@ -1072,6 +1136,14 @@ void SurfaceMapping::Update(const XMVECTOR& headPosition)
 		m_isActive = true;
 
 	m_meshRecordsMutex.unlock();
+
+	// Next meshing pass, unless the current one is not done
+	const long long now = Timer::GetSystemRelativeTime();
+	if (now - m_lastMeshingPassTime >= kMeshingPeriod && !m_isMeshingPassPending.exchange(true))
+	{
+		m_lastMeshingPassTime = now;
+		m_meshingQueue.Schedule([this]() { StartMeshingPass(); });
+	}
 }
 
 void SurfaceMapping::ConvertMesh(winrt::Windows::Perception::Spatial::Surfaces::SpatialSurfaceMesh sourceMesh, shared_ptr<Mesh> destinationMesh)
@@ -1202,10 +1274,10 @@ QRCodeTracker::QRCodeTracker()
 {
 	if (winrt::Microsoft::MixedReality::QR::QRCodeWatcher::IsSupported())
 	{
-		thread requestAccessThread([this]()
+		// Completed on a system thread, no thread waits for the user answer
+		winrt::Microsoft::MixedReality::QR::QRCodeWatcher::RequestAccessAsync().Completed([this](auto const& operation, winrt::Windows::Foundation::AsyncStatus status)
 		{
-			auto permissionResult = winrt::Microsoft::MixedReality::QR::QRCodeWatcher::RequestAccessAsync().get();
-			if (permissionResult == winrt::Microsoft::MixedReality::QR::QRCodeWatcherAccessStatus::Allowed)
+			if (status == winrt::Windows::Foundation::AsyncStatus::Completed && operation.GetResults() == winrt::Microsoft::MixedReality::QR::QRCodeWatcherAccessStatus::Allowed)
 			{
 				m_qrWatcher = winrt::Microsoft::MixedReality::QR::QRCodeWatcher();
 
@@ -1218,8 +1290,6 @@ QRCodeTracker::QRCodeTracker()
 				m_trackingStartTime = Timer::GetFileTime();
 			}
 		});
-
-		requestAccessThread.detach();
 	}
 }
 
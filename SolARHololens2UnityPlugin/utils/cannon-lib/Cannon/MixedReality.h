@@ -28,11 +28,16 @@
 #endif
 
 #include "Common/Intersectable.h"
+#include "HeadPoseHistory.h"
+#include "LockProfiler.h"
+#include "TaskExecutor.h"
 #include "DrawCall.h"
 
 #include <d3d11.h>
 #include <DirectXMath.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <vector>
 #include <map>
@@ -168,7 +173,9 @@ public:
 	void Update();
 
 	long long GetPredictedDisplayTime();
+	// Interpolated from the poses recorded by Update() when the timestamp is in their window, else queried from the system
 	bool GetHeadPoseAtTimestamp(long long fileTimeTimestamp, DirectX::XMVECTOR& position, DirectX::XMVECTOR& direction, DirectX::XMVECTOR& up);	// timestamp is FILETIME
+	const HeadPoseHistory& GetHeadPoseHistory() const { return m_headPoseHistory; }
 
 	const DirectX::XMVECTOR& GetHeadPosition();
 	const DirectX::XMVECTOR& GetHeadForwardDirection();
@@ -255,6 +262,11 @@ private:
 	DirectX::XMVECTOR m_headUpDirection;
 	DirectX::XMVECTOR m_gravityDirection;
 
+	// Head poses at the predicted display time of each frame, in the coordinate system they were
+	// recorded in (history is cleared when the world coordinate system changes)
+	HeadPoseHistory m_headPoseHistory;
+	winrt::Windows::Perception::Spatial::SpatialCoordinateSystem m_headPoseHistoryCoordinateSystem{ nullptr };
+
 	std::string m_worldCoordinateSystemQRCodeValue;
 
 	bool m_isArticulatedHandTrackingAPIAvailable;	// True if articulated hand tracking API is available
@@ -286,6 +298,7 @@ public:
 
 	// If mesh draw is enabled, this class will automatically create draw calls to go with each mesh for debug viz
 	SurfaceMapping(winrt::Windows::Perception::Spatial::SpatialStationaryFrameOfReference const& referenceFrame);
+	~SurfaceMapping();
 
 	// Returns true once at least one mesh has been processed
 	bool IsActive();
@@ -346,24 +359,49 @@ private:
 	SurfaceDrawMode m_surfaceDrawMode;
 
 	XMVECTOR m_headPosition;
-	std::mutex m_headPositionMutex;
+	ProfiledMutex m_headPositionMutex{ "SurfaceMapping::m_headPositionMutex" };
 
 	std::map<winrt::guid, MeshRecord> m_meshRecords;
 	std::vector<winrt::guid> m_meshRecordIDsToErase;
-	std::mutex m_meshRecordsMutex;
+	ProfiledMutex m_meshRecordsMutex{ "SurfaceMapping::m_meshRecordsMutex" };
 
 	unsigned m_numberOfSurfacesInProcessingQueue;
-	std::mutex m_numberOfSurfacesInProcessingQueueMutex;
+	ProfiledMutex m_numberOfSurfacesInProcessingQueueMutex{ "SurfaceMapping::m_numberOfSurfacesInProcessingQueueMutex" };
 
 	std::vector<MeshRecord> m_newMeshRecords;
-	std::mutex m_newMeshRecordsMutex;
-
-	std::unique_ptr<std::thread> m_surfaceObservationThread;
+	ProfiledMutex m_newMeshRecordsMutex{ "SurfaceMapping::m_newMeshRecordsMutex" };
 
 	typedef std::pair<long long, winrt::Windows::Perception::Spatial::Surfaces::SpatialSurfaceInfo> TimestampSurfacePair;
+
+	// Meshing runs as Background tasks of the shared executor, a pass every kMeshingPeriod at most,
+	// scheduled by Update(). A pass starts the computation of one surface, whose completion
+	// schedules the conversion of the mesh, which ends the pass.
+	static constexpr long long kMeshingPeriod = 50 * 10000;	// hundreds of nanoseconds
+	SerialTaskQueue m_meshingQueue{ TaskExecutor::GetShared(), TaskPriority::Background };
+	std::atomic<bool> m_isMeshingPassPending = false;
+	long long m_lastMeshingPassTime = 0;
+	// Used by the meshing tasks only
+	std::vector<TimestampSurfacePair> m_surfacesToProcess;
+	// Mesh computations started by the passes and not converted yet
+	unsigned m_pendingMeshings = 0;
+	ProfiledMutex m_pendingMeshingsMutex{ "SurfaceMapping::m_pendingMeshingsMutex" };
+	std::condition_variable_any m_pendingMeshingsCondVar;
+
+	// State of the access request, shared with its completion handler which may run after the
+	// destruction: the request is not waited for, only canceled
+	struct AccessRequest
+	{
+		std::atomic<bool> isRequested = false;
+		std::atomic<bool> isAllowed = false;
+	};
+	std::shared_ptr<AccessRequest> m_accessRequest = std::make_shared<AccessRequest>();
+	// Used by the meshing tasks, then by the destructor
+	winrt::Windows::Foundation::IAsyncOperation<winrt::Windows::Perception::Spatial::SpatialPerceptionAccessStatus> m_accessOperation{ nullptr };
+
 	void CreaterObserverIfNeeded();
 	void GetLatestSurfacesToProcess(std::vector<TimestampSurfacePair>& surfacesToProcess);
-	void SurfaceObservationThreadFunction();
+	void StartMeshingPass();
+	void AddMeshRecord(winrt::Windows::Perception::Spatial::Surfaces::SpatialSurfaceMesh sourceMesh);
 	void ConvertMesh(winrt::Windows::Perception::Spatial::Surfaces::SpatialSurfaceMesh sourceMesh, std::shared_ptr<Mesh> destinationMesh);
 };
 